@@ -26,6 +26,7 @@ OPTION(X11 "X11 clipboard / notify" Yes)
 OPTION(HAWKNL_BUILTIN "HawkNL builtin support" Yes)
 OPTION(LIBZIP_BUILTIN "LibZIP builtin support" No)
 OPTION(LIBLUA_BUILTIN "LibLua builtin support" Yes)
+OPTION(LUAJIT "Use LuaJIT instead of the Lua 5.1 interpreter (libs/luajit submodule or system package)" No)
 OPTION(STLPORT "STLport support" No)
 OPTION(GCOREDUMPER "Google Coredumper support" No)
 OPTION(PCH "Precompiled header (CMake 2.6 only)" No)
@@ -87,6 +88,10 @@ ELSE(UNIX)
 	ENDIF(WIN32)
 ENDIF(UNIX)
 
+IF (LUAJIT)
+	SET(LIBLUA_BUILTIN OFF) # LuaJIT replaces it, also where the platform wants the builtin Lua
+ENDIF (LUAJIT)
+
 
 MESSAGE( "SYSTEM_DATA_DIR = ${SYSTEM_DATA_DIR}" )
 MESSAGE( "DEBUG = ${DEBUG}" )
@@ -96,6 +101,7 @@ MESSAGE( "X11 = ${X11}" )
 MESSAGE( "HAWKNL_BUILTIN = ${HAWKNL_BUILTIN}" )
 MESSAGE( "LIBZIP_BUILTIN = ${LIBZIP_BUILTIN}" )
 MESSAGE( "LIBLUA_BUILTIN = ${LIBLUA_BUILTIN}" )
+MESSAGE( "LUAJIT = ${LUAJIT}" )
 MESSAGE( "STLPORT = ${STLPORT}" )
 MESSAGE( "GCOREDUMPER = ${GCOREDUMPER}" )
 MESSAGE( "HASBFD = ${HASBFD}" )
@@ -195,6 +201,29 @@ IF (LIBZIP_BUILTIN)
 	SET(ALL_SRCS ${ALL_SRCS} ${LIBZIP_SRCS})
 ENDIF (LIBZIP_BUILTIN)
 
+IF (LUAJIT)
+	ADD_DEFINITIONS(-DLUA_JIT)
+	IF(EXISTS ${OLXROOTDIR}/libs/luajit/src/luajit.h)
+		# Submodule is checked out, build the static library with its own Makefile
+		SET(LUAJIT_SRCDIR ${OLXROOTDIR}/libs/luajit/src)
+		SET(LUAJIT_LIBRARY ${LUAJIT_SRCDIR}/libluajit.a)
+		ADD_CUSTOM_COMMAND(OUTPUT ${LUAJIT_LIBRARY}
+			COMMAND make -C ${LUAJIT_SRCDIR} libluajit.a BUILDMODE=static
+			COMMENT "Building LuaJIT")
+		ADD_CUSTOM_TARGET(luajit DEPENDS ${LUAJIT_LIBRARY})
+		SET(LUAJIT_BUILD_TARGET luajit)
+		INCLUDE_DIRECTORIES(${LUAJIT_SRCDIR})
+	ELSE(EXISTS ${OLXROOTDIR}/libs/luajit/src/luajit.h)
+		EXEC_PROGRAM(pkg-config ARGS luajit --cflags-only-I --silence-errors OUTPUT_VARIABLE LUAJIT_CFLAGS)
+		STRING(REGEX REPLACE "[\r\n]" "" LUAJIT_CFLAGS "${LUAJIT_CFLAGS}")
+		STRING(REGEX REPLACE "^-I" "" LUAJIT_SEARCHDIR "${LUAJIT_CFLAGS}")
+		IF(NOT LUAJIT_SEARCHDIR)
+			MESSAGE(WARNING "No LuaJIT found by pkg-config. Run 'git submodule update --init libs/luajit' or install the LuaJIT development package")
+		ELSE(NOT LUAJIT_SEARCHDIR)
+			INCLUDE_DIRECTORIES(${LUAJIT_SEARCHDIR})
+		ENDIF(NOT LUAJIT_SEARCHDIR)
+	ENDIF(EXISTS ${OLXROOTDIR}/libs/luajit/src/luajit.h)
+ELSE (LUAJIT)
 IF (LIBLUA_BUILTIN)
 	INCLUDE_DIRECTORIES(${OLXROOTDIR}/libs/lua)
 	AUX_SOURCE_DIRECTORY(${OLXROOTDIR}/libs/lua LIBLUA_SRCS)
@@ -228,6 +257,7 @@ ELSE (LIBLUA_BUILTIN)
 		MESSAGE(WARNING "No Lua header directory found. Make sure that Lua 5.1 development packages are installed, or use the built-in library")
 	ENDIF(LUA_SEARCHDIR)
 ENDIF (LIBLUA_BUILTIN)
+ENDIF (LUAJIT)
 
 IF (STLPORT)
 	INCLUDE_DIRECTORIES(/usr/include/stlport)
@@ -402,7 +432,21 @@ if(UNIX)
 	IF (NOT LIBZIP_BUILTIN)
 		SET(LIBS ${LIBS} zip)
 	ENDIF (NOT LIBZIP_BUILTIN)
-	IF (NOT LIBLUA_BUILTIN)
+	IF (LUAJIT)
+		IF(NOT LUAJIT_LIBRARY)
+			EXEC_PROGRAM(pkg-config ARGS luajit --libs --silence-errors OUTPUT_VARIABLE LUAJIT_LIBRARY)
+			STRING(REGEX REPLACE "[\r\n]" " " LUAJIT_LIBRARY "${LUAJIT_LIBRARY}")
+		ENDIF(NOT LUAJIT_LIBRARY)
+		IF(NOT LUAJIT_LIBRARY)
+			SET(LUAJIT_LIBRARY luajit-5.1)
+		ENDIF(NOT LUAJIT_LIBRARY)
+		SET(LIBS ${LIBS} ${LUAJIT_LIBRARY} dl)
+		IF(APPLE)
+			# LuaJIT 2.0 on x64 needs its memory in the lower 2GB
+			SET(CMAKE_EXE_LINKER_FLAGS "${CMAKE_EXE_LINKER_FLAGS} -pagezero_size 10000 -image_base 100000000")
+		ENDIF(APPLE)
+	ENDIF (LUAJIT)
+	IF (NOT LIBLUA_BUILTIN AND NOT LUAJIT)
 		EXEC_PROGRAM(pkg-config ARGS lua5.1 --libs --silence-errors OUTPUT_VARIABLE LIBLUA_NAME) #Search for lua5.1 first because newer versions seem to be incompatible
 		IF(NOT LIBLUA_NAME)
 			EXEC_PROGRAM(pkg-config ARGS lua-5.1 --libs --silence-errors OUTPUT_VARIABLE LIBLUA_NAME) #On some systems, e.g. Fedora, it may be lua-5.1
@@ -419,7 +463,7 @@ if(UNIX)
 			SET(LIBLUA_NAME lua) #Set default if nothing works, although this will likely lead to errors
 		ENDIF(NOT LIBLUA_NAME)
 		SET(LIBS ${LIBS} ${LIBLUA_NAME})
-	ENDIF (NOT LIBLUA_BUILTIN)
+	ENDIF (NOT LIBLUA_BUILTIN AND NOT LUAJIT)
 	IF(X11)
 		SET(LIBS ${LIBS} X11)
 	ENDIF(X11)
@@ -24,6 +24,7 @@
 
 
 #include "SmartPointer.h"
+#include "DirtyRects.h"
 
 
 // Routines
@@ -71,12 +72,20 @@ void doVppOperation(Action* act);
 void EnableSystemMouseCursor(bool enable = true);
 
 class VideoPostProcessor {
+public:
+	VideoPostProcessor() : m_buffersEqual(false), m_forceFullUpload(true) {}
 protected:
 	SmartPointer<SDL_Window> m_window;
 	SmartPointer<SDL_Renderer> m_renderer;
 	SmartPointer<SDL_Texture> m_videoTexture;
 	SmartPointer<SDL_Surface> m_videoSurface;
 	SmartPointer<SDL_Surface> m_videoBufferSurface;
+	// Where m_videoTexture differs from m_videoBufferSurface
+	DirtyRects m_textureDirty;
+	// Set by cloneBuffer(), so that flipBuffers() knows that the swap doesn't change anything
+	bool m_buffersEqual;
+	// Set by invalidate(), which may be called from any thread
+	volatile bool m_forceFullUpload;
 	static VideoPostProcessor instance;
 	
 public:
@@ -86,7 +95,11 @@ public:
 	// IMPORTANT: only call these from the main thread
 	static void process();
 	static void render();
+	// Makes the video buffer equal to the video surface. Only the changed parts are copied,
+	// and only those are uploaded by the next process(). Nothing must draw between this and the flip.
 	static void cloneBuffer();
+	// Forces a full upload with the next process(). Call this when writing to the video buffer directly.
+	static void invalidate();
 
 public:
 	static VideoPostProcessor* get() { return &instance; }
@@ -18,41 +18,66 @@
 #define __CBANLIST_H__
 
 #include <string>
+#include <vector>
+#include <map>
+#include <boost/unordered_map.hpp>
+#include <SDL_stdinc.h>
 
 
 // Ban List structure
 class banlist_t { public:
 
     std::string szNick;
-    std::string szAddress;
-
-    banlist_t   *psNext;
-    banlist_t   *psLink;        // For sorted array
+    std::string szAddress;	// A single IP, a range ("1.2.3.0/24" or "1.2.*") or something else we compare as text
 
 };
 
 
 // Ban List class
+// Lookups don't depend on the size of the list: single IPs are in a hash map, ranges in a binary
+// prefix trie, both keyed by the numeric address.
 class CBanList {
 private:
     // Attributes
 
-    banlist_t   *m_psBanList;
-    banlist_t   *m_psSortedList;
-    int         m_nCount;
+	// Addresses of one subnet differ only in some bits, spread them over the whole hash
+	struct IPHash {
+		size_t operator()(Uint32 ip) const { ip ^= ip >> 16; ip *= 0x45d9f3bu; ip ^= ip >> 16; return ip; }
+	};
+
+	struct TrieNode {
+		int			child[2];
+		banlist_t	*entry;
+		TrieNode() : entry(NULL) { child[0] = child[1] = -1; }
+	};
+
+    std::vector<banlist_t *>	m_entries;		// In the order they were added
+	boost::unordered_map<Uint32, banlist_t *, IPHash>	m_exact;
+	std::vector<TrieNode>		m_ranges;		// [0] is the root
+	std::map<std::string, banlist_t *>	m_other;	// Lowercase
 	std::string	m_szPath;
 	bool		m_bLoading;
 
+	static bool	parseIP(const std::string& s, size_t& pos, Uint32& ip);
+	static bool	parseRange(const std::string& s, Uint32& ip, int& prefixLen);
+	static std::string	normalizeAddress(const std::string& szAddress);
 
+	void		indexEntry(banlist_t *entry);
+	void		unindexEntry(banlist_t *entry);
+	banlist_t	*findEntry(const std::string& addr);
+	bool		addEntry(const std::string& szAddress, const std::string& szNick);
+	int			readList(const std::string& szFilename);
 
 public:
     // Methods
 
     // Constructor
     CBanList();
+	~CBanList() { Shutdown(); }
 
     void        loadList(const std::string& szFilename);
     void        saveList(const std::string& szFilename);
+	int			importList(const std::string& szFilename); // Adds the entries of another list, returns how many
     void        Shutdown();
 
     bool        isBanned(const std::string& szAddress);
@@ -61,15 +86,12 @@ public:
 	void		removeBanned(const std::string& stAddress);
     banlist_t   *findBanned(const std::string& szAddress);
 
-    void        sortList();
 	void		Clear();
 
-    banlist_t   *getList();
     int         getNumItems();
 
 	std::string getPath();
 	banlist_t	*getItemById(int ID);
-	int			getIdByAddr(const std::string& szAddress);
 
 };
 
@@ -18,6 +18,7 @@
 #define __CCHANNEL_H__
 
 #include <list>
+#include <string>
 #include "CBytestream.h"
 #include "olx-types.h"
 #include "Networking.h"
@@ -94,6 +95,42 @@ public:
 };
 
 
+// Estimates how many bytes per second the other side of a channel can take.
+// It is fed with the RTT measurements and retransmissions of the channel:
+// the budget grows while the acks come back in time, and shrinks when packets
+// get lost or the RTT rises above the lowest one seen (a queue is building up
+// on the way). The server doesn't send more than getBudget() to a client.
+class SendRateController {
+public:
+	SendRateController() { Clear(); }
+
+	void		Clear();
+
+	void		onSent(size_t bytes)	{ iSentSinceIncrease += bytes; }
+	void		onRtt(int rttMs);
+	// We had to resend because the other side did not get something
+	void		onLoss();
+
+	float		getBudget() const		{ return fBudget; }
+	float		getSmoothedRtt() const	{ return fSmoothedRtt; }
+	float		getMinRtt() const		{ return fMinRtt; }
+	std::string	stats() const;
+
+private:
+	bool		decrease(float factor);
+
+	float		fBudget;			// Bytes per second
+	float		fSmoothedRtt;		// In ms, 0 until the first measurement
+	float		fMinRtt;
+	bool		bSlowStart;			// Double the budget each RTT until the first loss
+	AbsTime		fLastIncrease;
+	AbsTime		fLastDecrease;
+	size_t		iSentSinceIncrease;
+	size_t		iLossEvents;
+	size_t		iDelayEvents;
+};
+
+
 class CChannel {
 	
 protected:
@@ -114,6 +151,8 @@ protected:
 	int				iPing;								// current ping
 	AbsTime			fLastPingSent;
 
+	SendRateController	cSendRate;
+
 	// Statistics
 	size_t			iPacketsDropped;
 	size_t			iPacketsGood;
@@ -165,6 +204,9 @@ public:
 	float 			getIncomingRate()		{ return cIncomingRate.getRate(); }
 	float 			getOutgoingRate()		{ return cOutgoingRate.getRate(); }
 	float 			getOutgoingRate(float timeRange)		{ return cOutgoingRate.getRate((int)(timeRange * 1000.0f)); }
+
+	const SendRateController& getSendRate() const	{ return cSendRate; }
+	float			getSendBudget() const	{ return cSendRate.getBudget(); }
 		
 	SmartPointer<NetworkSocket>	getSocket()			{ return Socket; }
 	
@@ -355,5 +397,6 @@ public:
 };
 
 void TestCChannelRobustness();
+void TestCChannelSendRate();
 
 #endif  //  __CCHANNEL_H__
@@ -54,6 +54,8 @@ struct profile_t;
 class FlagInfo;
 struct ClientConnectionRequestInfo;
 struct GameState;
+class DemoRecorder;
+class DemoPlayer;
 
 // TODO: this is just a small helper for now; some of these parts should just move into CClient::Connect
 bool JoinServer(const std::string& addr, const std::string& name, const std::string& player);
@@ -96,6 +98,24 @@ struct game_log_t {
 };
 
 
+// What the scoreboard shows, so that UpdateIngameScore only touches the rows which changed
+struct ScoreboardRow {
+	ScoreboardRow() : wormId(-1), version(0), highlight(false), hasSkin(false), unlimitedLives(false), ping(-1) {}
+	int			wormId;
+	Uint32		version; // ScoreRoster::rowVersion
+	std::string	name;
+	Color		nameColour;
+	bool		highlight;
+	bool		hasSkin; // The listview skips image subitems without image
+	bool		unlimitedLives; // Image instead of text in the lives column
+	std::string	state; // Lives or ready
+	Color		stateColour;
+	std::string	kills;
+	std::string	damage;
+	int			ping; // -1 if there is none
+};
+
+
 struct interface_sett {
 	int		ChatterX;
 	int		ChatterY;
@@ -268,6 +288,8 @@ private:
 	// Ingame scoreboard
 	SmartPointer<SDL_Surface> bmpIngameScoreBg;
 	DeprecatedGUI::CGuiLayout	cScoreLayout;
+	std::vector<ScoreboardRow> tScoreboardRows;
+	int			iScoreboardLayout; // -1 means rebuild
 
 	// Bonus's
 	CBonus		*cBonuses;
@@ -319,6 +341,8 @@ private:
 	SmartPointer<NetworkSocket>	tSocket;
 	CChannel	* cNetChan;
 	CBytestream	bsUnreliable;
+	DemoRecorder* demoRecorder; // set while we record a network game, see Demo.h
+	DemoPlayer* demoPlayer; // set while we play a demo instead of being connected
 	CShootList	cShootList;
     AbsTime      fZombieTime;
 	AbsTime		fLastUpdateSent;
@@ -490,6 +514,11 @@ public:
 
 	bool		ReadPackets();
 	void		SendPackets(bool sendPendingOnly = false);
+
+	bool		PlayDemo(const std::string& file, float speed, std::string& err);
+	void		StopDemo();
+	DemoRecorder* getDemoRecorder()		{ return demoRecorder; }
+	DemoPlayer*	getDemoPlayer()			{ return demoPlayer; }
 	void		SendGameStateUpdates();
 
 	void		InitializeDownloads();
@@ -22,6 +22,8 @@
 
 #include <SDL.h>
 #include <vector>
+#include <list>
+#include <map>
 #include "Unicode.h"
 #include "SmartPointer.h"
 #include "Color.h"
@@ -43,6 +45,7 @@ public:
 		Spacing = 1;
 		VSpacing = 3;
 		NumCharacters = 0;
+		iTextRunBytes = 0;
 	}
 
 
@@ -65,6 +68,33 @@ private:
 	Color f_white;
 	Color f_green;
 
+	// Cache of pre-composited text runs, so that the same strings drawn every frame
+	// (scoreboard, chat, names, HUD) cost one blit instead of one blit per glyph
+	struct TextRunKey {
+		std::string	text;
+		Color		col;
+		int			width; // Width limit, already clamped to the text width
+		int			vspacing;
+		bool operator<(const TextRunKey& k) const {
+			if (width != k.width) return width < k.width;
+			if (col != k.col) return col < k.col;
+			if (vspacing != k.vspacing) return vspacing < k.vspacing;
+			return text < k.text;
+		}
+	};
+	typedef std::list<const TextRunKey *> TextRunLRU;
+	struct TextRun {
+		SmartPointer<SDL_Surface>	bmpRun;
+		size_t						iBytes;
+		TextRunLRU::iterator		lruIt;
+	};
+	typedef std::map<TextRunKey, TextRun> TextRunCache;
+
+	TextRunCache					tTextRuns;
+	TextRunLRU						tTextRunLRU; // Most recently used at the front
+	size_t							iTextRunBytes;
+	std::map<std::string, int>		tWidthCache;
+
 public:
 	// Methods
 
@@ -80,8 +110,11 @@ public:
 	void				DrawGlyph(SDL_Surface *dst, int x, int y, Color col, UnicodeChar c);
 
 	void				Shutdown();
+	void				ClearTextCache();
 
 	INLINE void			SetOutline(bool _o)  {
+		if (OutlineFont != _o)
+			ClearTextCache();
 		OutlineFont = _o;
 	}
 	INLINE bool			IsOutline()  {
@@ -108,6 +141,8 @@ public:
 	INLINE bool			CanDisplayCharacter (UnicodeChar c)  { return (c < FIRST_CHARACTER + NumCharacters) && (c >= FIRST_CHARACTER); }
 
 	INLINE void			SetSpacing(int _s)  {
+		if (Spacing != _s)
+			ClearTextCache();
 		Spacing = _s;
 	}
 	INLINE int			GetSpacing()		 {
@@ -122,6 +157,11 @@ public:
 private:
 	bool				IsColumnFree(int x);
 	void				Parse();
+	SmartPointer<SDL_Surface> GetPrecachedSurface(Color col);
+	SmartPointer<SDL_Surface> GetTextRun(const std::string& txt, Color col, int width);
+	SmartPointer<SDL_Surface> RenderTextRun(const std::string& txt, Color col, int width);
+	void				DrawAdvDirect(SDL_Surface * dst, int x, int y, int max_w, Color col, const std::string& txt);
+	int					CalculateWidth(const std::string& buf);
 	void				PreCalculate(const SmartPointer<SDL_Surface> & bmpSurf, Color colour);
 	
 	// Internal functions for glyph drawing, first one for normal fonts, second one for outline fonts
@@ -134,9 +134,13 @@ public:
 	bool		isLoaded() const { return loaded; }
 	
 private:
+	bool		Write(FILE *fp);
 	proj_t		*LoadProjectile(FILE *fp, bool loadImagesAndSounds = true);
 	bool		SaveProjectile(proj_t *proj, FILE *fp);
 
+	// Source mods are compiled only once, see CompiledModCache in CGameScript.cpp
+	bool		SaveCompiled(const std::string& dir, const std::string& sig);
+
 public:
 	size_t		GetMemorySize();
 	std::string	getError(int code);
@@ -25,6 +25,8 @@
 #include "HTTP.h"
 #include "Timer.h"
 #include "CBanList.h"
+#include "ChallengeTable.h"
+#include "RateLimiter.h"
 #include "game/GameMode.h"
 
 class CWorm;
@@ -42,14 +44,6 @@ enum {
 };
 
 
-// Challenge structure
-class challenge_t { public:
-	NetworkAddr	Address;
-	AbsTime		fTime;
-	int			iNum;
-	std::string	sClientVersion;
-};
-
 // Client leaving reasons
 enum {
 	CLL_QUIT=0,
@@ -100,8 +94,8 @@ private:
 	int				nPort;
 	typedef std::list< SmartPointer<NatConnection> > NatConnList;
 	NatConnList	tNatClients;
-	challenge_t		tChallenges[MAX_CHALLENGES]; // TODO: use std::list or vector
-	CShootList		cShootList;
+	ChallengeTable	tChallenges;
+	CShotJournal	cShotJournal;
 	CHttp			tHttp;
 	CHttp			tHttp2;
 	bool			bLocalClientConnected;
@@ -128,6 +122,21 @@ private:
 	
 	std::string	netError;
 
+	// Replies to lx::query and lx::getinfo, every browser asks the same. Rebuilt when the
+	// game state or the worms change, otherwise after Network.QueryReplyCacheTime.
+	struct ConnectionlessReply {
+		std::string	data;
+		size_t		patchPos; // The query number in lx::queryreturn
+		AbsTime		built;
+		int			state;
+		int			worms;
+		bool		valid;
+		ConnectionlessReply() : patchPos(0), state(0), worms(0), valid(false) {}
+	};
+	ConnectionlessReply	m_queryReply;
+	ConnectionlessReply	m_infoReply;
+	SourceRateLimiter	m_queryLimiter; // Per IP, for the connectionless queries
+
 	friend class CServerNetEngine;
 	friend class CServerNetEngineBeta7;
 	friend class CServerNetEngineBeta9;
@@ -244,6 +253,11 @@ public:
 	
 	// Connectionless packets only here
 	void		ParseConnectionlessPacket(const SmartPointer<NetworkSocket>& tSocket, CBytestream *bs, const std::string& ip);
+	bool		allowConnectionlessQuery(const std::string& ip);
+	bool		isReplyCached(const ConnectionlessReply& r);
+	void		cacheReply(ConnectionlessReply& r, const std::string& data);
+	void		invalidateConnectionlessReplies();
+	const SourceRateLimiter& getQueryLimiter() const { return m_queryLimiter; }
 	void		ParseGetChallenge(const SmartPointer<NetworkSocket>& tSocket, CBytestream *bs);
 	void		ParseConnect(const SmartPointer<NetworkSocket>& tSocket, CBytestream *bs);
 	void		ParsePing(const SmartPointer<NetworkSocket>& tSocket);
@@ -258,6 +272,7 @@ public:
 	// Variables
 	FlagInfo*		flagInfo() const	{ return m_flagInfo; }
 	CBanList		*getBanList()		{ return &cBanList; }
+	CShotJournal	*getShotJournal()	{ return &cShotJournal; }
 	CServerConnection *getClient(int iWormID);
 	CHttp *getHttp()  { return &tHttp; }
 	CServerConnection* getClients() { return cClients; }
@@ -81,7 +81,7 @@ private:
 	CChannel	* cNetChan;
 	CBytestream	bsUnreliable;
 
-	CShootList	cShootList;
+	CShotJournal::Cursor	iShotCursor; // Position in GameServer::cShotJournal
 public:
 	GameState*	gameState;
 private:
@@ -148,7 +148,7 @@ public:
 	int			getNetSpeed()				{ return iNetSpeed; }
 	void		setNetSpeed(int _n)			{ iNetSpeed = _n; }
 
-	CShootList	*getShootList()				{ return &cShootList; }
+	CShotJournal::Cursor& getShotCursor()	{ return iShotCursor; }
 
     void        setZombieTime(const AbsTime& z)      { fZombieTime = z; }
     AbsTime       getZombieTime()      	   { return fZombieTime; }
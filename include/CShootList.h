@@ -18,6 +18,10 @@
 #define __CSHOOTLIST_H__
 
 
+#include <deque>
+#include <string>
+#include "CodeAttributes.h"
+
 class CBytestream;
 class CWorm;
 struct Version;
@@ -107,6 +111,9 @@ public:
 	bool		addShoot(int weaponID, TimeDiff serverTime, float fSpeed, int nAngle, CWorm *pcWorm, bool release);
 
 	bool		writePacket(CBytestream *bs, const Version& receiverVer);
+	// writePacket() gives the same bytes for all versions with the same variant
+	static int	encodingVariant(const Version& receiverVer);
+	enum { EncodingVariants = 2 };
 	
 private:
 	void		writeSingle(CBytestream *bs, const Version& receiverVer, int index);
@@ -134,4 +141,51 @@ public:
 
 
 
+// Shots of all worms on the server side, each one stored only once.
+// The shots are collected in segments, one per server update. A sealed segment is encoded once per
+// encoding variant and these bytes are sent to every connection. Every connection only keeps
+// a cursor, see CServerConnection::getShotCursor().
+class CShotJournal : DontCopyTag {
+public:
+	typedef Uint64 Cursor;
+
+	CShotJournal() : m_first(0), m_open(NULL) {}
+	~CShotJournal() { Clear(); }
+
+private:
+	enum { MaxSegments = 256 }; // Connections which don't get updates for so long miss the oldest shots
+
+	struct Segment {
+		Segment() { shots.Initialize(); for(int i = 0; i < CShootList::EncodingVariants; i++) isEncoded[i] = false; }
+		CShootList	shots;
+		bool		isEncoded[CShootList::EncodingVariants];
+		std::string	encoded[CShootList::EncodingVariants];
+	};
+
+	std::deque<Segment*> m_segments; // Sealed ones
+	Cursor		m_first; // Cursor of m_segments.front()
+	Segment		*m_open;
+
+	void		dropFront();
+
+public:
+	// Cursors stay valid, they just don't see any of the old shots anymore
+	void		Clear();
+
+	bool		addShoot(int weaponID, TimeDiff serverTime, float fSpeed, int nAngle, CWorm *pcWorm, bool release);
+	// Makes the shots added since the last call available for sending
+	void		seal();
+	// Forget the segments every connection has already got
+	void		trim(Cursor oldestInUse);
+
+	// Cursor of a connection which has got everything
+	Cursor		end() const		{ return m_first + m_segments.size(); }
+	bool		hasPending(Cursor c) const	{ return c < end(); }
+	// When the oldest shot the connection hasn't got yet was added
+	AbsTime		getPendingStartTime(Cursor c);
+	// Writes all shots from c on and moves c to the end
+	void		writePacket(CBytestream *bs, const Version& receiverVer, Cursor& c);
+};
+
+
 #endif  //  __CSHOOTLIST_H__
@@ -28,6 +28,7 @@
 #include <cassert>
 #include "SmartPointer.h"
 #include "olx-types.h"
+#include "Mutex.h"
 
 // these forward-declaration are needed here
 // they will be declared in CMap.h and CGameScript.h
@@ -37,15 +38,14 @@ class CGameScript;
  
 class CCache  {
 public:
-	CCache() { mutex = SDL_CreateMutex(); };
-	~CCache() { SDL_DestroyMutex(mutex); };
+	CCache() : lastShrinkFailedSize(0) {}
 	CCache(const CCache&) { assert(false); }
 	CCache& operator=(const CCache&) { assert(false); return *this; }
 	void Clear();
 	void ClearSounds();
-	void ClearExtraEntries(); // Clears cache partially - should be called from time to time
+	void ClearExtraEntries(); // Evicts the least recently used entries until we are within the limits (Advanced.CacheMaxSize, Advanced.MaxCachedEntries)
 
-	SmartPointer<SDL_Surface>	GetImage__unsafe(const std::string& file);
+	SmartPointer<SDL_Surface>	GetImage(const std::string& file);
 	SmartPointer<SoundSample>	GetSound(const std::string& file);
 	SmartPointer<CMap>			GetMap(const std::string& file);
 	SmartPointer<CGameScript>	GetMod(const std::string& dir);
@@ -54,7 +54,8 @@ public:
 	// no copying is done, so it is required to use SmartPointer returned,
 	// if you don't want cache system to delete your image right after you've loaded it.
 	// Oh, don't ever call gfxFreeSurface() or FreeSoundSample() - cache will do that for you.
-	void	SaveImage__unsafe(const std::string& file, const SmartPointer<SDL_Surface> & img);
+	// If another thread has saved the same image meanwhile, that one is kept and returned.
+	SmartPointer<SDL_Surface>	SaveImage(const std::string& file, const SmartPointer<SDL_Surface> & img);
 	void	SaveSound(const std::string& file, const SmartPointer<SoundSample> & smp);
 	void	SaveMod(const std::string& dir, const SmartPointer<CGameScript> & mod);
 	// Map is copied to cache, 'cause it will be modified during game - you should free your data yourself.
@@ -62,60 +63,212 @@ public:
 	size_t	GetCacheSize();
 	size_t	GetEntryCount();
 
-	SDL_mutex* mutex;
+	enum ItemType { IT_Image = 0, IT_Sound, IT_Map, IT_Mod, IT_Count };
+	static const char* ItemTypeName(ItemType t);
 
-private:
-	class CacheItem_t { public:
-		//virtual ~CacheItem_t() {} // TODO: do we need this when there is no other virtual function? 
-		CacheItem_t() : fSaveTime(0), iFileTimeStamp(0) {}
-		CacheItem_t(const CacheItem_t& oth)  { operator=(oth); }
-		CacheItem_t(const AbsTime& savetime, Uint64 timestamp) : fSaveTime(savetime), iFileTimeStamp(timestamp) {}
-		// TODO: this op= was virtual; was there any reason for this? (no other class had overloaded it)
-		CacheItem_t& operator=(const CacheItem_t& oth)  { if (&oth != this) { fSaveTime = oth.fSaveTime; iFileTimeStamp = oth.iFileTimeStamp; } return *this; }
-		AbsTime	fSaveTime;
-		Uint64	iFileTimeStamp;
+	struct Stats {
+		Stats() : entries(0), bytes(0), hits(0), misses(0), evictions(0) {}
+		size_t entries;
+		size_t bytes;
+		Uint64 hits;
+		Uint64 misses;
+		Uint64 evictions;
 	};
+	Stats GetStats(ItemType t);
 
-	class ImageItem_t : public CacheItem_t { public:
-		ImageItem_t() : CacheItem_t() { bmpSurf = NULL; }
-		ImageItem_t(const ImageItem_t& oth) { operator=(oth); }
-		ImageItem_t(SmartPointer<SDL_Surface> img, const AbsTime& savetime, Uint64 timestamp) : CacheItem_t(savetime, timestamp) { bmpSurf = img; }
-		ImageItem_t& operator=(const ImageItem_t& oth) { CacheItem_t::operator =(oth); if (&oth != this) { bmpSurf = oth.bmpSurf; } return *this; }
-		SmartPointer<SDL_Surface> bmpSurf;
-	};
+private:
+	/*
+	 Sharded LRU of one resource type.
+	 The name decides the shard, every shard has its own mutex, so loaders for different files
+	 don't wait for each other. In every shard, the entries are in an intrusive doubly linked
+	 list, most recently used first, so a hit and an eviction are O(1) (plus the map lookup).
+	 */
+	template<typename _T>
+	class Store {
+	public:
+		struct Entry {
+			std::string name; // Key, lower case
+			std::string file; // As given to Save*(), needed for the file timestamp
+			SmartPointer<_T> data;
+			Uint64 fileTimeStamp;
+			size_t bytes;
+			AbsTime lastAccess;
+			Entry* prev;
+			Entry* next;
+		};
 
-	class SoundItem_t : public CacheItem_t { public:
-		SoundItem_t() : CacheItem_t() { sndSample = NULL; }
-		SoundItem_t(const SoundItem_t& oth) { operator=(oth); }
-		SoundItem_t(SmartPointer<SoundSample> snd, const AbsTime& savetime, Uint64 timestamp) : CacheItem_t(savetime, timestamp) { sndSample = snd; }
-		SoundItem_t& operator=(const SoundItem_t& oth) { CacheItem_t::operator =(oth); if (&oth != this) { sndSample = oth.sndSample; } return *this; }
-		SmartPointer<SoundSample> sndSample;
-	};
+	private:
+		enum { Shards = 8 };
+		struct Shard {
+			Shard() : head(NULL), tail(NULL), bytes(0), hits(0), misses(0), evictions(0) {}
+			Mutex mutex;
+			std::map<std::string, Entry*> index;
+			Entry* head; // Most recently used
+			Entry* tail;
+			size_t bytes;
+			Uint64 hits, misses, evictions;
 
-	class MapItem_t : public CacheItem_t { public:
-		MapItem_t() : CacheItem_t() { tMap = NULL; }
-		MapItem_t(const MapItem_t& oth) { operator=(oth); }
-		MapItem_t(SmartPointer<CMap> map, const AbsTime& savetime, Uint64 timestamp) : CacheItem_t(savetime, timestamp) { tMap = map; }
-		MapItem_t& operator=(const MapItem_t& oth) { CacheItem_t::operator =(oth); if (&oth != this) { tMap = oth.tMap; } return *this; }
-		SmartPointer<CMap> tMap;
-	};
+			void unlink(Entry* e) {
+				if(e->prev) e->prev->next = e->next; else head = e->next;
+				if(e->next) e->next->prev = e->prev; else tail = e->prev;
+				e->prev = e->next = NULL;
+			}
+			void pushFront(Entry* e) {
+				e->prev = NULL; e->next = head;
+				if(head) head->prev = e; else tail = e;
+				head = e;
+			}
+			void erase(typename std::map<std::string, Entry*>::iterator it, SDL_atomic_t& totalBytes) {
+				Entry* e = it->second;
+				unlink(e);
+				bytes -= e->bytes;
+				SDL_AtomicAdd(&totalBytes, -(int)e->bytes);
+				index.erase(it);
+				delete e;
+			}
+		};
+		Shard shards[Shards];
+		SDL_atomic_t m_bytes; // Sum of all shards, so the size can be checked without taking all locks
+
+		Shard& shardFor(const std::string& name) {
+			size_t h = 0;
+			for(std::string::const_iterator c = name.begin(); c != name.end(); ++c)
+				h = h * 31 + (unsigned char)*c;
+			return shards[h % Shards];
+		}
+
+	public:
+		Store() { SDL_AtomicSet(&m_bytes, 0); }
+		~Store() { clear(); }
+
+		// Unsigned, so up to 4 GB
+		size_t bytes() { return (size_t)(Uint32)SDL_AtomicGet(&m_bytes); }
 
-	class ModItem_t : public CacheItem_t { public:
-		ModItem_t() : CacheItem_t() { tMod = NULL; }
-		ModItem_t(const ModItem_t& oth) { operator=(oth); }
-		ModItem_t(SmartPointer<CGameScript> mod, const AbsTime& savetime, Uint64 timestamp) : CacheItem_t(savetime, timestamp) { tMod = mod; }
-		ModItem_t& operator=(const ModItem_t& oth) { CacheItem_t::operator =(oth); if (&oth != this) { tMod = oth.tMod; } return *this; }
-		SmartPointer<CGameScript> tMod;
+		// name must be lower case. On a hit, it copies out the entry and marks it as used.
+		bool get(const std::string& name, const AbsTime& now, Entry& out) {
+			Shard& s = shardFor(name);
+			Mutex::ScopedLock lock(s.mutex);
+			typename std::map<std::string, Entry*>::iterator it = s.index.find(name);
+			if(it == s.index.end()) { s.misses++; return false; }
+			Entry* e = it->second;
+			e->lastAccess = now;
+			s.unlink(e);
+			s.pushFront(e);
+			s.hits++;
+			out = *e;
+			return true;
+		}
+
+		// Returns the data which is in the cache after the call, i.e. the old one if there was already one
+		SmartPointer<_T> put(const std::string& name, const std::string& file, const SmartPointer<_T>& data, Uint64 fileTimeStamp, size_t bytes, const AbsTime& now, bool* existed = NULL) {
+			Shard& s = shardFor(name);
+			Mutex::ScopedLock lock(s.mutex);
+			typename std::map<std::string, Entry*>::iterator it = s.index.find(name);
+			if(existed) *existed = (it != s.index.end());
+			if(it != s.index.end()) return it->second->data;
+			Entry* e = new Entry();
+			e->name = name;
+			e->file = file;
+			e->data = data;
+			e->fileTimeStamp = fileTimeStamp;
+			e->bytes = bytes + name.size();
+			e->lastAccess = now;
+			s.pushFront(e);
+			s.index[name] = e;
+			s.bytes += e->bytes;
+			SDL_AtomicAdd(&m_bytes, (int)e->bytes);
+			return data;
+		}
+
+		// Removes the entry only if it still has this data, i.e. nobody replaced it meanwhile.
+		// The get() before is then counted as a miss.
+		void eraseStale(const std::string& name, const SmartPointer<_T>& data) {
+			Shard& s = shardFor(name);
+			Mutex::ScopedLock lock(s.mutex);
+			typename std::map<std::string, Entry*>::iterator it = s.index.find(name);
+			if(it == s.index.end() || it->second->data.get() != data.get()) return;
+			s.hits--; s.misses++;
+			s.erase(it, m_bytes);
+		}
+
+		void clear() {
+			for(int i = 0; i < Shards; ++i) {
+				Mutex::ScopedLock lock(shards[i].mutex);
+				while(!shards[i].index.empty())
+					shards[i].erase(shards[i].index.begin(), m_bytes);
+			}
+		}
+
+		Stats stats() {
+			Stats r;
+			for(int i = 0; i < Shards; ++i) {
+				Mutex::ScopedLock lock(shards[i].mutex);
+				r.entries += shards[i].index.size();
+				r.bytes += shards[i].bytes;
+				r.hits += shards[i].hits;
+				r.misses += shards[i].misses;
+				r.evictions += shards[i].evictions;
+			}
+			return r;
+		}
+
+		// Evicts the least recently used entries until there are at most maxEntries entries with at most maxBytes.
+		// Entries which are still used somewhere else cannot be freed, they count as used right now.
+		// Returns the number of freed bytes.
+		size_t shrink(size_t maxBytes, size_t maxEntries, const AbsTime& now) {
+			size_t freed = 0;
+			bool exhausted[Shards] = {};
+			while(true) {
+				Stats cur = stats();
+				if(cur.bytes <= maxBytes && cur.entries <= maxEntries) break;
+
+				// The shard with the oldest tail approximates the global LRU order
+				int best = -1;
+				AbsTime bestTime;
+				for(int i = 0; i < Shards; ++i) {
+					if(exhausted[i]) continue;
+					Mutex::ScopedLock lock(shards[i].mutex);
+					if(!shards[i].tail) { exhausted[i] = true; continue; }
+					if(best < 0 || shards[i].tail->lastAccess < bestTime) {
+						best = i;
+						bestTime = shards[i].tail->lastAccess;
+					}
+				}
+				if(best < 0) break; // Everything left is in use
+
+				Shard& s = shards[best];
+				Mutex::ScopedLock lock(s.mutex);
+				size_t tries = s.index.size();
+				bool evicted = false;
+				while(s.tail && tries-- > 0) {
+					Entry* e = s.tail;
+					if(e->data.tryDeleteData()) {
+						freed += e->bytes;
+						s.evictions++;
+						s.erase(s.index.find(e->name), m_bytes);
+						evicted = true;
+						break;
+					}
+					e->lastAccess = now;
+					s.unlink(e);
+					s.pushFront(e);
+				}
+				if(!evicted) exhausted[best] = true;
+			}
+			return freed;
+		}
 	};
 
-	typedef std::map<std::string, ImageItem_t > ImageCache_t;
-	ImageCache_t ImageCache;
-	typedef std::map<std::string, SoundItem_t > SoundCache_t;
-	SoundCache_t SoundCache;
-	typedef std::map<std::string, MapItem_t > MapCache_t;
-	MapCache_t MapCache;
-	typedef std::map<std::string, ModItem_t > ModCache_t;
-	ModCache_t ModCache;
+	Store<SDL_Surface> ImageCache;
+	Store<SoundSample> SoundCache;
+	Store<CMap> MapCache;
+	Store<CGameScript> ModCache;
+
+	Mutex shrinkMutex;
+	size_t lastShrinkFailedSize; // Protected by shrinkMutex
+	size_t effectiveMaxSize();
+	static size_t optionMaxSize();
+	void ClearExtraEntriesIfNeeded();
 };
 
 extern CCache cCache;
@@ -0,0 +1,64 @@
+/*
+ *  ChallengeTable.h
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#ifndef __OLX__CHALLENGETABLE_H__
+#define __OLX__CHALLENGETABLE_H__
+
+#include <string>
+#include <vector>
+#include <list>
+#include <map>
+#include "Networking.h"
+#include "olx-types.h"
+#include "CodeAttributes.h"
+
+// Challenge structure
+class challenge_t { public:
+	NetworkAddr	Address;
+	AbsTime		fTime;
+	int			iNum;
+	std::string	sClientVersion;
+};
+
+/*
+ The challenges the server handed out with lx::challenge and which were not used for
+ lx::connect yet. Lookups go through an index by address instead of scanning all slots,
+ when it is full, the oldest challenge is overwritten.
+ */
+class ChallengeTable : DontCopyTag {
+	typedef std::multimap<std::string, size_t> AddrIndex; // Address string -> slot
+	typedef std::list<size_t> Order; // Used slots, oldest first
+	// Where a used slot is in the index and in the order, so remove() doesn't have to search
+	struct SlotPos {
+		AddrIndex::iterator byAddr;
+		Order::iterator order;
+	};
+
+	std::vector<challenge_t> m_slots;
+	std::vector<SlotPos> m_pos;
+	AddrIndex m_byAddr;
+	Order m_order;
+	std::vector<size_t> m_free;
+
+	void remove(size_t slot);
+
+public:
+	ChallengeTable(size_t maxSize);
+
+	void clear();
+	size_t size() const { return m_order.size(); }
+
+	// Hands out a new challenge
+	const challenge_t& add(const NetworkAddr& addr, const std::string& clientVersion, const AbsTime& now);
+	enum TakeResult { TR_Ok, TR_NotFound, TR_WrongNum };
+	// Checks if num is a challenge we gave to addr. TR_WrongNum means that addr has challenges,
+	// but not this one. All challenges of addr are removed, so every challenge can only be used for one connect.
+	TakeResult take(const NetworkAddr& addr, int num, std::string* clientVersion);
+};
+
+#endif
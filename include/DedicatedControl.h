@@ -59,6 +59,7 @@ public:
 	void GameLoop_Frame();
 	void ChangeScript(const std::string& filename, const std::string& args);
 	bool GetNextSignal(CmdLineIntf* sender); // false means that we should not finalizeReturn() yet!
+	void GetSignalQueueStats(CmdLineIntf* caller);
 };
 
 
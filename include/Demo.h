@@ -0,0 +1,120 @@
+/*
+ *  Demo.h
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#ifndef __DEMO_H__
+#define __DEMO_H__
+
+#include <string>
+#include <list>
+#include <set>
+#include <SDL.h>
+#include "CBytestream.h"
+#include "Version.h"
+#include "olx-types.h"
+
+struct gzFile_s;
+class CClient;
+
+/*
+	Client-side network demos.
+
+	While we are connected to a server, DemoRecorder writes every logical packet
+	the server sends us (what CClient::ReadPackets passes to ParsePacket) together
+	with its time. Our own worms are never sent back to us by the server, so we
+	add their state as S2C_WORMINFO/S2C_UPDATEWORMS packets, as the server would
+	send them to other clients.
+
+	DemoPlayer feeds these packets back into CClient at the same times. The client
+	then parses, simulates and draws the game like a normal network game, as a
+	spectator. Nothing is sent anywhere in that case.
+
+	File format (gzip compressed): records of
+		byte type, uint32 time (ms since start), uint32 length, data
+	where the first record is DR_HEADER.
+*/
+
+enum DemoRecordType {
+	DR_HEADER = 1,		// format version, game version, server version, server name
+	DR_PACKET = 2,		// packet for CClientNetEngine::ParsePacket
+	DR_GAMEINFO = 3,	// mod and map path of a game which was started
+};
+
+class DemoRecorder {
+public:
+	// Opens demos/<date>.olxdemo for writing
+	static DemoRecorder* start(CClient* client);
+	~DemoRecorder();
+
+	const std::string& filename() const { return m_filename; }
+
+	void packet(const CBytestream& bs);
+	void gameInfo(const std::string& mod, const std::string& map);
+	void localWorms();
+
+private:
+	DemoRecorder() : m_file(NULL), m_client(NULL), m_bytes(0) {}
+	void write(uchar type, const std::string& data);
+	Uint32 now() const;
+
+	gzFile_s* m_file;
+	CClient* m_client;
+	std::string m_filename;
+	AbsTime m_start;
+	AbsTime m_lastWormUpdate;
+	size_t m_bytes;
+};
+
+class DemoPlayer {
+public:
+	// speed 0 means as fast as possible
+	static DemoPlayer* open(const std::string& file, float speed, std::string& err);
+	~DemoPlayer();
+
+	const std::string& filename() const { return m_filename; }
+	const Version& serverVersion() const { return m_serverVersion; }
+	const std::string& serverName() const { return m_serverName; }
+	float speed() const { return m_speed; }
+	bool unthrottled() const { return m_speed <= 0.0f; }
+	bool finished() const { return m_finished; }
+	Uint32 length() const { return m_length; }
+
+	// Called each frame; drives the game clock if we don't play in real time.
+	void frame();
+	// Appends all packets which are due at the current time.
+	void readPackets(std::list<CBytestream>& out);
+	std::string summary() const;
+
+private:
+	DemoPlayer();
+	bool readRecord(uchar& type, Uint32& time, std::string& data);
+
+	gzFile_s* m_file;
+	std::string m_filename;
+	Version m_serverVersion;
+	std::string m_serverName;
+	float m_speed;
+	Uint32 m_length;
+	bool m_finished;
+	bool m_started;
+	AbsTime m_start;
+
+	// The next record, already read
+	bool m_havePending;
+	uchar m_pendingType;
+	Uint32 m_pendingTime;
+	std::string m_pendingData;
+
+	bool m_manualClock;
+	Uint32 m_lastTicks;
+	float m_clockRest;
+
+	size_t m_frames;
+	Uint64 m_wallStart;
+};
+
+#endif
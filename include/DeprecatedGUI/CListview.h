@@ -18,6 +18,8 @@
 #define __CLISTVIEW_H__DEPRECATED_GUI__
 
 #include <string>
+#include <vector>
+#include <map>
 #include "DeprecatedGUI/CWidget.h"
 #include "DeprecatedGUI/CScrollbar.h"
 #include "DynDraw.h"
@@ -87,7 +89,7 @@ struct lv_column_t : DontCopyTag {
 
 // Sub item structure
 struct lv_subitem_t : DontCopyTag {
-	lv_subitem_t() : iType(0), tWidget(NULL), fMouseOverTime(0), tNext(NULL) {} // safety
+	lv_subitem_t() : iType(0), tWidget(NULL), fMouseOverTime(0), bSortKeyNumeric(false), iSortKey(0), tNext(NULL) {} // safety
 	~lv_subitem_t()  { if (tWidget) delete tWidget; }
 
 	int			iType;
@@ -102,6 +104,12 @@ struct lv_subitem_t : DontCopyTag {
 	Color		iBgColour;
 
 	TimeDiff	fMouseOverTime;
+
+	// Parsed sText for sorting, valid as long as sText == sSortKeyText
+	std::string	sSortKeyText;
+	bool		bSortKeyNumeric;
+	int			iSortKey;
+
 	lv_subitem_t *tNext;
 
 };
@@ -115,7 +123,7 @@ struct lv_item_t : DontCopyTag {
 	int			iIndex;
     int         _iID;
 	bool		bSelected;
-	int			iHeight;
+	int			iHeight; // Set it with CListview::setItemHeight(), the listview keeps the sum
 	Color		iColour;
 	Color		iBgColour;
 
@@ -136,11 +144,11 @@ public:
 		tLastItem = NULL;
 		tSelected = NULL;
 		iItemCount=0;
+		iItemsHeight = 0;
 		bGotScrollbar = false;
 		iType = wid_Listview;
 		fLastMouseUp = AbsTime();
 		iContentHeight = 0;
-        iItemID = 0;
         bShowSelect = true;
 		iLastMouseX = 0;
 		iGrabbed = 0;
@@ -180,11 +188,16 @@ private:
 	int				iLastMouseX;
 
 	// Items
+	// The items are kept in tItemArray in the displayed order, tItemArray[i]->_iID == i.
+	// tItems/tNext are the same order as a list, a lot of code outside iterates the items that way.
 	lv_item_t		*tItems;
 	lv_item_t		*tLastItem;
 	lv_item_t		*tSelected;
+	std::vector<lv_item_t *> tItemArray;
+	std::multimap<int, lv_item_t *> tItemsByIndex;
+	std::multimap<std::string, lv_item_t *> tItemsByName; // Lower case sIndex
 	int				iItemCount;
-    int             iItemID;
+	int				iItemsHeight; // Sum of all iHeight
 	int				iContentHeight;
 	bool			bSubItemsAreAligned; // if the left item is too long, subitems are shifted right
 	
@@ -216,6 +229,8 @@ private:
 private:
 	void	ShowTooltip(const std::string& text, int ms_x, int ms_y);
 	void	UpdateItemIDs();
+	void	FreeItems();
+	lv_item_t *getItemAt(int pos)	{ return (pos >= 0 && pos < (int)tItemArray.size()) ? tItemArray[pos] : NULL; }
 
 public:
 	// Methods
@@ -242,6 +257,7 @@ public:
 	DWORD SendMessage(int iMsg, std::string *sStr, DWORD Param);
 
 	void	ReadjustScrollbar();
+	void	setItemHeight(lv_item_t* item, int h);
 	void	SetupScrollbar(int x, int y, int h, bool always_visible);
 
 	void	Clear();
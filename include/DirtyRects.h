@@ -0,0 +1,54 @@
+/*
+ *  DirtyRects.h
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#ifndef __DIRTYRECTS_H__
+#define __DIRTYRECTS_H__
+
+#include <vector>
+#include <SDL.h>
+
+/*
+	A small set of rectangles of a surface which have changed.
+
+	Added rects are clipped to the bounds and merged with overlapping or
+	touching ones. If we get more than MaxRects, the two rects whose union
+	grows the least are merged. If the rects cover most of the surface anyway,
+	we fall back to a full refresh, because then one big copy is cheaper than
+	many small ones.
+*/
+class DirtyRects {
+public:
+	enum { MaxRects = 8 };
+
+	DirtyRects() : m_full(true) { m_bounds.x = m_bounds.y = m_bounds.w = m_bounds.h = 0; }
+
+	void setBounds(int w, int h) { m_bounds.x = m_bounds.y = 0; m_bounds.w = w; m_bounds.h = h; }
+	const SDL_Rect& bounds() const { return m_bounds; }
+
+	void add(const SDL_Rect& r);
+	void add(const DirtyRects& other);
+	void setFull() { m_full = true; m_rects.clear(); }
+	void clear() { m_full = false; m_rects.clear(); }
+
+	bool full() const { return m_full; }
+	bool empty() const { return !m_full && m_rects.empty(); }
+	// Not valid if full()
+	const std::vector<SDL_Rect>& rects() const { return m_rects; }
+	// The whole bounds if full()
+	std::vector<SDL_Rect> rectsOrFull() const;
+
+private:
+	void insert(SDL_Rect r);
+	void checkArea();
+
+	SDL_Rect m_bounds;
+	bool m_full;
+	std::vector<SDL_Rect> m_rects;
+};
+
+#endif
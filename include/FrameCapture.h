@@ -0,0 +1,112 @@
+/*
+ *  FrameCapture.h
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#ifndef __FRAMECAPTURE_H__
+#define __FRAMECAPTURE_H__
+
+#include <string>
+#include <list>
+#include <set>
+#include <vector>
+#include <cstdio>
+#include <SDL.h>
+#include "SmartPointer.h"
+#include "Mutex.h"
+#include "Condition.h"
+#include "olx-types.h"
+#include "util/Result.h"
+
+struct ThreadPoolItem;
+
+/*
+	Saves frames without stalling the game.
+
+	The main thread only copies the frame into a pooled buffer and queues it.
+	Worker threads encode (PNG/JPG/GIF/BMP via SaveSurface) and write it.
+	The queue is bounded: screenshots wait for a free slot, frames of a
+	continuous capture are dropped instead.
+
+	A continuous capture writes either an image sequence (one file per frame)
+	or a raw stream (all frames uncompressed in one file, in order, plus a
+	text file describing the format) at a fixed rate of game time.
+	It is started and stopped by console commands on the gameloop thread
+	while the main thread adds the frames, so all of its state is
+	protected by m_mutex. The raw file belongs to the jobs writing to it and
+	is closed when the last of them is done.
+*/
+class FrameCapture {
+public:
+	enum { MaxQueue = 8, FormatRaw = -1 };
+
+	// Created on first use
+	static FrameCapture* Get();
+	// Waits until everything in the queue is written
+	static void Uninit();
+
+	// Copies the frame now, the file is written in the background.
+	void screenshot(SDL_Surface* frame, const std::string& file, int format, const std::string& data);
+	// True if we have queued but not yet written this file
+	bool isPending(const std::string& file);
+
+	// format is FMT_* or FormatRaw
+	bool startSequence(float fps, int format, std::string& err);
+	void stopSequence();
+	bool capturing();
+	// Main thread, called with each presented frame
+	void frame(SDL_Surface* frame);
+
+private:
+	FrameCapture();
+	~FrameCapture();
+
+	struct RawStream {
+		FILE* file;
+		size_t nextSeq; // next frame to write, protected by m_mutex
+		RawStream(FILE* f) : file(f), nextSeq(0) {}
+		~RawStream() { if(file) fclose(file); }
+	};
+
+	struct Job {
+		SmartPointer<SDL_Surface> surf;
+		std::string file;
+		int format;
+		std::string data;
+		SmartPointer<RawStream> raw; // only for raw
+		size_t seq; // only for raw
+	};
+
+	SmartPointer<SDL_Surface> getBuffer(SDL_Surface* frame);
+	bool push(const Job& job, bool wait);
+	bool pushLocked(const Job& job, bool wait);
+	void startWorkers();
+	Result run();
+	void encode(const Job& job);
+
+	Mutex m_mutex;
+	Condition m_jobAvailable;
+	Condition m_jobDone;
+	std::list<Job> m_queue;
+	std::set<std::string> m_pendingFiles;
+	std::vector< SmartPointer<SDL_Surface> > m_freeBuffers;
+	std::vector<ThreadPoolItem*> m_threads;
+	size_t m_working;
+	bool m_quit;
+
+	// Continuous capture, protected by m_mutex
+	bool m_seqActive;
+	unsigned int m_seqId; // changes with every start, to notice a restart while we copy a frame
+	std::string m_seqName;
+	int m_seqFormat;
+	TimeDiff m_seqPeriod;
+	AbsTime m_seqNext;
+	size_t m_seqFrames;
+	size_t m_seqDropped;
+	SmartPointer<RawStream> m_rawStream;
+};
+
+#endif
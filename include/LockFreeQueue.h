@@ -0,0 +1,206 @@
+/*
+	OpenLieroX
+
+	bounded lock-free queues for passing data between threads
+
+	code under LGPL
+*/
+
+#ifndef __LOCKFREEQUEUE_H__
+#define __LOCKFREEQUEUE_H__
+
+#include <vector>
+#include <list>
+#include <SDL_atomic.h>
+#include <SDL_timer.h>
+#include "CodeAttributes.h"
+#include "Mutex.h"
+
+
+/*
+	Single-producer/single-consumer ring buffer.
+	Exactly one thread may call push() and exactly one (other) thread may call pop().
+	The capacity is rounded up to a power of two, push() returns false if the queue is full.
+*/
+template < typename _T >
+class SpscQueue : DontCopyTag {
+private:
+	std::vector<_T> m_items;
+	unsigned int m_mask;
+	SDL_atomic_t m_head; // next item to read, only changed by the consumer
+	SDL_atomic_t m_tail; // next item to write, only changed by the producer
+
+public:
+	SpscQueue(unsigned int capacity = 1024) {
+		unsigned int size = 1;
+		while(size < capacity) size <<= 1;
+		m_items.resize(size);
+		m_mask = size - 1;
+		SDL_AtomicSet(&m_head, 0);
+		SDL_AtomicSet(&m_tail, 0);
+	}
+
+	bool push(const _T& item) {
+		const unsigned int tail = (unsigned int)SDL_AtomicGet(&m_tail);
+		const unsigned int head = (unsigned int)SDL_AtomicGet(&m_head);
+		if(tail - head > m_mask) return false; // full
+		m_items[tail & m_mask] = item;
+		SDL_AtomicSet(&m_tail, (int)(tail + 1)); // publishes the item
+		return true;
+	}
+
+	bool pop(_T& item) {
+		const unsigned int head = (unsigned int)SDL_AtomicGet(&m_head);
+		if(head == (unsigned int)SDL_AtomicGet(&m_tail)) return false; // empty
+		item = m_items[head & m_mask];
+		m_items[head & m_mask] = _T(); // don't keep references alive
+		SDL_AtomicSet(&m_head, (int)(head + 1)); // frees the slot
+		return true;
+	}
+
+	bool empty() { return SDL_AtomicGet(&m_head) == SDL_AtomicGet(&m_tail); }
+	unsigned int capacity() const { return m_mask + 1; }
+};
+
+
+/*
+	Multi-producer/single-consumer queue.
+	Any thread may call push(). Only one thread at a time may call pop() and popAll(),
+	if there can be several consumer threads, they must serialize these calls themselves.
+	A consumer which needs to insert or erase in the middle can move everything into
+	its own list with popAll() and edit it there, see EventQueue.
+
+	The fast path is a bounded ring (the algorithm by Dmitry Vyukov, every cell has a
+	sequence number): push() is one CAS and a copy into a preallocated cell, there is no lock
+	and no allocation. Only if the ring is full, the items go into a mutex-protected
+	overflow list, so push() never fails. As long as there are items in the overflow,
+	all producers use it too, so the items of each producer stay in order.
+*/
+template < typename _T >
+class MpscQueue : DontCopyTag {
+private:
+	struct Cell {
+		SDL_atomic_t seq;
+		_T item;
+	};
+	std::vector<Cell> m_cells;
+	unsigned int m_mask;
+	SDL_atomic_t m_tail; // next cell to write, producers
+	unsigned int m_head; // next cell to read, consumer only
+	SDL_atomic_t m_count; // approximate number of items
+	
+	Mutex m_overflowMutex;
+	std::list<_T> m_overflow; // protected by m_overflowMutex
+	SDL_atomic_t m_useOverflow;
+	std::list<_T> m_spill; // overflow items taken over by the consumer, consumer only
+	unsigned int m_spillBarrier; // m_tail when m_spill was taken over, consumer only
+	SDL_atomic_t m_overflowPushes;
+
+	bool pushRing(const _T& item) {
+		unsigned int pos = (unsigned int)SDL_AtomicGet(&m_tail);
+		Cell* cell = NULL;
+		while(true) {
+			cell = &m_cells[pos & m_mask];
+			const int dif = SDL_AtomicGet(&cell->seq) - (int)pos;
+			if(dif == 0) {
+				if(SDL_AtomicCAS(&m_tail, (int)pos, (int)(pos + 1))) break;
+			}
+			else if(dif < 0)
+				return false; // full
+			pos = (unsigned int)SDL_AtomicGet(&m_tail);
+		}
+		cell->item = item;
+		SDL_AtomicSet(&cell->seq, (int)(pos + 1)); // publishes the item
+		return true;
+	}
+
+	bool popRing(_T& item) {
+		Cell& cell = m_cells[m_head & m_mask];
+		if(SDL_AtomicGet(&cell.seq) != (int)(m_head + 1)) return false; // empty
+		item = cell.item;
+		cell.item = _T(); // don't keep references alive
+		SDL_AtomicSet(&cell.seq, (int)(m_head + m_mask + 1)); // frees the cell for the next round
+		m_head++;
+		return true;
+	}
+
+public:
+	MpscQueue(unsigned int capacity = 1024) : m_head(0), m_spillBarrier(0) {
+		unsigned int size = 2;
+		while(size < capacity) size <<= 1;
+		m_cells.resize(size);
+		m_mask = size - 1;
+		for(unsigned int i = 0; i < size; ++i)
+			SDL_AtomicSet(&m_cells[i].seq, (int)i);
+		SDL_AtomicSet(&m_tail, 0);
+		SDL_AtomicSet(&m_count, 0);
+		SDL_AtomicSet(&m_useOverflow, 0);
+		SDL_AtomicSet(&m_overflowPushes, 0);
+	}
+
+	// Always succeeds
+	void push(const _T& item) {
+		if(SDL_AtomicGet(&m_useOverflow) == 0 && pushRing(item)) {
+			SDL_AtomicIncRef(&m_count);
+			return;
+		}
+		
+		{
+			Mutex::ScopedLock lock(m_overflowMutex);
+			m_overflow.push_back(item);
+			SDL_AtomicSet(&m_useOverflow, 1);
+		}
+		SDL_AtomicIncRef(&m_count);
+		SDL_AtomicIncRef(&m_overflowPushes);
+	}
+
+	// Consumer only
+	bool pop(_T& item) {
+		if(m_spill.empty()) {
+			if(popRing(item)) {
+				SDL_AtomicAdd(&m_count, -1);
+				return true;
+			}
+			if(SDL_AtomicGet(&m_useOverflow) == 0) return false;
+			Mutex::ScopedLock lock(m_overflowMutex);
+			m_spill.swap(m_overflow);
+			m_spillBarrier = (unsigned int)SDL_AtomicGet(&m_tail);
+			SDL_AtomicSet(&m_useOverflow, 0);
+			if(m_spill.empty()) return false;
+		}
+		
+		// Ring cells taken before we took over the overflow are older than it
+		if((int)(m_spillBarrier - m_head) > 0) {
+			if(!popRing(item)) return false; // still being written
+		}
+		else {
+			item = m_spill.front();
+			m_spill.pop_front();
+		}
+		SDL_AtomicAdd(&m_count, -1);
+		return true;
+	}
+
+	// Consumer only. Moves all items which were pushed before this call to the end of out, in order.
+	// pop() alone can stop early at a cell which a producer has claimed but is still writing,
+	// here we wait for such cells instead.
+	void popAll(std::list<_T>& out) {
+		const unsigned int tail = (unsigned int)SDL_AtomicGet(&m_tail);
+		_T item;
+		while(true) {
+			if(pop(item)) {
+				out.push_back(item);
+				continue;
+			}
+			if((int)(tail - m_head) <= 0) break;
+			SDL_Delay(0); // a cell before our tail is still being written
+		}
+	}
+
+	bool empty() { return SDL_AtomicGet(&m_count) <= 0; }
+	unsigned int capacity() const { return m_mask + 1; }
+	// How often the ring was full and the slow path was used
+	int overflowPushes() { return SDL_AtomicGet(&m_overflowPushes); }
+};
+
+#endif
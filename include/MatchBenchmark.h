@@ -0,0 +1,72 @@
+/*
+ *  MatchBenchmark.h
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#ifndef __MATCHBENCHMARK_H__
+#define __MATCHBENCHMARK_H__
+
+#include <string>
+#include <vector>
+#include <map>
+#include <SDL.h>
+#include "olx-types.h"
+
+/*
+	Headless benchmark mode (-benchmark <scenario>).
+
+	It sets up a dedicated server game from a scenario file (mod, map, bots,
+	game settings), seeds all random generators with a fixed seed and then
+	runs the fixed 100FPS simulation for a given amount of ticks, as fast as
+	possible. The game clock is driven manually while measuring, so every
+	main loop frame simulates exactly one tick, independent of the wall time.
+	At the end, a machine-readable report is written and the game quits.
+
+	Scenario files are INI files, see share/gamedir/benchmarks/.
+*/
+class MatchBenchmark {
+private:
+	MatchBenchmark(); ~MatchBenchmark();
+public:
+	static bool Init(const std::string& scenario, int ticks, int seed, const std::string& outputFile);
+	static void Uninit();
+	static MatchBenchmark* Get();
+
+	// Called at the beginning of each main loop frame.
+	void Frame();
+	// True while we are measuring. The main loop doesn't cap the FPS then.
+	bool measuring() const { return m_state == S_Measure; }
+	// Called around each simulation tick.
+	void tickBegin();
+	void tickEnd();
+
+private:
+	bool loadScenario();
+	void applySettings();
+	void seedRandom();
+	void startMeasuring();
+	void finish(const std::string& error);
+	std::string report(const std::string& error) const;
+
+	enum State { S_Setup, S_WaitLobby, S_WaitBots, S_WaitGame, S_Measure, S_Done };
+	State m_state;
+
+	std::string m_scenarioFile;
+	std::string m_name;
+	std::string m_outputFile;
+	int m_ticks;
+	int m_seed;
+	int m_bots;
+	int m_botDifficulty;
+	std::map<std::string, std::string> m_vars; // full var name -> value
+
+	AbsTime m_stateStart;
+	Uint64 m_measureStart;
+	Uint64 m_tickStart;
+	std::vector<Uint64> m_tickTimes;
+};
+
+#endif
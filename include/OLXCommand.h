@@ -90,8 +90,11 @@ struct CmdLineIntf {
 		CmdLineIntf* sender;
 		SmartPointer<ExecScope> execScope;
 		std::string cmd;
+		// If set, cmd is only the command name and the params are already split up (no quoting needed)
+		bool preparsed;
+		std::vector<std::string> params;
 		Command(CmdLineIntf* s = NULL, const SmartPointer<ExecScope>& sc = NULL, const std::string& c = "")
-			: sender(s), execScope(sc), cmd(c) {}
+			: sender(s), execScope(sc), cmd(c), preparsed(false) {}
 	};
 
 
@@ -227,7 +227,9 @@ public:
 	int		iNetworkPort;
 	int		iNetworkSpeed;
 	int		iMaxUploadBandwidth;
+	int		iServerListProbes;
 	bool	bCheckBandwidthSanity;
+	bool	bAdaptiveSendRate;	// Lower the rate to a client when its link gets congested
 	bool	bUseIpToCountry;	
 	std::string	sHttpProxy;
 	bool	bAutoSetupHttpProxy;
@@ -239,6 +241,9 @@ public:
 	bool	bAllowWantsJoinMsg;
 	bool	bWantsJoinBanned;
 	bool	bAllowRemoteBots;
+	int		iQueryRateLimit;		// Connectionless queries per second per IP, 0 = unlimited
+	int		iQueryBurst;			// How many of them an IP may send at once
+	int		iQueryReplyCacheTime;	// In ms, how long the lx::query/lx::getinfo replies are reused
 	bool	bForceCompatibleConnect;
 	std::string	sForceMinVersion;
 	int		iMaxPlayers;
@@ -319,16 +324,24 @@ public:
     int     nMaxFPS;
 	int		iJpegQuality;
 	int		iMaxCachedEntries;		// Amount of entries to cache, including maps, mods, images and sounds.
+	int		iCacheMaxSize;			// Memory budget (in MB) for the cache of images, sounds, maps and mods
+	int		iFontCacheSize;			// Memory budget (in KB) for the pre-rendered text of each font
+	int		iLuaGCBudget;			// In microseconds per frame for the Lua garbage collector, 0 = automatic GC
+	bool	bGusLevelBundles;		// Cache converted Gusanos level images in cache/gus_levels/, see level_bundle.h
+	bool	bCompiledModCache;		// Cache compiled source mods (main.txt) in cache/compiled_mods/, see CGameScript::Load
 	bool	bMatchLogging;			// Save screenshot of every game final score
 	bool	bRecoverAfterCrash;		// If we should try to recover after segfault etc, or generate coredump and quit
 	bool	bCheckForUpdates;		// Check for new development version on sourceforge.net
 
 	// Misc.
 	bool    bLogConvos;
+	bool	bRecordDemos;			// Record every joined network game into demos/, see Demo.h
 	bool	bShowPing;
 	int		iScreenshotFormat;
 	std::string sDedicatedScript;
 	std::string sDedicatedScriptArgs;
+	bool	bDedicatedBinaryProtocol;
+	int		iDedicatedSignalQueueSize;
 	int		iVerbosity;			// the higher the number, the higher the amount of debug messages; 0 is default, at 10 it shows backtraces for all warnings
 	bool	bLogTimestamps;  // Show timestamps in console output
 	bool	bAdvancedLobby;  // Show advanced game info in join lobby
@@ -0,0 +1,50 @@
+/*
+ *  RateLimiter.h
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#ifndef __OLX__RATELIMITER_H__
+#define __OLX__RATELIMITER_H__
+
+#include <string>
+#include <map>
+#include "olx-types.h"
+#include "CodeAttributes.h"
+
+/*
+ Token bucket per source (usually an IP without the port).
+
+ Each source may do burst requests at once and then rate requests per second. The buckets of
+ sources which were quiet long enough to be full again are forgotten, so a flood from many
+ different addresses cannot make this grow without bounds.
+ Not thread-safe, the server uses it only from the main thread.
+ */
+class SourceRateLimiter : DontCopyTag {
+	struct Bucket {
+		float tokens;
+		AbsTime last;
+	};
+	typedef std::map<std::string, Bucket> Buckets;
+	Buckets m_buckets;
+	AbsTime m_lastPrune;
+	Uint64 m_allowed;
+	Uint64 m_dropped;
+
+	void prune(const AbsTime& now, float rate, float burst);
+
+public:
+	SourceRateLimiter() : m_allowed(0), m_dropped(0) {}
+
+	// Takes one token of the source. Returns false if there is none, drop the request then.
+	bool allow(const std::string& source, const AbsTime& now, float rate, float burst);
+	void clear() { m_buckets.clear(); m_allowed = m_dropped = 0; }
+
+	size_t sources() const { return m_buckets.size(); }
+	Uint64 allowed() const { return m_allowed; }
+	Uint64 dropped() const { return m_dropped; }
+};
+
+#endif
@@ -0,0 +1,111 @@
+/*
+ *  TaskScheduler.h
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#ifndef __OLX__TASKSCHEDULER_H__
+#define __OLX__TASKSCHEDULER_H__
+
+#include <vector>
+#include <deque>
+#include <boost/function.hpp>
+#include <SDL_atomic.h>
+#include <SDL_thread.h>
+#include "Mutex.h"
+#include "Condition.h"
+#include "CodeAttributes.h"
+#include "ThreadPool.h" // ThreadId
+
+/*
+ Work-stealing scheduler for many small tasks.
+
+ There is a fixed number of workers (about one per core). Each has its own deque per priority:
+ tasks spawned from a worker go to the back of its own deque and it takes them from there again,
+ idle workers steal from the front of the others. Tasks spawned from other threads go to a
+ shared injection queue.
+
+ Unlike ThreadPool::start(), tasks here must not block (waiting for network, pipes, other
+ threads, ...), otherwise they take a core away from everybody else. Long-running or blocking
+ jobs still belong into the ThreadPool or the TaskManager.
+ */
+
+enum TaskPriority { TP_High = 0, TP_Normal, TP_Low, TP_Count };
+
+// Fork/join: counts the spawned tasks which are not finished yet, see TaskScheduler::wait()
+class TaskGroup : DontCopyTag {
+	friend class TaskScheduler;
+	SDL_atomic_t pending;
+public:
+	TaskGroup() { SDL_AtomicSet(&pending, 0); }
+	bool done() { return SDL_AtomicGet(&pending) == 0; }
+};
+
+class TaskScheduler : DontCopyTag {
+public:
+	typedef boost::function<void()> Function;
+	typedef boost::function<void(int,int)> RangeFunction;
+
+private:
+	struct Job {
+		Function fct;
+		TaskGroup* group;
+		Job() : group(NULL) {}
+	};
+
+	struct Worker {
+		TaskScheduler* scheduler;
+		unsigned int index;
+		SDL_Thread* thread;
+		ThreadId nativeThreadId;
+		Mutex mutex;
+		std::deque<Job> jobs[TP_Count]; // protected by mutex
+	};
+
+	std::vector<Worker*> m_workers;
+	Mutex m_injectMutex;
+	std::deque<Job> m_inject[TP_Count]; // protected by m_injectMutex
+
+	// Idle workers and waiting threads sleep here
+	Mutex m_sleepMutex;
+	Condition m_wakeup;
+	SDL_atomic_t m_sleepers;
+	SDL_atomic_t m_queued; // jobs not yet taken by anybody
+	SDL_atomic_t m_quit;
+	SDL_atomic_t m_stealSeed;
+
+	static int workerThread(void* param);
+	Worker* currentWorker();
+	bool popJob(std::deque<Job>& q, Mutex& m, bool back, Job& job);
+	bool findJob(Worker* self, Job& job);
+	void runJob(Job& job);
+	void wakeUp(bool all);
+
+public:
+	TaskScheduler(unsigned int workers);
+	~TaskScheduler();
+
+	unsigned int workerCount() const { return (unsigned int)m_workers.size(); }
+
+	void spawn(TaskGroup& group, const Function& fct, TaskPriority prio = TP_Normal);
+
+	// Waits until all tasks of the group are finished. The calling thread runs pending tasks meanwhile,
+	// so this also works from inside a task and with 0 workers.
+	void wait(TaskGroup& group);
+
+	// Calls fct(chunkBegin, chunkEnd) for [begin,end) split into chunks of grain elements and waits for all.
+	// The chunks only depend on begin, end and grain, never on the number of workers, so if you
+	// combine per chunk results in chunk order, you get the same result everywhere.
+	void parallelFor(int begin, int end, int grain, const RangeFunction& fct, TaskPriority prio = TP_Normal);
+	static int chunkCount(int begin, int end, int grain) { return (end > begin) ? ((end - begin + grain - 1) / grain) : 0; }
+};
+
+extern TaskScheduler* taskScheduler;
+
+// Done by InitThreadPool() / UnInitThreadPool()
+void InitTaskScheduler();
+void UnInitTaskScheduler();
+
+#endif
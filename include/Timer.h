@@ -33,11 +33,28 @@ struct TimeCounter {
 	SDL_mutex* mutex;
 	AbsTime time;
 	Uint32 lastTicks;
+	bool manual; // if set, time only moves forward by advance(); used for the benchmark mode
 	
-	TimeCounter() : time(0), lastTicks(0) { mutex = SDL_CreateMutex(); lastTicks = SDL_GetTicks(); }
+	TimeCounter() : time(0), lastTicks(0), manual(false) { mutex = SDL_CreateMutex(); lastTicks = SDL_GetTicks(); }
 	~TimeCounter() { SDL_DestroyMutex(mutex); mutex = NULL; }
+	void setManual(bool m) {
+		if(mutex) SDL_mutexP(mutex);
+		manual = m;
+		lastTicks = SDL_GetTicks(); // don't count the time spent in manual mode when we switch back
+		if(mutex) SDL_mutexV(mutex);
+	}
+	void advance(TimeDiff td) {
+		if(mutex) SDL_mutexP(mutex);
+		time += td;
+		if(mutex) SDL_mutexV(mutex);
+	}
 	AbsTime update() {
 		if(mutex) SDL_mutexP(mutex);
+		if(manual) {
+			AbsTime t = time;
+			if(mutex) SDL_mutexV(mutex);
+			return t;
+		}
 		Uint32 curTicks = SDL_GetTicks();
 		if(curTicks < lastTicks) {
 			AbsTime t = time;
@@ -75,6 +75,7 @@
 #include "Geometry.h"
 #include "MainLoop.h"
 #include "gusanos/allegro.h"
+#include "FrameCapture.h"
 
 
 Null null;	// Used in timer class
@@ -544,6 +545,9 @@ bool VideoPostProcessor::resetVideo() {
 		errors << "failed to init video texture: " << SDL_GetError() << endl;
 		return false;
 	}
+	// The new texture is empty
+	m_textureDirty.setBounds(screenWidth(), screenHeight());
+	m_textureDirty.setFull();
 	
 	// No need to reinit this.
 	if(!m_videoBufferSurface.get()) {
@@ -561,6 +565,14 @@ bool VideoPostProcessor::resetVideo() {
 
 void VideoPostProcessor::flipBuffers() {
 	std::swap(get()->m_videoBufferSurface, get()->m_videoSurface);
+	// If the surfaces were not cloned, we don't know what has changed.
+	if(!get()->m_buffersEqual)
+		get()->m_textureDirty.setFull();
+	get()->m_buffersEqual = false;
+}
+
+void VideoPostProcessor::invalidate() {
+	get()->m_forceFullUpload = true;
 }
 
 
@@ -568,9 +580,29 @@ void VideoPostProcessor::flipBuffers() {
 
 void VideoPostProcessor::process() {
 	ProcessScreenshots();
+	FrameCapture::Get()->frame(get()->m_videoBufferSurface.get());
 	
-	void* pixels = get()->m_videoBufferSurface->pixels;
-	SDL_UpdateTexture(get()->m_videoTexture.get(), NULL, pixels, get()->screenWidth() * sizeof (uint32_t));
+	VideoPostProcessor* vpp = get();
+	if(vpp->m_forceFullUpload) {
+		vpp->m_forceFullUpload = false;
+		vpp->m_textureDirty.setFull();
+	}
+	if(vpp->m_textureDirty.empty()) return;
+
+	SDL_Surface* surf = vpp->m_videoBufferSurface.get();
+	if(vpp->m_textureDirty.full())
+		SDL_UpdateTexture(vpp->m_videoTexture.get(), NULL, surf->pixels, surf->pitch);
+	else {
+		const std::vector<SDL_Rect>& rects = vpp->m_textureDirty.rects();
+		for(size_t i = 0; i < rects.size(); ++i) {
+			const uint8_t* pixels =
+				(const uint8_t*) surf->pixels
+				+ rects[i].y * surf->pitch
+				+ rects[i].x * surf->format->BytesPerPixel;
+			SDL_UpdateTexture(vpp->m_videoTexture.get(), &rects[i], pixels, surf->pitch);
+		}
+	}
+	vpp->m_textureDirty.clear();
 }
 
 void VideoPostProcessor::render() {
@@ -586,8 +618,46 @@ void VideoPostProcessor::render() {
 	SDL_RenderPresent(get()->m_renderer.get());
 }
 
+// Rows are compared in bands of this height; each band gives at most one dirty rect.
+static const int CLONE_BAND_HEIGHT = 16;
+
 void VideoPostProcessor::cloneBuffer() {
-	DrawImageAdv(get()->m_videoBufferSurface.get(), get()->m_videoSurface.get(), 0, 0, 0, 0, get()->m_videoSurface->w, get()->m_videoSurface->h);
+	VideoPostProcessor* vpp = get();
+	SDL_Surface* src = vpp->m_videoSurface.get();
+	SDL_Surface* dst = vpp->m_videoBufferSurface.get();
+
+	if(src->w != dst->w || src->h != dst->h || src->format->BytesPerPixel != 4 || dst->format->BytesPerPixel != 4) {
+		DrawImageAdv(dst, src, 0, 0, 0, 0, src->w, src->h);
+		vpp->m_textureDirty.setFull();
+		vpp->m_buffersEqual = true;
+		return;
+	}
+
+	// Only copy what differs from the last frame and remember it for the texture upload.
+	// Reading both surfaces is much cheaper than writing and uploading all of it.
+	const int w = src->w;
+	for(int y0 = 0; y0 < src->h; y0 += CLONE_BAND_HEIGHT) {
+		const int y1 = MIN(y0 + CLONE_BAND_HEIGHT, src->h);
+		int minX = w, maxX = -1;
+		for(int y = y0; y < y1; ++y) {
+			const Uint32* a = (const Uint32*)((const uint8_t*)src->pixels + y * src->pitch);
+			const Uint32* b = (const Uint32*)((const uint8_t*)dst->pixels + y * dst->pitch);
+			if(memcmp(a, b, w * sizeof(Uint32)) == 0) continue;
+			int l = 0, r = w - 1;
+			while(a[l] == b[l]) ++l;
+			while(a[r] == b[r]) --r;
+			minX = MIN(minX, l);
+			maxX = MAX(maxX, r);
+		}
+		if(maxX < 0) continue;
+
+		for(int y = y0; y < y1; ++y)
+			memcpy((uint8_t*)dst->pixels + y * dst->pitch + minX * sizeof(Uint32),
+				   (const uint8_t*)src->pixels + y * src->pitch + minX * sizeof(Uint32),
+				   (maxX - minX + 1) * sizeof(Uint32));
+		vpp->m_textureDirty.add(MakeRect(minX, y0, maxX - minX + 1, y1 - y0));
+	}
+	vpp->m_buffersEqual = true;
 }
 
 void VideoPostProcessor::uninit() {
@@ -650,6 +720,12 @@ static std::string GetPicName(const std::string& prefix, size_t i, const std::st
 
 ////////////////////
 // Helper function for TakeScreenshot
+// Screenshots are written in the background, so the file may not exist yet
+static bool screenshotFileTaken(const std::string& file)
+{
+	return IsFileAvailable(file, false) || FrameCapture::Get()->isPending(file);
+}
+
 static std::string GetScreenshotFileName(const std::string& scr_path, const std::string& extension)
 {
 	std::string path = scr_path;
@@ -695,7 +771,7 @@ static std::string GetScreenshotFileName(const std::string& scr_path, const std:
 
 	// Find a raw range of where the screenshot filename could be
 	// For example: between lierox1000.png and lierox1256.png
-	while (IsFileAvailable(fullname, false))  {
+	while (screenshotFileTaken(fullname))  {
 		lower_bound = upper_bound;
 		upper_bound += step;
 
@@ -703,15 +779,15 @@ static std::string GetScreenshotFileName(const std::string& scr_path, const std:
 	}
 
 	// First file?
-	if (!IsFileAvailable(path + GetPicName(filePrefix, lower_bound, extension)))
+	if (!screenshotFileTaken(path + GetPicName(filePrefix, lower_bound, extension)))
 		return path + GetPicName(filePrefix, lower_bound, extension);
 
 	// Use binary search on the given range to find the exact file name
 	size_t i = (lower_bound + upper_bound) / 2;
 	while (true)  {
-		if (IsFileAvailable(path + GetPicName(filePrefix, i, extension), false))  {
+		if (screenshotFileTaken(path + GetPicName(filePrefix, i, extension)))  {
 			// If the current (i) filename exists, but the i+1 does not, we're done
-			if (!IsFileAvailable(path + GetPicName(filePrefix, i + 1, extension)))
+			if (!screenshotFileTaken(path + GetPicName(filePrefix, i + 1, extension)))
 				return path + GetPicName(filePrefix, i + 1, extension);
 			else  {
 				// The filename is somewhere in the interval (i, upper_bound)
@@ -730,7 +806,7 @@ static std::string GetScreenshotFileName(const std::string& scr_path, const std:
 
 ///////////////////
 // Take a screenshot
-// This should run on the main thread.
+// This should run on the main thread. The frame is copied and encoded in the background.
 static void TakeScreenshot(const std::string& scr_path, const std::string& additional_data)
 {
 	if (scr_path.empty()) // Check
@@ -750,7 +826,7 @@ static void TakeScreenshot(const std::string& scr_path, const std::string& addit
 	}
 
 	// Save the surface
-	SaveSurface(VideoPostProcessor::videoBufferSurface(), GetScreenshotFileName(scr_path, extension),
+	FrameCapture::Get()->screenshot(VideoPostProcessor::videoBufferSurface().get(), GetScreenshotFileName(scr_path, extension),
 		tLXOptions->iScreenshotFormat, additional_data);
 }
 
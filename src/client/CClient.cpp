@@ -17,6 +17,7 @@
 #include "LieroX.h"
 #include "ProfileSystem.h"
 #include "CClient.h"
+#include "Demo.h"
 #include "CBonus.h"
 #include "DeprecatedGUI/Menu.h"
 #include "OLXConsole.h"
@@ -226,6 +227,7 @@ CClient::CClient() {
 	bmpBoxLeft = NULL;
 	bmpBoxRight = NULL;
 	bmpIngameScoreBg = NULL;
+	iScoreboardLayout = -1;
 	cHealthBar1 = NULL;
 	cHealthBar2 = NULL;
 	cWeaponBar1 = NULL;
@@ -246,6 +248,8 @@ CClient::CClient() {
 	
 	cNetEngine = new CClientNetEngine(this);
 	cNetChan = NULL;
+	demoRecorder = NULL;
+	demoPlayer = NULL;
 	iNetStatus = NET_DISCONNECTED;
 	bsUnreliable.Clear();
 	bBadConnection = false;
@@ -1028,7 +1032,13 @@ bool CClient::ReadPackets()
 {	
 	bool anythingNew = false;
 
-	while(true) {
+	if(demoPlayer) {
+		demoPlayer->frame();
+		demoPlayer->readPackets(outstandingPackets);
+	}
+
+	// In demo playback, everything comes from the demo
+	while(demoPlayer == NULL) {
 		CBytestream bs;
 		if(!bs.Read(tSocket)) break;
 		anythingNew = true;
@@ -1063,6 +1073,8 @@ bool CClient::ReadPackets()
 		while(true) {
 			if(!cNetChan->Process(&bs))
 				break;
+			if(demoRecorder)
+				demoRecorder->packet(bs);
 			outstandingPackets.push_back(bs);
 			bs.Clear();
 		}
@@ -1082,8 +1094,19 @@ bool CClient::ReadPackets()
 		outstandingPackets.pop_front();
 	}
 
+	if(demoPlayer && demoPlayer->finished() && outstandingPackets.empty() && !bServerError) {
+		if(bDedicated)
+			// headless playback, e.g. for profiling
+			game.state = Game::S_Quit;
+		else {
+			// this goes back to the menu like when the server quits
+			bServerError = true;
+			strServerErrorMsg = "Demo finished";
+		}
+	}
+
 	// Check if our connection with the server timed out
-	if(game.state == Game::S_Playing && cNetChan->getLastReceived() + TimeDiff((float)LX_CLTIMEOUT) < tLX->currentTime && game.isClient()) {
+	if(game.state == Game::S_Playing && !demoPlayer && cNetChan->getLastReceived() + TimeDiff((float)LX_CLTIMEOUT) < tLX->currentTime && game.isClient()) {
 		// AbsTime out
 		bServerError = true;
 		strServerErrorMsg = "Connection with server timed out";
@@ -1111,6 +1134,12 @@ bool CClient::ReadPackets()
 // Send the packets
 void CClient::SendPackets(bool sendPendingOnly)
 {
+	if(demoPlayer) {
+		// there is nobody to send anything to
+		bsUnreliable.Clear();
+		return;
+	}
+
 	if(game.isClient()) // in server mode, we call this from CServer::SendPackets
 		network.olxSend(sendPendingOnly);
 
@@ -1120,6 +1149,9 @@ void CClient::SendPackets(bool sendPendingOnly)
 		{
 			cNetEngine->SendWormDetails();
 			cNetEngine->SendReportDamage();	// It sends only if someting is queued
+
+			if(demoRecorder)
+				demoRecorder->localWorms();
 		}
 
 
@@ -1198,6 +1230,75 @@ bool JoinServer(const std::string& addr, const std::string& name, const std::str
 
 
 
+///////////////////
+// Play a demo (see Demo.h). We behave like a client which is connected
+// to a server without own worms, just that the packets come from the demo.
+bool CClient::PlayDemo(const std::string& file, float speed, std::string& err) {
+	DemoPlayer* player = DemoPlayer::open(file, speed, err);
+	if(!player) return false;
+
+	game.startClient();
+	if(!Initialize()) {
+		err = "could not initialize client";
+		delete player;
+		game.state = Game::S_Inactive;
+		return false;
+	}
+
+	// no worms: we are a spectator
+	connectInfo = new ClientConnectionRequestInfo;
+
+	outstandingPackets.clear();
+	reconnectingAmount = 0;
+	strServerAddr_HumanReadable = strServerAddr = file;
+	setServerName("Demo: " + player->serverName());
+	cServerVersion = player->serverVersion();
+	setNetEngineFromServerVersion();
+	bHostAllowsStrafing = true;
+
+	// Some code sends to the server directly via the channel. It has no valid address,
+	// so nothing leaves the channel (SendPackets doesn't transmit anyway).
+	if(!createChannel(std::min(cServerVersion, GetGameVersion()))) {
+		err = "demo was recorded on an incompatible server";
+		delete player;
+		game.state = Game::S_Inactive;
+		return false;
+	}
+	NetworkAddr noAddr;
+	SetNetAddrValid(noAddr, false);
+	cNetChan->Create(noAddr, tSocket);
+
+	demoPlayer = player;
+	iNetStatus = NET_CONNECTED;
+
+	if(!bDedicated) {
+		SetupViewports();
+		SetupGameInputs();
+	}
+
+	network.olxConnect();
+
+	if(game.needManualClientSideStateManagement())
+		game.state = Game::S_Lobby;
+
+	if(DedicatedControl::Get())
+		DedicatedControl::Get()->Connecting_Signal(file);
+
+	return true;
+}
+
+void CClient::StopDemo() {
+	if(demoRecorder) {
+		delete demoRecorder;
+		demoRecorder = NULL;
+	}
+	if(demoPlayer) {
+		notes << demoPlayer->summary() << endl;
+		delete demoPlayer;
+		demoPlayer = NULL;
+	}
+}
+
 ///////////////////
 // Start a connection with the server
 void CClient::Connect(const std::string& address)
@@ -1543,7 +1644,7 @@ void CClient::Connecting(bool force)
 // Disconnect
 void CClient::Disconnect()
 {
-	if(iNetStatus != NET_DISCONNECTED && cNetEngine) {
+	if(iNetStatus != NET_DISCONNECTED && cNetEngine && !demoPlayer) {
 		cNetEngine->SendDisconnect();
 
 		// Log leaving the server
@@ -1551,6 +1652,7 @@ void CClient::Disconnect()
 			convoLogger->leaveServer();
 	}
 
+	StopDemo();
 	iNetStatus = NET_DISCONNECTED;
 }
 
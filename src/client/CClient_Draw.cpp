@@ -57,6 +57,7 @@
 #include "game/Game.h"
 #include "gusanos/gusgame.h"
 #include "gusanos/luaapi/context.h"
+#include "gusanos/luaapi/profiler.h"
 #include "game/SinglePlayer.h"
 #include "gusanos/network.h"
 #include "CodeAttributes.h"
@@ -704,6 +705,8 @@ void CClient::Draw(const SmartPointer<SDL_Surface>& bmpDest)
 		dbgtxtHudLines.push_back("Objects: " + cast<std::string>(game.objects.size()));
 		dbgtxtHudLines.push_back("Players: " + cast<std::string>(game.players.size()));
 		dbgtxtHudLines.push_back("Lua Mem: " + cast<std::string>(lua_gc(luaIngame, LUA_GCCOUNT, 0)));
+		if(luaIngameGC.frames > 0)
+			dbgtxtHudLines.push_back("Lua GC max: " + ftoa(float(luaIngameGC.maxFrameTicks * 1000.0 / SDL_GetPerformanceFrequency()), 3) + " ms");
 	}
 	
 	foreach(i, hudDebugInfo)
@@ -1650,14 +1653,6 @@ void CClient::DrawGameMenu(SDL_Surface * bmpDest)
 }
 
 
-struct ScoreCompare {
-	bool operator()(int i, int j) const {
-		CWorm *w1 = game.wormById(i), *w2 = game.wormById(j);
-		if(cClient->getGameLobby()[FT_GameMode].as<GameModeInfo>()->mode) return cClient->getGameLobby()[FT_GameMode].as<GameModeInfo>()->mode->CompareWormsScore(w1, w2) > 0;
-		return GameMode(GM_DEATHMATCH)->CompareWormsScore(w1, w2) > 0;
-	}
-};
-
 ///////////////////
 // Update the player list in game menu
 // see also CClient::UpdateIngameScore
@@ -1672,12 +1667,10 @@ void CClient::UpdateScore(DeprecatedGUI::CListview *Left, DeprecatedGUI::CListvi
 	}
 
 	// Add the worms to the list
-	std::vector<int> iScoreboard;
+	const std::vector<int>& iScoreboard = game.roster.ranked();
 	for_each_iterator(CWorm*, w_, game.worms()) {
 		CWorm* w = w_->get();
 
-		iScoreboard.push_back(w->getID());
-
 		// in other cases, we got the scores from the server
 		if(getServerVersion() < OLXBetaVersion(0,58,1)) {
 			// Add to the team score
@@ -1707,8 +1700,6 @@ void CClient::UpdateScore(DeprecatedGUI::CListview *Left, DeprecatedGUI::CListvi
 		}
 	}
 
-	std::sort(iScoreboard.begin(), iScoreboard.end(), ScoreCompare());
-
 	// Clear any previous info
 	Left->Clear();
 	Right->Clear();
@@ -2580,84 +2571,187 @@ void CClient::InitializeIngameScore()
 
 }
 
+static int GetScoreboardPing(CWorm *p, bool showPing)
+{
+	if (showPing)  {
+		CServerConnection *remoteClient = cServer->getClient(p->getID());
+		if (remoteClient && p->getID())
+			return remoteClient->getPing();
+	}
+	return -1;
+}
+
 ////////////////////
-// Update the scoreboard
-// see also CClient::UpdateScore
-void CClient::UpdateIngameScore(DeprecatedGUI::CListview *Left, DeprecatedGUI::CListview *Right, bool WaitForPlayers)
+// Fill in one scoreboard row as it should look now
+static void GetScoreboardRow(CWorm *p, bool WaitForPlayers, bool showPing, ScoreboardRow& row)
 {
-	DeprecatedGUI::CListview *lv = Left;
-	Color iColor;
+	row.wormId = p->getID();
+	row.version = game.roster.rowVersion(p->getID());
+	row.name = p->getName();
 
-	// Clear them first
-	Left->Clear();
-	Right->Clear();
+	// Get colour
+	if (tLXOptions->bColorizeNicks && cClient->getGameLobby()[FT_GameMode].as<GameModeInfo>()->generalGameType == GMT_TEAMS)
+		row.nameColour = tLX->clTeamColors[p->getTeam()];
+	else
+		row.nameColour = tLX->clNormalLabel;
+
+	// Local & human players are highlighted
+	row.highlight = p->getLocal() && (p->getType() != PRF_COMPUTER || game.isClient());
+	row.hasSkin = p->getPicimg().get() != NULL;
+
+	row.unlimitedLives = false;
+	row.stateColour = tLX->clPink; // Item colour
+	if (WaitForPlayers)  {
+		row.state = p->bWeaponsReady ? "Ready" : "Waiting";
+		row.stateColour = p->bWeaponsReady ? tLX->clReady : tLX->clWaiting;
+		row.kills = row.damage = "";
+	} else {
+		switch (p->getLives())  {
+		case WRM_OUT:
+			row.state = "out";
+			break;
+		case WRM_UNLIM:
+			row.state = "";
+			row.unlimitedLives = true;
+			break;
+		default:
+			row.state = itoa(p->getLives());
+			break;
+		}
+		row.kills = itoa(p->getKills());
+		row.damage = itoa(Round(p->getDamage()));
+	}
 
-	std::vector<int> iScoreboard;
-	for_each_iterator(CWorm*, w, game.worms()) {
-		iScoreboard.push_back(w->get()->getID());
+	row.ping = GetScoreboardPing(p, showPing);
+}
+
+////////////////////
+// Add a scoreboard row to the listview
+static void AddScoreboardRow(DeprecatedGUI::CListview *lv, int index, CWorm *p, bool WaitForPlayers, const ScoreboardRow& row)
+{
+	lv->AddItem(row.name, index, tLX->clNormalLabel);
+	if (row.highlight)  {
+		DeprecatedGUI::lv_item_t *it = lv->getItem(index);
+		it->iBgColour = tLX->clScoreHighlight;
+		it->iBgColour.a = 64;
 	}
-	std::sort(iScoreboard.begin(), iScoreboard.end(), ScoreCompare());
 
-	// Fill the listviews
-	for(size_t i=0; i < iScoreboard.size(); i++) {
-		if (i >= 16)  // Left listview overflowed, fill in the right one
-			lv = Right;
+	// ID
+	lv->AddSubitem(DeprecatedGUI::LVS_TEXT, itoa(row.wormId), (DynDrawIntf*)NULL, NULL);
 
-		CWorm *p = game.wormById(iScoreboard[i], false);
-		if(!p) return;
+	// Skin
+	lv->AddSubitem(DeprecatedGUI::LVS_IMAGE, "", p->getPicimg(), NULL, DeprecatedGUI::VALIGN_TOP);
 
-		// Get colour
-		if (tLXOptions->bColorizeNicks && getGameLobby()[FT_GameMode].as<GameModeInfo>()->generalGameType == GMT_TEAMS)
-			iColor = tLX->clTeamColors[p->getTeam()];
-		else
-			iColor = tLX->clNormalLabel;
-
-        // Add the player and if this player is local & human, highlight it
-		lv->AddItem(p->getName(), (int)i, tLX->clNormalLabel);
-		if (p->getLocal() && (p->getType() != PRF_COMPUTER || game.isClient()))  {
-			DeprecatedGUI::lv_item_t *it = lv->getItem((int)i);
-			it->iBgColour = tLX->clScoreHighlight;
-			it->iBgColour.a = 64;
-		}
+	// Name
+	lv->AddSubitem(DeprecatedGUI::LVS_TEXT, row.name, (DynDrawIntf*)NULL, NULL, DeprecatedGUI::VALIGN_MIDDLE, row.nameColour);
 
-		// ID
-		lv->AddSubitem(DeprecatedGUI::LVS_TEXT, itoa(p->getID()), (DynDrawIntf*)NULL, NULL);
+	// Lives or ready state
+	if (row.unlimitedLives)
+		lv->AddSubitem(DeprecatedGUI::LVS_IMAGE, "", DeprecatedGUI::gfxGame.bmpInfinite, NULL);
+	else
+		lv->AddSubitem(DeprecatedGUI::LVS_TEXT, row.state, (DynDrawIntf*)NULL, NULL, DeprecatedGUI::VALIGN_MIDDLE, row.stateColour);
 
-        // Skin
-		lv->AddSubitem(DeprecatedGUI::LVS_IMAGE, "", p->getPicimg(), NULL, DeprecatedGUI::VALIGN_TOP);
+	if (!WaitForPlayers)  {
+		// Kills
+		lv->AddSubitem(DeprecatedGUI::LVS_TEXT, row.kills, (DynDrawIntf*)NULL, NULL);
+		// Damage
+		lv->AddSubitem(DeprecatedGUI::LVS_TEXT, row.damage, (DynDrawIntf*)NULL, NULL);
+	}
 
-		// Name
-		lv->AddSubitem(DeprecatedGUI::LVS_TEXT, p->getName(), (DynDrawIntf*)NULL, NULL, DeprecatedGUI::VALIGN_MIDDLE, iColor);
+	// Ping
+	if (row.ping >= 0)
+		lv->AddSubitem(DeprecatedGUI::LVS_TEXT, itoa(row.ping), (DynDrawIntf*)NULL, NULL);
+}
 
-		if (WaitForPlayers)
-			lv->AddSubitem(DeprecatedGUI::LVS_TEXT, p->bWeaponsReady ? "Ready" : "Waiting", (DynDrawIntf*)NULL, NULL, DeprecatedGUI::VALIGN_MIDDLE, p->bWeaponsReady ? tLX->clReady : tLX->clWaiting);
-		else  {
-			// Lives
-			switch (p->getLives())  {
-			case WRM_OUT:
-				lv->AddSubitem(DeprecatedGUI::LVS_TEXT, "out", (DynDrawIntf*)NULL, NULL);
-				break;
-			case WRM_UNLIM:
-				lv->AddSubitem(DeprecatedGUI::LVS_IMAGE, "", DeprecatedGUI::gfxGame.bmpInfinite, NULL);
-				break;
-			default:
-				lv->AddSubitem(DeprecatedGUI::LVS_TEXT, itoa(p->getLives()), (DynDrawIntf*)NULL, NULL);
-				break;
-			}
+static void SetScoreboardText(DeprecatedGUI::lv_subitem_t *sub, const std::string& text)
+{
+	if (sub && sub->sText != text)
+		sub->sText = text;
+}
 
-			// Kills
-			lv->AddSubitem(DeprecatedGUI::LVS_TEXT, itoa(p->getKills()), (DynDrawIntf*)NULL, NULL);
-			// Damage
-			lv->AddSubitem(DeprecatedGUI::LVS_TEXT, itoa(Round(p->getDamage())), (DynDrawIntf*)NULL, NULL);
+////////////////////
+// Update a shown row in place, returns false if it has to be recreated
+static bool UpdateScoreboardRow(DeprecatedGUI::CListview *lv, int index, bool WaitForPlayers, const ScoreboardRow& old, const ScoreboardRow& row)
+{
+	// The name is the item key, the others change the subitem layout
+	if (old.wormId != row.wormId || old.name != row.name || old.nameColour != row.nameColour ||
+		old.highlight != row.highlight || old.hasSkin != row.hasSkin || old.unlimitedLives != row.unlimitedLives || (old.ping >= 0) != (row.ping >= 0))
+		return false;
+
+	DeprecatedGUI::lv_item_t *it = lv->getItem(index);
+	if (!it)
+		return false;
+
+	const int state = row.hasSkin ? 3 : 2;
+	// Without the image, the infinite lives subitem isn't there either
+	const int next = (row.unlimitedLives && !DeprecatedGUI::gfxGame.bmpInfinite.get()) ? state : state + 1;
+	if (!row.unlimitedLives)  {
+		DeprecatedGUI::lv_subitem_t *sub = lv->getSubItem(it, state);
+		if (!sub) return false;
+		SetScoreboardText(sub, row.state);
+		sub->iColour = (row.stateColour == tLX->clPink) ? it->iColour : row.stateColour;
+	}
+	if (!WaitForPlayers)  {
+		SetScoreboardText(lv->getSubItem(it, next), row.kills);
+		SetScoreboardText(lv->getSubItem(it, next + 1), row.damage);
+	}
+	if (row.ping >= 0)
+		SetScoreboardText(lv->getSubItem(it, WaitForPlayers ? next : next + 2), itoa(row.ping));
+
+	lv->SetRepaint(true);
+	return true;
+}
+
+////////////////////
+// Update the scoreboard
+// see also CClient::UpdateScore
+// The ranking comes from game.roster; rows which didn't change are not touched.
+void CClient::UpdateIngameScore(DeprecatedGUI::CListview *Left, DeprecatedGUI::CListview *Right, bool WaitForPlayers)
+{
+	const std::vector<int>& ranked = game.roster.ranked();
+	const bool showPing = game.isServer() && !game.isLocalGame();
+	const int layout = (WaitForPlayers ? 1 : 0) | (showPing ? 2 : 0);
+
+	// The listviews could have been cleared or recreated in the meanwhile
+	bool rebuild = layout != iScoreboardLayout || tScoreboardRows.size() != ranked.size() ||
+		(size_t)(Left->getNumItems() + Right->getNumItems()) != ranked.size();
+
+	std::vector<ScoreboardRow> rows(ranked.size());
+	for(size_t i=0; i < ranked.size(); i++) {
+		CWorm *p = game.wormById(ranked[i], false);
+		if(!p) {
+			// The roster is ahead of us; try again next time
+			iScoreboardLayout = -1;
+			return;
 		}
 
-		// Ping
-		if((game.isServer() && !game.isLocalGame()))  {
-			CServerConnection *remoteClient = cServer->getClient(p->getID());
-			if (remoteClient && p->getID())
-				lv->AddSubitem(DeprecatedGUI::LVS_TEXT, itoa(remoteClient->getPing()), (DynDrawIntf*)NULL, NULL);
+		const ScoreboardRow* old = (i < tScoreboardRows.size()) ? &tScoreboardRows[i] : NULL;
+		if(!rebuild && old->wormId == p->getID() && old->version == game.roster.rowVersion(p->getID()) &&
+			old->ping == GetScoreboardPing(p, showPing)) {
+			rows[i] = *old;
+			continue;
 		}
-    }
+
+		GetScoreboardRow(p, WaitForPlayers, showPing, rows[i]);
+
+		if(!rebuild && !UpdateScoreboardRow(i >= 16 ? Right : Left, (int)i, WaitForPlayers, *old, rows[i]))
+			rebuild = true;
+	}
+
+	if(rebuild) {
+		Left->Clear();
+		Right->Clear();
+
+		// Fill the listviews
+		for(size_t i=0; i < ranked.size(); i++) {
+			// Left listview overflowed, fill in the right one
+			DeprecatedGUI::CListview *lv = (i >= 16) ? Right : Left;
+			AddScoreboardRow(lv, (int)i, game.wormById(ranked[i]), WaitForPlayers, rows[i]);
+		}
+	}
+
+	tScoreboardRows.swap(rows);
+	iScoreboardLayout = layout;
 }
 
 #define WAIT_COL_W 180
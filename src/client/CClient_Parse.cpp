@@ -21,6 +21,7 @@
 #include "LieroX.h"
 #include "Cache.h"
 #include "CClient.h"
+#include "Demo.h"
 #include "CServer.h"
 #include "OLXConsole.h"
 #include "GfxPrimitives.h"
@@ -357,6 +358,9 @@ void CClientNetEngine::ParseConnected(CBytestream *bs)
 	DeprecatedGUI::bJoin_Update = true;
 	DeprecatedGUI::bHost_Update = true;
 
+	if(!isReconnect && game.isClient() && tLXOptions->bRecordDemos && !client->demoRecorder)
+		client->demoRecorder = DemoRecorder::start(client);
+
 	if(!isReconnect) {
 		// We always allow it on servers < 0.57 beta5 because 0.57b5 is the first version
 		// which has a setting for allowing/disallowing it.
@@ -2011,6 +2015,13 @@ void CClientNetEngine::ParseUpdateStats(CBytestream *bs)
 	client->bShouldRepaintInfo = true;
 
 	byte num = bs->readByte();
+	if (client->demoPlayer) {
+		// These are the stats of the worms of whoever recorded the demo
+		for (short i=0;i<num;i++)
+			if (CWorm::skipStatUpdate(bs))
+				break;
+		return;
+	}
 	if (num > MAX_PLAYERS)
 		warnings << "CClientNetEngine::ParseUpdateStats: invalid worm count (" << num << ") - clamping" << endl;
 
@@ -23,6 +23,7 @@
 #include "PixelFunctors.h"
 #include "Unicode.h"
 #include "MathLib.h"
+#include "Options.h"
 
 
 //
@@ -45,6 +46,7 @@ int CFont::Load(const std::string& fontname, bool _colour) {
 	SetColorKey(bmpFont.get(), 255, 0, 255);
 
 	Colorize = _colour;
+	ClearTextCache();
 
 	bmpWhite = gfxCreateSurfaceAlpha(bmpFont.get()->w, bmpFont.get()->h);
 	bmpGreen = gfxCreateSurfaceAlpha(bmpFont.get()->w, bmpFont.get()->h);
@@ -69,6 +71,18 @@ int CFont::Load(const std::string& fontname, bool _colour) {
 ///////////////////
 // Shutdown the font
 void CFont::Shutdown() {
+	ClearTextCache();
+}
+
+
+///////////////////
+// Throw away all the pre-rendered text runs and measured widths
+// Must be called whenever something changes the look or the metrics of the glyphs
+void CFont::ClearTextCache() {
+	tTextRuns.clear();
+	tTextRunLRU.clear();
+	iTextRunBytes = 0;
+	tWidthCache.clear();
 }
 
 
@@ -243,7 +257,27 @@ void CFont::DrawAdv(SDL_Surface * dst, int x, int y, int max_w, Color col, const
 		errors << "CFont::DrawAdv(" << txt << "): dst->format == NULL" << endl;
 		return;
 	}
-	
+
+	// The glyph drawing below starts new lines at the left border of the clipping rect,
+	// a text run always starts them at x, so use the runs only when both are the same
+	if (x >= dst->clip_rect.x && max_w > 0)  {
+		const int width = MIN(max_w, GetWidth(txt));
+		if (width <= 0)
+			return;
+
+		SmartPointer<SDL_Surface> bmpRun = GetTextRun(txt, col, width);
+		if (bmpRun.get())  {
+			DrawImageAdv(dst, bmpRun, 0, 0, x, y, bmpRun->w, bmpRun->h);
+			return;
+		}
+	}
+
+	DrawAdvDirect(dst, x, y, max_w, col, txt);
+}
+
+///////////////////
+// Draw a font glyph by glyph, without the text run cache
+void CFont::DrawAdvDirect(SDL_Surface * dst, int x, int y, int max_w, Color col, const std::string& txt) {
 	// Set the newrect width and use this newrect temporarily to draw the font
 	// We use this rect because of precached fonts which use SDL_Blit for drawing (and it takes care of cliprect)
 	SDL_Rect newrect = dst->clip_rect;
@@ -255,25 +289,7 @@ void CFont::DrawAdv(SDL_Surface * dst, int x, int y, int max_w, Color col, const
 
 	ScopedSurfaceClip clip(dst, newrect);
 
-	// Look in the precached fonts if there's some for this color
-	SmartPointer<SDL_Surface> bmpCached = NULL;
-	if (Colorize) {
-		// HINT: if we leave this disabled, the drawing will always be done manually
-		// this is a bit (not not much) slower but prevents from the usual errors with CFont (wrong color, invisible, so on)
-		// TODO: should we completly remove the caches? how much speed improvements do they give?
-		// under MacOSX, it doesn't seem to give any performance improvement at all, at least no change in FPS
-		// I have activated it again now as it seem to work at the moment (perhabps because of my change in gfxCreateSurfaceAlpha)
-		if (col == f_white)
-			bmpCached = bmpWhite;
-		else if (col == tLX->clBlack)
-			bmpCached = bmpFont;
-		else if (col == f_green)
-			bmpCached = bmpGreen;
-	}
-	// Not colourize, bmpFont itself should be blitted without any changes, so it's precached
-	else {
-		bmpCached = bmpFont;
-	}
+	SmartPointer<SDL_Surface> bmpCached = GetPrecachedSurface(col);
 
 
 	// Lock the surfaces
@@ -361,6 +377,141 @@ void CFont::DrawAdv(SDL_Surface * dst, int x, int y, int max_w, Color col, const
 	}
 }
 
+///////////////////
+// Returns the pre-colored font surface for the given colour, NULL if the glyphs have to be colored manually
+SmartPointer<SDL_Surface> CFont::GetPrecachedSurface(Color col) {
+	// Not colourize, bmpFont itself should be blitted without any changes, so it's precached
+	if (!Colorize)
+		return bmpFont;
+
+	// Look in the precached fonts if there's some for this color
+	// HINT: if we leave this disabled, the drawing will always be done manually
+	// this is a bit (not not much) slower but prevents from the usual errors with CFont (wrong color, invisible, so on)
+	// TODO: should we completly remove the caches? how much speed improvements do they give?
+	// under MacOSX, it doesn't seem to give any performance improvement at all, at least no change in FPS
+	// I have activated it again now as it seem to work at the moment (perhabps because of my change in gfxCreateSurfaceAlpha)
+	if (col == f_white)
+		return bmpWhite;
+	else if (col == tLX->clBlack)
+		return bmpFont;
+	else if (col == f_green)
+		return bmpGreen;
+
+	return NULL;
+}
+
+///////////////////
+// Get the pre-rendered surface for the text, renders it if it is not in the cache yet
+// Returns NULL if the text should rather be drawn directly (too big for the cache)
+SmartPointer<SDL_Surface> CFont::GetTextRun(const std::string& txt, Color col, int width) {
+	TextRunKey key;
+	key.text = txt;
+	key.col = col;
+	key.width = width;
+	key.vspacing = VSpacing;
+
+	// Already rendered, move it to the front of the LRU list
+	TextRunCache::iterator it = tTextRuns.find(key);
+	if (it != tTextRuns.end())  {
+		tTextRunLRU.splice(tTextRunLRU.begin(), tTextRunLRU, it->second.lruIt);
+		return it->second.bmpRun;
+	}
+
+	const size_t budget = (size_t)MAX(0, tLXOptions ? tLXOptions->iFontCacheSize : 0) * 1024;
+	const size_t bytes = (size_t)width * (size_t)(GetHeight(txt) - VSpacing) * 4;
+
+	// Don't let a single huge text (console log, credits) flush everything else
+	if (bytes == 0 || bytes > budget / 8)
+		return NULL;
+
+	SmartPointer<SDL_Surface> bmpRun = RenderTextRun(txt, col, width);
+	if (!bmpRun.get())
+		return NULL;
+
+	// Make space for the new run, least recently used ones go first
+	while (iTextRunBytes + bytes > budget && tTextRunLRU.size())  {
+		TextRunCache::iterator old = tTextRuns.find(*tTextRunLRU.back());
+		tTextRunLRU.pop_back();
+		iTextRunBytes -= old->second.iBytes;
+		tTextRuns.erase(old);
+	}
+
+	it = tTextRuns.insert(TextRunCache::value_type(key, TextRun())).first;
+	it->second.bmpRun = bmpRun;
+	it->second.iBytes = bytes;
+	tTextRunLRU.push_front(&it->first);
+	it->second.lruIt = tTextRunLRU.begin();
+	iTextRunBytes += bytes;
+
+	return bmpRun;
+}
+
+///////////////////
+// Composes the whole text into a new alpha surface, width is the maximal width of the text
+SmartPointer<SDL_Surface> CFont::RenderTextRun(const std::string& txt, Color col, int width) {
+	const int char_h = bmpFont.get()->h;
+	SmartPointer<SDL_Surface> bmpRun = gfxCreateSurfaceAlpha(width, GetHeight(txt) - VSpacing);
+	if (!bmpRun.get())
+		return NULL;
+	FillSurfaceTransparent(bmpRun.get());
+
+	SmartPointer<SDL_Surface> bmpCached = GetPrecachedSurface(col);
+
+	// Precached glyphs are copied including their alpha, blending them onto the transparent surface
+	// would multiply the alpha in twice when the run gets blitted.
+	// bmpFont itself (not colorized or black) has no alpha but a colour key, it is blitted normally.
+	if (!bmpCached.get())  {
+		if (!LockSurface(bmpRun))
+			return NULL;
+		if (!LockSurface(bmpFont))  {
+			UnlockSurface(bmpRun);
+			return NULL;
+		}
+	}
+
+	PixelPutAlpha& putter = getPixelAlphaPutFunc(bmpRun.get());
+	PixelGet& getter = getPixelGetFunc(bmpFont.get());
+
+	typedef void(CFont::*GlyphBlitter)(SDL_Surface *dst, const SDL_Rect& r, int sx, int sy, Color col, int glyph_index, PixelPutAlpha& putter, PixelGet& getter);
+	GlyphBlitter func = &CFont::DrawGlyphNormal_Internal;
+	if (OutlineFont)
+		func = &CFont::DrawGlyphOutline_Internal;
+
+	int x = 0, y = 0;
+	for (std::string::const_iterator p = txt.begin(); p != txt.end();) {
+		if (*p == '\n') {
+			y += char_h + VSpacing;
+			x = 0;
+			p++;
+			continue;
+		}
+
+		int l = TranslateCharacter(p, txt.end()); // HINT: increases the iterator
+		if (l == -1)
+			continue;
+
+		int char_x = x;
+		int char_w = FontWidth[l];
+		if (OneSideClip(char_x, char_w, 0, width))  {
+			if (bmpCached.get() == bmpFont.get())  // Colour keyed, the key must stay transparent
+				DrawImageAdv(bmpRun.get(), bmpCached, CharacterOffset[l] + char_x - x, 0, char_x, y, char_w, char_h);
+			else if (bmpCached.get())
+				CopySurface(bmpRun.get(), bmpCached, CharacterOffset[l] + char_x - x, 0, char_x, y, char_w, char_h);
+			else
+				(this->*(func))(bmpRun.get(), MakeRect(char_x, y, char_w, char_h), char_x - x, 0, col, l, putter, getter);
+		}
+
+		x += FontWidth[l] + Spacing;
+	}
+
+	if (!bmpCached.get())  {
+		UnlockSurface(bmpRun);
+		UnlockSurface(bmpFont);
+	}
+
+	return bmpRun;
+}
+
 /////////////////////////
 // Draws an outlined character
 void CFont::DrawGlyphOutline_Internal(SDL_Surface *dst, const SDL_Rect& r, int sx, int sy, Color col, int glyph_index, PixelPutAlpha& putter, PixelGet& getter)
@@ -450,8 +601,24 @@ void CFont::DrawGlyph(SDL_Surface *dst, int x, int y, Color col, UnicodeChar c)
 
 
 ///////////////////
-// Calculate the width of a string of text
+// Get the width of a string of text, the widths are remembered because the same texts get measured every frame
 int CFont::GetWidth(const std::string& buf) {
+	std::map<std::string, int>::const_iterator it = tWidthCache.find(buf);
+	if (it != tWidthCache.end())
+		return it->second;
+
+	// Typed text and changing numbers would make this grow forever
+	if (tWidthCache.size() >= 4096)
+		tWidthCache.clear();
+
+	const int width = CalculateWidth(buf);
+	tWidthCache[buf] = width;
+	return width;
+}
+
+///////////////////
+// Calculate the width of a string of text
+int CFont::CalculateWidth(const std::string& buf) {
 	int length = 0, maxlength = 0;
 	short l;
 
@@ -81,71 +81,82 @@ static AbsTime getCurrentTime()
 	return tLX->currentTime;
 }
 
+static Uint64 getFileTimeStamp(const std::string& file)
+{
+	struct stat st;
+	if(!StatFile(file, &st)) return 0;
+	return (Uint64)st.st_mtime;
+}
+
+const char* CCache::ItemTypeName(ItemType t)
+{
+	switch(t) {
+		case IT_Image: return "images";
+		case IT_Sound: return "sounds";
+		case IT_Map: return "maps";
+		case IT_Mod: return "mods";
+		default: return "unknown";
+	}
+}
+
 //////////////
 // Save an image to the cache
-void CCache::SaveImage__unsafe(const std::string& file1, const SmartPointer<SDL_Surface> & img)
+SmartPointer<SDL_Surface> CCache::SaveImage(const std::string& file1, const SmartPointer<SDL_Surface> & img)
 {
 	if (img.get() == NULL)
-		return;
+		return img;
 
 	std::string file = file1;
 	stringlwr(file);
-	if( ImageCache.find(file) != ImageCache.end() )	// Error - already in cache
-	{
-		errors << "Error: image already in cache - memleak: " << file << endl;
-		return;
-	}
-	//notes << "CCache::SaveImage(): " << img << " " << file << endl;
-	ImageCache[file] = ImageItem_t(img, getCurrentTime(), 0);
+	// Another thread might have loaded the same image meanwhile, then we just use that one
+	SmartPointer<SDL_Surface> ret = ImageCache.put(file, file1, img, 0, GetSurfaceMemorySize(img.get()), getCurrentTime());
+	ClearExtraEntriesIfNeeded();
+	return ret;
 }
 
 //////////////
 // Save a sound sample to the cache
 void CCache::SaveSound(const std::string& file1, const SmartPointer<SoundSample> & smp)
 {
-	ScopedLock lock(mutex);
 	if (smp.get() == NULL)
 		return;
 
 	std::string file = file1;
 	stringlwr(file);
-	if( SoundCache.find(file) != SoundCache.end() )
-	{
+	size_t bytes = 0;
+#ifndef DEDICATED_ONLY
+	bytes = sizeof(SoundSample) + smp->GetMemorySize();
+#endif
+	bool existed = false;
+	SoundCache.put(file, file1, smp, 0, bytes, getCurrentTime(), &existed);
+	if(existed)
 		errors << "Error: sound already in cache - memleak: " << file << endl;
-		return;
-	};
-	SoundCache[file] = SoundItem_t( smp, getCurrentTime(), 0 );
+	ClearExtraEntriesIfNeeded();
 }
 
 //////////////
 // Save a map to the cache
 void CCache::SaveMap(const std::string& file1, CMap *map)
 {
-	{
-		ScopedLock lock(mutex);
-		if (map == NULL)
-			return;
-
-		std::string file = file1;
-		stringlwr(file);
-		if( MapCache.find(file) != MapCache.end() )	// Error - already in cache
-		{
-			errors << "Error: map already in cache: " << file << endl;
-			return;
-		}
+	if (map == NULL)
+		return;
 
-		// Copy the map to the cache (not just the pointer because map changes during the game)
-		SmartPointer<CMap> cached_map = new CMap;
-		if (cached_map.get() == NULL)
-			return;
+	std::string file = file1;
+	stringlwr(file);
 
-		if (!cached_map->NewFrom(map))
-			return;
+	// Copy the map to the cache (not just the pointer because map changes during the game)
+	SmartPointer<CMap> cached_map = new CMap;
+	if (cached_map.get() == NULL)
+		return;
+
+	if (!cached_map->NewFrom(map))
+		return;
+
+	bool existed = false;
+	MapCache.put(file, file1, cached_map, getFileTimeStamp(file1), cached_map->GetMemorySize(), getCurrentTime(), &existed);
+	if(existed)
+		errors << "Error: map already in cache: " << file << endl;
 
-		struct stat st;
-		StatFile(file1, &st);
-		MapCache[file] = MapItem_t( cached_map, getCurrentTime(), st.st_mtime );
-	}
 	ClearExtraEntries(); // Cache can get very big when browsing through levels - clear it here
 }
 
@@ -169,30 +180,22 @@ void CCache::SaveMod(const std::string& file1, const SmartPointer<CGameScript> &
 	std::string file = file1;
 	stringlwr(file);
 
-	ScopedLock lock(mutex);
-	if( ModCache.find(file) != ModCache.end() )	// Error - already in cache
-	{
+	bool existed = false;
+	ModCache.put(file, file1, mod, getFileTimeStamp(file1), mod->GetMemorySize(), getCurrentTime(), &existed);
+	if(existed)
 		errors << "Error: mod already in cache - memleak: " << file << endl;
-		return;
-	}
-
-	struct stat st;
-	StatFile(file1, &st);
-	ModCache[file] = ModItem_t( mod, getCurrentTime(), st.st_mtime );
+	ClearExtraEntriesIfNeeded();
 }
 
 //////////////
 // Get an image from the cache
-SmartPointer<SDL_Surface> CCache::GetImage__unsafe(const std::string& file1)
+SmartPointer<SDL_Surface> CCache::GetImage(const std::string& file1)
 {
 	std::string file = file1;
 	stringlwr(file);
-	ImageCache_t::iterator item = ImageCache.find(file);
-	if(item != ImageCache.end())
-	{
-		item->second.fSaveTime = getCurrentTime();
-		return item->second.bmpSurf;
-	}
+	Store<SDL_Surface>::Entry e;
+	if(ImageCache.get(file, getCurrentTime(), e))
+		return e.data;
 	return NULL;
 }
 
@@ -200,15 +203,11 @@ SmartPointer<SDL_Surface> CCache::GetImage__unsafe(const std::string& file1)
 // Get a sound sample from the cache
 SmartPointer<SoundSample> CCache::GetSound(const std::string& file1)
 {
-	ScopedLock lock(mutex);
 	std::string file = file1;
 	stringlwr(file);
-	SoundCache_t::iterator item = SoundCache.find(file);
-	if(item != SoundCache.end())
-	{
-		item->second.fSaveTime = getCurrentTime();
-		return item->second.sndSample;
-	};
+	Store<SoundSample>::Entry e;
+	if(SoundCache.get(file, getCurrentTime(), e))
+		return e.data;
 	return NULL;
 }
 
@@ -216,57 +215,45 @@ SmartPointer<SoundSample> CCache::GetSound(const std::string& file1)
 // Get a map from the cache
 SmartPointer<CMap> CCache::GetMap(const std::string& file1)
 {
-	ScopedLock lock(mutex);
 	std::string file = file1;
 	stringlwr(file);
-	MapCache_t::iterator item = MapCache.find(file);
-	if(item != MapCache.end())
-	{
-		// If the file has changed, don't consider it as found and erase it from the cache
-		struct stat st;
-		StatFile(item->first, &st);
-		if (item->second.iFileTimeStamp != (Uint64)st.st_mtime)  {
-			item->second.tMap = NULL;
-			MapCache.erase(item);
-			return NULL;
-		}
-
-		item->second.fSaveTime = getCurrentTime();
-		return item->second.tMap;
+	Store<CMap>::Entry e;
+	if(!MapCache.get(file, getCurrentTime(), e))
+		return NULL;
+
+	// If the file has changed, don't consider it as found and erase it from the cache.
+	// The stat is done without holding the lock.
+	if (e.fileTimeStamp != getFileTimeStamp(e.file))  {
+		MapCache.eraseStale(file, e.data);
+		return NULL;
 	}
-	return NULL;
+
+	return e.data;
 }
 
 //////////////
 // Get a mod from the cache
 SmartPointer<CGameScript> CCache::GetMod(const std::string& file1)
 {
-	ScopedLock lock(mutex);
 	std::string file = file1;
 	stringlwr(file);
-	ModCache_t::iterator item = ModCache.find(file);
-	if(item != ModCache.end())
-	{
-		// If the file has changed, don't consider it as found and erase it from the cache
-		struct stat st;
-		StatFile(item->first, &st);
-		if (item->second.iFileTimeStamp != (Uint64)st.st_mtime)  {
-			item->second.tMod = NULL;
-			ModCache.erase(item);
-			return NULL;
-		}
+	Store<CGameScript>::Entry e;
+	if(!ModCache.get(file, getCurrentTime(), e))
+		return NULL;
+
+	// If the file has changed, don't consider it as found and erase it from the cache
+	if (e.fileTimeStamp != getFileTimeStamp(e.file))  {
+		ModCache.eraseStale(file, e.data);
+		return NULL;
+	}
 
-		item->second.fSaveTime = getCurrentTime();
-		return item->second.tMod;
-	};
-	return NULL;
+	return e.data;
 }
 
 //////////////
 // Free all allocated data
 void CCache::Clear()
 {
-	ScopedLock lock(mutex);
 	ModCache.clear();
 	MapCache.clear();
 	ImageCache.clear();
@@ -274,161 +261,97 @@ void CCache::Clear()
 }
 
 void CCache::ClearSounds() {
-	ScopedLock lock(mutex);
 	SoundCache.clear();
 }
 
 
+CCache::Stats CCache::GetStats(ItemType t)
+{
+	switch(t) {
+		case IT_Image: return ImageCache.stats();
+		case IT_Sound: return SoundCache.stats();
+		case IT_Map: return MapCache.stats();
+		case IT_Mod: return ModCache.stats();
+		default: return Stats();
+	}
+}
+
 ///////////////////////
 // Get the number of memory occupied (in bytes)
+// The sizes are taken when the entries are saved.
+// Lock-free, Save*() calls this for every new entry
 size_t CCache::GetCacheSize()
 {
-	ScopedLock lock(mutex);
-
-	size_t res = sizeof(CCache);
-	for (ImageCache_t::iterator it = ImageCache.begin(); it != ImageCache.end(); it++)
-		res += GetSurfaceMemorySize(it->second.bmpSurf.get()) + it->first.size();
-
-	for (ModCache_t::iterator it = ModCache.begin(); it != ModCache.end(); it++)
-		res += it->second.tMod.get()->GetMemorySize() + it->first.size();
-
-	for (MapCache_t::iterator it = MapCache.begin(); it != MapCache.end(); it++)
-		res += it->second.tMap.get()->GetMemorySize() + it->first.size();
-
-#ifndef DEDICATED_ONLY
-	for (SoundCache_t::iterator it = SoundCache.begin(); it != SoundCache.end(); it++)
-		res += it->first.size() + sizeof(SoundSample) + it->second.sndSample->GetMemorySize();
-#endif
-
-	return res;
+	return sizeof(CCache) + ImageCache.bytes() + SoundCache.bytes() + MapCache.bytes() + ModCache.bytes();
 }
 
 size_t CCache::GetEntryCount() {
-	ScopedLock lock(mutex);
-	
 	size_t res = 0;
-	res += ImageCache.size();
-	res += ModCache.size();
-	res += MapCache.size();
-	res += SoundCache.size();
-	
+	for(int t = 0; t < IT_Count; ++t)
+		res += GetStats((ItemType)t).entries;
 	return res;
 }
 
-void CCache::ClearExtraEntries()
+///////////////////////
+// The memory budget: Advanced.CacheMaxSize, but we don't take more than half of the free system memory
+size_t CCache::effectiveMaxSize()
+{
+	size_t maxSize = optionMaxSize();
+	const size_t available = GetCacheSize() + GetFreeSysMemory() / 2;
+	if(available < maxSize) maxSize = available;
+	return maxSize;
+}
+
+size_t CCache::optionMaxSize()
+{
+	return (size_t)MAX(tLXOptions ? tLXOptions->iCacheMaxSize : 256, 1) * 1024 * 1024;
+}
+
+// Called for every new entry, so it is kept cheap. The entry count limits are checked in ClearExtraEntries().
+void CCache::ClearExtraEntriesIfNeeded()
 {
-	static const int estimatedCacheEntrySize = 1024*300;
-	size_t availableMem = GetFreeSysMemory() + GetCacheSize();
-	int estimatedMaxPossibleEntries = int(availableMem / estimatedCacheEntrySize);
-	if(estimatedMaxPossibleEntries < tLXOptions->iMaxCachedEntries) {
-		warnings << "The estimated possible max entry count in cache (" << estimatedMaxPossibleEntries << ") ";
-		warnings << "is lower than the current set maximum (" << tLXOptions->iMaxCachedEntries << ")" << endl;
-		hints << "Free system memory: " << (GetFreeSysMemory() / 1024) << " KB" << endl; 
-		notes << "Lowering cache limit now" << endl;
-		tLXOptions->iMaxCachedEntries = estimatedMaxPossibleEntries;
+	const size_t maxSize = optionMaxSize();
+	const size_t size = GetCacheSize();
+	if(size <= maxSize) return;
+	{
+		Mutex::ScopedLock lock(shrinkMutex);
+		// Everything was in use last time, don't check all entries again for each new one
+		if(size < lastShrinkFailedSize + maxSize / 16) return;
 	}
+	ClearExtraEntries();
+}
 
-	ScopedLock lock(mutex);
-	
-	if( (int)MapCache.size() >= tLXOptions->iMaxCachedEntries / 50 )
-	{	// Sorted by last-access time, iterators are not invalidated in a map when element is erased
-		typedef std::multimap< AbsTime, MapCache_t :: iterator > TimeSorted_t;
-		TimeSorted_t TimeSorted;
-		int count = 0;
-		for( MapCache_t :: iterator it = MapCache.begin(); it != MapCache.end(); it++  )
-		{
-			TimeSorted.insert( std::make_pair( it->second.fSaveTime, it ) );
-			if( it->second.tMap.getRefCount() <= 1 )
-				count ++;
-		}
-		{
-			int clearCount = (int)MIN( (size_t)count, MapCache.size() - tLXOptions->iMaxCachedEntries / 50 );
-			for( TimeSorted_t :: iterator it1 = TimeSorted.begin();
-					it1 != TimeSorted.end() && clearCount > 0; it1++, clearCount-- )
-			{
-				if( it1->second->second.tMap.tryDeleteData() )
-				{
-					clearCount --;
-					MapCache.erase( it1->second );
-				}
-			}
-		}
+void CCache::ClearExtraEntries()
+{
+	Mutex::ScopedLock lock(shrinkMutex);
+	const AbsTime now = getCurrentTime();
+	const size_t maxEntries = (size_t)MAX(tLXOptions ? tLXOptions->iMaxCachedEntries : 300, 1);
+	const size_t maxSize = effectiveMaxSize();
+	const size_t size = GetCacheSize();
+	size_t excess = (size > maxSize) ? (size - maxSize) : 0;
+
+	// Delete maps and mods first, and images/sounds after, 'cause they are used by mods mainly
+	{
+		const size_t bytes = MapCache.stats().bytes;
+		excess -= MIN(excess, MapCache.shrink(bytes - MIN(bytes, excess), MAX(maxEntries / 50, (size_t)1), now));
 	}
-	
-	// Delete mods first, and images/sounds after, 'cause they are used by mods mainly
-	if( (int)ModCache.size() >= tLXOptions->iMaxCachedEntries / 50 )
-	{	// Sorted by last-access time, iterators are not invalidated in a map when element is erased
-		typedef std::multimap< AbsTime, ModCache_t :: iterator > TimeSorted_t;
-		TimeSorted_t TimeSorted;
-		int count = 0;
-		for( ModCache_t :: iterator it = ModCache.begin(); it != ModCache.end(); it++  )
-		{
-			TimeSorted.insert( std::make_pair( it->second.fSaveTime, it ) );
-			if( it->second.tMod.getRefCount() <= 1 )
-				count ++;
-		}
-		{
-			int clearCount = (int)MIN( (size_t)count, ModCache.size() - tLXOptions->iMaxCachedEntries / 50 );
-			for( TimeSorted_t :: iterator it1 = TimeSorted.begin();
-					it1 != TimeSorted.end() && clearCount > 0; it1++, clearCount-- )
-			{
-				if( it1->second->second.tMod.tryDeleteData() )
-				{
-					clearCount --;
-					ModCache.erase( it1->second );
-				}
-			}
-		}
+	{
+		const size_t bytes = ModCache.stats().bytes;
+		excess -= MIN(excess, ModCache.shrink(bytes - MIN(bytes, excess), MAX(maxEntries / 50, (size_t)1), now));
+	}
+	{
+		const size_t bytes = ImageCache.stats().bytes;
+		excess -= MIN(excess, ImageCache.shrink(bytes - MIN(bytes, excess), maxEntries, now));
+	}
+	{
+		const size_t bytes = SoundCache.stats().bytes;
+		excess -= MIN(excess, SoundCache.shrink(bytes - MIN(bytes, excess), maxEntries, now));
 	}
 
-	if( (int)ImageCache.size() >= tLXOptions->iMaxCachedEntries )
-	{	// Sorted by last-access time, iterators are not invalidated in a map when element is erased
-		typedef std::multimap< AbsTime, ImageCache_t :: iterator > TimeSorted_t;
-		TimeSorted_t TimeSorted;
-		int count = 0;
-		for( ImageCache_t :: iterator it = ImageCache.begin(); it != ImageCache.end(); it++  )
-		{
-			TimeSorted.insert( std::make_pair( it->second.fSaveTime, it ) );
-			if( it->second.bmpSurf.getRefCount() <= 1 )
-				count ++;
-		}
-		{
-			int clearCount = (int)MIN( (size_t)count, ImageCache.size() - tLXOptions->iMaxCachedEntries );
-			for( TimeSorted_t :: iterator it1 = TimeSorted.begin();
-					it1 != TimeSorted.end() && clearCount > 0; it1++ )
-			{
-				if( it1->second->second.bmpSurf.tryDeleteData() )
-				{
-					clearCount --;
-					ImageCache.erase( it1->second );
-				};
-			};
-		};
-	};
-
-	if( (int)SoundCache.size() >= tLXOptions->iMaxCachedEntries )
-	{	// Sorted by last-access time, iterators are not invalidated in a map when element is erased
-		typedef std::multimap< AbsTime, SoundCache_t :: iterator > TimeSorted_t;
-		TimeSorted_t TimeSorted;
-		int count = 0;
-		for( SoundCache_t :: iterator it = SoundCache.begin(); it != SoundCache.end(); it++  )
-		{
-			TimeSorted.insert( std::make_pair( it->second.fSaveTime, it ) );
-			if( it->second.sndSample.getRefCount() <= 1 )
-				count ++;
-		}
-		{
-			int clearCount = (int)MIN( (size_t)count, SoundCache.size() - tLXOptions->iMaxCachedEntries );
-			for( TimeSorted_t :: iterator it1 = TimeSorted.begin();
-					it1 != TimeSorted.end() && clearCount > 0; it1++, clearCount-- )
-			{
-				if( it1->second->second.sndSample.tryDeleteData() )
-				{
-					clearCount --;
-					SoundCache.erase( it1->second );
-				}
-			}
-		}
+	if(excess > 0) {
+		warnings << "Cache: " << (excess / 1024) << " KB over the limit, all remaining entries are in use" << endl;
+		lastShrinkFailedSize = GetCacheSize();
 	}
+	else
+		lastShrinkFailedSize = 0;
 }
-
@@ -0,0 +1,314 @@
+/*
+ *  Demo.cpp
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#include <zlib.h>
+
+#include "Demo.h"
+#include "Debug.h"
+#include "LieroX.h"
+#include "Timer.h"
+#include "AuxLib.h"
+#include "FindFile.h"
+#include "StringUtils.h"
+#include "Protocol.h"
+#include "CClient.h"
+#include "game/CWorm.h"
+#include "game/Game.h"
+#include "game/Mod.h"
+#include "game/Level.h"
+
+
+static const int DEMO_FORMAT_VERSION = 1;
+static const size_t RECORD_HEADER_SIZE = 9; // type, time, length
+// Records are single packets or short headers, anything bigger is a broken file
+static const int MAX_RECORD_SIZE = 1024 * 1024;
+// How often we add the state of our own worms
+static const TimeDiff WORM_UPDATE_PERIOD = TimeDiff((Uint64)20);
+
+
+DemoRecorder* DemoRecorder::start(CClient* client) {
+	std::string name = client->getServerName();
+	if(name.size() > 32) name.resize(32);
+	for(size_t i = 0; i < name.size(); ++i)
+		if(!isalnum((uchar)name[i]) && name[i] != '-' && name[i] != '_')
+			name[i] = '-';
+
+	std::string file = "demos/" + GetDateTimeFilename() + "-" + name;
+	for(int i = 2; IsFileAvailable(file + ".olxdemo", false); ++i)
+		file = "demos/" + GetDateTimeFilename() + "-" + name + "-" + itoa(i);
+	file += ".olxdemo";
+
+	gzFile f = gzopen(GetWriteFullFileName(file, true).c_str(), "wb6");
+	if(f == NULL) {
+		warnings << "DemoRecorder: cannot open " << file << " for writing" << endl;
+		return NULL;
+	}
+
+	DemoRecorder* rec = new DemoRecorder();
+	rec->m_file = f;
+	rec->m_client = client;
+	rec->m_filename = file;
+	rec->m_start = tLX->currentTime;
+
+	CBytestream header;
+	header.writeString("OLX demo");
+	header.writeInt(DEMO_FORMAT_VERSION, 1);
+	header.writeString(GetFullGameName());
+	header.writeString(client->getServerVersion().asString());
+	header.writeString(client->getServerName());
+	rec->write(DR_HEADER, header.data());
+
+	// The server doesn't tell us about our own worms, so do it like for other clients
+	for_each_iterator(CWorm*, w, game.localWorms()) {
+		CBytestream bs;
+		bs.writeByte(S2C_WORMINFO);
+		bs.writeInt(w->get()->getID(), 1);
+		w->get()->writeInfo(&bs);
+		if(client->getServerVersion() >= OLXBetaVersion(0,58,1))
+			bs.writeString(client->getClientVersion().asString());
+		rec->write(DR_PACKET, bs.data());
+	}
+
+	notes << "recording demo " << file << endl;
+	return rec;
+}
+
+DemoRecorder::~DemoRecorder() {
+	if(m_file) {
+		gzclose(m_file);
+		notes << "demo " << m_filename << " saved (" << (m_bytes / 1024) << " KB uncompressed)" << endl;
+	}
+	m_file = NULL;
+}
+
+Uint32 DemoRecorder::now() const {
+	return (Uint32)(tLX->currentTime - m_start).milliseconds();
+}
+
+void DemoRecorder::write(uchar type, const std::string& data) {
+	if(m_file == NULL) return;
+
+	CBytestream rec;
+	rec.writeByte(type);
+	rec.writeInt(now(), 4);
+	rec.writeInt((int)data.size(), 4);
+	rec.writeData(data);
+
+	if(gzwrite(m_file, rec.data().data(), (unsigned)rec.GetLength()) != (int)rec.GetLength()) {
+		warnings << "DemoRecorder: error while writing " << m_filename << ", stopping the recording" << endl;
+		gzclose(m_file);
+		m_file = NULL;
+		return;
+	}
+	m_bytes += rec.GetLength();
+}
+
+void DemoRecorder::packet(const CBytestream& bs) {
+	if(bs.GetRestLen() == 0) return;
+	write(DR_PACKET, bs.peekData(bs.GetRestLen()));
+}
+
+void DemoRecorder::gameInfo(const std::string& mod, const std::string& map) {
+	CBytestream bs;
+	bs.writeString(mod);
+	bs.writeString(map);
+	write(DR_GAMEINFO, bs.data());
+}
+
+void DemoRecorder::localWorms() {
+	if(game.state != Game::S_Playing) return;
+	if(tLX->currentTime - m_lastWormUpdate < WORM_UPDATE_PERIOD) return;
+	m_lastWormUpdate = tLX->currentTime;
+
+	CBytestream worms;
+	int count = 0;
+	for_each_iterator(CWorm*, w, game.localWorms()) {
+		if(!w->get()->getAlive()) continue;
+		worms.writeByte(w->get()->getID());
+		w->get()->writePacketState(&worms, m_client->getServerVersion());
+		count++;
+	}
+	if(count == 0) return;
+
+	CBytestream bs;
+	bs.writeByte(S2C_UPDATEWORMS);
+	bs.writeByte(count);
+	bs.Append(&worms);
+	write(DR_PACKET, bs.data());
+}
+
+
+
+DemoPlayer::DemoPlayer() :
+	m_file(NULL), m_speed(1.0f), m_length(0), m_finished(false), m_started(false),
+	m_havePending(false), m_pendingType(0), m_pendingTime(0),
+	m_manualClock(false), m_lastTicks(0), m_clockRest(0.0f),
+	m_frames(0), m_wallStart(0) {}
+
+DemoPlayer::~DemoPlayer() {
+	if(m_file)
+		gzclose(m_file);
+	m_file = NULL;
+	if(m_manualClock)
+		timeCounter.setManual(false);
+}
+
+bool DemoPlayer::readRecord(uchar& type, Uint32& time, std::string& data) {
+	char head[RECORD_HEADER_SIZE];
+	if(gzread(m_file, head, RECORD_HEADER_SIZE) != (int)RECORD_HEADER_SIZE)
+		return false;
+
+	CBytestream bs(std::string(head, RECORD_HEADER_SIZE));
+	type = bs.readByte();
+	time = (Uint32)bs.readInt(4);
+	int len = bs.readInt(4);
+	if(len < 0 || len > MAX_RECORD_SIZE) {
+		warnings << "DemoPlayer: invalid record length " << len << " in " << m_filename << endl;
+		return false;
+	}
+
+	data.resize(len);
+	if(len > 0 && gzread(m_file, &data[0], (unsigned)len) != len)
+		return false;
+	return true;
+}
+
+DemoPlayer* DemoPlayer::open(const std::string& file, float speed, std::string& err) {
+	std::string fullname = IsAbsolutePath(file) ? file : GetFullFileName(file);
+	if(!IsFileAvailable(fullname, true)) {
+		fullname = GetFullFileName("demos/" + file);
+		if(!IsFileAvailable(fullname, true)) {
+			err = "file not found";
+			return NULL;
+		}
+	}
+
+	DemoPlayer* p = new DemoPlayer();
+	p->m_filename = file;
+	p->m_speed = MAX(speed, 0.0f);
+	p->m_file = gzopen(fullname.c_str(), "rb");
+	if(p->m_file == NULL) {
+		err = "cannot open file";
+		delete p;
+		return NULL;
+	}
+
+	uchar type = 0; Uint32 time = 0; std::string data;
+	if(!p->readRecord(type, time, data) || type != DR_HEADER) {
+		err = "not a demo file";
+		delete p;
+		return NULL;
+	}
+
+	CBytestream header(data);
+	if(header.readString() != "OLX demo") {
+		err = "not a demo file";
+		delete p;
+		return NULL;
+	}
+	int formatVersion = header.readInt(1);
+	if(formatVersion > DEMO_FORMAT_VERSION) {
+		err = "demo format " + itoa(formatVersion) + " is too new";
+		delete p;
+		return NULL;
+	}
+	std::string recordedWith = header.readString();
+	p->m_serverVersion = Version(header.readString());
+	p->m_serverName = header.readString();
+
+	// Go once through the whole demo to check that we have every mod and map.
+	// We cannot download them in playback.
+	std::set<std::string> mods, maps;
+	while(p->readRecord(type, time, data)) {
+		p->m_length = MAX(p->m_length, time);
+		if(type == DR_GAMEINFO) {
+			CBytestream bs(data);
+			mods.insert(bs.readString());
+			maps.insert(bs.readString());
+		}
+	}
+	foreach(m, mods)
+		if(*m != "" && !infoForMod(*m).valid) {
+			err = "mod " + *m + " is not available";
+			delete p;
+			return NULL;
+		}
+	foreach(m, maps)
+		if(*m != "" && !infoForLevel(*m).valid) {
+			err = "map " + *m + " is not available";
+			delete p;
+			return NULL;
+		}
+
+	gzrewind(p->m_file);
+	p->readRecord(type, time, data); // header
+
+	notes << "playing demo " << file << " recorded with " << recordedWith << " on " << p->m_serverName;
+	notes << ", " << (p->m_length / 1000) << " seconds" << endl;
+	return p;
+}
+
+void DemoPlayer::frame() {
+	m_frames++;
+	if(m_speed == 1.0f) return; // real time, we don't touch the clock
+
+	if(!m_manualClock) {
+		timeCounter.setManual(true);
+		m_manualClock = true;
+		m_lastTicks = SDL_GetTicks();
+	}
+
+	if(unthrottled()) {
+		// Exactly one simulation frame per main loop frame
+		timeCounter.advance(TimeDiff(Game::FixedFrameTime));
+		return;
+	}
+
+	const Uint32 ticks = SDL_GetTicks();
+	m_clockRest += (ticks - m_lastTicks) * m_speed;
+	m_lastTicks = ticks;
+	const Uint64 ms = (Uint64)m_clockRest;
+	m_clockRest -= ms;
+	timeCounter.advance(TimeDiff(ms));
+}
+
+void DemoPlayer::readPackets(std::list<CBytestream>& out) {
+	if(m_finished) return;
+	if(!m_started) {
+		m_started = true;
+		m_start = tLX->currentTime;
+		m_wallStart = SDL_GetPerformanceCounter();
+	}
+
+	const Uint64 elapsed = (tLX->currentTime - m_start).milliseconds();
+	while(true) {
+		if(!m_havePending) {
+			if(!readRecord(m_pendingType, m_pendingTime, m_pendingData)) {
+				m_finished = true;
+				return;
+			}
+			m_havePending = true;
+		}
+		if(m_pendingTime > elapsed)
+			return;
+
+		if(m_pendingType == DR_PACKET)
+			out.push_back(CBytestream(m_pendingData));
+		m_havePending = false;
+	}
+}
+
+std::string DemoPlayer::summary() const {
+	const double wallSecs = m_started ?
+		(SDL_GetPerformanceCounter() - m_wallStart) / double(SDL_GetPerformanceFrequency()) : 0.0;
+	const float demoSecs = m_length / 1000.0f;
+	std::string res = "demo " + m_filename + ": " + ftoa(demoSecs, 1) + " s played in " + ftoa(float(wallSecs), 1) + " s";
+	if(wallSecs > 0)
+		res += " (" + ftoa(float(demoSecs / wallSecs), 2) + "x real time, " + ftoa(float(m_frames / wallSecs), 1) + " frames/s)";
+	return res + ", " + to_string(m_frames) + " frames";
+}
@@ -14,6 +14,7 @@
 // Jason Boettcher
 
 
+#include <algorithm>
 #include "LieroX.h"
 
 #include "DeprecatedGUI/Menu.h"
@@ -93,8 +94,8 @@ void CListview::Draw(SDL_Surface * bmpDest)
 	}
 
 	x = iX+4;
-	lv_item_t *item = tItems;
-	int count=0;
+	// Only the visible rows are visited
+	lv_item_t *item = getItemAt(cScrollbar.getValue());
 
 	// Right bound
 	int right_bound = iX+iWidth-2;
@@ -109,9 +110,6 @@ void CListview::Draw(SDL_Surface * bmpDest)
 		
 		// Draw the items
 		for(;item;item = item->tNext) {
-			if(count++ < cScrollbar.getValue())
-				continue;
-
 			x = iX+4;
 
 			col = tColumns;
@@ -364,18 +362,15 @@ lv_item_t* CListview::AddItem(const std::string& sIndex, int iIndex, Color iColo
 	item->iColour = iColour;
 	item->iBgColour = tLX->clBlack;
 	item->iBgColour.a = SDL_ALPHA_TRANSPARENT;
-    item->_iID = iItemID++;
 
 	// Add it to the list
-	if(tItems) {
-		lv_item_t *i = tItems;
-		for(;i;i = i->tNext) {
-			if(i->tNext == NULL) {
-				i->tNext = item;
-				break;
-			}
-		}
-	}
+	item->_iID = (int)tItemArray.size();
+	tItemArray.push_back(item);
+	tItemsByIndex.insert(std::make_pair(iIndex, item));
+	tItemsByName.insert(std::make_pair(stringtolower(sIndex), item));
+	iItemsHeight += item->iHeight;
+	if(tLastItem)
+		tLastItem->tNext = item;
 	else {
 		tItems = item;
 		tSelected = item;
@@ -414,6 +409,8 @@ void CListview::AddSubitem(int iType, const std::string& sText, const SmartPoint
 		return;
 	}
 
+	const int oldHeight = tLastItem->iHeight;
+
 	// Allocate
 	lv_subitem_t *sub = new lv_subitem_t;
 
@@ -481,6 +478,7 @@ void CListview::AddSubitem(int iType, const std::string& sText, const SmartPoint
 			tLastItem->iHeight = MAX(tLastItem->iHeight,(sub->bmpImage.get()->h+4));
 		}
 	}
+	iItemsHeight += tLastItem->iHeight - oldHeight;
 
 	// Readjust the scrollbar
 	ReadjustScrollbar();
@@ -506,15 +504,9 @@ void CListview::ShowTooltip(const std::string &text, int ms_x, int ms_y)
 // Re-adjust the scrollbar
 void CListview::ReadjustScrollbar()
 {
-	// Go through each item and find the average height
-	lv_item_t *item = tItems;
-	int count = 0;
-	int size = 0;
-
-	for(;item;item=item->tNext) {
-		size += item->iHeight;
-		count++;
-	}
+	// Find the average height
+	int count = (int)tItemArray.size();
+	int size = iItemsHeight;
 
 	// Buffer size on top & bottom
 	int display_height = iHeight;  // Size of box with items
@@ -523,7 +515,7 @@ void CListview::ReadjustScrollbar()
 	if (bDrawBorder)
 		display_height -= 4;
 
-	if(count == 0) {
+	if(count == 0 || size / count <= 0) {
 		cScrollbar.setItemsperbox(0);
 		cScrollbar.setValue(0);
 		bGotScrollbar = false;
@@ -545,87 +537,62 @@ void CListview::ReadjustScrollbar()
 }
 
 
+///////////////////
+// Change the height of an item, keeps the sum for ReadjustScrollbar() right
+void CListview::setItemHeight(lv_item_t* item, int h)
+{
+	iItemsHeight += h - item->iHeight;
+	item->iHeight = h;
+	ReadjustScrollbar();
+}
+
+
 ///////////////////
 // Remove an item from the list
 void CListview::RemoveItem(int iIndex)
 {
-	lv_item_t *prev = NULL;
-	lv_item_t *i = tItems;
-	lv_item_t *next = NULL;
 	lv_subitem_t *s,*sub;
-	int first = true;
-	int found = false;
-
-	// Find the item and it's previous item
-	prev = i;
-	for(;i;i=i->tNext) {
-
-		if(i->iIndex == iIndex) {
-			found=true;
-			next = i->tNext;
-
-			// If it's the first item, we do it differently
-			if(first) {
-
-				// Free the sub items
-				for(s=i->tSubitems;s;s=sub) {
-					sub = s->tNext;
-					if (s->tWidget == tFocusedSubWidget)
-						tFocusedSubWidget = NULL;
-					delete s;
-				}
-				delete i;
 
-				// Set the first one to point to the next in the list
-				tItems = next;
-			} else {
-				// Free the sub items
-				for(s=i->tSubitems;s;s=sub) {
-					sub = s->tNext;
-					if (s->tWidget == tFocusedSubWidget)
-						tFocusedSubWidget = NULL;
-					delete s;
-				}
-				delete i;
+	std::pair<std::multimap<int, lv_item_t *>::iterator, std::multimap<int, lv_item_t *>::iterator> range = tItemsByIndex.equal_range(iIndex);
+	if (range.first == range.second)
+		return;
 
-				// The previous item now points to the next one
-				prev->tNext = next;
+	for (std::multimap<int, lv_item_t *>::iterator it = range.first; it != range.second; ++it)  {
+		lv_item_t *i = it->second;
+
+		// Remove it from the name index
+		std::pair<std::multimap<std::string, lv_item_t *>::iterator, std::multimap<std::string, lv_item_t *>::iterator> names = tItemsByName.equal_range(stringtolower(i->sIndex));
+		for (std::multimap<std::string, lv_item_t *>::iterator n = names.first; n != names.second; ++n)
+			if (n->second == i)  {
+				tItemsByName.erase(n);
+				break;
 			}
-			i = next;
-			iItemCount--;
-			//break;
-		}
 
-		if(!i)
-			break;
+		tItemArray[i->_iID] = NULL;
+		iItemsHeight -= i->iHeight;
+		iItemCount--;
+		if (i == tMouseOver)
+			tMouseOver = NULL;
 
-		prev = i;
-		first=false;
+		// Free the sub items
+		for(s=i->tSubitems;s;s=sub) {
+			sub = s->tNext;
+			if (s->tWidget == tFocusedSubWidget)
+				tFocusedSubWidget = NULL;
+			delete s;
+		}
+		delete i;
 	}
+	tItemsByIndex.erase(range.first, range.second);
+	tItemArray.erase(std::remove(tItemArray.begin(), tItemArray.end(), (lv_item_t *)NULL), tItemArray.end());
 
-	// Find the last item
-	i=tItems;
-	tLastItem = NULL;
-	for(;i;i=i->tNext) {
-		if(i->tNext == NULL)
-			tLastItem = i;
-	}
+	// Relink the list
+	UpdateItemIDs();
 
 	tSelected = tItems;
 	if(tSelected)
 		tSelected->bSelected = true;
 
-	// Adjust the scrollbar
-	//cScrollbar.setMax( cScrollbar.getMax()-1 );
-
-	/*// Do we use a scrollbar?
-	if(cScrollbar.getMax()*20 >= iHeight)
-		bGotScrollbar = true;
-	else
-		bGotScrollbar = false;*/
-
-	UpdateItemIDs();
-
 	// Readjust the scrollbar
 	ReadjustScrollbar();
 
@@ -683,6 +650,34 @@ void CListview::ReSort()
 	SortBy(i,col->iSorted==1);
 }
 
+///////////////
+// Sort key of one item, see CListview::SortBy
+struct lv_sortkey_t {
+	lv_item_t		*item;
+	lv_subitem_t	*sub; // NULL if the item has no subitem in the sort column
+};
+
+// Same order as the former bubble sort: numbers are compared as numbers, everything else case insensitive,
+// items without the subitem first (ascending) or last (descending)
+struct lv_sortcmp_t {
+	bool ascending;
+	lv_sortcmp_t(bool asc) : ascending(asc) {}
+	bool operator()(const lv_sortkey_t& a, const lv_sortkey_t& b) const {
+		if (!a.sub || !b.sub)  {
+			if (ascending)
+				return !a.sub && b.sub;
+			else
+				return a.sub && !b.sub;
+		}
+
+		if (a.sub->bSortKeyNumeric && b.sub->bSortKeyNumeric)
+			return ascending ? (a.sub->iSortKey < b.sub->iSortKey) : (b.sub->iSortKey < a.sub->iSortKey);
+
+		int tmp = stringcasecmp(a.sub->sText, b.sub->sText);
+		return ascending ? (tmp < 0) : (tmp > 0);
+	}
+};
+
 ///////////////
 // Sorts the listview by specified column, ascending or descending
 void CListview::SortBy(int column, bool ascending)
@@ -691,89 +686,32 @@ void CListview::SortBy(int column, bool ascending)
 	if (column < 0 || column >= iNumColumns)
 		return;
 
-	// Get the item
-	lv_item_t *item = tItems;
-	if (!item)
+	if (tItemArray.empty())
 		return;
 
-	lv_item_t *prev_item = NULL;
-	lv_subitem_t *subitem1 = NULL;
-	lv_subitem_t *subitem2 = NULL;
-
-	bool bSwapped = true;
-
-	// Bubble sort the list
-	while (bSwapped)  {
-		bSwapped = false;
-		prev_item = NULL;
-		for(item=tItems;item->tNext;item=item->tNext) {
-			subitem1=item->tSubitems;
-			subitem2=item->tNext->tSubitems;
-
-			// Get subitem 1
-			int i;
-			for(i=0;i != column && subitem1;subitem1=subitem1->tNext,i++) {	}
-
-			// Get subitem 2
-			for(i=0;i != column && subitem2;subitem2=subitem2->tNext,i++) { }
-
-			bool swap = false;
-			if (subitem2 && subitem1)  {
-				// Swap the two items?
-				bool failed1,failed2;
-				int nat_cmp1 = from_string<int>(subitem1->sText,failed1);
-				int nat_cmp2 = from_string<int>(subitem2->sText,failed2);
-				// First try, if we compare numbers
-				if (!failed1 && !failed2)  {
-					if (ascending)
-						swap = nat_cmp1 > nat_cmp2;
-					else
-						swap = nat_cmp2 > nat_cmp1;
-				// String comparison
-				} else {
-					int tmp = stringcasecmp(subitem1->sText,subitem2->sText);
-					if (ascending)
-						swap = tmp > 0;
-					else
-						swap = tmp < 0;
-				}
-			} else  {
-				if (ascending)
-					swap = subitem1 != NULL;
-				else
-					swap = subitem2 != NULL;
-			}
-
-			// Swap if they're not in the right order
-			if (swap)  {
-				lv_item_t *it3 = item->tNext;
-				lv_item_t *it4 = item->tNext->tNext;
-				if (prev_item)
-					prev_item->tNext = it3;
-				else
-					tItems = it3;
-				it3->tNext = item;
-				item->tNext = it4;
-				if (!it4)  {
-					tLastItem = it3;
-					break;
-				}
-				bSwapped = true;
-				prev_item = item;
-				continue;
-			}
-
-			prev_item = item;
+	std::vector<lv_sortkey_t> keys(tItemArray.size());
+	for (size_t k = 0; k < tItemArray.size(); ++k)  {
+		lv_item_t *item = tItemArray[k];
+		lv_subitem_t *sub = item->tSubitems;
+		for(int i=0;i != column && sub;sub=sub->tNext,i++) {	}
+
+		// Parse the text only if it has changed since the last sort
+		if (sub && (sub->sSortKeyText != sub->sText || sub->sSortKeyText.empty()))  {
+			bool failed = false;
+			sub->iSortKey = from_string<int>(sub->sText, failed);
+			sub->bSortKeyNumeric = !failed;
+			sub->sSortKeyText = sub->sText;
 		}
+
+		keys[k].item = item;
+		keys[k].sub = sub;
 	}
 
-	// Update the ID of the selected item
-	int i=0;
-	for (item=tItems;item;item=item->tNext,i++)
-		if (item == tSelected)  {
-			iItemID = i;
-			break;
-		}
+	// Stable, so equal items keep their order like before
+	std::stable_sort(keys.begin(), keys.end(), lv_sortcmp_t(ascending));
+
+	for (size_t k = 0; k < keys.size(); ++k)
+		tItemArray[k] = keys[k].item;
 
 	UpdateItemIDs();
 
@@ -811,14 +749,12 @@ int CListview::GetSortColumn()
 
 
 ///////////////////
-// Clear the items
-void CListview::Clear()
+// Free all items
+void CListview::FreeItems()
 {
-	// Free the items
-	lv_item_t *i,*item;
 	lv_subitem_t *s,*sub;
-	for(i=tItems;i;i=item) {
-		item = i->tNext;
+	for (size_t k = 0; k < tItemArray.size(); ++k)  {
+		lv_item_t *i = tItemArray[k];
 
 		// Free the sub items
 		for(s=i->tSubitems;s;s=sub) {
@@ -830,6 +766,19 @@ void CListview::Clear()
 		delete i;
 	}
 
+	tItemArray.clear();
+	tItemsByIndex.clear();
+	tItemsByName.clear();
+	iItemsHeight = 0;
+}
+
+
+///////////////////
+// Clear the items
+void CListview::Clear()
+{
+	FreeItems();
+
 	tItems = NULL;
 	tLastItem = NULL;
 	tSelected = NULL;
@@ -842,7 +791,6 @@ void CListview::Clear()
 	cScrollbar.setMax(1);
 	cScrollbar.setValue(0);
 	iItemCount=0;
-    iItemID = 0;
 	bGotScrollbar=false;
 	bNeedsRepaint = true; // Repaint required
 }
@@ -855,7 +803,6 @@ void CListview::Create()
 	// Destroy any previous settings
 	Destroy();
 	iItemCount=0;
-    iItemID = 0;
 	bGotScrollbar=false;
     bShowSelect = true;
 
@@ -885,40 +832,27 @@ void CListview::Destroy()
 
 
 	// Free the items
-	lv_item_t *i,*item;
-	lv_subitem_t *s,*sub;
-	for(i=tItems;i;i=item) {
-		item = i->tNext;
-
-		// Free the sub items
-		for(s=i->tSubitems;s;s=sub) {
-			sub = s->tNext;
-
-			delete s;
-		}
-
-		delete i;
-	}
+	FreeItems();
 
 	tFocusedSubWidget = NULL;
 	tMouseOverSubWidget = NULL;
 	tItems = NULL;
+	tLastItem = NULL;
+	tSelected = NULL;
+	tMouseOver = NULL;
 }
 
 
 ////////////////////
-// Updates _iID field of the items
+// Updates _iID field of the items and the item list from tItemArray
 void CListview::UpdateItemIDs()
 {
-	lv_item_t *it = tItems;
-	if (!it)
-		return;
+	tItems = tItemArray.empty() ? NULL : tItemArray.front();
+	tLastItem = tItemArray.empty() ? NULL : tItemArray.back();
 
-	int i = 0;
-	while (it)  {
-		it->_iID = i;
-		it = it->tNext;
-		++i;
+	for (size_t i = 0; i < tItemArray.size(); ++i)  {
+		tItemArray[i]->_iID = (int)i;
+		tItemArray[i]->tNext = (i + 1 < tItemArray.size()) ? tItemArray[i + 1] : NULL;
 	}
 }
 
@@ -926,16 +860,8 @@ void CListview::UpdateItemIDs()
 // Get an index based on item count
 int CListview::getIndex(int count)
 {
-	lv_item_t *item = tItems;
-	int i;
-
-	for(i=0; item; item=item->tNext, i++) {
-
-		if(i==count)
-			return item->iIndex;
-	}
-
-	return -1;
+	lv_item_t *item = getItemAt(count);
+	return item ? item->iIndex : -1;
 }
 
 
@@ -981,14 +907,14 @@ int	CListview::MouseOver(mouse_t *tMouse)
 
 	// Go through items and subitems, processing the widgets
 	tMouseOverSubWidget = NULL; // Reset it here
-	lv_item_t *item = tItems;
+	int scroll = (bGotScrollbar ? cScrollbar.getValue() : 0);
+	lv_item_t *item = getItemAt(scroll);
 	lv_subitem_t *subitem = NULL;
 	int result = LV_NONE;
-	int scroll = (bGotScrollbar ? cScrollbar.getValue() : 0);
 	int y = iY + 2 + (tColumns ? tLX->cFont.GetHeight() + 2 : 0);
-	for(int i = 0;item;item = item->tNext, i++) {
-		if (i < scroll)
-			continue;
+	for(;item;item = item->tNext) {
+		if (y >= iY + iHeight)
+			break;
 		subitem = item->tSubitems;
 		int x = iX + 2;
 		lv_column_t *col = tColumns;
@@ -1042,14 +968,10 @@ int	CListview::MouseOver(mouse_t *tMouse)
 	y = iY+tLX->cFont.GetHeight()+2;
 	if (!tColumns)
 		y = iY+2;
-	item = tItems;
-	int count=0;
+	item = getItemAt(cScrollbar.getValue());
 
 	for(;item;item = item->tNext) 
 	{
-		if(count++ < cScrollbar.getValue())
-			continue;
-
 		// Find the max height
 		int h = item->iHeight;
 
@@ -1172,8 +1094,7 @@ int	CListview::MouseDown(mouse_t *tMouse, int nDown)
 	int y = iY+tLX->cFont.GetHeight()+2;
 	if (!tColumns)
 		y = iY+2;
-	lv_item_t *item = tItems;
-	int count=0;
+	lv_item_t *item = getItemAt(cScrollbar.getValue());
 
 	// Remove focus from the active widget, the following loop will maybe recover it
 	if (tFocusedSubWidget) {
@@ -1186,9 +1107,6 @@ int	CListview::MouseDown(mouse_t *tMouse, int nDown)
 	}
 
 	for(;item;item = item->tNext) {
-		if(count++ < cScrollbar.getValue())
-			continue;
-
 		// Find the max height
 		int h = item->iHeight;
 
@@ -1324,8 +1242,7 @@ int	CListview::MouseUp(mouse_t *tMouse, int nDown)
 	int y = iY+tLX->cFont.GetHeight()+2;
 	if (!tColumns)
 		y = iY+2;
-	lv_item_t *item = tItems;
-	int count=0;
+	lv_item_t *item = getItemAt(cScrollbar.getValue());
 
 	// Remove focus from the active widget, the following loop will maybe recover it
 	if (tFocusedSubWidget)  {
@@ -1339,9 +1256,6 @@ int	CListview::MouseUp(mouse_t *tMouse, int nDown)
 	}
 
 	for(;item;item = item->tNext) {
-		if(count++ < cScrollbar.getValue())
-			continue;
-
 		// Find the max height
 		int h = item->iHeight;
 
@@ -1542,22 +1456,17 @@ int CListview::KeyDown(UnicodeChar c, int keysym, const ModifiersState& modstate
 
 	// Down arrow
 	if (keysym == SDLK_UP)  {
-		lv_item_t *i = tItems;
-		if (tItems)  {
-			int idx = 0;
-			for ( ; i && i->tNext; i=i->tNext, idx++ )  {
-				if (i->tNext == tSelected) {
-					if (tSelected)
-						tSelected->bSelected = false;
-					tSelected = i;
-					tSelected->bSelected = true;
-					iLastChar = SDLK_UP;
-					if (bGotScrollbar)
-						if (cScrollbar.getValue() > idx)
-							cScrollbar.setValue( cScrollbar.getValue()-1 );
-					return LV_CHANGED;
-				}
-			}
+		lv_item_t *i = tSelected ? getItemAt(tSelected->_iID - 1) : NULL;
+		if (i)  {
+			int idx = i->_iID;
+			tSelected->bSelected = false;
+			tSelected = i;
+			tSelected->bSelected = true;
+			iLastChar = SDLK_UP;
+			if (bGotScrollbar)
+				if (cScrollbar.getValue() > idx)
+					cScrollbar.setValue( cScrollbar.getValue()-1 );
+			return LV_CHANGED;
 		}
 	}
 
@@ -1642,23 +1551,19 @@ int CListview::getSelectedID()
 // Set the cur item to the item with the matching ID
 void CListview::setSelectedID(int id)
 {
-    lv_item_t *item = tItems;
-	for(;item;item = item->tNext) {
-
-        if(item->_iID == id) {
-            if(tSelected)
-                tSelected->bSelected = false;
-            item->bSelected = true;
-            tSelected = item;
+    lv_item_t *item = getItemAt(id);
+	if(!item)
+		return;
 
-			// Scroll to the item if needed
-			if (bGotScrollbar)  {
-				cScrollbar.setValue(tSelected->_iID);
-			}
+	if(tSelected)
+		tSelected->bSelected = false;
+	item->bSelected = true;
+	tSelected = item;
 
-            return;
-        }
-    }
+	// Scroll to the item if needed
+	if (bGotScrollbar)  {
+		cScrollbar.setValue(tSelected->_iID);
+	}
 }
 
 
@@ -1781,21 +1686,24 @@ DWORD CListview::SendMessage(int iMsg, std::string *sStr, DWORD Param)
 ///////////////////
 // Get an item based on the index
 lv_item_t* CListview::getItem(int index) {
-	for(lv_item_t* i = tItems; i; i = i->tNext) {
-		if(i->iIndex == index)
-			return i;
-	}
-	return NULL;
+	// If there are several, the first one in the list
+	lv_item_t *ret = NULL;
+	std::pair<std::multimap<int, lv_item_t *>::iterator, std::multimap<int, lv_item_t *>::iterator> range = tItemsByIndex.equal_range(index);
+	for (std::multimap<int, lv_item_t *>::iterator it = range.first; it != range.second; ++it)
+		if (!ret || it->second->_iID < ret->_iID)
+			ret = it->second;
+	return ret;
 }
 
 /////////////////
 // Get an item based on the name
 lv_item_t* CListview::getItem(const std::string& name) {
-	for(lv_item_t* i = tItems; i; i = i->tNext) {
-		if(stringcasecmp(i->sIndex,name) == 0)
-			return i;
-	}
-	return NULL;
+	lv_item_t *ret = NULL;
+	std::pair<std::multimap<std::string, lv_item_t *>::iterator, std::multimap<std::string, lv_item_t *>::iterator> range = tItemsByName.equal_range(stringtolower(name));
+	for (std::multimap<std::string, lv_item_t *>::iterator it = range.first; it != range.second; ++it)
+		if (!ret || it->second->_iID < ret->_iID)
+			ret = it->second;
+	return ret;
 }
 
 ////////////////
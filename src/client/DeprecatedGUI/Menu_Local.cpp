@@ -1144,7 +1144,7 @@ static void initFeaturesList(CListview* l)
 			resetBtn->bVisible = varIsSet(it->second.var);
 			
 			l->AddSubitem(LVS_TEXT, it->second.shortDesc, (DynDrawIntf*)NULL, NULL); 
-			item->iHeight = 24; // So checkbox / textbox will fit okay
+			l->setItemHeight(item, 24); // So checkbox / textbox will fit okay
 
 			if( it->second.var.valueType() == SVT_BOOL )
 			{
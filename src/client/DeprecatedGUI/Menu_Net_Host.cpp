@@ -1713,6 +1713,9 @@ void Menu_BanList()
 		tListBox->AddSubitem(LVS_TEXT, item->szAddress, (DynDrawIntf*)NULL, NULL);
 		tListBox->AddSubitem(LVS_TEXT, item->szNick, (DynDrawIntf*)NULL, NULL);
 	}
+
+	// The ban list keeps the order the entries were added, show them by nick
+	tListBox->SortBy(1, true);
 }
 
 
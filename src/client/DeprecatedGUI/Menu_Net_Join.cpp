@@ -343,7 +343,7 @@ static void initDetailsList(CListview* l) {
 		CButton *more = new CButton(BUT_MORE, tMenu->bmpButtons);
 		more->setID(jl_More);
 		more->Create();
-		it->iHeight = more->getHeight() + 10;
+		l->setItemHeight(it, more->getHeight() + 10);
 		l->AddSubitem(LVS_WIDGET, "", (DynDrawIntf*)NULL, more);
 	}
 #undef SUBS
@@ -472,7 +472,7 @@ static void updateDetailsList(CListview* l) {
 		CButton *less = new CButton(BUT_LESS, tMenu->bmpButtons);
 		less->setID(jl_Less);
 		less->Create();
-		it->iHeight = less->getHeight() + 10;
+		l->setItemHeight(it, less->getHeight() + 10);
 		l->AddSubitem(LVS_WIDGET, "", (DynDrawIntf*)NULL, less);
 	}
 
@@ -0,0 +1,88 @@
+/*
+ *  DirtyRects.cpp
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#include "DirtyRects.h"
+#include "GfxPrimitives.h"
+
+
+// If the rects cover more than this part of the bounds, we just refresh everything.
+static const float FULL_REFRESH_AREA = 0.6f;
+
+static SDL_Rect unionRect(const SDL_Rect& a, const SDL_Rect& b) {
+	const int x1 = MIN(a.x, b.x), y1 = MIN(a.y, b.y);
+	const int x2 = MAX(a.x + a.w, b.x + b.w), y2 = MAX(a.y + a.h, b.y + b.h);
+	return MakeRect(x1, y1, x2 - x1, y2 - y1);
+}
+
+// Overlapping or directly adjacent
+static bool touching(const SDL_Rect& a, const SDL_Rect& b) {
+	return a.x <= b.x + b.w && b.x <= a.x + a.w &&
+		a.y <= b.y + b.h && b.y <= a.y + a.h;
+}
+
+static int area(const SDL_Rect& r) { return r.w * r.h; }
+
+void DirtyRects::add(const SDL_Rect& _r) {
+	if(m_full) return;
+	SDL_Rect r = _r;
+	if(!ClipRefRectWith(r, (SDLRect&)m_bounds)) return;
+	insert(r);
+	checkArea();
+}
+
+void DirtyRects::add(const DirtyRects& other) {
+	if(m_full) return;
+	if(other.m_full) { setFull(); return; }
+	for(size_t i = 0; i < other.m_rects.size(); ++i)
+		insert(other.m_rects[i]);
+	checkArea();
+}
+
+void DirtyRects::insert(SDL_Rect r) {
+	// Merge with everything we touch. The union can touch further rects, so repeat.
+	for(size_t i = 0; i < m_rects.size(); ) {
+		if(touching(m_rects[i], r)) {
+			r = unionRect(m_rects[i], r);
+			m_rects[i] = m_rects.back();
+			m_rects.pop_back();
+			i = 0;
+		}
+		else
+			++i;
+	}
+	m_rects.push_back(r);
+
+	while(m_rects.size() > MaxRects) {
+		size_t bestA = 0, bestB = 1;
+		int bestGrowth = -1;
+		for(size_t a = 0; a < m_rects.size(); ++a)
+			for(size_t b = a + 1; b < m_rects.size(); ++b) {
+				const int growth = area(unionRect(m_rects[a], m_rects[b])) - area(m_rects[a]) - area(m_rects[b]);
+				if(bestGrowth < 0 || growth < bestGrowth) {
+					bestGrowth = growth;
+					bestA = a; bestB = b;
+				}
+			}
+		m_rects[bestA] = unionRect(m_rects[bestA], m_rects[bestB]);
+		m_rects[bestB] = m_rects.back();
+		m_rects.pop_back();
+	}
+}
+
+void DirtyRects::checkArea() {
+	int sum = 0;
+	for(size_t i = 0; i < m_rects.size(); ++i)
+		sum += area(m_rects[i]);
+	if(sum > FULL_REFRESH_AREA * area(m_bounds))
+		setFull();
+}
+
+std::vector<SDL_Rect> DirtyRects::rectsOrFull() const {
+	if(!m_full) return m_rects;
+	return std::vector<SDL_Rect>(1, m_bounds);
+}
@@ -0,0 +1,312 @@
+/*
+ *  FrameCapture.cpp
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#include <cstring>
+#include <boost/bind.hpp>
+
+#include "FrameCapture.h"
+#include "ThreadPool.h"
+#include "AuxLib.h"
+#include "GfxPrimitives.h"
+#include "Options.h"
+#include "FindFile.h"
+#include "StringUtils.h"
+#include "Timer.h"
+#include "Debug.h"
+#include "MathLib.h"
+
+
+static FrameCapture* frameCaptureInstance = NULL;
+
+FrameCapture* FrameCapture::Get() {
+	if(!frameCaptureInstance)
+		frameCaptureInstance = new FrameCapture();
+	return frameCaptureInstance;
+}
+
+void FrameCapture::Uninit() {
+	delete frameCaptureInstance;
+	frameCaptureInstance = NULL;
+}
+
+FrameCapture::FrameCapture() :
+	m_working(0), m_quit(false),
+	m_seqActive(false), m_seqId(0), m_seqFormat(FMT_PNG), m_seqFrames(0), m_seqDropped(0) {}
+
+FrameCapture::~FrameCapture() {
+	stopSequence();
+	{
+		Mutex::ScopedLock lock(m_mutex);
+		m_quit = true;
+		m_jobAvailable.broadcast();
+	}
+	// The workers write everything which is left in the queue before they quit
+	for(size_t i = 0; i < m_threads.size(); ++i)
+		threadPool->wait(m_threads[i], NULL);
+	m_threads.clear();
+}
+
+void FrameCapture::startWorkers() {
+	if(!m_threads.empty()) return;
+	const int count = CLAMP(SDL_GetCPUCount() - 1, 1, 3);
+	for(int i = 0; i < count; ++i)
+		m_threads.push_back(threadPool->start(boost::bind(&FrameCapture::run, this), "frame capture encoder"));
+}
+
+SmartPointer<SDL_Surface> FrameCapture::getBuffer(SDL_Surface* frame) {
+	SmartPointer<SDL_Surface> buf;
+	{
+		Mutex::ScopedLock lock(m_mutex);
+		while(!m_freeBuffers.empty() && !buf.get()) {
+			SmartPointer<SDL_Surface> s = m_freeBuffers.back();
+			m_freeBuffers.pop_back();
+			// The video mode could have changed
+			if(s->w == frame->w && s->h == frame->h && s->format->format == frame->format->format)
+				buf = s;
+		}
+	}
+	if(!buf.get())
+		return GetCopiedImage(frame);
+
+	LockSurface(frame);
+	const size_t rowSize = frame->w * frame->format->BytesPerPixel;
+	for(int y = 0; y < frame->h; ++y)
+		memcpy((uchar*)buf->pixels + y * buf->pitch, (const uchar*)frame->pixels + y * frame->pitch, rowSize);
+	UnlockSurface(frame);
+	return buf;
+}
+
+bool FrameCapture::push(const Job& job, bool wait) {
+	Mutex::ScopedLock lock(m_mutex);
+	return pushLocked(job, wait);
+}
+
+bool FrameCapture::pushLocked(const Job& job, bool wait) {
+	startWorkers();
+	while(m_queue.size() >= MaxQueue) {
+		if(!wait) return false;
+		m_jobDone.wait(m_mutex);
+	}
+	m_queue.push_back(job);
+	if(!job.raw.get())
+		m_pendingFiles.insert(job.file);
+	m_jobAvailable.signal();
+	return true;
+}
+
+Result FrameCapture::run() {
+	Mutex::ScopedLock lock(m_mutex);
+	while(true) {
+		while(m_queue.empty() && !m_quit)
+			m_jobAvailable.wait(m_mutex);
+		if(m_queue.empty())
+			return true; // quit, and everything is written
+
+		Job job = m_queue.front();
+		m_queue.pop_front();
+		m_working++;
+		m_jobDone.broadcast(); // there is a free slot now
+
+		// Raw frames go into one file, so they must be written in order.
+		// Jobs are taken in order, so the previous frame is already being handled.
+		while(job.raw.get() && job.seq != job.raw->nextSeq)
+			m_jobDone.wait(m_mutex);
+
+		{
+			Mutex::ScopedUnlock unlock(m_mutex);
+			encode(job);
+		}
+
+		if(job.raw.get())
+			job.raw->nextSeq++;
+		else
+			m_pendingFiles.erase(job.file);
+		if(m_freeBuffers.size() < MaxQueue)
+			m_freeBuffers.push_back(job.surf);
+		m_working--;
+		m_jobDone.broadcast();
+	}
+}
+
+void FrameCapture::encode(const Job& job) {
+	if(!job.raw.get()) {
+		if(!SaveSurface(job.surf, job.file, job.format, job.data))
+			warnings << "FrameCapture: could not save " << job.file << endl;
+		return;
+	}
+
+	SDL_Surface* s = job.surf.get();
+	const size_t rowSize = s->w * s->format->BytesPerPixel;
+	for(int y = 0; y < s->h; ++y)
+		if(fwrite((const uchar*)s->pixels + y * s->pitch, 1, rowSize, job.raw->file) != rowSize) {
+			warnings << "FrameCapture: error while writing the raw stream" << endl;
+			return;
+		}
+}
+
+void FrameCapture::screenshot(SDL_Surface* frame, const std::string& file, int format, const std::string& data) {
+	if(frame == NULL) return;
+	Job job;
+	job.surf = getBuffer(frame);
+	if(!job.surf.get()) {
+		warnings << "FrameCapture: cannot copy the frame for " << file << endl;
+		return;
+	}
+	job.file = file;
+	job.format = format;
+	job.data = data;
+	job.seq = 0;
+	push(job, true);
+}
+
+bool FrameCapture::isPending(const std::string& file) {
+	Mutex::ScopedLock lock(m_mutex);
+	return m_pendingFiles.count(file) > 0;
+}
+
+bool FrameCapture::startSequence(float fps, int format, std::string& err) {
+	if(fps <= 0.0f || fps > 100.0f) {
+		err = "fps must be between 0 and 100";
+		return false;
+	}
+	if(capturing()) {
+		err = "already capturing";
+		return false;
+	}
+
+	const std::string name = "capture/" + GetDateTimeFilename();
+	SmartPointer<RawStream> raw;
+	if(format == FormatRaw) {
+		FILE* f = OpenGameFile(name + ".raw", "wb");
+		if(f == NULL) {
+			err = "cannot open " + name + ".raw for writing";
+			return false;
+		}
+		raw = new RawStream(f);
+	}
+
+	Mutex::ScopedLock lock(m_mutex);
+	if(m_seqActive) { // started meanwhile
+		err = "already capturing to " + m_seqName;
+		return false; // this closes the raw file again
+	}
+	m_seqName = name;
+	m_rawStream = raw;
+	m_seqFormat = format;
+	m_seqPeriod = TimeDiff(1.0f / fps);
+	m_seqNext = GetTime();
+	m_seqFrames = m_seqDropped = 0;
+	m_seqId++;
+	m_seqActive = true;
+	notes << "capturing " << ftoa(fps, 1) << " frames/s to " << m_seqName << ((format == FormatRaw) ? ".raw" : "/") << endl;
+	return true;
+}
+
+void FrameCapture::stopSequence() {
+	Mutex::ScopedLock lock(m_mutex);
+	if(!m_seqActive) return;
+	m_seqActive = false;
+	// The queued frames keep the raw file open until they are written
+	m_rawStream = NULL;
+	notes << "capture " << m_seqName << " stopped: " << m_seqFrames << " frames, " << m_seqDropped << " dropped" << endl;
+}
+
+bool FrameCapture::capturing() {
+	Mutex::ScopedLock lock(m_mutex);
+	return m_seqActive;
+}
+
+// Name of the pixel format for ffmpeg -f rawvideo
+static std::string rawPixelFormat(const SDL_PixelFormat* fmt) {
+	if(fmt->BytesPerPixel != 4) return "";
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+	if(fmt->Rmask == 0x00ff0000 && fmt->Gmask == 0x0000ff00 && fmt->Bmask == 0x000000ff) return "bgr0";
+	if(fmt->Rmask == 0x000000ff && fmt->Gmask == 0x0000ff00 && fmt->Bmask == 0x00ff0000) return "rgb0";
+#else
+	if(fmt->Rmask == 0x00ff0000 && fmt->Gmask == 0x0000ff00 && fmt->Bmask == 0x000000ff) return "0rgb";
+	if(fmt->Rmask == 0x000000ff && fmt->Gmask == 0x0000ff00 && fmt->Bmask == 0x00ff0000) return "0bgr";
+#endif
+	return "";
+}
+
+void FrameCapture::frame(SDL_Surface* frame) {
+	if(frame == NULL) return;
+
+	unsigned int seqId = 0;
+	bool raw = false, first = false;
+	std::string name;
+	float fps = 0.0f;
+	{
+		Mutex::ScopedLock lock(m_mutex);
+		if(!m_seqActive) return;
+
+		const AbsTime now = GetTime();
+		if(now < m_seqNext) return;
+		m_seqNext += m_seqPeriod;
+		// Don't try to catch up if we are far behind (e.g. loading), just continue from now
+		if(m_seqNext + m_seqPeriod < now)
+			m_seqNext = now + m_seqPeriod;
+
+		// Don't even copy the frame if the workers are behind
+		if(m_queue.size() >= MaxQueue) {
+			m_seqDropped++;
+			return;
+		}
+
+		seqId = m_seqId;
+		raw = m_rawStream.get() != NULL;
+		first = m_seqFrames == 0;
+		name = m_seqName;
+		fps = 1.0f / m_seqPeriod.seconds();
+	}
+
+	if(raw && first) {
+		// Describe the stream, the raw file itself has no header
+		std::string info = itoa(frame->w) + "x" + itoa(frame->h) + ", " + itoa(frame->format->BitsPerPixel) + " bpp";
+		info += ", masks R=" + hex(frame->format->Rmask) + " G=" + hex(frame->format->Gmask) + " B=" + hex(frame->format->Bmask);
+		info += ", " + ftoa(fps, 1) + " fps\n";
+		const std::string pixFmt = rawPixelFormat(frame->format);
+		if(pixFmt != "")
+			info += "ffmpeg -f rawvideo -pixel_format " + pixFmt + " -video_size " + itoa(frame->w) + "x" + itoa(frame->h) +
+				" -framerate " + ftoa(fps, 2) + " -i " + GetBaseFilename(name) + ".raw video.mp4\n";
+		FILE* f = OpenGameFile(name + ".txt", "w");
+		if(f) {
+			fwrite(info.data(), 1, info.size(), f);
+			fclose(f);
+		}
+	}
+
+	Job job;
+	job.surf = getBuffer(frame);
+
+	Mutex::ScopedLock lock(m_mutex);
+	// Stopped or restarted while we copied the frame
+	if(!m_seqActive || m_seqId != seqId) return;
+	if(!job.surf.get()) { m_seqDropped++; return; }
+	job.raw = m_rawStream;
+	job.seq = m_seqFrames;
+	job.format = m_seqFormat;
+	if(!raw) {
+		std::string ext;
+		switch(m_seqFormat) {
+		case FMT_BMP: ext = ".bmp"; break;
+		case FMT_JPG: ext = ".jpg"; break;
+		case FMT_GIF: ext = ".gif"; break;
+		default: ext = ".png";
+		}
+		std::string num = itoa(m_seqFrames);
+		if(num.size() < 6) num = std::string(6 - num.size(), '0') + num;
+		job.file = m_seqName + "/" + num + ext;
+	}
+
+	// The sequence number is only taken if the frame is queued, so the raw frames have no gaps
+	if(pushLocked(job, false))
+		m_seqFrames++;
+	else
+		m_seqDropped++;
+}
@@ -2936,11 +2936,9 @@ SmartPointer<SDL_Surface> LoadGameImage_unaltered(const std::string& _filename,
 // Loads an image, and converts it to the same colour depth as the screen (speed)
 SmartPointer<SDL_Surface> LoadGameImage(const std::string& _filename, bool withalpha)
 {
-	ScopedLock lock(cCache.mutex);
-	
 	{
 		// Try cache first
-		SmartPointer<SDL_Surface> ImageCache = cCache.GetImage__unsafe(_filename);
+		SmartPointer<SDL_Surface> ImageCache = cCache.GetImage(_filename);
 		if( ImageCache.get() )
 			return ImageCache;
 	}
@@ -2995,8 +2993,8 @@ SmartPointer<SDL_Surface> LoadGameImage(const std::string& _filename, bool witha
 	#ifdef DEBUG
 	//printf("LoadImage() %p %s\n", Image.get(), _filename.c_str() );
 	#endif
-	cCache.SaveImage__unsafe(_filename, img);
-	return img;
+	// If another thread loaded it meanwhile, we get that one back
+	return cCache.SaveImage(_filename, img);
 }
 
 void test_Clipper() {
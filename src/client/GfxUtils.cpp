@@ -74,6 +74,7 @@ ScopedBackgroundLoadingAni::ScopedBackgroundLoadingAni(int x, int y, int rx, int
 	// Also, this caused about 25% overhead in the whole loading process!
 	// So, to avoid flickering, just copy to our back buffer:
 	CopySurface(VideoPostProcessor::videoBufferSurface().get(), VideoPostProcessor::videoSurface().get(), 0,0,0,0,640,480);
+	VideoPostProcessor::invalidate();
 	
 	data = new Data();
 	
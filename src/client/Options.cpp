@@ -150,6 +150,8 @@ bool GameOptions::Init() {
 		( tLXOptions->bUseIpToCountry, "Network.UseIpToCountry", true )
 		( tLXOptions->iMaxUploadBandwidth, "Network.MaxUploadBandwidth", 50000 )
 		( tLXOptions->bCheckBandwidthSanity, "Network.CheckBandwidthSanity", true )
+		( tLXOptions->bAdaptiveSendRate, "Network.AdaptiveSendRate", true )
+		( tLXOptions->iServerListProbes, "Network.ServerListProbes", 64 ) // How many servers we ping/query at the same time
 		( tLXOptions->sHttpProxy, "Network.HttpProxy", "" )
 		( tLXOptions->bAutoSetupHttpProxy, "Network.AutoSetupHttpProxy", true )
 
@@ -162,6 +164,9 @@ bool GameOptions::Init() {
 		( tLXOptions->bAllowWantsJoinMsg, "Network.AllowWantsJoinMsg", true )
 		( tLXOptions->bWantsJoinBanned, "Network.WantsToJoinFromBanned", true )
 		( tLXOptions->bAllowRemoteBots, "Network.AllowRemoteBots", true )
+		( tLXOptions->iQueryRateLimit, "Network.QueryRateLimit", 10 ) // Per IP and second, for lx::ping, lx::query, lx::getinfo, ...
+		( tLXOptions->iQueryBurst, "Network.QueryBurst", 30 )
+		( tLXOptions->iQueryReplyCacheTime, "Network.QueryReplyCacheTime", 200 ) // In ms
 		( tLXOptions->bForceCompatibleConnect, "Network.ForceCompatibleConnect", true, "Force Compatible", "Don't allow incompatible clients to connect" )
 		( tLXOptions->sForceMinVersion, "Network.ForceMinVersion", defaultMinVersion.asString(), "Force Min Version", "Minimal version needed to play on this server" )
 		( tLXOptions->bCheckChatMessageLength, "Network.CheckChatMessageLength", true)	//Check chat message length
@@ -221,6 +226,11 @@ bool GameOptions::Init() {
 		( tLXOptions->nMaxFPS, "Advanced.MaxFPS", 95 )
 		( tLXOptions->iJpegQuality, "Advanced.JpegQuality", 80 )
 		( tLXOptions->iMaxCachedEntries, "Advanced.MaxCachedEntries", 300 ) // Should be enough for every mod (we have 2777 .png and .wav files total now) and does not matter anyway with SmartPointer
+		( tLXOptions->iCacheMaxSize, "Advanced.CacheMaxSize", 256 ) // In MB, see CCache::ClearExtraEntries
+		( tLXOptions->iFontCacheSize, "Advanced.FontCacheSize", 1024 ) // In KB, per font
+		( tLXOptions->iLuaGCBudget, "Advanced.LuaGCBudget", 500 ) // In microseconds per frame, see LuaGCPacer
+		( tLXOptions->bGusLevelBundles, "Advanced.GusLevelBundles", true )
+		( tLXOptions->bCompiledModCache, "Advanced.CompiledModCache", true )
 		( tLXOptions->bMatchLogging, "Advanced.MatchLogging", true )
 		( tLXOptions->bRecoverAfterCrash, "Advanced.RecoverAfterCrash",
 #ifndef DEDICATED_ONLY
@@ -231,12 +241,15 @@ bool GameOptions::Init() {
 		( tLXOptions->bCheckForUpdates, "Advanced.CheckForUpdates", true )
 
 		( tLXOptions->bLogConvos, "Misc.LogConversations", false )
+		( tLXOptions->bRecordDemos, "Misc.RecordDemos", false )
 		( tLXOptions->bShowPing, "Misc.ShowPing", true )
 		( tLXOptions->bShowNetRates, "Misc.ShowNetRate", false )
 		( tLXOptions->bShowProjectileUsage, "Misc.ShowProjectileUsage", false )
 		( tLXOptions->iScreenshotFormat, "Misc.ScreenshotFormat", (int)FMT_PNG )
 		( tLXOptions->sDedicatedScript, "Misc.DedicatedScript", "dedicated_control" )
 		( tLXOptions->sDedicatedScriptArgs, "Misc.DedicatedScriptArgs", "cfg/dedicated_config" )
+		( tLXOptions->bDedicatedBinaryProtocol, "Misc.DedicatedBinaryProtocol", false ) // Length-prefixed frames and batched signals, see DedicatedControl.cpp
+		( tLXOptions->iDedicatedSignalQueueSize, "Misc.DedicatedSignalQueueSize", 4096 )
 		( tLXOptions->iVerbosity, "Misc.Verbosity", 0 )	
 		( tLXOptions->bLogTimestamps, "Misc.LogTimestamps", false )	
 		( tLXOptions->bAdvancedLobby, "Misc.ShowAdvancedLobby", false )
@@ -35,6 +35,96 @@ enum {
 	RELIABLE_HEADER_LEN = 8 // Only for CChannel_056b
 };
 
+///////////////////
+// Send rate controller
+
+enum {
+	SENDRATE_MIN = 2000,		// Bytes per second, a bit below the modem rate of GameServer
+	SENDRATE_MAX = 1000000,
+	SENDRATE_START = 10000		// The LAN rate of GameServer, slow start takes it up from there
+};
+
+void SendRateController::Clear()
+{
+	fBudget = SENDRATE_START;
+	fSmoothedRtt = 0;
+	fMinRtt = 0;
+	bSlowStart = true;
+	fLastIncrease = fLastDecrease = AbsTime();
+	iSentSinceIncrease = 0;
+	iLossEvents = 0;
+	iDelayEvents = 0;
+}
+
+bool SendRateController::decrease(float factor)
+{
+	// At most once per RTT, all losses of one burst are one congestion event
+	if(tLX->currentTime - fLastDecrease < fSmoothedRtt / 1000.0f)
+		return false;
+
+	fLastDecrease = tLX->currentTime;
+	bSlowStart = false;
+	fBudget = MAX(fBudget * factor, (float)SENDRATE_MIN);
+	return true;
+}
+
+void SendRateController::onRtt(int rttMs)
+{
+	const float rtt = (float)MAX(rttMs, 1);
+	if(fSmoothedRtt == 0) {
+		fSmoothedRtt = fMinRtt = rtt;
+		fLastIncrease = tLX->currentTime;
+		iSentSinceIncrease = 0;
+		return;
+	}
+
+	fSmoothedRtt = fSmoothedRtt * 0.875f + rtt * 0.125f;
+	if(rtt < fMinRtt)
+		fMinRtt = rtt;
+	else
+		fMinRtt += (rtt - fMinRtt) * 0.01f; // Follow route changes, slowly
+
+	// Our packets are waiting in a queue somewhere, we send more than the link takes
+	if(fSmoothedRtt > fMinRtt * 2.0f + 50.0f) {
+		if(decrease(0.85f))
+			iDelayEvents++;
+		return;
+	}
+
+	// Grow at most once per RTT, when the acks of what we sent came back
+	const TimeDiff elapsed = tLX->currentTime - fLastIncrease;
+	if(elapsed < fSmoothedRtt / 1000.0f || elapsed.milliseconds() == 0)
+		return;
+	const float sentRate = iSentSinceIncrease / elapsed.seconds();
+	fLastIncrease = tLX->currentTime;
+	iSentSinceIncrease = 0;
+
+	// If we don't use the budget, the acks tell nothing about how much more the link takes
+	if(sentRate < fBudget * 0.5f)
+		return;
+
+	if(bSlowStart)
+		fBudget *= 2.0f;
+	else
+		fBudget += MAX(500.0f, fBudget * 0.05f);
+	fBudget = MIN(fBudget, (float)SENDRATE_MAX);
+}
+
+void SendRateController::onLoss()
+{
+	if(decrease(0.7f))
+		iLossEvents++;
+}
+
+std::string SendRateController::stats() const
+{
+	return "budget " + ftoa(fBudget / 1024.0f, 1) + " kB/s" +
+		", rtt " + itoa((int)fSmoothedRtt) + " ms (min " + itoa((int)fMinRtt) + ")" +
+		(bSlowStart ? ", slow start" : "") +
+		", loss events " + itoa(iLossEvents) +
+		", delay events " + itoa(iDelayEvents);
+}
+
 void CChannel::Clear()
 {
 	Socket = NULL;
@@ -45,6 +135,7 @@ void CChannel::Clear()
 	iOutgoingBytes = 0;
 	iIncomingBytes = 0;
 	iPing = 0;
+	cSendRate.Clear();
 	fLastSent = fLastPckRecvd = fLastPingSent = AbsTime();
 	iCurrentIncomingBytes = 0;
 	iCurrentOutgoingBytes = 0;
@@ -93,6 +184,7 @@ void CChannel::UpdateTransmitStatistics( size_t sentDataSize )
 
 	// Calculate the bytes per second
 	cOutgoingRate.addData( sentDataSize );
+	cSendRate.onSent( sentDataSize );
 }
 
 void CChannel::UpdateReceiveStatistics( size_t receivedDataSize )
@@ -149,6 +241,7 @@ void CChannel_056b::Transmit( CBytestream *bs )
 	{
 		//hints << "Remote side dropped a reliable packet, resending..." << endl;
 		SendReliable = 1;
+		cSendRate.onLoss();
 	}
 
 
@@ -270,6 +363,7 @@ bool CChannel_056b::Process(CBytestream *bs)
 	if(SequenceAck >= (size_t)iPongSequence)  {
 		iPongSequence = -1;  // Ready for new pinging
 		iPing = (int)((tLX->currentTime - fLastPingSent).milliseconds());
+		cSendRate.onRtt(iPing);
 	}
 
 
@@ -489,6 +583,7 @@ bool CChannel2::Process(CBytestream *bs)
 	if( PongSequence != -1 && SequenceDiff( LastReliableOut, PongSequence ) >= 0 )
 	{
 		iPing = (int) ((tLX->currentTime - fLastPingSent).milliseconds());
+		cSendRate.onRtt(iPing);
 		PongSequence = -1;
 		// Traffic shaping occurs here - change DataPacketTimeout according to received ping
 		// Change the value slowly, to avoid peaks
@@ -600,6 +695,8 @@ void CChannel2::Transmit(CBytestream *unreliableData)
 		}
 	};
 
+	const int prevNextReliablePacketToSend = NextReliablePacketToSend;
+
 	// Check if other side acknowledged packets with indexes bigger than NextReliablePacketToSend,
 	// and roll NextReliablePacketToSend back to LastReliableOut.
 	if( ! ReliableOut.empty() )
@@ -620,6 +717,10 @@ void CChannel2::Transmit(CBytestream *unreliableData)
 	{
 		NextReliablePacketToSend = LastReliableOut;
 	}
+
+	// Going back means resending what the other side did not get
+	if( SequenceDiff( prevNextReliablePacketToSend, NextReliablePacketToSend ) > 0 )
+		cSendRate.onLoss();
 	
 	// Add packet headers and data - send all packets with indexes from NextReliablePacketToSend and up.
 	// Add older packets to the output first.
@@ -894,6 +995,146 @@ void TestCChannelRobustness()
 	}
 }
 
+///////////////////
+// Send rate test for CChannel
+// c1 sends as much as its send budget allows, like GameServer does to a client,
+// over an emulated link with a bottleneck, a queue, latency, jitter and loss.
+// The capacity of the link changes over time, the budget should follow it.
+
+void TestCChannelSendRate()
+{
+	notes << "Testing CChannel send rate controller" << endl;
+	int latency = 60; // One way, in ms
+	int jitter = 20;
+	int packetLoss = 2; // In percents
+	int queueMs = 300; // Size of the bottleneck buffer, in ms of its capacity
+	int updateSize = 200; // Size of the messages c1 sends
+	// Transmit() is called every 10 ms and sends one packet, so c1 can't send more than ~50 kB/s
+	struct Phase { int until; float capacity; };
+	const Phase phases[] = { { 20000, 20000 }, { 40000, 45000 }, { 60000, 6000 }, { 80000, 30000 } };
+	const int testLength = phases[sizeof(phases)/sizeof(phases[0]) - 1].until;
+
+	CChannel3 c1, c2;
+	SmartPointer<NetworkSocket> s1 = new NetworkSocket(); s1->OpenUnreliable(0);
+	SmartPointer<NetworkSocket> s2 = new NetworkSocket(); s2->OpenUnreliable(0);
+	SmartPointer<NetworkSocket> s1lag = new NetworkSocket(); s1lag->OpenUnreliable(0);
+	SmartPointer<NetworkSocket> s2lag = new NetworkSocket(); s2lag->OpenUnreliable(0);
+	NetworkAddr a1, a2, a1lag, a2lag;
+	a1 = s1->localAddress();
+	a2 = s2->localAddress();
+	a1lag = s1lag->localAddress();
+	a2lag = s2lag->localAddress();
+	c1.Create( a1lag, s1 );
+	c2.Create( a2lag, s2 );
+	s1lag->setRemoteAddress( a2 );
+	s2lag->setRemoteAddress( a1 );
+
+	std::multimap< int, CBytestream > s1buf, s2buf;
+	float linkFreeAt = 0; // When the bottleneck has sent out everything in its queue
+	float allowance = 0; // Bytes c1 may still send, refilled with the budget
+	size_t delivered = 0, queueDrops = 0, randomDrops = 0;
+	size_t phase = 0;
+
+	for( int testtime=0; testtime < testLength; testtime += 10 )
+	{
+		tLX->currentTime = AbsTime(testtime);
+		while( testtime >= phases[phase].until )
+			phase++;
+		const float capacity = phases[phase].capacity;
+
+		// Send updates within the budget
+		allowance = MIN( allowance + c1.getSendBudget() * 0.01f, c1.getSendBudget() * 0.1f );
+		while( allowance >= updateSize && !c1.getBufferFull() && c1.Messages.size() < 4 )
+		{
+			CBytestream b;
+			for( int f=0; f<updateSize; f++ )
+				b.writeByte(0xff);
+			c1.AddReliablePacketToSend(b);
+			allowance -= updateSize;
+		}
+
+		CBytestream b1u, b2u;
+		c1.Transmit( &b1u );
+		c2.Transmit( &b2u );
+
+		// c1 -> bottleneck -> c2
+		while( true )
+		{
+			CBytestream b;
+			b.Read(s1lag.get());
+			if( b.GetLength() == 0 )
+				break;
+
+			if( GetRandomInt(100) < packetLoss ) {
+				randomDrops++;
+				continue;
+			}
+			const float start = MAX( (float)testtime, linkFreeAt );
+			if( start - testtime > queueMs ) {
+				queueDrops++; // Queue full
+				continue;
+			}
+			linkFreeAt = start + b.GetLength() * 1000.0f / capacity;
+			int arrival = (((int)linkFreeAt + latency + GetRandomInt(jitter)) / 10 + 1) * 10; // Round up to 10
+			s1buf.insert( std::make_pair( arrival, b ) );
+		}
+
+		// c2 -> c1, only latency
+		while( true )
+		{
+			CBytestream b;
+			b.Read(s2lag.get());
+			if( b.GetLength() == 0 )
+				break;
+			int arrival = ((testtime + latency + GetRandomInt(jitter)) / 10 + 1) * 10;
+			s2buf.insert( std::make_pair( arrival, b ) );
+		}
+
+		for( std::multimap< int, CBytestream > :: iterator it = s1buf.begin(); it != s1buf.end() && it->first <= testtime; )
+		{
+			it->second.ResetPosToBegin();
+			it->second.Send(s1lag.get());
+			delivered += it->second.GetLength();
+			s1buf.erase(it++);
+		}
+		for( std::multimap< int, CBytestream > :: iterator it = s2buf.begin(); it != s2buf.end() && it->first <= testtime; )
+		{
+			it->second.ResetPosToBegin();
+			it->second.Send(s2lag.get());
+			s2buf.erase(it++);
+		}
+
+		// Receive
+		while( true )
+		{
+			CBytestream b;
+			b.Read(s2.get());
+			if( b.GetLength() == 0 )
+				break;
+			while( c2.Process( &b ) )
+				b.Clear();
+		}
+		while( true )
+		{
+			CBytestream b;
+			b.Read(s1.get());
+			if( b.GetLength() == 0 )
+				break;
+			while( c1.Process( &b ) )
+				b.Clear();
+		}
+
+		if( testtime % 1000 == 990 )
+		{
+			notes << (testtime + 10) / 1000 << "s: link " << ftoa(capacity / 1024.0f, 1) << " kB/s" <<
+					", delivered " << ftoa(delivered / 1024.0f, 1) << " kB/s" <<
+					", dropped " << queueDrops << " in queue, " << randomDrops << " random" <<
+					", " << c1.getSendRate().stats() << endl;
+			delivered = queueDrops = randomDrops = 0;
+		}
+	}
+}
+
 /*
 The format for packet is the same as with CChannel2, but with CRC16 added at the beginning,
 and with indicator that packet is split into several smaller packets.
@@ -1027,6 +1268,7 @@ bool CChannel3::Process(CBytestream *bs)
 	if( PongSequence != -1 && SequenceDiff( LastReliableOut, PongSequence ) >= 0 )
 	{
 		iPing = (int) ((tLX->currentTime - fLastPingSent).milliseconds());
+		cSendRate.onRtt(iPing);
 		PongSequence = -1;
 		// Traffic shaping occurs here - change DataPacketTimeout according to received ping
 		// Change the value slowly, to avoid peaks
@@ -1153,6 +1395,8 @@ void CChannel3::Transmit(CBytestream *unreliableData)
 		}
 	}
 
+	const int prevNextReliablePacketToSend = NextReliablePacketToSend;
+
 	// Check if other side acknowledged packets with indexes bigger than NextReliablePacketToSend,
 	// and roll NextReliablePacketToSend back to LastReliableOut.
 	if( ! ReliableOut.empty() )
@@ -1173,6 +1417,10 @@ void CChannel3::Transmit(CBytestream *unreliableData)
 	{
 		NextReliablePacketToSend = LastReliableOut;	
 	}
+
+	// Going back means resending what the other side did not get
+	if( SequenceDiff( prevNextReliablePacketToSend, NextReliablePacketToSend ) > 0 )
+		cSendRate.onLoss();
 	
 	// Add packet headers and data - send all packets with indexes from NextReliablePacketToSend and up.
 	// Add older packets to the output first.
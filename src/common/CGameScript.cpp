@@ -34,6 +34,7 @@
 #include "game/Mod.h"
 #include "gusanos/gusanos.h"
 #include "sound/SoundsBase.h"
+#include "Options.h"
 
 
 
@@ -102,17 +103,24 @@ static std::string readString(FILE *fp)
 // Save the script (compiler)
 int CGameScript::Save(const std::string& filename)
 {
-	FILE *fp;
-	int n;
-
-
 	// Open it
-	fp = OpenGameFile(filename,"wb");
+	FILE *fp = OpenGameFile(filename,"wb");
 	if(fp == NULL) {
 		errors << "CGameScript::Save: Could not open " << filename << " for writing" << endl;
 		return false;
 	}
 
+	const bool ok = Write(fp);
+	fclose(fp);
+	return ok;
+}
+
+///////////////////
+// Write the script in the script.lgs format
+bool CGameScript::Write(FILE *fp)
+{
+	int n;
+
 	Header.Version = GS_VERSION;
 	strcpy(Header.ID,"Liero Game Script");
 
@@ -197,18 +205,19 @@ int CGameScript::Save(const std::string& filename)
 
 
 	// Ninja Rope
-	fwrite_endian_compat((int)gameSettings[FT_RopeMaxLength],sizeof(int),1,fp);
-	fwrite_endian_compat((int)gameSettings[FT_RopeRestLength],sizeof(int),1,fp);
-	fwrite_endian_compat((float)gameSettings[FT_RopeStrength],sizeof(float),1,fp);
+	// Our own settings, as read by Load() and Compile(), not the ones of the current game
+	fwrite_endian_compat((int)lx56modSettings[FT_RopeMaxLength],sizeof(int),1,fp);
+	fwrite_endian_compat((int)lx56modSettings[FT_RopeRestLength],sizeof(int),1,fp);
+	fwrite_endian_compat((float)lx56modSettings[FT_RopeStrength],sizeof(float),1,fp);
 
 	// Worm
 	gs_worm_t tmpworm;
 	tmpworm.AngleSpeed = 100;
-	tmpworm.GroundSpeed = gameSettings[FT_WormGroundSpeed];
-	tmpworm.AirSpeed = gameSettings[FT_WormAirSpeed];
-	tmpworm.Gravity = gameSettings[FT_WormGravity];
-	tmpworm.JumpForce = gameSettings[FT_WormJumpForce];
-	tmpworm.AirFriction = gameSettings[FT_WormAirFriction];
+	tmpworm.GroundSpeed = lx56modSettings[FT_WormGroundSpeed];
+	tmpworm.AirSpeed = lx56modSettings[FT_WormAirSpeed];
+	tmpworm.Gravity = lx56modSettings[FT_WormGravity];
+	tmpworm.JumpForce = lx56modSettings[FT_WormJumpForce];
+	tmpworm.AirFriction = lx56modSettings[FT_WormAirFriction];
 	tmpworm.GroundFriction = 0;
 	EndianSwap(tmpworm.AngleSpeed);
 	EndianSwap(tmpworm.GroundSpeed);
@@ -219,12 +228,9 @@ int CGameScript::Save(const std::string& filename)
 	EndianSwap(tmpworm.GroundFriction);
 	fwrite(&tmpworm, sizeof(gs_worm_t), 1, fp);
 
-
-	fclose(fp);
-
 	savedProjs.clear();
 	
-	return true;
+	return ferror(fp) == 0;
 }
 
 
@@ -574,6 +580,135 @@ CheckFileEnd:
 }
 
 
+/*
+	Compiled mod cache
+
+	Compiling a source mod (main.txt) parses all of its weapon and projectile
+	files. We do that only once: the result is written in the script.lgs
+	format to cache/compiled_mods/<mod>.lgs, behind a small header with the
+	signature of the sources. That is name, size and modification time of
+	every file of the mod, so changing, adding or removing any of them makes
+	Load() compile again.
+*/
+
+// Increase if Compile() changes in a way which affects the result
+static const Uint32 CompiledModVersion = 1;
+static const char CompiledModMagic[8] = { 'O','L','X','G','S','C','M','P' };
+
+static std::string compiledModFileName(const std::string& dir) {
+	std::string name = dir;
+	for(size_t i = 0; i < name.size(); ++i)
+		if(!isalnum((unsigned char)name[i]) && name[i] != '-' && name[i] != '.')
+			name[i] = '_';
+	return "cache/compiled_mods/" + name + ".lgs";
+}
+
+struct FileNameCollector {
+	std::set<std::string>& names;
+	FileNameCollector(std::set<std::string>& n) : names(n) {}
+	bool operator()(const std::string& abs_filename) {
+		std::string name = GetBaseFilename(abs_filename);
+		stringlwr(name);
+		names.insert(name);
+		return true;
+	}
+};
+
+static void listModFiles(const std::string& path, std::set<std::string>& files) {
+	std::set<std::string> names, subdirs;
+	FileNameCollector fileCollector(names), dirCollector(subdirs);
+	FindFiles(fileCollector, path, false, FM_REG);
+	FindFiles(dirCollector, path, false, FM_DIR);
+
+	for(std::set<std::string>::iterator i = names.begin(); i != names.end(); ++i)
+		files.insert(path + "/" + *i);
+	for(std::set<std::string>::iterator i = subdirs.begin(); i != subdirs.end(); ++i)
+		listModFiles(path + "/" + *i, files);
+}
+
+static std::string compiledModSignature(const std::string& dir) {
+	std::set<std::string> files;
+	listModFiles(dir, files);
+
+	std::string sig = "v" + itoa(CompiledModVersion) + " gs" + itoa(GS_VERSION);
+	for(std::set<std::string>::iterator i = files.begin(); i != files.end(); ++i) {
+		struct stat st;
+		if(!StatFile(*i, &st)) continue;
+		sig += " " + i->substr(dir.size() + 1) + ":" + itoa((long)st.st_size) + ":" + itoa((long)st.st_mtime);
+	}
+	return sig;
+}
+
+// Returns the cache file positioned at the script.lgs data if it is there and up to date
+static FILE* openCompiledMod(const std::string& dir, const std::string& sig) {
+	FILE* fp = OpenGameFile(compiledModFileName(dir), "rb");
+	if(!fp) return NULL;
+
+	char magic[sizeof(CompiledModMagic)];
+	Uint32 version = 0, sigLen = 0;
+	bool ok = fread(magic, sizeof(magic), 1, fp) == 1 && memcmp(magic, CompiledModMagic, sizeof(magic)) == 0 &&
+		fread_endian<Uint32>(fp, version) && version == CompiledModVersion &&
+		fread_endian<Uint32>(fp, sigLen) && sigLen == sig.size();
+	if(ok) {
+		std::string fileSig(sigLen, '\0');
+		ok = (sigLen == 0 || fread(&fileSig[0], sigLen, 1, fp) == 1) && fileSig == sig;
+	}
+
+	// Load() fails hard on a bad header, we rather compile again
+	const long dataStart = ftell(fp);
+	if(ok) {
+		gs_header_t head;
+		ok = fread(&head, sizeof(gs_header_t), 1, fp) == 1;
+		EndianSwap(head.Version);
+		fix_markend(head.ID);
+		ok = ok && strcmp(head.ID, "Liero Game Script") == 0 && head.Version == GS_VERSION;
+	}
+	if(ok)
+		ok = fseek(fp, dataStart, SEEK_SET) == 0;
+
+	if(!ok) {
+		notes << "compiled mod cache for " << dir << " is outdated or broken, ignoring it" << endl;
+		fclose(fp);
+		return NULL;
+	}
+	return fp;
+}
+
+bool CGameScript::SaveCompiled(const std::string& dir, const std::string& sig)
+{
+	// Written to a temporary file first, so an interrupted save never leaves a truncated cache
+	const std::string fileName = compiledModFileName(dir);
+	const std::string tmpFileName = fileName + ".tmp";
+	FILE* fp = OpenGameFile(tmpFileName, "wb");
+	if(!fp) {
+		warnings << "cannot write " << tmpFileName << endl;
+		return false;
+	}
+
+	fwrite(CompiledModMagic, sizeof(CompiledModMagic), 1, fp);
+	fwrite_endian<Uint32>(fp, CompiledModVersion);
+	fwrite_endian<Uint32>(fp, (Uint32)sig.size());
+	fwrite(sig.data(), 1, sig.size(), fp);
+	bool ok = Write(fp);
+	ok = (fclose(fp) == 0) && ok;
+
+	const std::string tmpFullName = GetWriteFullFileName(tmpFileName);
+	if(ok) {
+		const std::string fullName = GetWriteFullFileName(fileName);
+		remove(fullName.c_str()); // rename() doesn't overwrite on Windows
+		ok = rename(tmpFullName.c_str(), fullName.c_str()) == 0;
+	}
+	if(!ok) {
+		warnings << "error while writing " << fileName << endl;
+		remove(tmpFullName.c_str());
+		return false;
+	}
+
+	notes << "saved compiled mod " << fileName << endl;
+	return true;
+}
+
+
 ///////////////////
 // Load the game script from a file (game)
 int CGameScript::Load(const std::string& dir, bool loadImagesAndSounds)
@@ -595,17 +730,30 @@ int CGameScript::Load(const std::string& dir, bool loadImagesAndSounds)
 
 	// Open it
 	FILE* fp = OpenGameFile(filename,"rb");
-	if(fp == NULL) {
-		if(IsFileAvailable(dir + "/main.txt")) {
+	if(fp == NULL && IsFileAvailable(dir + "/main.txt")) {
+		const bool useCache = tLXOptions && tLXOptions->bCompiledModCache;
+		const std::string sig = useCache ? compiledModSignature(dir) : "";
+		if(useCache)
+			fp = openCompiledMod(dir, sig);
+		
+		if(fp) {
+			// Read it like a script.lgs below
+			hints << "GameScript: '" << dir << "': loading compiled gamescript source from cache" << endl;
+			filename = compiledModFileName(dir);
+		}
+		else {
 			hints << "GameScript: '" << dir << "': loading from gamescript source" << endl;
-			if(Compile(dir))
-				return GSE_OK;
-			else {
+			if(!Compile(dir)) {
 				warnings << "GameScript::Load(): could not compile source gamescript '" << dir << "'" << endl;
 				return GSE_BAD;
 			}
+			if(useCache)
+				SaveCompiled(dir, sig);
+			return GSE_OK;
 		}
-		
+	}
+	
+	if(fp == NULL) {
 		ModInfo info;
 		if(checkGusMod(dir, false, info)) {
 			// Note: In case of Gusanos, this will not actually load the mod.
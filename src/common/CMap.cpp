@@ -17,6 +17,8 @@
 #include <cassert>
 #include <zlib.h>
 #include <list>
+#include <algorithm>
+#include <boost/bind.hpp>
 
 
 #include "LieroX.h"
@@ -46,6 +48,7 @@
 #include "game/Game.h"
 #include "CodeAttributes.h"
 #include "CGameScript.h"
+#include "TaskScheduler.h"
 
 
 ////////////////////
@@ -235,6 +238,7 @@ bool CMap::MiniCreate(uint _width, uint _height, uint _minimap_w, uint _minimap_
 	MinimapHeight = _minimap_h;
 	
 	fBlinkTime = 0;
+	invalidateSpawnIndex();
 	
 	Objects = NULL;
 	
@@ -604,6 +608,9 @@ void CMap::ApplyShadow(int sx, int sy, int w, int h)
 // Updates an area according to pixel flags, recalculates minimap, draw image, pixel flags and shadow
 void CMap::UpdateArea(int x, int y, int w, int h, bool update_image)
 {
+	// Also on dedicated servers, they spawn the worms
+	invalidateSpawnCells(x, y, w, h);
+
 	if(bDedicated) return;
 
 	// When drawing shadows, we have to update a bigger area
@@ -802,14 +809,32 @@ void CMap::TileMap()
 
 ///////////////////
 // Calculate the dirt count in the level
+static void countDirtRows(CMap* map, std::vector<int>* counts, int rowsPerChunk, int firstRow, int endRow)
+{
+	int count = 0;
+	for (int y = firstRow; y < endRow; y++)
+		for (int x = 0; x < (int)map->GetWidth(); x++)
+			if(map->unsafeGetMaterial((uint)x, (uint)y).toLxFlags() & PX_DIRT)
+				count++;
+	(*counts)[firstRow / rowsPerChunk] = count;
+}
+
 void CMap::CalculateDirtCount()
 {
-    nTotalDirtCount = 0;
+	// Each chunk of rows is counted as a task, the map is only read here
+	static const int RowsPerChunk = 64;
+	const int h = (int)Height;
+	std::vector<int> counts(TaskScheduler::chunkCount(0, h, RowsPerChunk), 0);
+	const TaskScheduler::RangeFunction count = boost::bind(&countDirtRows, this, &counts, RowsPerChunk, _1, _2);
+	if(taskScheduler)
+		taskScheduler->parallelFor(0, h, RowsPerChunk, count);
+	else
+		for (int y = 0; y < h; y += RowsPerChunk)
+			count(y, MIN(y + RowsPerChunk, h));
 
-	for (int y = Height - 1; y >= 0; y--)
-		for (int x = Width - 1; x >= 0; x--)
-			if(unsafeGetMaterial((uint)x, (uint)y).toLxFlags() & PX_DIRT)
-				nTotalDirtCount++;
+	nTotalDirtCount = 0;
+	for (size_t i = 0; i < counts.size(); i++)
+		nTotalDirtCount += counts[i];
 }
 
 
@@ -2122,6 +2147,7 @@ void CMap::NewNet_RestoreFromMemory()
 	
 		unlockFlags();
 		UnlockSurface(bmpSavedImage);
+		invalidateSpawnCells(startX, startY, sizeX, sizeY);
 		
 		if( tLXOptions->bShadows )
 		{
@@ -2240,6 +2266,7 @@ void CMap::Shutdown()
 	}
 
 	gusShutdown();
+	invalidateSpawnIndex();
 	Created = false;
 	FileName = "";
 
@@ -2468,44 +2495,203 @@ void CMap::putSurfaceTo(long x, long y, SDL_Surface* surf, int sx, int sy, int s
 
 ///////////////////
 // Find a spot with no rock
+///////////////////
+// Spawn candidate index
+
+// Counts the good spawn points in a cell and optionally returns them
+uint CMap::countGoodSpawnPoints(uint cell, std::vector<CVec>* points)
+{
+	// IsGoodSpawnPoint(x,y) means no rock in [x-3,x+3) x [y-3,y+3), outside of the map is rock.
+	// With a summed area table of the cell plus that border, each point is checked in O(1).
+	enum { Before = 3, After = 2, Size = SPAWN_CELL + Before + After + 1 };
+	const int x0 = (cell % spawnCellsX) * SPAWN_CELL;
+	const int y0 = (cell / spawnCellsX) * SPAWN_CELL;
+	const int w = MIN((int)SPAWN_CELL, (int)Width - x0);
+	const int h = MIN((int)SPAWN_CELL, (int)Height - y0);
+	const int areaW = w + Before + After;
+	const int areaH = h + Before + After;
+
+	ushort rock[Size][Size];
+	for(int x = 0; x <= areaW; x++)
+		rock[0][x] = 0;
+	for(int y = 0; y < areaH; y++) {
+		ushort row = 0;
+		rock[y + 1][0] = 0;
+		for(int x = 0; x < areaW; x++) {
+			if(GetPixelFlag(x0 - Before + x, y0 - Before + y) & PX_ROCK)
+				row++;
+			rock[y + 1][x + 1] = rock[y][x + 1] + row;
+		}
+	}
+
+	static const int Window = Before + After + 1;
+	uint count = 0;
+	for(int y = 0; y < h; y++)
+		for(int x = 0; x < w; x++) {
+			if(rock[y + Window][x + Window] - rock[y][x + Window] - rock[y + Window][x] + rock[y][x] != 0)
+				continue;
+			count++;
+			if(points)
+				points->push_back(CVec((float)(x0 + x), (float)(y0 + y)));
+		}
+
+	return count;
+}
+
+void CMap::recountSpawnCells(const std::vector<uint>* cells, int first, int end)
+{
+	for(int i = first; i < end; i++)
+		spawnCellGood[(*cells)[i]] = countGoodSpawnPoints((*cells)[i], NULL);
+}
+
+///////////////////
+// Recounts the dirty cells, spawnIndexMutex and the flags read lock must be held
+void CMap::updateSpawnIndex()
+{
+	if(!bSpawnIndexBuilt) {
+		spawnCellsX = (Width + SPAWN_CELL - 1) / SPAWN_CELL;
+		spawnCellsY = (Height + SPAWN_CELL - 1) / SPAWN_CELL;
+		spawnCellGood.assign(spawnCellsX * spawnCellsY, 0);
+		spawnCellDirty.assign(spawnCellsX * spawnCellsY, 1);
+		bSpawnIndexBuilt = true;
+		bSpawnSumsDirty = true;
+	}
+	if(!bSpawnSumsDirty) return;
+
+	std::vector<uint> dirty;
+	for(uint i = 0; i < spawnCellDirty.size(); i++)
+		if(spawnCellDirty[i]) {
+			dirty.push_back(i);
+			spawnCellDirty[i] = 0;
+		}
+
+	// The first build touches the whole map, the cells are independent
+	static const int CellsPerTask = 64;
+	const int n = (int)dirty.size();
+	const TaskScheduler::RangeFunction recount = boost::bind(&CMap::recountSpawnCells, this, &dirty, _1, _2);
+	if(taskScheduler)
+		taskScheduler->parallelFor(0, n, CellsPerTask, recount);
+	else
+		recount(0, n);
+
+	spawnCellSums.resize(spawnCellGood.size());
+	Uint64 sum = 0;
+	for(size_t i = 0; i < spawnCellGood.size(); i++) {
+		sum += spawnCellGood[i];
+		spawnCellSums[i] = sum;
+	}
+	bSpawnSumsDirty = false;
+}
+
+void CMap::invalidateSpawnIndex()
+{
+	Mutex::ScopedLock lock(spawnIndexMutex);
+	bSpawnIndexBuilt = false;
+	spawnCellGood.clear();
+	spawnCellDirty.clear();
+	spawnCellSums.clear();
+}
+
+///////////////////
+// Marks the cells whose spawn points may have changed because of changes in the given map area
+void CMap::invalidateSpawnCells(int x, int y, int w, int h)
+{
+	Mutex::ScopedLock lock(spawnIndexMutex);
+	if(!bSpawnIndexBuilt || w <= 0 || h <= 0) return;
+
+	// A point looks 3 pixels around itself
+	const int cx1 = CLAMP((x - 3) / (int)SPAWN_CELL, 0, (int)spawnCellsX - 1);
+	const int cy1 = CLAMP((y - 3) / (int)SPAWN_CELL, 0, (int)spawnCellsY - 1);
+	const int cx2 = CLAMP((x + w + 3) / (int)SPAWN_CELL, 0, (int)spawnCellsX - 1);
+	const int cy2 = CLAMP((y + h + 3) / (int)SPAWN_CELL, 0, (int)spawnCellsY - 1);
+	for(int cy = cy1; cy <= cy2; cy++)
+		for(int cx = cx1; cx <= cx2; cx++)
+			spawnCellDirty[cy * spawnCellsX + cx] = 1;
+	bSpawnSumsDirty = true;
+}
+
+///////////////////
+// Picks count good spawn points, uniformly distributed over all good spawn points of the map.
+// Returns false if there is none.
+bool CMap::pickSpawnPoints(size_t count, std::vector<CVec>& points)
+{
+	if(material == NULL || Width == 0 || Height == 0) return false;
+
+	Mutex::ScopedLock lock(spawnIndexMutex);
+	updateSpawnIndex();
+
+	const Uint64 total = spawnCellSums.empty() ? 0 : spawnCellSums.back();
+	if(total == 0) return false;
+
+	std::vector<CVec> cellPoints;
+	for(size_t i = 0; i < count; i++) {
+		const Uint64 r = MIN((Uint64)(rnd() * (double)total), total - 1);
+		const size_t cell = std::upper_bound(spawnCellSums.begin(), spawnCellSums.end(), r) - spawnCellSums.begin();
+		const Uint64 k = r - (cell > 0 ? spawnCellSums[cell - 1] : 0);
+
+		cellPoints.clear();
+		countGoodSpawnPoints((uint)cell, &cellPoints);
+		if(k >= cellPoints.size()) {
+			// Should not happen, the cell is up to date
+			errors << "CMap::pickSpawnPoints: spawn index out of date" << endl;
+			return false;
+		}
+		points.push_back(cellPoints[(size_t)k]);
+	}
+
+	return true;
+}
+
+
 CVec CMap::FindSpot()
 {
 	CVec pos;
 	PixelFlagAccess flags(this);
-	
-	size_t tries = 1000;
-	do {
-		pos.x = float((double)rnd() * Width);
-		pos.y = float((double)rnd() * Height);
-		tries--;
-	} while ( tries > 0 && !IsGoodSpawnPoint(flags, pos) );
-	
-	if(tries == 0) errors << "FindSpot(): didn't found any free spot" << endl;
+
+	std::vector<CVec> points;
+	if(pickSpawnPoints(1, points))
+		return points[0];
+
+	errors << "FindSpot(): didn't found any free spot" << endl;
+	pos.x = float((double)rnd() * Width);
+	pos.y = float((double)rnd() * Height);
 	return pos;
 }
 
 
 
 CVec CMap::FindSpotCloseToPos(const std::list<CVec>& goodPos, const std::list<CVec>& badPos, bool keepDistanceToBad) {
-	// TODO: optimise this!
-	
+	static const size_t Candidates = 100;
+
+	std::vector<CVec> candidates;
+	{
+		PixelFlagAccess flags(this);
+		pickSpawnPoints(Candidates, candidates);
+	}
+	if(candidates.empty())
+		return FindSpot();
+
+	const std::vector<CVec> good(goodPos.begin(), goodPos.end());
+	const std::vector<CVec> bad(badPos.begin(), badPos.end());
+	const float goodFactor = good.empty() ? 0.0f : 1.0f / (good.size() * 10.0f);
+	const float badFactor = bad.empty() ? 0.0f : 1.0f / bad.size();
+
 	float team_dist = -9999999.0f;
-	CVec pos = FindSpot();
-	CVec pos1;
-	
-	for( int k=0; k<100; k++ )
+	CVec pos = candidates[0];
+
+	for(size_t k = 0; k < candidates.size(); k++)
 	{
+		const CVec& pos1 = candidates[k];
 		float team_dist1 = 0;
-		pos1 = FindSpot();
-		for(std::list<CVec>::const_iterator i = goodPos.begin(); i != goodPos.end(); ++i)
-			team_dist1 -= ( pos1 - *i ).GetLength() / (goodPos.size() * 10.0f);
-		for(std::list<CVec>::const_iterator i = badPos.begin(); i != badPos.end(); ++i) {
+		for(size_t i = 0; i < good.size(); ++i)
+			team_dist1 -= ( pos1 - good[i] ).GetLength() * goodFactor;
+		for(size_t i = 0; i < bad.size(); ++i) {
 			if(keepDistanceToBad)
-				team_dist1 += 2.0f * ( ( pos1 - *i ).GetLength() ) / badPos.size();
+				team_dist1 += 2.0f * ( pos1 - bad[i] ).GetLength() * badFactor;
 			else
 				// sqrt will make sure there's no large dist between team1 and 2 and short dist between 2 and 3
 				// The sum will get considerably smaller if any two teams are on short dist
-				team_dist1 += sqrt( ( pos1 - *i ).GetLength() ) / badPos.size();			
+				team_dist1 += sqrt( ( pos1 - bad[i] ).GetLength() ) * badFactor;
 		}
 		
 		if( team_dist1 > team_dist )
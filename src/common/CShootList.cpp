@@ -141,6 +141,14 @@ bool CShootList::writePacket( CBytestream *bs, const Version& receiverVer )
 }
 
 
+///////////////////
+// Shot encoding only depends on whether the receiver knows the release bit
+int CShootList::encodingVariant( const Version& receiverVer )
+{
+	return (receiverVer >= OLXBetaVersion(0,58,1)) ? 1 : 0;
+}
+
+
 ///////////////////
 // A single shot packet
 void CShootList::writeSingle( CBytestream *bs, const Version& receiverVer, int index )
@@ -741,3 +749,95 @@ AbsTime shoot_t::spawnTime() {
 	
 	return time;
 }
+
+
+
+///////////////////
+// Clear the journal
+void CShotJournal::Clear()
+{
+	while( !m_segments.empty() )
+		dropFront();
+	if( m_open ) {
+		delete m_open;
+		m_open = NULL;
+	}
+}
+
+
+void CShotJournal::dropFront()
+{
+	delete m_segments.front();
+	m_segments.pop_front();
+	m_first++;
+}
+
+
+///////////////////
+// Add a shot for all connections
+// (done on server-side from GameServer::WormShoot)
+bool CShotJournal::addShoot( int weaponID, TimeDiff fTime, float fSpeed, int nAngle, CWorm *pcWorm, bool release )
+{
+	if( m_open && m_open->shots.getNumShots() >= MAX_SHOOTINGS )
+		seal();
+	if( !m_open )
+		m_open = new Segment();
+
+	return m_open->shots.addShoot( weaponID, fTime, fSpeed, nAngle, pcWorm, release );
+}
+
+
+///////////////////
+// Close the current segment
+void CShotJournal::seal()
+{
+	if( !m_open || m_open->shots.getNumShots() == 0 )
+		return;
+
+	m_segments.push_back( m_open );
+	m_open = NULL;
+
+	while( m_segments.size() > MaxSegments )
+		dropFront();
+}
+
+
+///////////////////
+// Free the segments before the given cursor
+void CShotJournal::trim( Cursor oldestInUse )
+{
+	while( !m_segments.empty() && m_first < oldestInUse )
+		dropFront();
+}
+
+
+AbsTime CShotJournal::getPendingStartTime( Cursor c )
+{
+	if( c < m_first )
+		c = m_first;
+	if( c >= end() )
+		return AbsTime();
+	return m_segments[ (size_t)(c - m_first) ]->shots.getStartTime();
+}
+
+
+///////////////////
+// Write the shots the connection didn't get yet
+void CShotJournal::writePacket( CBytestream *bs, const Version& receiverVer, Cursor& c )
+{
+	const int variant = CShootList::encodingVariant( receiverVer );
+
+	if( c < m_first )
+		c = m_first;
+	for( ; c < end(); c++ ) {
+		Segment *seg = m_segments[ (size_t)(c - m_first) ];
+		// Encode only for the first connection of this variant
+		if( !seg->isEncoded[variant] ) {
+			CBytestream strm;
+			seg->shots.writePacket( &strm, receiverVer );
+			seg->encoded[variant] = strm.data();
+			seg->isEncoded[variant] = true;
+		}
+		bs->writeData( seg->encoded[variant] );
+	}
+}
@@ -738,10 +738,18 @@ SmartPointer<SDL_Surface> CWorm::ColorizeImage(const std::string& filename) cons
 
 
 
+void CWorm::onScoreUpdate(BaseObject *obj, const AttrDesc *attrDesc, ScriptVar_t old) {
+	CWorm* w = dynamic_cast<CWorm*>(obj);
+	assert(w != NULL);
+	game.roster.wormChanged(w->getID());
+}
+
 void CWorm::onWeaponsReadyUpdate(BaseObject *obj, const AttrDesc *attrDesc, ScriptVar_t old) {
 	CWorm* w = dynamic_cast<CWorm*>(obj);
 	assert(w != NULL);
 
+	game.roster.wormChanged(w->getID()); // Ready column in the scoreboard
+
 	if(game.isServer() && cServer)
 		cServer->RecheckGame();
 
@@ -53,6 +53,22 @@ void CWorm::writeInfo(CBytestream *bs)
 ///////////////////
 // Write a packet out (client-to-server + server-to-client)
 void CWorm::writePacket(CBytestream *bs, bool fromServer, CServerConnection* receiver)
+{
+	const Version& versionOfReceiver = fromServer ? receiver->getClientVersion() : cClient->getServerVersion();
+	writePacketState(bs, versionOfReceiver);
+
+	// client (>=beta8) sends also current server time
+	if(!fromServer && versionOfReceiver >= OLXBetaVersion(0,57,8)) {
+		bs->writeFloat( (float)game.serverTime().seconds() );
+	}
+
+	// Update the "last" variables
+	updateCheckVariables();
+}
+
+///////////////////
+// Write the worm state, as read by readPacketState
+void CWorm::writePacketState(CBytestream *bs, const Version& versionOfReceiver) const
 {
 	short x, y;
 
@@ -87,24 +103,15 @@ void CWorm::writePacket(CBytestream *bs, bool fromServer, CServerConnection* rec
 
 	// Write out the ninja rope details
 	if(cNinjaRope.get().isReleased())
-		cNinjaRope.write().write(bs);
+		cNinjaRope.get().write(bs);
 
 
 	// Velocity
-	const Version& versionOfReceiver = fromServer ? receiver->getClientVersion() : cClient->getServerVersion();
 	if(tState.get().bShoot || versionOfReceiver >= OLXBetaVersion(0,57,5)) {
 		CVec v = vVelocity;
 		bs->writeInt16( (Sint16)v.x );
 		bs->writeInt16( (Sint16)v.y );
 	}
-	
-	// client (>=beta8) sends also current server time
-	if(!fromServer && versionOfReceiver >= OLXBetaVersion(0,57,8)) {
-		bs->writeFloat( (float)game.serverTime().seconds() );
-	}
-
-	// Update the "last" variables
-	updateCheckVariables();
 }
 
 //////////////
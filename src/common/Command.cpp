@@ -44,6 +44,7 @@
 #include "Autocompletion.h"
 #include "OLXCommand.h"
 #include "TaskManager.h"
+#include "TaskScheduler.h"
 #include "game/Mod.h"
 #include "StringUtils.h"
 #include "game/Game.h"
@@ -53,8 +54,11 @@
 #include "game/Level.h"
 #include "game/ServerList.h"
 #include "EventQueue.h"
+#include "LockFreeQueue.h"
 #include "client/ClientConnectionRequestInfo.h"
 #include "gusanos/luaapi/context.h"
+#include "gusanos/luaapi/profiler.h"
+#include "FrameCapture.h"
 
 
 CmdLineIntf& stdoutCLI() {
@@ -319,8 +323,10 @@ struct Command : CommandDesc {
 	virtual void exec(CmdLineIntf* caller, const std::vector<std::string>& params) = 0;
 
 	void exec(CmdLineIntf* caller, const std::string& params) {
-		std::vector<std::string> ps = ParseParams(params);
-		
+		execChecked(caller, ParseParams(params));
+	}
+	
+	void execChecked(CmdLineIntf* caller, std::vector<std::string> ps) {
 		// if we want max 1 param but we give more, this is a small hack to dont be too strict
 		if(maxParams == 1 && ps.size() > 1) {
 			for(size_t i = 1; i < ps.size(); ++i)
@@ -890,6 +896,76 @@ void Cmd_connect::exec(CmdLineIntf* caller, const std::vector<std::string>& para
 	if(!JoinServer(server, server, player)) return;
 }
 
+COMMAND(playDemo, "play a recorded network game", "file [speed]", 1, 2);
+void Cmd_playDemo::exec(CmdLineIntf* caller, const std::vector<std::string>& params) {
+	if(game.state != Game::S_Inactive) {
+		caller->writeMsg("we cannot play a demo in current state", CNC_NOTIFY);
+		caller->writeMsg("stop game if you want to play a demo", CNC_NOTIFY);
+		return;
+	}
+
+	float speed = 1.0f;
+	if(params.size() > 1) {
+		bool fail = true;
+		speed = from_string<float>(params[1], fail);
+		if(fail || speed < 0.0f) {
+			caller->writeMsg("speed is a factor of real time, 0 is as fast as possible", CNC_WARNING);
+			return;
+		}
+	}
+
+	std::string err;
+	if(!cClient->PlayDemo(params[0], speed, err)) {
+		caller->writeMsg("cannot play demo " + params[0] + ": " + err, CNC_ERROR);
+		return;
+	}
+}
+
+COMMAND(startCapture, "capture the screen to capture/ as an image sequence or a raw video stream", "[fps] [png|jpg|bmp|gif|raw]", 0, 2);
+void Cmd_startCapture::exec(CmdLineIntf* caller, const std::vector<std::string>& params) {
+	if(bDedicated) {
+		caller->writeMsg("cannot capture in dedicated mode, there is no screen", CNC_ERROR);
+		return;
+	}
+
+	float fps = 25.0f;
+	if(params.size() > 0) {
+		bool fail = true;
+		fps = from_string<float>(params[0], fail);
+		if(fail) {
+			caller->writeMsg("fps must be a number", CNC_WARNING);
+			return;
+		}
+	}
+
+	int format = FMT_PNG;
+	if(params.size() > 1) {
+		const std::string& f = params[1];
+		if(stringcaseequal(f, "png")) format = FMT_PNG;
+		else if(stringcaseequal(f, "jpg")) format = FMT_JPG;
+		else if(stringcaseequal(f, "bmp")) format = FMT_BMP;
+		else if(stringcaseequal(f, "gif")) format = FMT_GIF;
+		else if(stringcaseequal(f, "raw")) format = FrameCapture::FormatRaw;
+		else {
+			caller->writeMsg("unknown format " + f, CNC_WARNING);
+			return;
+		}
+	}
+
+	std::string err;
+	if(!FrameCapture::Get()->startSequence(fps, format, err))
+		caller->writeMsg("cannot start capture: " + err, CNC_ERROR);
+}
+
+COMMAND(stopCapture, "stop capturing the screen", "", 0, 0);
+void Cmd_stopCapture::exec(CmdLineIntf* caller, const std::vector<std::string>& params) {
+	if(!FrameCapture::Get()->capturing()) {
+		caller->writeMsg("not capturing", CNC_NOTIFY);
+		return;
+	}
+	FrameCapture::Get()->stopSequence();
+}
+
 COMMAND(wait, "Execute commands after wait", "seconds|lobby|game command [args] [ ; command2 args... ]", 2, INT_MAX);
 void Cmd_wait::exec(CmdLineIntf* caller, const std::vector<std::string>& params) {
 	
@@ -1307,6 +1383,30 @@ void Cmd_banWorm::exec(CmdLineIntf* caller, const std::vector<std::string>& para
 	cServer->banWorm(id,reason);
 }
 
+COMMAND(banAddress, "ban an IP or a range of IPs (1.2.3.0/24 or 1.2.3.*)", "address [nick]", 1, 2);
+void Cmd_banAddress::exec(CmdLineIntf* caller, const std::vector<std::string>& params)
+{
+	if(game.isClient() || !cServer || !cServer->isServerRunning()) {
+		caller->writeMsg(name + ": cannot do that as client", CNC_WARNING);
+		return;
+	}
+
+	cServer->getBanList()->addBanned(params[0], (params.size() >= 2) ? params[1] : "");
+	caller->writeMsg(params[0] + " banned, " + itoa(cServer->getBanList()->getNumItems()) + " entries in the ban list");
+}
+
+COMMAND(importBanList, "add all entries of a ban list file (address[,nick] per line) to the ban list", "file", 1, 1);
+void Cmd_importBanList::exec(CmdLineIntf* caller, const std::vector<std::string>& params)
+{
+	if(game.isClient() || !cServer || !cServer->isServerRunning()) {
+		caller->writeMsg(name + ": cannot do that as client", CNC_WARNING);
+		return;
+	}
+
+	const int added = cServer->getBanList()->importList(params[0]);
+	caller->writeMsg(itoa(added) + " new entries, " + itoa(cServer->getBanList()->getNumItems()) + " entries in the ban list");
+}
+
 COMMAND(muteWorm, "mute worm", "id", 1, 1);
 // TODO: Add name muting, if wanted.
 void Cmd_muteWorm::exec(CmdLineIntf* caller, const std::vector<std::string>& params)
@@ -2189,6 +2289,8 @@ void Cmd_whoIs::exec(CmdLineIntf* caller, const std::vector<std::string>& params
 		caller->pushReturnArg("ConnectTime: " + ftoa((tLX->currentTime - w->getClient()->getConnectTime()).seconds()) + " secs");
 		caller->pushReturnArg("NetSpeed: " + NetworkSpeedString((NetworkSpeed)w->getClient()->getNetSpeed()));
 		caller->pushReturnArg("Ping: " + itoa(w->getClient()->getPing()));
+		if(w->getClient()->getChannel())
+			caller->pushReturnArg("SendRate: " + w->getClient()->getChannel()->getSendRate().stats());
 		caller->pushReturnArg("LastResponse: " + ftoa((tLX->currentTime - w->getClient()->getLastReceived()).seconds()) + " secs ago");
 		if(game.state != Game::S_Lobby) {
 			caller->pushReturnArg("IsReady: " + to_string(w->getClient()->getGameReady()));
@@ -2268,6 +2370,165 @@ void Cmd_dumpSysState::exec(CmdLineIntf* caller, const std::vector<std::string>&
 	hints << "Free system memory: " << (GetFreeSysMemory() / 1024) << " KB" << endl;
 	hints << "Cache size: " << (cCache.GetCacheSize() / 1024) << " KB" << endl;
 	hints << "Current time: " << GetDateTimeText() << endl;
+	if(taskScheduler)
+		hints << "Task scheduler workers: " << taskScheduler->workerCount() << endl;
+}
+
+COMMAND(cacheStats, "show the cache statistics", "", 0, 0);
+void Cmd_cacheStats::exec(CmdLineIntf* caller, const std::vector<std::string>& params) {
+	for(int t = 0; t < CCache::IT_Count; ++t) {
+		const CCache::Stats s = cCache.GetStats((CCache::ItemType)t);
+		caller->writeMsg(std::string(CCache::ItemTypeName((CCache::ItemType)t)) + ": " +
+						 itoa((int)s.entries) + " entries, " + itoa((int)(s.bytes / 1024)) + " KB, " +
+						 to_string(s.hits) + " hits, " + to_string(s.misses) + " misses, " +
+						 to_string(s.evictions) + " evictions");
+	}
+	caller->writeMsg("total: " + itoa((int)(cCache.GetCacheSize() / 1024)) + " KB of " + itoa(tLXOptions->iCacheMaxSize * 1024) + " KB");
+}
+
+static Result benchThreadPoolJob(void*) { return true; }
+static void benchTaskJob() {}
+
+static void writeLatencyStats(CmdLineIntf* caller, const std::string& name, std::vector<Uint64>& ns) {
+	std::sort(ns.begin(), ns.end());
+	Uint64 sum = 0;
+	for(size_t i = 0; i < ns.size(); ++i) sum += ns[i];
+	caller->writeMsg(name + ": avg " + itoa((int)(sum / ns.size())) + " ns, "
+					 "p50 " + itoa((int)ns[ns.size() / 2]) + " ns, "
+					 "p99 " + itoa((int)ns[(ns.size() - 1) * 99 / 100]) + " ns");
+}
+
+COMMAND(benchTasks, "measure the spawn+join latency of the ThreadPool and the TaskScheduler", "[count]", 0, 1);
+void Cmd_benchTasks::exec(CmdLineIntf* caller, const std::vector<std::string>& params) {
+	int count = 1000;
+	if(params.size() > 0) {
+		bool fail = false;
+		count = from_string<int>(params[0], fail);
+		if(fail || count <= 0 || count > 100000) {
+			printUsage(caller);
+			return;
+		}
+	}
+	if(!threadPool || !taskScheduler) {
+		caller->writeMsg("thread pool not initialised", CNC_ERROR);
+		return;
+	}
+
+	const double nsPerTick = 1e9 / (double)SDL_GetPerformanceFrequency();
+	std::vector<Uint64> ns(count);
+
+	// One empty job at a time, so we measure the round trip: start it and wait until it is done
+	for(int i = 0; i < count; ++i) {
+		const Uint64 start = SDL_GetPerformanceCounter();
+		threadPool->wait(threadPool->start((ThreadFunc)benchThreadPoolJob, (void*)NULL, "bench task"), NULL);
+		ns[i] = (Uint64)((SDL_GetPerformanceCounter() - start) * nsPerTick);
+	}
+	writeLatencyStats(caller, "ThreadPool start+wait", ns);
+
+	for(int i = 0; i < count; ++i) {
+		const Uint64 start = SDL_GetPerformanceCounter();
+		TaskGroup group;
+		taskScheduler->spawn(group, benchTaskJob);
+		taskScheduler->wait(group);
+		ns[i] = (Uint64)((SDL_GetPerformanceCounter() - start) * nsPerTick);
+	}
+	writeLatencyStats(caller, "TaskScheduler spawn+wait", ns);
+
+	// All at once, per task
+	{
+		const Uint64 start = SDL_GetPerformanceCounter();
+		TaskGroup group;
+		for(int i = 0; i < count; ++i)
+			taskScheduler->spawn(group, benchTaskJob);
+		taskScheduler->wait(group);
+		const Uint64 total = (Uint64)((SDL_GetPerformanceCounter() - start) * nsPerTick);
+		caller->writeMsg("TaskScheduler " + itoa(count) + " tasks in one group: " + itoa((int)(total / count)) + " ns per task, "
+						 + itoa(taskScheduler->workerCount()) + " workers");
+	}
+}
+
+COMMAND(benchQueryFlood, "flood the own server with connectionless queries over loopback and measure the frame time spent on them", "[count]", 0, 1);
+void Cmd_benchQueryFlood::exec(CmdLineIntf* caller, const std::vector<std::string>& params) {
+	int count = 500;
+	if(params.size() > 0) {
+		bool fail = false;
+		count = from_string<int>(params[0], fail);
+		if(fail || count <= 0 || count > 20000) {
+			printUsage(caller);
+			return;
+		}
+	}
+	if(game.isClient() || !cServer || !cServer->isServerRunning()) {
+		caller->writeMsg("benchQueryFlood works only as server", CNC_ERROR);
+		return;
+	}
+	if(game.isLocalGame()) {
+		caller->writeMsg("a local game doesn't answer queries", CNC_ERROR);
+		return;
+	}
+
+	NetworkSocket sock;
+	NetworkAddr addr;
+	if(!sock.OpenUnreliable(0) || !StringToNetAddr("127.0.0.1:" + itoa(cServer->getPort()), addr)) {
+		caller->writeMsg("cannot open the loopback socket", CNC_ERROR);
+		return;
+	}
+	sock.setRemoteAddress(addr);
+
+	struct Run { const char* name; bool cache; bool limit; };
+	static const Run runs[] = {
+		{ "uncached, unlimited", false, false },
+		{ "cached, unlimited", true, false },
+		{ "cached, rate limited", true, true } };
+
+	const int oldCacheTime = tLXOptions->iQueryReplyCacheTime;
+	const int oldRateLimit = tLXOptions->iQueryRateLimit;
+	const double msPerTick = 1e3 / (double)SDL_GetPerformanceFrequency();
+
+	for(size_t r = 0; r < sizeof(runs) / sizeof(runs[0]); ++r) {
+		tLXOptions->iQueryReplyCacheTime = runs[r].cache ? MAX(oldCacheTime, 200) : 0;
+		tLXOptions->iQueryRateLimit = runs[r].limit ? MAX(oldRateLimit, 1) : 0;
+		cServer->invalidateConnectionlessReplies();
+
+		// The queries a server browser sends, all arriving within one frame
+		for(int i = 0; i < count; ++i) {
+			CBytestream bs;
+			bs.writeInt(-1, 4);
+			if(i % 3 == 0)
+				bs.writeString("lx::getinfo");
+			else if(i % 3 == 1) {
+				bs.writeString("lx::query");
+				bs.writeByte(i & 0xff);
+			}
+			else
+				bs.writeString("lx::ping");
+			bs.Send(&sock);
+		}
+
+		const Uint64 start = SDL_GetPerformanceCounter();
+		cServer->ReadPackets();
+		const double ms = (SDL_GetPerformanceCounter() - start) * msPerTick;
+
+		int replies = 0;
+		CBytestream bs;
+		sock.WaitForSocketRead(100);
+		while(bs.Read(&sock)) {
+			replies++;
+			bs.Clear();
+		}
+
+		caller->writeMsg(std::string(runs[r].name) + ": " + itoa(count) + " queries took " + ftoa((float)ms) + " ms of the frame (" +
+						 ftoa((float)(ms * 1000.0 / count)) + " us each), " + itoa(replies) + " replies");
+	}
+
+	tLXOptions->iQueryReplyCacheTime = oldCacheTime;
+	tLXOptions->iQueryRateLimit = oldRateLimit;
+	cServer->invalidateConnectionlessReplies();
+	sock.Close();
+
+	const SourceRateLimiter& limiter = cServer->getQueryLimiter();
+	caller->writeMsg("rate limiter: " + to_string(limiter.allowed()) + " allowed, " + to_string(limiter.dropped()) + " dropped, " +
+					 itoa((int)limiter.sources()) + " sources");
 }
 
 #ifdef DEBUG
@@ -2513,6 +2774,16 @@ void Cmd_signal::exec(CmdLineIntf* caller, const std::vector<std::string>& param
 	DedicatedControl::Get()->Custom_Signal( std::list<std::string>(params.begin(), params.end()) );
 }
 
+COMMAND(dedicatedStats, "show the signal queue statistics of the dedicated script", "", 0, 0);
+void Cmd_dedicatedStats::exec(CmdLineIntf* caller, const std::vector<std::string>& params) {
+	if(!DedicatedControl::Get()) {
+		caller->writeMsg("dedicated control not available", CNC_ERROR);
+		return;
+	}
+	
+	DedicatedControl::Get()->GetSignalQueueStats(caller);
+}
+
 COMMAND(lua, "execute Lua command", "<cmd>", 1, 1);
 void Cmd_lua::exec(CmdLineIntf *caller, const std::vector<std::string>& params) {
 	int r = luaGlobal.execCode(params[0], *caller);
@@ -2521,13 +2792,60 @@ void Cmd_lua::exec(CmdLineIntf *caller, const std::vector<std::string>& params)
 	luaGlobal.pop(r);
 }
 
+COMMAND(benchLua, "measure the next logic frames of the running game, to compare Lua backends", "[frames]", 0, 1);
+void Cmd_benchLua::exec(CmdLineIntf *caller, const std::vector<std::string>& params) {
+	if(params.empty()) {
+		if(luaFrameBench.running())
+			caller->writeMsg("benchLua is still running");
+		else
+			caller->writeMsg(luaFrameBench.summary());
+		return;
+	}
+	bool fail = true;
+	int frames = from_string<int>(params[0], fail);
+	if(fail || frames <= 0) {
+		printUsage(caller);
+		return;
+	}
+	luaFrameBench.start((size_t)frames);
+	caller->writeMsg("benchLua: recording " + itoa(frames) + " frames with " + LuaFrameBench::backend() + ", see the log or call benchLua again");
+}
+
+COMMAND(luaProfile, "profile the Lua callbacks and functions", "start|stop|reset|dump [count]", 1, 2);
+void Cmd_luaProfile::exec(CmdLineIntf *caller, const std::vector<std::string>& params) {
+	const std::string& what = params[0];
+	if(what == "start") {
+		LuaProfiler::enabled = true;
+		caller->writeMsg("Lua profiler started");
+	}
+	else if(what == "stop") {
+		LuaProfiler::enabled = false;
+		caller->writeMsg("Lua profiler stopped");
+	}
+	else if(what == "reset") {
+		LuaProfiler::reset();
+		luaIngameGC.resetStats();
+	}
+	else if(what == "dump") {
+		int count = 20;
+		if(params.size() > 1) {
+			bool fail = true;
+			count = from_string<int>(params[1], fail);
+			if(fail || count < 0) { printUsage(caller); return; }
+		}
+		LuaProfiler::dump(*caller, (size_t)count);
+	}
+	else
+		printUsage(caller);
+}
+
 
 static void HandleCommand(const CmdLineIntf::Command& command) {
 	assert(isGameloopThread());
 
 	std::string cmdstr = command.cmd; TrimSpaces(cmdstr);
 	std::string params;
-	size_t f = cmdstr.find(' ');
+	size_t f = command.preparsed ? std::string::npos : cmdstr.find(' ');
 	if(f != std::string::npos) {
 		params = cmdstr.substr(f + 1);
 		TrimSpaces(params);
@@ -2538,7 +2856,10 @@ static void HandleCommand(const CmdLineIntf::Command& command) {
 	CommandMap::iterator cmd = commands.find(cmdstr);
 	
 	if(cmd != commands.end()) {
-		cmd->second->exec(command.sender, params);
+		if(command.preparsed)
+			cmd->second->execChecked(command.sender, command.params);
+		else
+			cmd->second->exec(command.sender, params);
 	}
 	// we must handle this command seperate
 	else if( stringcaseequal(cmdstr, "nextsignal") ) {
@@ -2556,47 +2877,24 @@ static void HandleCommand(const CmdLineIntf::Command& command) {
 }
 
 
-struct CmdQueue {
-	
-	SDL_mutex* pendingCommandsMutex;
-	std::list<CmdLineIntf::Command> pendingCommands;
-	
-	CmdQueue() {
-		pendingCommandsMutex = SDL_CreateMutex();
-	}
-	
-	~CmdQueue() {
-		SDL_DestroyMutex(pendingCommandsMutex);
-		pendingCommandsMutex = NULL;
-	}
-
-};
-
-static CmdQueue cmdQueue;
+// Commands come from the dedicated script thread, the console, chat and network threads.
+// Only the gameloop thread executes them.
+static MpscQueue<CmdLineIntf::Command> cmdQueue(256);
 
 
 void Execute(const CmdLineIntf::Command& command) {
-	ScopedLock lock(cmdQueue.pendingCommandsMutex);
-	cmdQueue.pendingCommands.push_back(command);
+	cmdQueue.push(command);
 }
 
 bool havePendingCommands() {
-	ScopedLock lock(cmdQueue.pendingCommandsMutex);
-	return !cmdQueue.pendingCommands.empty();
+	return !cmdQueue.empty();
 }
 
 void HandlePendingCommands() {
 	while(true) {
 		CmdLineIntf::Command command;
-		{
-			ScopedLock lock(cmdQueue.pendingCommandsMutex);
-			if(cmdQueue.pendingCommands.size() > 0) {
-				command = cmdQueue.pendingCommands.front();
-				cmdQueue.pendingCommands.pop_front();
-			}
-			else
-				break;
-		}
+		if(!cmdQueue.pop(command))
+			break;
 
 		if(command.execScope.get())
 			command.execScope->execNow(command);
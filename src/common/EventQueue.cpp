@@ -20,6 +20,9 @@
 #include "LieroX.h"
 #include "EventQueue.h"
 #include "ReadWriteLock.h"
+#include "LockFreeQueue.h"
+#include "Mutex.h"
+#include "Condition.h"
 #include "Debug.h"
 #include "InputEvents.h"
 #include "game/Game.h"
@@ -29,13 +32,26 @@ static void InitQuitSignalHandler();
 EventQueue* mainQueue = NULL;
 
 struct EventQueueIntern {
-	SDL_mutex* mutex;
-	SDL_cond* cond;
-	std::list<EventItem> queue;
-	EventQueueIntern() : mutex(NULL), cond(NULL) {}
-	void init() {
-		mutex = SDL_CreateMutex();
-		cond = SDL_CreateCond();
+	// Producers (input layer, network and other threads) never take a lock on the fast path.
+	MpscQueue<EventItem> queue;
+	// The consumer side (poll/wait from the main or gameloop thread, copyCustomEvents and
+	// removeCustomEvents) is serialized by consumerMutex. The last two need to insert and
+	// erase in the middle, so they move everything from queue to taken and edit it there.
+	Mutex consumerMutex;
+	std::list<EventItem> taken; // older than everything in queue
+	SDL_atomic_t takenCount;
+	// For wait(). Producers only touch waitMutex if somebody is actually waiting.
+	Mutex waitMutex;
+	Condition waitCond;
+	SDL_atomic_t waiters;
+	EventQueueIntern() : queue(4096) { SDL_AtomicSet(&waiters, 0); SDL_AtomicSet(&takenCount, 0); }
+	bool empty() { return queue.empty() && SDL_AtomicGet(&takenCount) == 0; }
+	// Expects that consumerMutex is locked
+	void takeAll() {
+		// Not empty() while the items are moved, wait() would sleep otherwise
+		SDL_AtomicSet(&takenCount, (int)taken.size() + 1);
+		queue.popAll(taken);
+		SDL_AtomicSet(&takenCount, (int)taken.size());
 	}
 	void uninit() { // WARNING: don't call this if any other thread could be using this queue
 		while(true) {
@@ -43,8 +59,10 @@ struct EventQueueIntern {
 			// and that would either cause deadlocks or crashes, thus we still need a vaild eventqueue at this point.
 			std::list<EventItem> tmpList;
 			{
-				ScopedLock lock(mutex);
-				tmpList.swap(queue);
+				Mutex::ScopedLock lock(consumerMutex);
+				takeAll();
+				tmpList.swap(taken);
+				SDL_AtomicSet(&takenCount, 0);
 			}
 			if(tmpList.size() > 0)
 				warnings << "there are still " << tmpList.size() << " pending events in the event queue" << endl;
@@ -63,18 +81,11 @@ struct EventQueueIntern {
 				}
 			}
 		}
-		
-		SDL_DestroyMutex(mutex);
-		mutex = NULL;
-		
-		SDL_DestroyCond(cond);
-		cond = NULL;
 	}
 };
 
 EventQueue::EventQueue() {
 	data = new EventQueueIntern();
-	data->init();
 }
 
 EventQueue::~EventQueue() {
@@ -98,43 +109,41 @@ void ShutdownEventQueue() {
 
 
 bool EventQueue::hasItems() {
-	ScopedLock lock(data->mutex);
-	return !data->queue.empty();
+	return !data->empty();
 }
 
 bool EventQueue::poll(EventItem& event) {
-	ScopedLock lock(data->mutex);
-	
-	if( data->queue.empty() )
-		return false;
-
-	event = data->queue.front();	
-	data->queue.pop_front();
-	
-	return true;
+	Mutex::ScopedLock lock(data->consumerMutex);
+	if(!data->taken.empty()) {
+		event = data->taken.front();
+		data->taken.pop_front();
+		SDL_AtomicAdd(&data->takenCount, -1);
+		return true;
+	}
+	return data->queue.pop(event);
 }
 
 bool EventQueue::wait(EventItem& event) {
-	ScopedLock lock(data->mutex);
-	
-	while( data->queue.empty() ) {
-		SDL_CondWait( data->cond, data->mutex );
+	while(true) {
+		if(poll(event))
+			return true;
+		
+		// We don't keep consumerMutex while we sleep, removeCustomEvents() must not block on us
+		Mutex::ScopedLock lock(data->waitMutex);
+		SDL_AtomicIncRef(&data->waiters);
+		while( data->empty() )
+			data->waitCond.wait(data->waitMutex);
+		SDL_AtomicDecRef(&data->waiters);
 	}
-	
-	event = data->queue.front();
-	data->queue.pop_front();
-	
-	return true;
 }
 
 bool EventQueue::push(const EventItem& event) {
-	{
-		ScopedLock lock(data->mutex);
-
-		// TODO: some limit if queue too full? it could happen that OLX eats up all mem if there is no limit
-		data->queue.push_back(event);
-
-		SDL_CondSignal(data->cond);
+	// TODO: some limit if queue too full? it could happen that OLX eats up all mem if there is no limit
+	data->queue.push(event);
+	
+	if(SDL_AtomicGet(&data->waiters) > 0) {
+		Mutex::ScopedLock lock(data->waitMutex);
+		data->waitCond.signal();
 	}
 
 #ifdef SINGLETHREADED
@@ -167,32 +176,36 @@ bool EventQueue::push(Action* act) {
 }
 
 void EventQueue::copyCustomEvents(const _Event* oldOwner, _Event* newOwner) {
-	ScopedLock lock(data->mutex);
+	Mutex::ScopedLock lock(data->consumerMutex);
+	data->takeAll();
 
-	for(std::list<EventItem>::iterator i = data->queue.begin(); i != data->queue.end(); ++i) {
+	for(std::list<EventItem>::iterator i = data->taken.begin(); i != data->taken.end(); ++i) {
 		if(i->type == SDL_USEREVENT && i->user.code == UE_CustomEventHandler) {
 			CustomEventHandler* hndl = dynamic_cast<CustomEventHandler*>( (Action*)i->user.data1 );
 			if(hndl && hndl->owner() == oldOwner) {
-				data->queue.insert(i, CustomEvent(hndl->copy(newOwner)));
+				data->taken.insert(i, CustomEvent(hndl->copy(newOwner)));
 			}
 		}
 	}
+	SDL_AtomicSet(&data->takenCount, (int)data->taken.size());
 }
 
 void EventQueue::removeCustomEvents(const _Event* owner) {
-	ScopedLock lock(data->mutex);
+	Mutex::ScopedLock lock(data->consumerMutex);
+	data->takeAll();
 	
-	for(std::list<EventItem>::iterator i = data->queue.begin(); i != data->queue.end(); ) {
+	for(std::list<EventItem>::iterator i = data->taken.begin(); i != data->taken.end(); ) {
 		std::list<EventItem>::iterator last = i; ++i;
 		const SDL_Event& ev = *last;
 		if(ev.type == SDL_USEREVENT && ev.user.code == UE_CustomEventHandler) {
 			CustomEventHandler* hndl = dynamic_cast<CustomEventHandler*>( (Action*)ev.user.data1 );
 			if(hndl && hndl->owner() == owner) {
 				delete (Action*)ev.user.data1;
-				data->queue.erase(last);
+				data->taken.erase(last);
 			}
 		}
 	}
+	SDL_AtomicSet(&data->takenCount, (int)data->taken.size());
 }
 
 
@@ -0,0 +1,301 @@
+/*
+ *  MatchBenchmark.cpp
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <cstdlib>
+#include <ctime>
+
+#ifdef WIN32
+#include <windows.h>
+#include <psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#include "MatchBenchmark.h"
+#include "Debug.h"
+#include "Timer.h"
+#include "IniReader.h"
+#include "FindFile.h"
+#include "StringUtils.h"
+#include "OLXCommand.h"
+#include "CScriptableVars.h"
+#include "CClient.h"
+#include "CServer.h"
+#include "NewNetEngine.h"
+#include "game/Game.h"
+#include "game/Settings.h"
+#include "game/Mod.h"
+#include "game/Level.h"
+#include "util/math_func.h"
+
+
+// How long (wall time) we wait for the lobby/bots/game before giving up.
+static const float SETUP_TIMEOUT = 120.0f;
+
+static MatchBenchmark* matchBenchmarkInstance = NULL;
+
+bool MatchBenchmark::Init(const std::string& scenario, int ticks, int seed, const std::string& outputFile) {
+	if(matchBenchmarkInstance) return true;
+
+	MatchBenchmark* b = new MatchBenchmark();
+	b->m_scenarioFile = scenario;
+	b->m_outputFile = outputFile;
+	if(!b->loadScenario()) {
+		errors << "benchmark: cannot load scenario " << scenario << endl;
+		delete b;
+		return false;
+	}
+	// Command line overrides the scenario
+	if(ticks > 0) b->m_ticks = ticks;
+	if(seed >= 0) b->m_seed = seed;
+
+	notes << "benchmark: scenario " << b->m_name << ", " << b->m_ticks << " ticks, seed " << b->m_seed << endl;
+	matchBenchmarkInstance = b;
+	return true;
+}
+
+void MatchBenchmark::Uninit() {
+	delete matchBenchmarkInstance;
+	matchBenchmarkInstance = NULL;
+}
+
+MatchBenchmark* MatchBenchmark::Get() { return matchBenchmarkInstance; }
+
+MatchBenchmark::MatchBenchmark() :
+	m_state(S_Setup), m_ticks(6000), m_seed(1), m_bots(4), m_botDifficulty(-1),
+	m_measureStart(0), m_tickStart(0) {}
+
+MatchBenchmark::~MatchBenchmark() {
+	if(m_state == S_Measure)
+		timeCounter.setManual(false);
+}
+
+bool MatchBenchmark::loadScenario() {
+	std::string file = m_scenarioFile;
+	// Allow just the name of one of the shipped scenarios
+	if(!IsFileAvailable(file, IsAbsolutePath(file)) && GetFileExtension(file) == "")
+		file = "benchmarks/" + file + ".cfg";
+
+	IniReader ini(file);
+	if(!ini.Parse()) return false;
+
+	ini.ReadString("Benchmark", "Name", m_name, GetBaseFilenameWithoutExt(file));
+	ini.ReadInteger("Benchmark", "Ticks", &m_ticks, m_ticks);
+	ini.ReadInteger("Benchmark", "Seed", &m_seed, m_seed);
+	ini.ReadInteger("Benchmark", "Bots", &m_bots, m_bots);
+	ini.ReadInteger("Benchmark", "BotDifficulty", &m_botDifficulty, m_botDifficulty);
+
+	// All other sections are variables, e.g. [GameInfo] ModName = Classic
+	// is the same as "setVar GameOptions.GameInfo.ModName Classic".
+	for(IniReader::SectionMap::iterator s = ini.m_sections.begin(); s != ini.m_sections.end(); ++s) {
+		if(stringcaseequal(s->first, "Benchmark")) continue;
+		for(IniReader::Section::iterator i = s->second.begin(); i != s->second.end(); ++i)
+			m_vars["GameOptions." + s->first + "." + i->first] = i->second;
+	}
+
+	m_bots = CLAMP(m_bots, 0, MAX_WORMS - 1);
+	return m_ticks > 0;
+}
+
+void MatchBenchmark::applySettings() {
+	for(std::map<std::string, std::string>::iterator i = m_vars.begin(); i != m_vars.end(); ++i) {
+		RegisteredVar* var = CScriptableVars::GetVar(i->first);
+		if(var == NULL) {
+			warnings << "benchmark: unknown variable " << i->first << endl;
+			continue;
+		}
+		CScriptableVars::SetVarByString(var->var, i->second);
+	}
+
+	// We need a slot for every bot
+	tLXOptions->iMaxPlayers = CLAMP(MAX(tLXOptions->iMaxPlayers, m_bots), 2, (int)MAX_PLAYERS);
+}
+
+void MatchBenchmark::seedRandom() {
+	srand((unsigned int)m_seed);
+	rndgen.seed((boost::mt19937::result_type)m_seed);
+	// These hold their own copy of the engine.
+	rnd.base().seed((boost::mt19937::result_type)m_seed);
+	midrnd.engine().seed((boost::mt19937::result_type)m_seed);
+	NewNet::netRandom.seed((unsigned)m_seed);
+}
+
+void MatchBenchmark::Frame() {
+	if(m_state != S_Measure && m_state != S_Done && m_state != S_Setup) {
+		if(GetTime() - m_stateStart > TimeDiff(SETUP_TIMEOUT)) {
+			finish("timeout while setting up the game");
+			return;
+		}
+	}
+
+	switch(m_state) {
+	case S_Setup:
+		applySettings();
+		seedRandom();
+		Execute(&stdoutCLI(), "startLobby");
+		m_state = S_WaitLobby;
+		m_stateStart = GetTime();
+		break;
+
+	case S_WaitLobby:
+		if(game.state != Game::S_Lobby) break;
+		if(m_bots > 0)
+			Execute(&stdoutCLI(), "addBots " + itoa(m_bots) + " " + itoa(m_botDifficulty));
+		m_state = S_WaitBots;
+		m_stateStart = GetTime();
+		break;
+
+	case S_WaitBots:
+		if((int)game.worms()->size() < m_bots) break;
+		Execute(&stdoutCLI(), "startGame");
+		m_state = S_WaitGame;
+		m_stateStart = GetTime();
+		break;
+
+	case S_WaitGame:
+		if(game.state == Game::S_Playing)
+			startMeasuring();
+		else if(game.state < Game::S_Lobby)
+			finish("game was stopped before it started");
+		break;
+
+	case S_Measure:
+		if(game.state != Game::S_Playing) {
+			finish("game ended after " + itoa(m_tickTimes.size()) + " ticks, disable the game limits in the scenario");
+			break;
+		}
+		if(m_tickTimes.size() >= (size_t)m_ticks) {
+			finish("");
+			break;
+		}
+		// Exactly one simulation tick in this frame
+		timeCounter.advance(TimeDiff(Game::FixedFrameTime));
+		break;
+
+	case S_Done:
+		break;
+	}
+}
+
+void MatchBenchmark::startMeasuring() {
+	// Seed again, the setup itself (loading, spawning) uses a varying amount of random numbers
+	seedRandom();
+	m_tickTimes.clear();
+	m_tickTimes.reserve(m_ticks);
+	timeCounter.setManual(true);
+	m_measureStart = SDL_GetPerformanceCounter();
+	m_state = S_Measure;
+	notes << "benchmark: game started, measuring " << m_ticks << " ticks" << endl;
+}
+
+void MatchBenchmark::tickBegin() {
+	if(m_state != S_Measure) return;
+	m_tickStart = SDL_GetPerformanceCounter();
+}
+
+void MatchBenchmark::tickEnd() {
+	if(m_state != S_Measure) return;
+	m_tickTimes.push_back(SDL_GetPerformanceCounter() - m_tickStart);
+}
+
+void MatchBenchmark::finish(const std::string& error) {
+	const std::string res = report(error);
+	if(error != "")
+		errors << "benchmark: " << error << endl;
+	notes << "benchmark result: " << res << endl;
+
+	if(m_outputFile != "") {
+		std::ofstream f(m_outputFile.c_str());
+		if(f)
+			f << res << std::endl;
+		else
+			errors << "benchmark: cannot write " << m_outputFile << endl;
+	}
+
+	if(m_state == S_Measure)
+		timeCounter.setManual(false);
+	m_state = S_Done;
+	game.state = Game::S_Quit;
+}
+
+// In KB
+static Uint64 peakMemoryUsage() {
+#ifdef WIN32
+	// psapi is not linked, so load it dynamically like the StackWalker does
+	typedef BOOL (__stdcall *tGPMI)(HANDLE, PPROCESS_MEMORY_COUNTERS, DWORD);
+	HINSTANCE psapi = LoadLibraryA("psapi.dll");
+	if(psapi == NULL) return 0;
+	Uint64 res = 0;
+	tGPMI gpmi = (tGPMI) GetProcAddress(psapi, "GetProcessMemoryInfo");
+	PROCESS_MEMORY_COUNTERS pmc;
+	if(gpmi && gpmi(GetCurrentProcess(), &pmc, sizeof(pmc)))
+		res = pmc.PeakWorkingSetSize / 1024;
+	FreeLibrary(psapi);
+	return res;
+#else
+	struct rusage usage;
+	if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+	return (Uint64)usage.ru_maxrss / 1024; // bytes on Mac OS X
+#else
+	return (Uint64)usage.ru_maxrss;
+#endif
+#endif
+}
+
+static std::string jsonString(const std::string& s) {
+	std::string res = "\"";
+	for(std::string::const_iterator c = s.begin(); c != s.end(); ++c) {
+		if(*c == '"' || *c == '\\') res += '\\';
+		if((unsigned char)*c < 0x20) { res += ' '; continue; }
+		res += *c;
+	}
+	return res + "\"";
+}
+
+std::string MatchBenchmark::report(const std::string& error) const {
+	const double msPerTick = 1000.0 / double(SDL_GetPerformanceFrequency());
+	const size_t n = m_tickTimes.size();
+
+	std::vector<Uint64> sorted(m_tickTimes);
+	std::sort(sorted.begin(), sorted.end());
+	Uint64 total = 0;
+	for(size_t i = 0; i < n; ++i)
+		total += sorted[i];
+
+	double wallSecs = 0;
+	if(m_state == S_Measure)
+		wallSecs = (SDL_GetPerformanceCounter() - m_measureStart) * msPerTick / 1000.0;
+
+	std::string res = "{";
+	res += "\"scenario\": " + jsonString(m_name);
+	res += ", \"mod\": " + jsonString(gameSettings[FT_Mod].as<ModInfo>()->path);
+	res += ", \"map\": " + jsonString(gameSettings[FT_Map].as<LevelInfo>()->path);
+	res += ", \"bots\": " + itoa(m_bots);
+	res += ", \"seed\": " + itoa(m_seed);
+	res += ", \"ticks\": " + itoa(n);
+	res += ", \"complete\": " + std::string((error == "" && n >= (size_t)m_ticks) ? "true" : "false");
+	res += ", \"wallSeconds\": " + ftoa(float(wallSecs), 3);
+	res += ", \"ticksPerSecond\": " + ftoa(wallSecs > 0 ? float(n / wallSecs) : 0.0f, 1);
+	if(n > 0) {
+		res += ", \"tickMs\": {";
+		res += "\"avg\": " + ftoa(float(total * msPerTick / n), 4);
+		res += ", \"p50\": " + ftoa(float(sorted[n / 2] * msPerTick), 4);
+		res += ", \"p90\": " + ftoa(float(sorted[std::min(n - 1, n * 90 / 100)] * msPerTick), 4);
+		res += ", \"p99\": " + ftoa(float(sorted[std::min(n - 1, n * 99 / 100)] * msPerTick), 4);
+		res += ", \"max\": " + ftoa(float(sorted[n - 1] * msPerTick), 4);
+		res += "}";
+	}
+	res += ", \"peakMemoryKB\": " + to_string(peakMemoryUsage());
+	if(error != "")
+		res += ", \"error\": " + jsonString(error);
+	res += "}";
+	return res;
+}
@@ -0,0 +1,55 @@
+/*
+ *  RateLimiter.cpp
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#include "RateLimiter.h"
+#include "MathLib.h"
+
+
+// We look for full buckets at most this often
+static const Uint64 PruneInterval = 1000; // ms
+// ... or when there are more sources than this
+static const size_t PruneSourceCount = 4096;
+
+
+bool SourceRateLimiter::allow(const std::string& source, const AbsTime& now, float rate, float burst) {
+	if(now.milliseconds() >= m_lastPrune.milliseconds() + PruneInterval || m_buckets.size() > PruneSourceCount)
+		prune(now, rate, burst);
+
+	std::pair<Buckets::iterator, bool> ins = m_buckets.insert(Buckets::value_type(source, Bucket()));
+	Bucket& b = ins.first->second;
+	if(ins.second)
+		b.tokens = burst;
+	else if(now.milliseconds() > b.last.milliseconds())
+		b.tokens = MIN(burst, b.tokens + rate * (now.milliseconds() - b.last.milliseconds()) * 0.001f);
+	b.last = now;
+
+	if(b.tokens < 1.0f) {
+		m_dropped++;
+		return false;
+	}
+	b.tokens -= 1.0f;
+	m_allowed++;
+	return true;
+}
+
+void SourceRateLimiter::prune(const AbsTime& now, float rate, float burst) {
+	m_lastPrune = now;
+	for(Buckets::iterator it = m_buckets.begin(); it != m_buckets.end(); ) {
+		const Bucket& b = it->second;
+		const float age = (now.milliseconds() > b.last.milliseconds()) ? (now.milliseconds() - b.last.milliseconds()) * 0.001f : 0.0f;
+		// Full again, the same as a new one
+		if(b.tokens + rate * age >= burst)
+			m_buckets.erase(it++);
+		else
+			++it;
+	}
+	// Lots of different sources at once, most likely spoofed. Forgetting them all is cheap and
+	// only lets each of them do one more burst.
+	if(m_buckets.size() > PruneSourceCount)
+		m_buckets.clear();
+}
@@ -0,0 +1,226 @@
+/*
+ *  TaskScheduler.cpp
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#include <SDL_cpuinfo.h>
+#include <boost/bind.hpp>
+#include "TaskScheduler.h"
+#include "Debug.h"
+#include "AuxLib.h"
+#include "MathLib.h"
+#include "StringUtils.h"
+
+
+TaskScheduler* taskScheduler = NULL;
+
+// Sleeping workers wake up by themselves after this time, just in case we missed a signal somewhere
+static const Uint32 WorkerIdleTimeout = 10; // ms
+// wait() doesn't sleep longer than this at once; a finished group wakes it up earlier
+static const Uint32 WaitIdleTimeout = 1; // ms
+
+
+TaskScheduler::TaskScheduler(unsigned int workers) {
+	SDL_AtomicSet(&m_sleepers, 0);
+	SDL_AtomicSet(&m_queued, 0);
+	SDL_AtomicSet(&m_quit, 0);
+	SDL_AtomicSet(&m_stealSeed, 0);
+
+	notes << "TaskScheduler: creating " << workers << " workers ..." << endl;
+	for(unsigned int i = 0; i < workers; ++i) {
+		Worker* w = new Worker();
+		w->scheduler = this;
+		w->index = i;
+		w->nativeThreadId = 0;
+		m_workers.push_back(w);
+	}
+	// Start them only after m_workers is complete, they access it when stealing
+	for(size_t i = 0; i < m_workers.size(); ++i)
+		m_workers[i]->thread = SDL_CreateThread(workerThread, "TaskScheduler worker", m_workers[i]);
+}
+
+TaskScheduler::~TaskScheduler() {
+	if(SDL_AtomicGet(&m_queued) > 0)
+		warnings << "TaskScheduler: " << SDL_AtomicGet(&m_queued) << " tasks were never run" << endl;
+
+	{
+		Mutex::ScopedLock lock(m_sleepMutex);
+		SDL_AtomicSet(&m_quit, 1);
+		m_wakeup.broadcast();
+	}
+
+	for(size_t i = 0; i < m_workers.size(); ++i) {
+		SDL_WaitThread(m_workers[i]->thread, NULL);
+		delete m_workers[i];
+	}
+	m_workers.clear();
+}
+
+TaskScheduler::Worker* TaskScheduler::currentWorker() {
+	const ThreadId id = getCurrentThreadId();
+	for(size_t i = 0; i < m_workers.size(); ++i)
+		if(m_workers[i]->nativeThreadId == id)
+			return m_workers[i];
+	return NULL;
+}
+
+void TaskScheduler::wakeUp(bool all) {
+	if(!all && SDL_AtomicGet(&m_sleepers) == 0) return;
+	Mutex::ScopedLock lock(m_sleepMutex);
+	if(all)
+		m_wakeup.broadcast();
+	else
+		m_wakeup.signal();
+}
+
+void TaskScheduler::spawn(TaskGroup& group, const Function& fct, TaskPriority prio) {
+	Job job;
+	job.fct = fct;
+	job.group = &group;
+	SDL_AtomicIncRef(&group.pending);
+
+	Worker* self = currentWorker();
+	if(self) {
+		// Our own deque; we take it from the back again ourselves (it is hot in the cache),
+		// the others steal from the front
+		Mutex::ScopedLock lock(self->mutex);
+		self->jobs[prio].push_back(job);
+	}
+	else {
+		Mutex::ScopedLock lock(m_injectMutex);
+		m_inject[prio].push_back(job);
+	}
+
+	// Must be done after the push, see the sleep in workerThread()
+	SDL_AtomicIncRef(&m_queued);
+	wakeUp(false);
+}
+
+bool TaskScheduler::popJob(std::deque<Job>& q, Mutex& m, bool back, Job& job) {
+	Mutex::ScopedLock lock(m);
+	if(q.empty()) return false;
+	if(back) {
+		job = q.back();
+		q.pop_back();
+	}
+	else {
+		job = q.front();
+		q.pop_front();
+	}
+	SDL_AtomicAdd(&m_queued, -1);
+	return true;
+}
+
+bool TaskScheduler::findJob(Worker* self, Job& job) {
+	if(SDL_AtomicGet(&m_queued) <= 0) return false;
+
+	const size_t n = m_workers.size();
+	// Don't let all thieves start at the same victim
+	const size_t start = n ? ((size_t)SDL_AtomicAdd(&m_stealSeed, 1) % n) : 0;
+
+	for(int prio = 0; prio < TP_Count; ++prio) {
+		if(self && popJob(self->jobs[prio], self->mutex, true, job))
+			return true;
+		if(popJob(m_inject[prio], m_injectMutex, false, job))
+			return true;
+		for(size_t i = 0; i < n; ++i) {
+			Worker* victim = m_workers[(start + i) % n];
+			if(victim == self) continue;
+			if(popJob(victim->jobs[prio], victim->mutex, false, job))
+				return true;
+		}
+	}
+
+	return false;
+}
+
+void TaskScheduler::runJob(Job& job) {
+	job.fct();
+	if(SDL_AtomicDecRef(&job.group->pending))
+		// The group is done, wake up whoever waits for it
+		wakeUp(true);
+}
+
+int TaskScheduler::workerThread(void* param) {
+	Worker* self = (Worker*)param;
+	TaskScheduler* s = self->scheduler;
+	self->nativeThreadId = getCurrentThreadId();
+	setCurThreadName("TaskScheduler worker " + itoa(self->index));
+
+	while(!SDL_AtomicGet(&s->m_quit)) {
+		Job job;
+		if(s->findJob(self, job)) {
+			s->runJob(job);
+			continue;
+		}
+
+		Mutex::ScopedLock lock(s->m_sleepMutex);
+		// spawn() first increases m_queued and then checks m_sleepers, we do it the other way around.
+		// So either we see the new job here or spawn() sees us and signals (it needs m_sleepMutex for that).
+		SDL_AtomicIncRef(&s->m_sleepers);
+		if(SDL_AtomicGet(&s->m_queued) <= 0 && !SDL_AtomicGet(&s->m_quit))
+			s->m_wakeup.wait(s->m_sleepMutex, WorkerIdleTimeout);
+		SDL_AtomicAdd(&s->m_sleepers, -1);
+	}
+
+	return 0;
+}
+
+void TaskScheduler::wait(TaskGroup& group) {
+	Worker* self = currentWorker();
+
+	while(!group.done()) {
+		// Help instead of just waiting. This is also what makes waiting inside of a task work.
+		Job job;
+		if(findJob(self, job)) {
+			runJob(job);
+			continue;
+		}
+
+		// The remaining tasks of the group are running on other threads
+		Mutex::ScopedLock lock(m_sleepMutex);
+		if(!group.done() && SDL_AtomicGet(&m_queued) <= 0)
+			m_wakeup.wait(m_sleepMutex, WaitIdleTimeout);
+	}
+}
+
+void TaskScheduler::parallelFor(int begin, int end, int grain, const RangeFunction& fct, TaskPriority prio) {
+	if(end <= begin) return;
+	grain = MAX(grain, 1);
+
+	// Not worth it, and saves the overhead for tiny ranges
+	if(end - begin <= grain || m_workers.empty()) {
+		for(int b = begin; b < end; b += grain)
+			fct(b, MIN(b + grain, end));
+		return;
+	}
+
+	TaskGroup group;
+	for(int b = begin; b < end; b += grain)
+		spawn(group, boost::bind(fct, b, MIN(b + grain, end)), prio);
+	wait(group);
+}
+
+
+void InitTaskScheduler() {
+	unsigned int workers = 0;
+#ifndef SINGLETHREADED
+	// The calling thread also works while it waits, so leave one core for it
+	workers = (unsigned int)MAX(1, SDL_GetCPUCount() - 1);
+#endif
+	if(!taskScheduler)
+		taskScheduler = new TaskScheduler(workers);
+	else
+		errors << "TaskScheduler inited twice" << endl;
+}
+
+void UnInitTaskScheduler() {
+	if(taskScheduler) {
+		delete taskScheduler;
+		taskScheduler = NULL;
+	} else
+		errors << "TaskScheduler already uninited" << endl;
+}
@@ -9,6 +9,7 @@
 
 #include <SDL_thread.h>
 #include "ThreadPool.h"
+#include "TaskScheduler.h"
 #include "Debug.h"
 #include "AuxLib.h"
 #include "ReadWriteLock.h" // for ScopedLock
@@ -280,9 +281,11 @@ void InitThreadPool(unsigned int size) {
 		threadPool = new ThreadPool(size);
 	else
 		errors << "ThreadPool inited twice" << endl;
+	InitTaskScheduler();
 }
 
 void UnInitThreadPool() {
+	UnInitTaskScheduler();
 	if(threadPool) {
 		delete threadPool;
 		threadPool = NULL;
@@ -20,7 +20,9 @@
 #include <SDL.h>
 #include <string>
 #include <set>
+#include <vector>
 #include "ReadWriteLock.h"
+#include "Mutex.h"
 #include "SmartPointer.h"
 #include "LieroX.h" // for maprandom_t
 #include "GfxPrimitives.h" // for Rectangle<>
@@ -112,6 +114,10 @@ public:
 		savedPixelFlags = NULL;
 		savedMapCoords.clear();
 		
+		bSpawnIndexBuilt = false;
+		bSpawnSumsDirty = true;
+		spawnCellsX = spawnCellsY = 0;
+		
 		gusInit();
    	}
 
@@ -179,6 +185,26 @@ private:
 	};
 	std::set< SavedMapCoord_t > savedMapCoords;
 
+	// Spawn candidates, see FindSpot(). The map is divided into cells and for each cell we know
+	// how many good spawn points (IsGoodSpawnPoint()) it has. Cells are recounted lazily after
+	// UpdateArea() touched them.
+	enum { SPAWN_CELL = 16 };
+	Mutex		spawnIndexMutex;
+	bool		bSpawnIndexBuilt;
+	bool		bSpawnSumsDirty;
+	uint		spawnCellsX, spawnCellsY;
+	std::vector<Uint32> spawnCellGood;
+	std::vector<uchar> spawnCellDirty;
+	std::vector<Uint64> spawnCellSums; // Prefix sums of spawnCellGood, for picking a cell
+
+	uint		countGoodSpawnPoints(uint cell, std::vector<CVec>* points);
+	void		recountSpawnCells(const std::vector<uint>* cells, int first, int end);
+	void		updateSpawnIndex();
+	void		invalidateSpawnIndex();
+	void		invalidateSpawnCells(int x, int y, int w, int h);
+	// Needs the flags read lock
+	bool		pickSpawnPoints(size_t count, std::vector<CVec>& points);
+
 private:
 	// Update functions
 	void		UpdateMiniMap(bool force = false);
@@ -193,13 +193,13 @@ protected:
 	bool            bPrepared;
 
 public:
-	ATTR(CWorm, int32_t,	iTeam, 1, {serverside = true;})
-	ATTR(CWorm, std::string,	sName, 2, {serverside = false;})
+	ATTR(CWorm, int32_t,	iTeam, 1, {serverside = true; onUpdate = onScoreUpdate; })
+	ATTR(CWorm, std::string,	sName, 2, {serverside = false; onUpdate = onScoreUpdate; })
 
 	ATTR(CWorm, CGameSkin, cSkin, 3, {serverside = false;})
 
 	// Game
-	ATTR(CWorm, int32_t,	iLives, 5, { defaultValue = (int32_t)-2; })
+	ATTR(CWorm, int32_t,	iLives, 5, { defaultValue = (int32_t)-2; onUpdate = onScoreUpdate; })
 	ATTR(CWorm, bool,	bAlive, 6, {})
 
 	ATTR(CWorm, bool, bCanRespawnNow, 10, {serverside = true;})
@@ -306,11 +306,11 @@ protected:
 	EntityEffect cSparkles;
 
 	// Score
-	ATTR(CWorm,	int, iKills, 50, {serverside=true;})
-	ATTR(CWorm, int, iDeaths, 51, {serverside=true;})
-	ATTR(CWorm,	int, iSuicides, 52, {serverside=true;})
-	ATTR(CWorm,	int, iTeamkills, 53, {serverside=true;})
-	ATTR(CWorm,	float, fDamage, 54, {serverside=true;})
+	ATTR(CWorm,	int, iKills, 50, {serverside=true; onUpdate = onScoreUpdate;})
+	ATTR(CWorm, int, iDeaths, 51, {serverside=true; onUpdate = onScoreUpdate;})
+	ATTR(CWorm,	int, iSuicides, 52, {serverside=true; onUpdate = onScoreUpdate;})
+	ATTR(CWorm,	int, iTeamkills, 53, {serverside=true; onUpdate = onScoreUpdate;})
+	ATTR(CWorm,	float, fDamage, 54, {serverside=true; onUpdate = onScoreUpdate;})
 
 	ATTR(CWorm, int, iTotalWins, 55, {serverside=true;})
 	ATTR(CWorm, int, iTotalLosses, 56, {serverside=true;})
@@ -343,6 +343,7 @@ public:
 	void		updateCheckVariables();
 	bool		checkPacketNeeded();
 	void		writePacket(CBytestream *bs, bool fromServer, CServerConnection* receiver);
+	void		writePacketState(CBytestream *bs, const Version& versionOfReceiver) const; // like writePacket, without side effects
 	void		readPacket(CBytestream *bs);
 	void		net_updatePos(const CVec& newpos);
 	bool		skipPacket(CBytestream *bs);
@@ -369,6 +370,7 @@ public:
 	void		GetRandomWeapons();
 	void		CloneWeaponsFrom(CWorm* w);
 	static void	onWeaponsReadyUpdate(BaseObject* obj, const AttrDesc* attrDesc, ScriptVar_t old);
+	static void	onScoreUpdate(BaseObject* obj, const AttrDesc* attrDesc, ScriptVar_t old); // see ScoreRoster
 
 	//
 	// Graphics
@@ -16,6 +16,8 @@
 #include "EventQueue.h"
 #include "InputEvents.h"
 #include "DedicatedControl.h"
+#include "MatchBenchmark.h"
+#include "Demo.h"
 #include "CrashHandler.h"
 #include "Timer.h"
 #include "NewNetEngine.h"
@@ -43,6 +45,7 @@
 #include "Attr.h"
 #include "gusanos/luaapi/classes.h"
 #include "gusanos/network.h"
+#include "gusanos/simple_particle_system.h"
 #include "FlagInfo.h"
 #include "CWpnRest.h"
 #include "CChannel.h"
@@ -220,6 +223,11 @@ void Game::onSettingsUpdate(BaseObject* settingsObj, const AttrDesc* attrDesc, S
 		break;
 	case FT_GameMode:
 		if(gameWasPrepared && curValue != preparedMode) needReinit = true;
+		game.roster.orderChanged();
+		break;
+	case FT_Lives:
+	case FT_KillLimit:
+		game.roster.orderChanged(); // CGameMode::CompareWormsScore depends on them
 		break;
 	default: break; // nop
 	}
@@ -630,6 +638,11 @@ Result Game::prepareGameloop() {
 	
 	CrashHandler::recoverAfterCrash = tLXOptions->bRecoverAfterCrash && GetGameVersion().releasetype == Version::RT_NORMAL;
 	
+	if(cClient->getDemoRecorder())
+		cClient->getDemoRecorder()->gameInfo(
+			cClient->getGameLobby()[FT_Mod].as<ModInfo>()->path,
+			cClient->getGameLobby()[FT_Map].as<LevelInfo>()->path);
+
 	simulationTime = oldtime = GetTime();
 	gameWasPrepared = true;
 	return true;
@@ -655,6 +668,9 @@ struct GusSpeedScope {
 void Game::frame() {
 	SetCrashHandlerReturnPoint("main game loop");
 
+	if(MatchBenchmark::Get())
+		MatchBenchmark::Get()->Frame();
+
 	// Timing
 	tLX->currentTime = GetTime();
 	tLX->fDeltaTime = tLX->currentTime - oldtime;
@@ -679,7 +695,11 @@ void Game::frame() {
 	if(DbgSimulateSlow) SDL_Delay(700);
 
 	doVideoFrameInMainThread();
-	CapFPS();
+	const bool unthrottled =
+		(MatchBenchmark::Get() && MatchBenchmark::Get()->measuring()) ||
+		(cClient && cClient->getDemoPlayer() && cClient->getDemoPlayer()->unthrottled());
+	if(!unthrottled)
+		CapFPS();
 }
 
 
@@ -894,6 +914,9 @@ void Game::frameInner()
 			if(game.state == Game::S_Playing && !isGamePaused())
 				serverFrame++;
 
+			if(MatchBenchmark::Get())
+				MatchBenchmark::Get()->tickBegin();
+
 			// do lua/gus frames in all cases
 			{
 				GusSpeedScope speedScope;
@@ -904,6 +927,9 @@ void Game::frameInner()
 			if(isServer())
 				cServer->Frame();
 
+			if(MatchBenchmark::Get())
+				MatchBenchmark::Get()->tickEnd();
+
 			simulationTime += frameDt;
 		}
 		tLX->fDeltaTime = tLX->fRealDeltaTime = curDeltaTime;
@@ -1106,6 +1132,7 @@ void Game::onRemoveWorm(CWorm* w) {
 	std::map<int,CWorm*>::iterator i = m_worms.find(w->getID());
 	assert(i->second == w);
 	m_worms.erase(i);
+	roster.wormRemoved(w->getID());
 	gameStateUpdates->pushObjDeletion(w->thisRef);
 }
 
@@ -1158,12 +1185,14 @@ void Game::reset() {
 	
 	// Delete all objects
 	objects.clear();
+	simpleParticles.clear();
 }
 
 void Game::resetWorms() {
 	for_each_iterator(CWorm*, w, FullCopyIterator(worms()))
 		w->get()->deleteThis();
 	m_worms.clear();	
+	roster.clear();
 }
 
 CMap* Game::gameMap() { return m_gameMap.get(); }
@@ -1288,6 +1317,7 @@ CWorm* Game::createNewWorm(int wormId, bool local, const SmartPointer<profile_t>
 	w->setProfile(profile.get() ? profile : new profile_t());
 	w->thisRef.objId = wormId;
 	m_worms[wormId] = w;
+	roster.wormAdded(wormId);
 	gameStateUpdates->pushObjCreation(w->thisRef);
 
 	DeprecatedGUI::bHost_Update = true;
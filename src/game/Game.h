@@ -24,6 +24,7 @@
 #include "Attr.h"
 #include "util/Result.h"
 #include "util/List.h"
+#include "ScoreRoster.h"
 
 class CWormHumanInputHandler;
 class CWormInputHandler;
@@ -132,6 +133,7 @@ public:
 	
 	Grid objects;
 	SmartPointer<GameStateUpdates> gameStateUpdates;
+	ScoreRoster roster;
 
 	Iterator<CWorm*>::Ref worms();
 	Iterator<CWorm*>::Ref localWorms();
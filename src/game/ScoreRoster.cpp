@@ -0,0 +1,108 @@
+/*
+ *  ScoreRoster.cpp
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#include <algorithm>
+#include "ScoreRoster.h"
+#include "game/Game.h"
+#include "game/CWorm.h"
+#include "CGameMode.h"
+#include "game/GameMode.h"
+
+
+bool ScoreRoster::better(CWorm* w1, CWorm* w2) {
+	// The server settings on a server (also dedicated, without a client), else the lobby of the client
+	CGameMode* mode = game.gameMode();
+	if(!mode) mode = GameMode(GM_DEATHMATCH);
+	return mode->CompareWormsScore(w1, w2) > 0;
+}
+
+static bool betterId(int id1, int id2) {
+	CWorm* w1 = game.wormById(id1, false);
+	CWorm* w2 = game.wormById(id2, false);
+	// Worms we don't know (anymore) go to the end
+	if(!w1) return false;
+	if(!w2) return true;
+	return ScoreRoster::better(w1, w2);
+}
+
+void ScoreRoster::clear() {
+	m_order.clear();
+	m_pendingIds.clear();
+	std::fill(m_pending.begin(), m_pending.end(), false);
+	m_fullResort = false;
+	++m_changes;
+}
+
+void ScoreRoster::wormAdded(int wormId) {
+	if(std::find(m_order.begin(), m_order.end(), wormId) == m_order.end())
+		m_order.push_back(wormId);
+	wormChanged(wormId);
+}
+
+void ScoreRoster::wormRemoved(int wormId) {
+	std::vector<int>::iterator i = std::find(m_order.begin(), m_order.end(), wormId);
+	if(i != m_order.end())
+		m_order.erase(i);
+	if(isValidId(wormId))
+		++m_versions[wormId];
+	++m_changes;
+}
+
+void ScoreRoster::wormChanged(int wormId) {
+	++m_changes;
+	if(!isValidId(wormId)) {
+		m_fullResort = true;
+		return;
+	}
+	++m_versions[wormId];
+	if(!m_pending[wormId]) {
+		m_pending[wormId] = true;
+		m_pendingIds.push_back(wormId);
+	}
+}
+
+// Moves the worm at pos up or down until it is at its place. The others are in order.
+void ScoreRoster::reposition(size_t pos) {
+	while(pos > 0 && betterId(m_order[pos], m_order[pos - 1])) {
+		std::swap(m_order[pos], m_order[pos - 1]);
+		--pos;
+	}
+	while(pos + 1 < m_order.size() && betterId(m_order[pos + 1], m_order[pos])) {
+		std::swap(m_order[pos], m_order[pos + 1]);
+		++pos;
+	}
+}
+
+const std::vector<int>& ScoreRoster::ranked() {
+	if(m_fullResort) {
+		std::stable_sort(m_order.begin(), m_order.end(), betterId);
+		m_fullResort = false;
+	}
+	else {
+		for(size_t i = 0; i < m_pendingIds.size(); ++i) {
+			std::vector<int>::iterator it = std::find(m_order.begin(), m_order.end(), m_pendingIds[i]);
+			if(it != m_order.end())
+				reposition(it - m_order.begin());
+		}
+	}
+
+	for(size_t i = 0; i < m_pendingIds.size(); ++i)
+		m_pending[m_pendingIds[i]] = false;
+	m_pendingIds.clear();
+
+	// Some game modes rank by things which are no worm attributes (tag time,
+	// dirt count, race goals), so we don't get events for them. One pass over
+	// neighbours catches that; it's n-1 comparisons if nothing changed.
+	for(size_t i = 1; i < m_order.size(); ++i)
+		if(betterId(m_order[i], m_order[i - 1])) {
+			reposition(i);
+			++m_changes;
+		}
+
+	return m_order;
+}
@@ -0,0 +1,57 @@
+/*
+ *  ScoreRoster.h
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#ifndef __OLX_SCOREROSTER_H__
+#define __OLX_SCOREROSTER_H__
+
+#include <vector>
+#include <SDL_stdinc.h>
+
+class CWorm;
+
+/*
+ The worms ranked by score, kept up to date from the worm attribute updates
+ (lives, kills, damage, team, name, ready state) and join/leave.
+ Only the worms which changed are moved in the ranking. Users like the
+ scoreboard keep the row versions they have shown and update only the rows
+ whose worm changed (rowVersion) or which show another worm now.
+ */
+class ScoreRoster {
+public:
+	ScoreRoster() : m_versions(MAX_IDS, 0), m_pending(MAX_IDS, false), m_fullResort(false), m_changes(0) {}
+
+	void clear();
+	void wormAdded(int wormId);
+	void wormRemoved(int wormId);
+	void wormChanged(int wormId);
+	// Something which affects the order of all worms, e.g. the game mode
+	void orderChanged() { m_fullResort = true; ++m_changes; }
+
+	// Worm IDs, best first
+	const std::vector<int>& ranked();
+	// Changes whenever the content of the worm's row changes
+	Uint32 rowVersion(int wormId) const { return isValidId(wormId) ? m_versions[wormId] : 0; }
+	// Changes with any change of the roster
+	Uint32 changes() const { return m_changes; }
+
+	static bool better(CWorm* w1, CWorm* w2);
+
+private:
+	enum { MAX_IDS = 256 };
+	static bool isValidId(int wormId) { return wormId >= 0 && wormId < MAX_IDS; }
+	void reposition(size_t pos);
+
+	std::vector<int> m_order;
+	std::vector<Uint32> m_versions;
+	std::vector<bool> m_pending; // Changed since the last ranked()
+	std::vector<int> m_pendingIds;
+	bool m_fullResort;
+	Uint32 m_changes;
+};
+
+#endif
@@ -8,6 +8,7 @@
  */
 
 #include "ServerList.h"
+#include "ServerListProber.h"
 #include "TaskManager.h"
 #include "CBytestream.h"
 #include "Consts.h"
@@ -27,11 +28,6 @@
 // declare them only locally here as nobody really should use them explicitly
 std::string Utf8String(const std::string &OldLxString);
 
-// Maximum number of pings/queries before we ignore the server
-static const int	MaxPings = 4;
-static const int	MaxQueries = MAX_QUERIES;
-
-
 // tSocket is an array and just has the sockets copied from tMenu->tSocket.
 // Because there were some bugs where tMenu->tSocket was changed but our tSocket
 // was not updated, I wrapped this to just use tMenu->tSocket.
@@ -253,6 +249,7 @@ void ServerList::clearAuto()
 // Shutdown the server list
 void ServerList::shutdown()
 {
+	m_prober.reset();
 	SvrList::Writer l(psServerList);
 	l.get().clear();
 }
@@ -359,38 +356,6 @@ void ServerList::pingLAN()
 }
 
 
-///////////////////
-// Ping a server
-void ServerList::pingServer(server_t::Ptr svr)
-{
-	// If not available, probably the network is not connected right now.
-	if(!IsNetAddrAvailable(svr->sAddress)) return;
-	
-	if( svr->ports.size() == 0 )
-	{
-		errors << "svr->ports.size() == 0 at " << FILELINE << endl;
-		return;
-	}
-	
-	NetworkAddr addr = svr->sAddress;
-	//hints << "Pinging server " << tmp << " real addr " << svr->szAddress << " name " << svr->szName << endl;
-	svr->lastPingedPort++;
-	if( svr->lastPingedPort >= (int)svr->ports.size() || svr->lastPingedPort < 0 )
-		svr->lastPingedPort = 0;
-	SetNetAddrPort(addr, svr->ports[svr->lastPingedPort].first);
-	
-	tSocket[SCK_NET]->setRemoteAddress(addr);
-	
-	CBytestream bs;
-	bs.writeInt(-1,4);
-	bs.writeString("lx::ping");
-	bs.Send(tSocket[SCK_NET]);
-	
-	svr->bProcessing = true;
-	svr->nPings++;
-	svr->fLastPing = tLX->currentTime;
-}
-
 ///////////////////
 // Send Wants To Join message
 void ServerList::wantsToJoin(const std::string& Nick, server_t::Ptr svr)
@@ -467,25 +432,6 @@ void ServerList::getServerInfo(server_t::Ptr svr)
 	bs.Send(tSocket[SCK_NET]);
 }
 
-///////////////////
-// Query a server
-void ServerList::queryServer(server_t::Ptr svr)
-{
-	tSocket[SCK_NET]->setRemoteAddress(svr->sAddress);
-	
-	CBytestream bs;
-	bs.writeInt(-1,4);
-	bs.writeString("lx::query");
-    bs.writeByte(svr->nQueries);
-	bs.Send(tSocket[SCK_NET]);
-    svr->fQueryTimes[svr->nQueries] = tLX->currentTime;
-	
-	svr->bProcessing = true;
-	svr->nQueries++;
-	svr->fLastQuery = tLX->currentTime;
-}
-
-
 ///////////////////
 // Refresh the server list (Internet menu)
 void ServerList::refreshList()
@@ -525,6 +471,8 @@ void ServerList::refreshServer(server_t::Ptr s, bool updategui)
 	s->nPing = s->bBehindNat ? -2 : -3; // unknown yet
 	s->bAddrReady = false;
 	s->lastPingedPort = 0;
+	s->bProbeQueued = false;
+	s->probeGeneration++; // replies to probes which are still in flight are not for us anymore
 	
 	
 	if(!StringToNetAddr(s->szAddress, s->sAddress)) {
@@ -813,6 +761,14 @@ bool ServerList::process()
 		update = true;
 	}
 	
+	// Results of the prober thread
+	if(m_prober.get()) {
+		ServerProbeResult r;
+		while(m_prober->popResult(r))
+			if(applyProbeResult(r))
+				update = true;
+	}
+	
 	bool repaint = false;
 	
 	
@@ -846,37 +802,16 @@ bool ServerList::process()
 			}
 		}
 		
-		// Need a pingin'?
-		if(!s->bgotPong) {
-			if(tLX->currentTime - s->fLastPing > (float)PingWait / 1000.0f) {
-				
-				if(s->nPings >= MaxPings) {
-					s->bIgnore = true;
-					
-					update = true;
-				}
-				else  {
-					// Ping the server
-					pingServer(s);
-					repaint = true;
-				}
-			}
-		}
-		
-		// Need a querying?
-		if(s->bgotPong && !s->bgotQuery) {
-			if(tLX->currentTime - s->fLastQuery > (float)QueryWait / 1000.0f) {
-				
-				if(s->nQueries >= MaxQueries) {
-					s->bIgnore = true;
-					
-					update = true;
-				}
-				else  {
-					// Query the server
-					queryServer(s);
-					repaint = true;
-				}
+		// Need a pingin' or querying?
+		// The prober thread does both, including the retries, and gives us the result in applyProbeResult()
+		if(!s->bgotQuery && !s->bProbeQueued && IsNetAddrAvailable(s->sAddress)) {
+			if(!m_prober.get())
+				m_prober = ServerListProber::Ptr(new ServerListProber());
+			if(m_prober->probe(s)) {
+				s->bProbeQueued = true;
+				s->bProcessing = true;
+				s->fLastPing = tLX->currentTime;
+				repaint = true;
 			}
 		}
 		
@@ -896,6 +831,52 @@ bool ServerList::process()
 }
 
 
+///////////////////
+// Apply a ping/query result from the prober thread
+// Returns true if we should update the list
+bool ServerList::applyProbeResult(const ServerProbeResult& r)
+{
+	server_t::Ptr svr = r.server;
+	if(!svr.get() || !svr->bProbeQueued || r.generation != svr->probeGeneration)
+		return false; // Refreshed or removed in the meantime
+	
+	switch(r.type) {
+		case ServerProbeResult::PR_Pong:
+			// Same as the lx::pong handling in parsePacket
+			svr->bgotPong = true;
+			svr->nPings++;
+			svr->nQueries = 0;
+			svr->bBehindNat = false;
+			svr->lastPingedPort = 0;
+			SetNetAddrPort(svr->sAddress, GetNetAddrPort(r.addr));
+			NetAddrToString(svr->sAddress, svr->szAddress);
+			svr->ports.clear();
+			svr->ports.push_back( std::make_pair( (int)GetNetAddrPort(r.addr), -1 ) );
+			return false;
+			
+		case ServerProbeResult::PR_QueryReturn: {
+			svr->bProbeQueued = false;
+			svr->nQueries++;
+			CBytestream bs(r.data);
+			bs.readInt(4);
+			bs.readString(); // lx::queryreturn
+			svr->bgotQuery = true;
+			svr->bBehindNat = false;
+			parseQuery(svr, &bs, r.ping);
+			return true;
+		}
+			
+		case ServerProbeResult::PR_Failed:
+			svr->bProbeQueued = false;
+			svr->bIgnore = true;
+			svr->bProcessing = false;
+			return true;
+	}
+	
+	return false;
+}
+
+
 ///////////////////
 // Parse a packet
 // Returns true if we should update the list
@@ -1033,7 +1014,7 @@ server_t::Ptr ServerList::findServer(const NetworkAddr& addr, const std::string
 
 ///////////////////
 // Parse the server query return packet
-void ServerList::parseQuery(server_t::Ptr svr, CBytestream *bs)
+void ServerList::parseQuery(server_t::Ptr svr, CBytestream *bs, int ping)
 {
 	// TODO: move this net protocol stuff out here
 	
@@ -1054,7 +1035,10 @@ void ServerList::parseQuery(server_t::Ptr svr, CBytestream *bs)
     if(num < 0 || num >= MAX_QUERIES-1)
         num=0;
 	
-	svr->nPing = (int)( (tLX->currentTime - svr->fQueryTimes[num]).milliseconds() );
+	if(ping >= 0)
+		svr->nPing = ping; // Measured by the prober thread
+	else
+		svr->nPing = (int)( (tLX->currentTime - svr->fQueryTimes[num]).milliseconds() );
 	
 	if(svr->nPing < 0)
 		svr->nPing = 999;
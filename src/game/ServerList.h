@@ -21,7 +21,8 @@
 
 enum {
 	SVRLIST_TIMEOUT =  7000, 
-	MAX_QUERIES = 3
+	MAX_QUERIES = 3,
+	MAX_PINGS = 4
 };
 
 
@@ -49,10 +50,14 @@ struct server_t {
 		bBehindNat = false;
 		lastPingedPort = 0;
 		isLan = isFavourite = false;
+		bProbeQueued = false;
+		probeGeneration = 0;
 	}
 	
 	bool	bIgnore;
 	bool	bProcessing;
+	bool	bProbeQueued; // Handed to the ServerListProber, waiting for its result
+	unsigned int probeGeneration; // Increased on every refresh, results of older probes are ignored
     bool    bManual;
 	int		nPings;
 	int		nQueries;
@@ -155,6 +160,8 @@ struct UdpMasterserverInfo {
 
 typedef ThreadVar< std::list<server_t::Ptr> > SvrList;
 namespace DeprecatedGUI { class CListview; }
+class ServerListProber;
+struct ServerProbeResult;
 
 // Server list
 class ServerList  {
@@ -173,12 +180,14 @@ private:
 
 	SvrList psServerList;
 	static Ptr m_instance;
+	boost::shared_ptr<ServerListProber> m_prober; // Created on first use
 
 	void saveList(const std::string& szFilename, SvrListFilterType filterType, SvrListSettingsFilter::Ptr settingsFilter = SvrListSettingsFilter::Ptr((SvrListSettingsFilter*)NULL));
 	void loadList(const std::string& szFilename, SvrListFilterType filterType);
 	void mergeWithNewInfo(server_t::Ptr found, const std::string& address, const std::string & name, int udpMasterserverIndex);
 	bool parsePacket(CBytestream *bs, const SmartPointer<NetworkSocket>& sock, bool isLan);
-	void parseQuery(server_t::Ptr svr, CBytestream *bs);
+	void parseQuery(server_t::Ptr svr, CBytestream *bs, int ping = -1);
+	bool applyProbeResult(const ServerProbeResult& r);
 	std::string parseUdpServerlist(CBytestream *bs, int UdpMasterserverIndex);
 	void HTTPParseList(CHttp &http);
 public:
@@ -198,9 +207,7 @@ public:
 	server_t::Ptr addServer(const std::string& address, bool bManual, const std::string & name = "Untitled", int udpMasterserverIndex = -1);
 	void addFavourite(const std::string& szName, const std::string& szAddress);
 	server_t::Ptr findServerStr(const std::string& szAddress, const std::string & name = "");
-	void pingServer(server_t::Ptr svr);
 	void wantsToJoin(const std::string& Nick, server_t::Ptr svr);
-	void queryServer(server_t::Ptr svr);
 	void getServerInfo(server_t::Ptr svr);
 	UdpMasterserverInfo	getUdpMasterserverForServer(const std::string& szAddress);
 
@@ -0,0 +1,260 @@
+/*
+ *  ServerListProber.cpp
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#include <boost/bind.hpp>
+#include "ServerListProber.h"
+#include "ThreadPool.h"
+#include "CBytestream.h"
+#include "Options.h"
+#include "Timer.h"
+#include "Debug.h"
+#include "MathLib.h"
+
+
+// Delay before the first retry, it doubles with each further try
+static const int ProbeRetryBase = 300; // ms
+// We never sleep longer than this in the socket wait, so new requests get started quickly
+static const int ProbeMaxWait = 10; // ms
+
+
+ServerListProber::ServerListProber() : m_requests(1024), m_results(1024), m_quit(false), m_thread(NULL)
+{
+	if(!m_socket.OpenUnreliable(0)) {
+		errors << "ServerListProber: cannot open socket, servers cannot be pinged" << endl;
+		return;
+	}
+
+	m_thread = threadPool->start(boost::bind(&ServerListProber::run, this), "server list prober");
+}
+
+ServerListProber::~ServerListProber()
+{
+	m_quit = true;
+	if(m_thread) {
+		threadPool->wait(m_thread, NULL);
+		m_thread = NULL;
+	}
+	if(m_socket.isOpen())
+		m_socket.Close();
+}
+
+///////////////////
+// Hand a server to the prober
+bool ServerListProber::probe(const server_t::Ptr& svr)
+{
+	if(!m_thread) return false;
+
+	// Copy everything we need, the prober thread must not touch the server_t
+	Request req;
+	req.server = svr;
+	req.generation = svr->probeGeneration;
+	req.addr = svr->sAddress;
+	for(size_t i = 0; i < svr->ports.size(); ++i)
+		req.ports.push_back(svr->ports[i].first);
+	if(req.ports.empty())
+		req.ports.push_back(GetNetAddrPort(svr->sAddress));
+
+	return m_requests.push(req);
+}
+
+TimeDiff ServerListProber::retryDelay(int attempts) const
+{
+	return TimeDiff((Uint64)(ProbeRetryBase << MIN(MAX(attempts - 1, 0), 4)));
+}
+
+void ServerListProber::pushResult(const ServerProbeResult& r)
+{
+	if(m_pendingResults.empty() && m_results.push(r))
+		return;
+	m_pendingResults.push_back(r);
+}
+
+void ServerListProber::sendPing(Probe& p, const AbsTime& now)
+{
+	// Cycle through the known ports, the server may listen on any of them
+	p.portIndex = (p.attempts == 0) ? 0 : (p.portIndex + 1) % p.req.ports.size();
+	p.curAddr = p.req.addr;
+	SetNetAddrPort(p.curAddr, p.req.ports[p.portIndex]);
+
+	m_socket.setRemoteAddress(p.curAddr);
+	CBytestream bs;
+	bs.writeInt(-1, 4);
+	bs.writeString("lx::ping");
+	bs.Send(&m_socket);
+
+	p.attempts++;
+	p.nextSend = now + retryDelay(p.attempts);
+}
+
+void ServerListProber::sendQuery(Probe& p, const AbsTime& now)
+{
+	m_socket.setRemoteAddress(p.curAddr);
+	CBytestream bs;
+	bs.writeInt(-1, 4);
+	bs.writeString("lx::query");
+	bs.writeByte(p.attempts);
+	bs.Send(&m_socket);
+
+	p.queryTimes[p.attempts] = now;
+	p.attempts++;
+	p.nextSend = now + retryDelay(p.attempts);
+}
+
+void ServerListProber::startProbe(const Request& req, const AbsTime& now)
+{
+	// A refresh while it is still in flight just restarts it
+	for(std::list<Probe>::iterator it = m_probes.begin(); it != m_probes.end(); ++it)
+		if(it->req.server == req.server) {
+			m_probes.erase(it);
+			break;
+		}
+
+	m_probes.push_back(Probe());
+	Probe& p = m_probes.back();
+	p.req = req;
+	p.gotPong = false;
+	p.attempts = 0;
+	p.portIndex = 0;
+	sendPing(p, now);
+}
+
+///////////////////
+// Handle a packet received on the prober socket
+void ServerListProber::handlePacket(CBytestream& bs, const NetworkAddr& from, const AbsTime& received)
+{
+	if(bs.readInt(4) != -1)
+		return;
+	const std::string cmd = bs.readString();
+
+	for(std::list<Probe>::iterator it = m_probes.begin(); it != m_probes.end(); ++it) {
+		Probe& p = *it;
+
+		if(cmd == "lx::pong" && !p.gotPong) {
+			// Any of the known ports of the server may answer
+			NetworkAddr addr = p.req.addr;
+			bool found = false;
+			for(size_t i = 0; i < p.req.ports.size() && !found; ++i) {
+				SetNetAddrPort(addr, p.req.ports[i]);
+				found = AreNetAddrEqual(addr, from);
+			}
+			if(!found) continue;
+
+			ServerProbeResult r;
+			r.type = ServerProbeResult::PR_Pong;
+			r.server = p.req.server;
+			r.generation = p.req.generation;
+			r.addr = from;
+			pushResult(r);
+
+			// Query it right away
+			p.gotPong = true;
+			p.attempts = 0;
+			p.curAddr = from;
+			sendQuery(p, received);
+			return;
+		}
+
+		if(cmd == "lx::queryreturn" && p.gotPong && AreNetAddrEqual(p.curAddr, from)) {
+			ServerProbeResult r;
+			r.type = ServerProbeResult::PR_QueryReturn;
+			r.server = p.req.server;
+			r.generation = p.req.generation;
+			r.addr = from;
+			r.data = bs.data();
+
+			// The server sends back the number of our query, so we know which one was answered
+			bs.readString(); // name
+			bs.Skip(3); // players, max players, state
+			int num = bs.readByte();
+			if(num < 0 || num >= p.attempts || num > MAX_QUERIES)
+				num = p.attempts - 1;
+			r.ping = (int)(received - p.queryTimes[num]).milliseconds();
+
+			pushResult(r);
+			m_probes.erase(it);
+			return;
+		}
+	}
+}
+
+///////////////////
+// Retry or give up the probes which didn't get an answer in time
+void ServerListProber::checkTimeouts(const AbsTime& now)
+{
+	for(std::list<Probe>::iterator it = m_probes.begin(); it != m_probes.end(); ) {
+		Probe& p = *it;
+		if(now < p.nextSend) { ++it; continue; }
+
+		if(p.attempts < (p.gotPong ? (int)MAX_QUERIES : (int)MAX_PINGS)) {
+			if(p.gotPong)
+				sendQuery(p, now);
+			else
+				sendPing(p, now);
+			++it;
+			continue;
+		}
+
+		ServerProbeResult r;
+		r.type = ServerProbeResult::PR_Failed;
+		r.server = p.req.server;
+		r.generation = p.req.generation;
+		r.addr = p.curAddr;
+		pushResult(r);
+		it = m_probes.erase(it);
+	}
+}
+
+///////////////////
+// The prober thread
+Result ServerListProber::run()
+{
+	CBytestream bs;
+
+	while(!m_quit) {
+		AbsTime now = GetTime();
+
+		// Hand over the results the main thread had no room for yet
+		while(!m_pendingResults.empty() && m_results.push(m_pendingResults.front()))
+			m_pendingResults.pop_front();
+
+		// New requests
+		Request req;
+		while(m_requests.pop(req))
+			m_waiting.push_back(req);
+
+		// Start as many as allowed
+		const size_t maxInFlight = (size_t)MAX(1, tLXOptions ? tLXOptions->iServerListProbes : 32);
+		while(m_probes.size() < maxInFlight && !m_waiting.empty()) {
+			startProbe(m_waiting.front(), now);
+			m_waiting.pop_front();
+		}
+
+		// Wait for replies, but not past the next retry
+		int wait = ProbeMaxWait;
+		for(std::list<Probe>::const_iterator it = m_probes.begin(); it != m_probes.end(); ++it) {
+			if(it->nextSend <= now) { wait = 0; break; }
+			wait = MIN(wait, (int)(it->nextSend - now).milliseconds());
+		}
+		if(wait > 0) {
+			if(m_probes.empty())
+				SDL_Delay(wait);
+			else
+				m_socket.WaitForSocketRead(wait); // We are on our own thread, blocking is what we want here
+		}
+
+		// Timestamp every reply as soon as we read it
+		while(bs.Read(&m_socket)) {
+			const AbsTime received = GetTime();
+			handlePacket(bs, m_socket.remoteAddress(), received);
+		}
+
+		checkTimeouts(GetTime());
+	}
+
+	return true;
+}
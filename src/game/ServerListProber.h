@@ -0,0 +1,97 @@
+/*
+ *  ServerListProber.h
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#ifndef __OLX_SERVERLISTPROBER_H__
+#define __OLX_SERVERLISTPROBER_H__
+
+#include <string>
+#include <list>
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include "ServerList.h"
+#include "Networking.h"
+#include "LockFreeQueue.h"
+#include "olx-types.h"
+#include "util/Result.h"
+
+struct ThreadPoolItem;
+class CBytestream;
+
+// Outcome of pinging and querying one server
+struct ServerProbeResult {
+	enum Type { PR_Pong, PR_QueryReturn, PR_Failed };
+	ServerProbeResult() : type(PR_Failed), generation(0), ping(-1) {}
+	Type type;
+	server_t::Ptr server;
+	unsigned int generation; // server_t::probeGeneration when it was requested
+	NetworkAddr addr; // Address which replied
+	int ping; // In milliseconds, only for PR_QueryReturn
+	std::string data; // The whole lx::queryreturn packet
+};
+
+/*
+ Pings and queries the servers of the server list on its own socket and thread.
+
+ Many probes are kept in flight at the same time (Network.ServerListProbes), lost packets
+ are retried with an exponential backoff and the replies are timestamped right when they
+ are received, so the ping doesn't depend on the menu frame rate.
+ The results are handed back to the main thread through a lock-free queue, see ServerList::process().
+ */
+class ServerListProber : DontCopyTag {
+public:
+	typedef boost::shared_ptr<ServerListProber> Ptr;
+
+private:
+	struct Request {
+		server_t::Ptr server;
+		unsigned int generation;
+		NetworkAddr addr; // Does not include port
+		std::vector<int> ports; // Ports to try, like server_t::ports
+	};
+
+	struct Probe {
+		Request req;
+		bool gotPong;
+		int attempts; // Pings or queries sent in the current stage
+		size_t portIndex;
+		NetworkAddr curAddr; // Address including the port we are talking to
+		AbsTime nextSend;
+		AbsTime queryTimes[MAX_QUERIES + 1];
+	};
+
+	NetworkSocket m_socket;
+	SpscQueue<Request> m_requests; // main thread -> prober thread
+	SpscQueue<ServerProbeResult> m_results; // prober thread -> main thread
+	volatile bool m_quit;
+	ThreadPoolItem* m_thread;
+
+	// Only accessed by the prober thread
+	std::list<Request> m_waiting; // Requests which don't fit into the in-flight limit yet
+	std::list<Probe> m_probes; // In flight
+	std::list<ServerProbeResult> m_pendingResults; // Results which didn't fit into m_results
+
+	Result run();
+	void startProbe(const Request& req, const AbsTime& now);
+	void sendPing(Probe& p, const AbsTime& now);
+	void sendQuery(Probe& p, const AbsTime& now);
+	void handlePacket(CBytestream& bs, const NetworkAddr& from, const AbsTime& received);
+	void checkTimeouts(const AbsTime& now);
+	void pushResult(const ServerProbeResult& r);
+	TimeDiff retryDelay(int attempts) const;
+
+public:
+	ServerListProber();
+	~ServerListProber();
+
+	// Main thread only. Returns false if the request queue is full, try again later then.
+	bool probe(const server_t::Ptr& svr);
+	// Main thread only
+	bool popResult(ServerProbeResult& r) { return m_results.pop(r); }
+};
+
+#endif
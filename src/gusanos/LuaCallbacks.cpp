@@ -87,8 +87,11 @@ void LuaCallbacks::bind(const LuaContext& ctx, std::string callback, LuaReferenc
 	CB(gotoLobby);
 	CB(wormPrepare);
 
-	if(idx != -1)
+	if(idx != -1) {
 		callbacks[idx].push_back(LuaCallbackRef(ctx, ref));
+		if(names[idx].empty())
+			names[idx] = callback;
+	}
 	else
 		warnings << "LuaCallbacks::bind: '" << callback << "' unknown" << endl;
 }
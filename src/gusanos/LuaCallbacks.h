@@ -10,6 +10,7 @@
 #include <boost/function.hpp>
 #include "gusanos/luaapi/types.h"
 #include "gusanos/luaapi/context.h"
+#include "gusanos/luaapi/profiler.h"
 #include "util/macros.h"
 
 #define C_LocalPlayer_ActionCount 8
@@ -27,13 +28,15 @@ struct LuaCallbackProxy {
 	int nreturns;
 	typedef boost::function<void(LuaContext&,int)> PostHandler;
 	PostHandler postHandler;
-	LuaCallbackProxy(LuaCallbackList& callbacks_, int nreturns_, PostHandler postHandler_)
-		: callbacks(callbacks_), nreturns(nreturns_), postHandler(postHandler_) {}
+	const char* name; // For LuaProfiler
+	LuaCallbackProxy(LuaCallbackList& callbacks_, int nreturns_, PostHandler postHandler_, const char* name_ = "other")
+		: callbacks(callbacks_), nreturns(nreturns_), postHandler(postHandler_), name(name_) {}
 
 	LuaCallbackProxy& root() { return *this; }
 
 	template<typename T>
 	static void _Exec(T& base) {
+		LuaProfiler::Category category(base.root().name);
 		foreach(f, base.root().callbacks) {
 			if(!*f) continue;
 			base.root()._pushFunc(*f);
@@ -113,6 +116,8 @@ struct LuaCallbacks
 	};
 	void bind(const LuaContext& ctx, std::string callback, LuaReference ref);
 	LuaCallbackList callbacks[max];
+	std::string names[max]; // Name used in bind, set once
+	const char* name(Type t) const { return names[t].empty() ? "other" : names[t].c_str(); }
 	void cleanup();
 };
 
@@ -122,7 +127,7 @@ struct LuaCallbackProxyEnv {
 	LuaCallbacks::Type t;
 	LuaCallbackProxyEnv(LuaCallbacks::Type t_) : t(t_) {}
 	LuaCallbackProxy call(int nreturns = 0, LuaCallbackProxy::PostHandler postHandler = NULL) {
-		return LuaCallbackProxy(luaCallbacks.callbacks[t], nreturns, postHandler);
+		return LuaCallbackProxy(luaCallbacks.callbacks[t], nreturns, postHandler, luaCallbacks.name(t));
 	}
 };
 
@@ -16,6 +16,7 @@
 #include "object_grid.h"
 
 #include "omfgscript/omfg_script.h"
+#include "parsed_script.h"
 #include "game_actions.h"
 #include "FindFile.h"
 
@@ -31,7 +32,7 @@ using namespace std;
 ResourceList<ExpType> expTypeList;
 
 ExpType::ExpType()
-: wupixels(0), invisible(false)
+: wupixels(0), invisible(false), m_parsed(NULL)
 {
 	timeout = 0;
 	timeoutVariation = 0;
@@ -55,6 +56,7 @@ ExpType::ExpType()
 
 ExpType::~ExpType()
 {
+	delete m_parsed;
 	delete creation;
 #ifndef DEDICATED_ONLY
 	delete distortion;
@@ -75,15 +77,14 @@ enum type
 };
 }
 
-bool ExpType::load(std::string const& filename)
+bool ExpType::parse(std::string const& filename)
 {
-	std::ifstream fileStream;
-	OpenGameFileR(fileStream, filename, std::ios::binary | std::ios::in);
-
-	if (!fileStream )
+	delete m_parsed;
+	m_parsed = new ParsedScript(filename);
+	if(!m_parsed->parser.get())
 		return false;
 	
-	OmfgScript::Parser parser(fileStream, gameActions, filename);
+	OmfgScript::Parser& parser = *m_parsed->parser;
 	
 	parser.addEvent("creation", GameEventID::Creation, OmfgScript::ActionParamFlags::Object);
 	
@@ -92,13 +93,22 @@ bool ExpType::load(std::string const& filename)
 		("detect_owner")
 		("layers")
 	;
-		
-	if(!parser.run())
-	{
-		if(parser.incomplete())
-			parser.error("Trailing garbage");
+	
+	return m_parsed->run();
+}
+
+bool ExpType::load(std::string const& filename)
+{
+	// Already parsed if ResourceList::preparse() found the file
+	if(!m_parsed)
+		parse(filename);
+	std::auto_ptr<ParsedScript> parsed(m_parsed);
+	m_parsed = NULL;
+
+	if(!parsed->parser.get() || !parsed->ok)
 		return false;
-	}
+	
+	OmfgScript::Parser& parser = *parsed->parser;
 	
 	crc = parser.getCRC();
 
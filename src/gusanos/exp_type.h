@@ -18,6 +18,7 @@ class Distortion;
 struct GameEvent;
 struct DetectEvent;
 class Sprite;
+struct ParsedScript;
 
 class ExpType : public BaseObject
 {
@@ -27,6 +28,8 @@ public:
 	~ExpType();
 
 	bool load(std::string const& filename);
+	// The thread-safe first half of load(), see ParsedScript
+	bool parse(std::string const& filename);
 
 	int timeout;
 	int timeoutVariation;
@@ -50,6 +53,9 @@ public:
 
 	std::vector< DetectEvent* > detectRanges;
 	GameEvent *creation;
+
+private:
+	ParsedScript* m_parsed; // Between parse() and load()
 };
 
 extern ResourceList<ExpType> expTypeList;
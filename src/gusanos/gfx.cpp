@@ -89,6 +89,11 @@ ALLEGRO_BITMAP* Gfx::loadBitmap( const string& filename, bool keepAlpha , bool s
 		}
 	}
 
+	return finishBitmap(returnValue, keepAlpha);
+}
+
+ALLEGRO_BITMAP* Gfx::finishBitmap( ALLEGRO_BITMAP* returnValue, bool keepAlpha )
+{
 #ifndef DEDICATED_ONLY
 	if(returnValue && !keepAlpha && bitmap_color_depth(returnValue) == 32 && get_color_depth() == 32)
 	{
@@ -106,14 +111,21 @@ ALLEGRO_BITMAP* Gfx::loadBitmap( const string& filename, bool keepAlpha , bool s
 	return returnValue;
 }
 
+std::string Gfx::findBitmap(const std::string& filename) {
+	if(IsFileAvailable(filename)) return filename;
+	if(IsFileAvailable(filename + ".png")) return filename + ".png";
+	if(IsFileAvailable(filename + ".bmp")) return filename + ".bmp";
+	return "";
+}
+
 SmartPointer<SDL_Surface> Gfx::loadBitmapSDL(const std::string& _filename, bool keepAlpha, bool stretch2) {
-	std::string filename;
-	if(IsFileAvailable(_filename)) filename = _filename;
-	else if(IsFileAvailable(_filename + ".png")) filename = _filename + ".png";
-	else if(IsFileAvailable(_filename + ".bmp")) filename = _filename + ".bmp";
-	else return NULL;
+	std::string filename = findBitmap(_filename);
+	if(filename == "") return NULL;
 	
-	SmartPointer<SDL_Surface> img = load_bitmap__allegroformat(filename, stretch2);
+	return finishBitmapSDL(load_bitmap__allegroformat(filename, stretch2), keepAlpha);
+}
+
+SmartPointer<SDL_Surface> Gfx::finishBitmapSDL(const SmartPointer<SDL_Surface>& img, bool keepAlpha) {
 	if(!img.get()) return NULL;
 	
 	if(!keepAlpha)
@@ -21,6 +21,12 @@ public:
 	ALLEGRO_BITMAP* loadBitmap(const std::string &filename, bool keepAlpha = false, bool stretch2 = true);
 	SmartPointer<SDL_Surface> loadBitmapSDL(const std::string &filename, bool keepAlpha = false, bool stretch2 = true);
 	
+	// The file loadBitmapSDL() would load for filename, or "" if there is none
+	static std::string findBitmap(const std::string& filename);
+	// The conversions loadBitmap()/loadBitmapSDL() do after load_bitmap__allegroformat()
+	ALLEGRO_BITMAP* finishBitmap(ALLEGRO_BITMAP* bmp, bool keepAlpha);
+	SmartPointer<SDL_Surface> finishBitmapSDL(const SmartPointer<SDL_Surface>& img, bool keepAlpha);
+	
 };
 
 extern Gfx gfx;
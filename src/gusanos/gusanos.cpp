@@ -8,6 +8,7 @@
 #include "gusgame.h"
 #include "part_type.h"
 #include "particle.h"
+#include "simple_particle_system.h"
 #include "CWormHuman.h"
 #include "util/macros.h"
 
@@ -27,9 +28,11 @@
 #include "script.h"
 #include "LuaCallbacks.h"
 #include "luaapi/context.h"
+#include "luaapi/profiler.h"
 #include "lua/bindings.h"
 #include "util/log.h"
 #include "game/Game.h"
+#include "Options.h"
 #include <memory>
 #include <string>
 #include <vector>
@@ -61,6 +64,10 @@ bool gusInit(const std::string& mod) {
 }
 
 void gusLogicFrame() {
+	const bool bench = luaFrameBench.running();
+	const Uint64 benchStart = bench ? SDL_GetPerformanceCounter() : 0;
+	bool simulated = false;
+
 	for ( Grid::iterator iter = game.objects.beginAll(); iter;)
 	{
 		if(iter->deleteMe)
@@ -71,6 +78,8 @@ void gusLogicFrame() {
 
 	if ( game.isMapReady() && game.shouldDoPhysicsFrame() && gusGame.isLoaded() )
 	{
+		simulated = true;
+		simpleParticles.think();
 		for ( Grid::iterator iter = game.objects.beginAll(); iter; ++iter)
 		{
 			iter->think();
@@ -95,6 +104,14 @@ void gusLogicFrame() {
 	spriteList.think();
 
 	LUACALLBACK(afterUpdate).call()();
+
+	luaIngameGC.frame(luaIngame, tLXOptions->iLuaGCBudget);
+
+	if(bench && simulated) {
+		luaFrameBench.frame(SDL_GetPerformanceCounter() - benchStart, luaIngameGC.lastFrameTicks);
+		if(luaFrameBench.finished())
+			notes << "benchLua: " << luaFrameBench.summary() << endl;
+	}
 }
 
 void gusQuit() {
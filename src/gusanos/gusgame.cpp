@@ -408,13 +408,22 @@ void GusGame::loadWeapons()
 	std::string path = m_modPath + "/weapons";
 	if ( !gusExists( path ) ) return;
 	
+	std::vector<WeaponType*> weapons;
+	std::vector<std::string> files;
 	for( Iterator<std::string>::Ref iter = gusFileListIter(path); iter->isValid(); iter->next())
 	{
 		if( GetFileExtensionWithDot(iter->get()) != ".wpn" ) continue;
 
-		WeaponType* weapon = new WeaponType;
-		weapon->load(path + "/" + iter->get());
-		weaponList.push_back(weapon);
+		weapons.push_back(new WeaponType);
+		files.push_back(path + "/" + iter->get());
+	}
+	
+	// Parsing is independent for each file, linking loads the shared resources
+	parseInParallel(weapons, files);
+	for ( size_t i = 0; i < weapons.size(); ++i )
+	{
+		weapons[i]->load(files[i]);
+		weaponList.push_back(weapons[i]);
 	}
 	
 	WeaponOrder comp;
@@ -432,6 +441,10 @@ bool GusGame::_loadMod()
 
 	options.maxWeapons = options.maxWeaponsVar;
 	
+	// Parse all object files at once, the weapons only link them then
+	partTypeList.preparse(".obj");
+	expTypeList.preparse(".exp");
+	
 	NRPartType = partTypeList.load("ninjarope.obj");
 	deathObject = partTypeList.load("death.obj");
 	digObject = partTypeList.load("wormdig.obj");
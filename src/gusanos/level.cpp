@@ -435,6 +435,7 @@ void CMap::loaderSucceeded()
 {
 	assert(bmpDrawImage.get());
 	
+	invalidateSpawnIndex();
 	m_water.clear();
 	for ( int y = 0; y < material->h; ++y )
 		for ( int x = 0; x < material->w; ++x ) {
@@ -11,6 +11,9 @@
 #include "util/macros.h"
 #include "game/CMap.h"
 #include "GfxPrimitives.h"
+#include "Options.h"
+#include "LieroX.h"
+#include "level_bundle.h"
 #include <string>
 
 #include "../omfgscript/omfg_script.h"
@@ -174,16 +177,33 @@ bool GusanosLevelLoader::load(CMap* level, std::string const& path)
 	
 	level->FileName = path;
 	
+	// The config decides whether the images are stretched, so we need it first
+	level->m_config = LevelConfig();
+	loadConfig( path + "/config.cfg", level->m_config );
+	const bool stretch2 = !level->config()->doubleRes;
+	
+	// A dedicated server never draws the level, it only needs the material
+	unsigned int layerMask = 1 << GusLevelLayers::Material;
+#ifndef DEDICATED_ONLY
+	if(!bDedicated)
+		layerMask = (1 << GusLevelLayers::LayerCount) - 1;
+#endif
+	
+	GusLevelLayers layers;
+	const std::string bundleSig = GusLevelLayers::signature(path, stretch2);
+	const bool fromBundle = tLXOptions->bGusLevelBundles && layers.loadBundle(path, bundleSig, layerMask);
+	if(fromBundle)
+		layers.decode(path, stretch2, layerMask & (1 << GusLevelLayers::Foreground));
+	else
+		layers.decode(path, stretch2, layerMask);
+	
 	{
 		LocalSetColorDepth cd(8);
-		level->material = gfx.loadBitmap(materialPath.c_str(), false, false);
+		level->material = gfx.finishBitmap(create_bitmap_from_sdl(layers.layers[GusLevelLayers::Material]), false);
 	}
 	
 	if (level->material)
 	{
-		level->m_config = LevelConfig();
-		loadConfig( path + "/config.cfg", level->m_config );
-		
 		if(level->config()) {
 			if(level->config()->teamBases.size() == 0) {
 				parseCtfBasesFromLua(path + "/scripts/map_" + GetBaseFilenameWithoutExt(path) + ".lua", level->config() );
@@ -195,12 +215,25 @@ bool GusanosLevelLoader::load(CMap* level, std::string const& path)
 			errors << "GusanosLevelLoader::load: config structure not loaded" << endl;
 		
 #ifndef DEDICATED_ONLY		
-		level->bmpDrawImage = gfx.loadBitmapSDL(path + "/level", false, /*stretch2*/ !level->config()->doubleRes);
-		if (level->bmpDrawImage.get())
+		if(bDedicated)
+			// Nothing draws it, but a lot of code expects it
+			level->bmpDrawImage = gfxCreateSurface(level->material->w*2, level->material->h*2);
+		else if(fromBundle)
+			// Bundled layers are already converted
+			level->bmpDrawImage = layers.layers[GusLevelLayers::Level];
+		else
+			level->bmpDrawImage = gfx.finishBitmapSDL(layers.layers[GusLevelLayers::Level], false);
+		if (level->bmpDrawImage.get() && !bDedicated)
 		{			
-			level->bmpBackImageHiRes = gfx.loadBitmapSDL(path + "/background", false, !level->config()->doubleRes);
-			// "paralax" typo is here for historical reasons :p
-			level->bmpParallax = gfx.loadBitmapSDL(path + "/paralax", false, !level->config()->doubleRes);
+			if(fromBundle) {
+				level->bmpBackImageHiRes = layers.layers[GusLevelLayers::Background];
+				level->bmpParallax = layers.layers[GusLevelLayers::Paralax];
+			}
+			else {
+				level->bmpBackImageHiRes = gfx.finishBitmapSDL(layers.layers[GusLevelLayers::Background], false);
+				// "paralax" typo is here for historical reasons :p
+				level->bmpParallax = gfx.finishBitmapSDL(layers.layers[GusLevelLayers::Paralax], false);
+			}
 
 			if(!level->bmpParallax.get())
 				notes << "Paralax not loaded" << endl;
@@ -209,29 +242,42 @@ bool GusanosLevelLoader::load(CMap* level, std::string const& path)
 				// This is like blit() but with the colorkey set.
 				SetColorKey(level->bmpDrawImage.get());
 
-			level->bmpForeground = LoadGameImage(path + "/foreground.png", true);
-			if(!level->config()->doubleRes && level->bmpForeground.get())
-				level->bmpForeground = GetCopiedStretched2Image(level->bmpForeground);
-					
-			ALLEGRO_BITMAP* tempLightmap = gfx.loadBitmap(path + "/lightmap", false, !level->config()->doubleRes);
+			// Stretched already if needed
+			level->bmpForeground = layers.layers[GusLevelLayers::Foreground];
 			
-			if ( tempLightmap )
-			{
+			if(fromBundle) {
+				if(layers.layers[GusLevelLayers::Lightmap].get())
+					level->lightmap = create_bitmap_from_sdl(layers.layers[GusLevelLayers::Lightmap]);
+			}
+			else {
+				ALLEGRO_BITMAP* tempLightmap = gfx.finishBitmap(create_bitmap_from_sdl(layers.layers[GusLevelLayers::Lightmap]), false);
+				
+				if ( tempLightmap )
 				{
-					// NOTE: doubleRes lightmap
-					LocalSetColorDepth cd(8);
-					level->lightmap = create_bitmap(level->material->w*2, level->material->h*2);
+					{
+						// NOTE: doubleRes lightmap
+						LocalSetColorDepth cd(8);
+						level->lightmap = create_bitmap(level->material->w*2, level->material->h*2);
+					}
+					// tmpLightmap is also doubleRes already
+					for ( int y = 0; y < tempLightmap->h ; ++y )
+					for ( int x = 0; x < tempLightmap->w ; ++x )
+					{
+						Uint32 c = getpixel(tempLightmap, x, y);
+						putpixel( level->lightmap, x, y, c );
+					}
+					destroy_bitmap( tempLightmap );
 				}
-				// tmpLightmap is also doubleRes already
-				for ( int y = 0; y < tempLightmap->h ; ++y )
-				for ( int x = 0; x < tempLightmap->w ; ++x )
-				{
-					Uint32 c = getpixel(tempLightmap, x, y);
-					putpixel( level->lightmap, x, y, c );
+				
+				if(tLXOptions->bGusLevelBundles) {
+					// Bundle what we have now, after all conversions
+					layers.layers[GusLevelLayers::Level] = level->bmpDrawImage;
+					layers.layers[GusLevelLayers::Background] = level->bmpBackImageHiRes;
+					layers.layers[GusLevelLayers::Paralax] = level->bmpParallax;
+					layers.layers[GusLevelLayers::Lightmap] = level->lightmap ? level->lightmap->surf : NULL;
+					layers.saveBundle(path, bundleSig);
 				}
-				destroy_bitmap( tempLightmap );
 			}
-			
 		}
 #endif		
 		if(level->config()) {
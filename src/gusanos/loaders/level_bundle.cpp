@@ -0,0 +1,291 @@
+#include "level_bundle.h"
+#include "../gfx.h"
+#include "gusanos/allegro.h"
+#include "GfxPrimitives.h"
+#include "TaskScheduler.h"
+#include "FindFile.h"
+#include "StringUtils.h"
+#include "EndianSwap.h"
+#include "Debug.h"
+
+#include <cstring>
+#include <sys/stat.h>
+#include <boost/bind.hpp>
+
+namespace
+{
+	// Increase if the way the layers are converted changes
+	const Uint32 BundleVersion = 1;
+	const char BundleMagic[8] = { 'O','L','X','G','U','S','L','V' };
+
+	const char* const layerNames[GusLevelLayers::LayerCount] =
+	{
+		"material", "level", "background", "paralax", "lightmap", "foreground.png"
+	};
+
+	struct BundledLayer
+	{
+		Uint32 w, h;
+		Uint8 bpp;
+		Uint32 rmask, gmask, bmask, amask;
+		std::vector<SDL_Color> palette;
+		std::string data; // zlib compressed rows, without pitch padding
+	};
+
+	void decodeLayer(SmartPointer<SDL_Surface>& out, const std::string& path, int layer, bool stretch2)
+	{
+		if(layer == GusLevelLayers::Foreground)
+		{
+			out = LoadGameImage(path + "/" + layerNames[layer], true);
+			if(stretch2 && out.get())
+				out = GetCopiedStretched2Image(out);
+			return;
+		}
+
+		const std::string file = Gfx::findBitmap(path + "/" + layerNames[layer]);
+		if(file == "") return;
+		// The material is never stretched, see GusanosLevelLoader::load
+		out = load_bitmap__allegroformat(file, (layer == GusLevelLayers::Material) ? false : stretch2);
+	}
+
+	void packLayer(const SmartPointer<SDL_Surface>& surf, BundledLayer& out, bool& ok)
+	{
+		SDL_Surface* s = surf.get();
+		const size_t rowSize = s->w * s->format->BytesPerPixel;
+		std::string raw;
+		raw.reserve(rowSize * s->h);
+		LockSurface(s);
+		for(int y = 0; y < s->h; ++y)
+			raw.append((const char*)s->pixels + y * s->pitch, rowSize);
+		UnlockSurface(s);
+
+		if(!Compress(raw, &out.data))
+			ok = false;
+	}
+
+	void unpackLayer(const BundledLayer& in, SmartPointer<SDL_Surface>& out, bool& ok)
+	{
+		std::string raw;
+		if(!Decompress(in.data, &raw)) { ok = false; return; }
+
+		SmartPointer<SDL_Surface> s = SDL_CreateRGBSurface(0, in.w, in.h, in.bpp, in.rmask, in.gmask, in.bmask, in.amask);
+		if(!s.get()) { ok = false; return; }
+		const size_t rowSize = s->w * s->format->BytesPerPixel;
+		if(raw.size() != rowSize * s->h) { ok = false; return; }
+
+		if(s->format->palette && !in.palette.empty())
+			SDL_SetPaletteColors(s->format->palette, &in.palette[0], 0, (int)in.palette.size());
+
+		LockSurface(s);
+		for(int y = 0; y < s->h; ++y)
+			memcpy((Uint8*)s->pixels + y * s->pitch, raw.data() + y * rowSize, rowSize);
+		UnlockSurface(s);
+		out = s;
+	}
+
+	// Without a scheduler (early init, tools), just run everything here
+	void runAll(std::vector<TaskScheduler::Function>& jobs)
+	{
+		if(!taskScheduler)
+		{
+			for(size_t i = 0; i < jobs.size(); ++i)
+				jobs[i]();
+			return;
+		}
+		TaskGroup group;
+		for(size_t i = 0; i < jobs.size(); ++i)
+			taskScheduler->spawn(group, jobs[i]);
+		taskScheduler->wait(group);
+	}
+}
+
+std::string GusLevelLayers::bundleFileName(const std::string& path)
+{
+	std::string name = path;
+	for(size_t i = 0; i < name.size(); ++i)
+		if(!isalnum((unsigned char)name[i]) && name[i] != '-' && name[i] != '.')
+			name[i] = '_';
+	return "cache/gus_levels/" + name + ".lvlbundle";
+}
+
+std::string GusLevelLayers::signature(const std::string& path, bool stretch2)
+{
+	std::string sig = "v" + itoa(BundleVersion) + " byteorder " + itoa(SDL_BYTEORDER);
+	if(stretch2) sig += " stretch2";
+
+	for(int i = 0; i < BundledLayers; ++i)
+	{
+		const std::string file = Gfx::findBitmap(path + "/" + layerNames[i]);
+		struct stat st;
+		if(file == "" || !StatFile(file, &st))
+		{
+			sig += " -";
+			continue;
+		}
+		sig += " " + GetBaseFilename(file) + ":" + itoa((long)st.st_size) + ":" + itoa((long)st.st_mtime);
+	}
+	return sig;
+}
+
+void GusLevelLayers::decode(const std::string& path, bool stretch2, unsigned int layerMask)
+{
+	std::vector<TaskScheduler::Function> jobs;
+	for(int i = 0; i < LayerCount; ++i)
+		if(layerMask & (1 << i))
+			jobs.push_back(boost::bind(&decodeLayer, boost::ref(layers[i]), path, i, stretch2));
+	runAll(jobs);
+}
+
+bool GusLevelLayers::loadBundle(const std::string& path, const std::string& sig, unsigned int layerMask)
+{
+	FILE* f = OpenGameFile(bundleFileName(path), "rb");
+	if(!f) return false;
+
+	BundledLayer bundled[BundledLayers];
+	bool want[BundledLayers];
+	bool ok = true;
+
+	char magic[sizeof(BundleMagic)];
+	Uint32 version = 0, sigLen = 0;
+	ok = fread(magic, sizeof(magic), 1, f) == 1 && memcmp(magic, BundleMagic, sizeof(magic)) == 0 &&
+		fread_endian<Uint32>(f, version) && version == BundleVersion &&
+		fread_endian<Uint32>(f, sigLen) && sigLen == sig.size();
+	if(ok)
+	{
+		std::string fileSig(sigLen, '\0');
+		ok = (sigLen == 0 || fread(&fileSig[0], sigLen, 1, f) == 1) && fileSig == sig;
+	}
+
+	for(int i = 0; ok && i < BundledLayers; ++i)
+	{
+		BundledLayer& l = bundled[i];
+		Uint8 present = 0;
+		want[i] = false;
+		if(!fread_endian<Uint8>(f, present)) { ok = false; break; }
+		if(!present) continue;
+
+		Uint16 colors = 0;
+		Uint32 dataSize = 0;
+		ok = fread_endian<Uint32>(f, l.w) && fread_endian<Uint32>(f, l.h) && fread_endian<Uint8>(f, l.bpp) &&
+			fread_endian<Uint32>(f, l.rmask) && fread_endian<Uint32>(f, l.gmask) &&
+			fread_endian<Uint32>(f, l.bmask) && fread_endian<Uint32>(f, l.amask) &&
+			fread_endian<Uint16>(f, colors);
+		l.palette.resize(colors);
+		for(Uint16 c = 0; ok && c < colors; ++c)
+			ok = fread_endian<Uint8>(f, l.palette[c].r) && fread_endian<Uint8>(f, l.palette[c].g) &&
+				fread_endian<Uint8>(f, l.palette[c].b) && fread_endian<Uint8>(f, l.palette[c].a);
+		ok = ok && fread_endian<Uint32>(f, dataSize);
+		if(!ok) break;
+
+		if(!(layerMask & (1 << i)))
+		{
+			ok = fseek(f, dataSize, SEEK_CUR) == 0;
+			continue;
+		}
+		l.data.resize(dataSize);
+		ok = dataSize > 0 && fread(&l.data[0], dataSize, 1, f) == 1;
+		want[i] = true;
+	}
+	fclose(f);
+
+	if(!ok)
+	{
+		notes << "Gusanos level bundle for " << path << " is outdated or broken, ignoring it" << endl;
+		return false;
+	}
+
+	// Inflating is the expensive part, do all layers at the same time
+	std::vector<TaskScheduler::Function> jobs;
+	bool layerOk[BundledLayers];
+	for(int i = 0; i < BundledLayers; ++i)
+	{
+		layerOk[i] = true;
+		if(want[i])
+			jobs.push_back(boost::bind(&unpackLayer, boost::cref(bundled[i]), boost::ref(layers[i]), boost::ref(layerOk[i])));
+	}
+	runAll(jobs);
+
+	for(int i = 0; i < BundledLayers; ++i)
+		if(!layerOk[i])
+		{
+			warnings << "Gusanos level bundle for " << path << ": cannot unpack " << layerNames[i] << endl;
+			for(int j = 0; j < BundledLayers; ++j)
+				layers[j] = NULL;
+			return false;
+		}
+
+	return true;
+}
+
+bool GusLevelLayers::saveBundle(const std::string& path, const std::string& sig) const
+{
+	BundledLayer bundled[BundledLayers];
+	bool layerOk[BundledLayers];
+	std::vector<TaskScheduler::Function> jobs;
+	for(int i = 0; i < BundledLayers; ++i)
+	{
+		layerOk[i] = true;
+		if(layers[i].get())
+			jobs.push_back(boost::bind(&packLayer, boost::cref(layers[i]), boost::ref(bundled[i]), boost::ref(layerOk[i])));
+	}
+	runAll(jobs);
+
+	for(int i = 0; i < BundledLayers; ++i)
+		if(!layerOk[i])
+		{
+			warnings << "Gusanos level bundle for " << path << ": cannot compress " << layerNames[i] << endl;
+			return false;
+		}
+
+	const std::string fileName = bundleFileName(path);
+	FILE* f = OpenGameFile(fileName, "wb");
+	if(!f)
+	{
+		warnings << "cannot write " << fileName << endl;
+		return false;
+	}
+
+	fwrite(BundleMagic, sizeof(BundleMagic), 1, f);
+	fwrite_endian<Uint32>(f, BundleVersion);
+	fwrite_endian<Uint32>(f, (Uint32)sig.size());
+	fwrite(sig.data(), 1, sig.size(), f);
+
+	for(int i = 0; i < BundledLayers; ++i)
+	{
+		SDL_Surface* s = layers[i].get();
+		fwrite_endian<Uint8>(f, s ? 1 : 0);
+		if(!s) continue;
+
+		const SDL_Palette* pal = s->format->palette;
+		const Uint16 colors = pal ? (Uint16)pal->ncolors : 0;
+		fwrite_endian<Uint32>(f, (Uint32)s->w);
+		fwrite_endian<Uint32>(f, (Uint32)s->h);
+		fwrite_endian<Uint8>(f, s->format->BitsPerPixel);
+		fwrite_endian<Uint32>(f, s->format->Rmask);
+		fwrite_endian<Uint32>(f, s->format->Gmask);
+		fwrite_endian<Uint32>(f, s->format->Bmask);
+		fwrite_endian<Uint32>(f, s->format->Amask);
+		fwrite_endian<Uint16>(f, colors);
+		for(Uint16 c = 0; c < colors; ++c)
+		{
+			fwrite_endian<Uint8>(f, pal->colors[c].r);
+			fwrite_endian<Uint8>(f, pal->colors[c].g);
+			fwrite_endian<Uint8>(f, pal->colors[c].b);
+			fwrite_endian<Uint8>(f, pal->colors[c].a);
+		}
+		fwrite_endian<Uint32>(f, (Uint32)bundled[i].data.size());
+		fwrite(bundled[i].data.data(), 1, bundled[i].data.size(), f);
+	}
+
+	const bool failed = ferror(f) != 0;
+	fclose(f);
+	if(failed)
+	{
+		warnings << "error while writing " << fileName << endl;
+		remove(GetWriteFullFileName(fileName).c_str());
+		return false;
+	}
+
+	notes << "saved Gusanos level bundle " << fileName << endl;
+	return true;
+}
@@ -0,0 +1,53 @@
+#ifndef VERMES_LOADERS_LEVEL_BUNDLE_H
+#define VERMES_LOADERS_LEVEL_BUNDLE_H
+
+#include <string>
+#include <SDL.h>
+#include "SmartPointer.h"
+
+/*
+	The image layers of a Gusanos level.
+
+	Decoding and converting the images is the slow part of loading a big
+	level. decode() loads all layers at the same time on the task scheduler.
+	The layers after all conversions can then be saved as a bundle:
+	cache/gus_levels/<level>.lvlbundle holds each layer zlib compressed in
+	the pixel format it has in memory, so the next load only has to inflate
+	it. The bundle stores name, size and modification time of the source
+	files and is ignored (and rebuilt) as soon as one of them changes.
+
+	Foreground is decoded in parallel as well, but not bundled, because it is
+	converted to the display format.
+*/
+struct GusLevelLayers
+{
+	enum Layer
+	{
+		Material = 0,
+		Level,
+		Background,
+		Paralax,
+		Lightmap, // bundled as the final 8 bit doubleRes lightmap
+		Foreground,
+		LayerCount,
+		BundledLayers = Foreground
+	};
+
+	SmartPointer<SDL_Surface> layers[LayerCount];
+
+	// Identifies the source files and the conversion. Must be equal to use a bundle.
+	static std::string signature(const std::string& path, bool stretch2);
+
+	// layerMask is a set of 1 << Layer. Only those layers are read or decoded.
+	bool loadBundle(const std::string& path, const std::string& sig, unsigned int layerMask);
+	bool saveBundle(const std::string& path, const std::string& sig) const;
+
+	// Decodes the layers in parallel. The results still need the conversions of
+	// Gfx::finishBitmap/finishBitmapSDL, the lightmap is the raw image.
+	void decode(const std::string& path, bool stretch2, unsigned int layerMask);
+
+private:
+	static std::string bundleFileName(const std::string& path);
+};
+
+#endif // VERMES_LOADERS_LEVEL_BUNDLE_H
@@ -282,7 +282,9 @@ int shootFromObject(lua_State* L, CGameObject* object)
 			angle = spd.getAngle(); // Need to recompute angle
 		}
 		//gusGame.insertParticle( new Particle( p, object->getPos() + direction * distanceOffset, spd, object->getDir(), object->getOwner(), angle ));
-		last = p->newParticle(p, posVelTempHack.getPos(object) + direction * (float)distanceOffset, spd, object->getDir(), object->getOwner(), angle);
+		// Only the last one is returned, so only that one must be an object
+		NewParticleFunc f = (i == realAmount - 1) ? p->newParticleObject : p->newParticle;
+		last = f(p, posVelTempHack.getPos(object) + direction * (float)distanceOffset, spd, object->getDir(), object->getOwner(), angle);
 	}
 	
 	if(last)
@@ -532,7 +532,7 @@ METHODC(PartType, parttype_put,  {
 		case 2:  x = (float)lua_tonumber(context, 2);
 	}
 	
-	CGameObject* last = p->newParticle(p, Vec(x, y), Vec(xspd, yspd), 1, 0, angle);
+	CGameObject* last = p->newParticleObject(p, Vec(x, y), Vec(xspd, yspd), 1, 0, angle);
 
 	if(last)
 	{
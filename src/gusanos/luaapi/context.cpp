@@ -16,6 +16,7 @@ extern "C"
 #include "gusanos/luaapi/classes.h"
 #include "gusanos/lua/bindings.h"
 #include "gusanos/LuaCallbacks.h"
+#include "gusanos/luaapi/profiler.h"
 #include "FindFile.h"
 #include <cmath>
 #include <map>
@@ -105,7 +106,7 @@ LuaContext::LuaContext(lua_State* L) {
 
 namespace
 {
-	void* l_alloc (void*, void* ptr, size_t, size_t nsize)
+	void* l_alloc (void*, void* ptr, size_t osize, size_t nsize)
 	{
 		if (nsize == 0)
 		{
@@ -113,13 +114,27 @@ namespace
 			return 0;
 		}
 		else
+		{
+			if(nsize > osize)
+			{
+				luaAllocatedBytes += nsize - osize;
+				++luaAllocations;
+			}
 			return realloc(ptr, nsize);
+		}
 	}
 }
 
 void LuaContext::init()
 {
-	weakRef.set(lua_newstate(l_alloc, 0));
+	lua_State* L = lua_newstate(l_alloc, 0);
+#ifdef LUA_JIT
+	// LuaJIT 2.0 on x64 refuses custom allocators, its own one must keep the memory in
+	// the lower 2GB. We lose the allocation statistics (LuaProfiler) then.
+	if(!L)
+		L = luaL_newstate();
+#endif
+	weakRef.set(L);
 
 	lua_pushinteger(*this, 3);
 	lua_rawseti(*this, LUA_REGISTRYINDEX, ARRAY_SIZE);
@@ -128,6 +143,12 @@ void LuaContext::init()
 	luaopen_table(*this);
 	luaopen_string(*this);
 	luaopen_math(*this);
+#ifdef LUA_JIT
+	// The JIT compiler is only switched on by its library
+	lua_pushcfunction(*this, luaopen_jit);
+	lua_pushstring(*this, LUA_JITLIBNAME);
+	lua_call(*this, 1, 0);
+#endif
 }
 
 void LuaContext::reset()
@@ -379,7 +400,15 @@ void LuaContext::load(std::string const& chunk, istream& stream, string const& t
 
 int LuaContext::call(int params, int returns, int errfunc)
 {
-	int result = lua_pcall (*this, params, returns, errfunc);
+	int result;
+	if(LuaProfiler::enabled)
+	{
+		LuaProfiler::begin(*this, -(params + 1));
+		result = lua_pcall (*this, params, returns, errfunc);
+		LuaProfiler::end();
+	}
+	else
+		result = lua_pcall (*this, params, returns, errfunc);
 		
 	switch(result)
 	{
@@ -0,0 +1,285 @@
+#include "profiler.h"
+#include "OLXCommand.h"
+#include "StringUtils.h"
+#include "util/StringConv.h"
+#include <SDL.h>
+#include <algorithm>
+
+extern "C"
+{
+	#include "lauxlib.h"
+#ifdef LUA_JIT
+	#include "luajit.h"
+#endif
+}
+
+Uint64 luaAllocatedBytes = 0;
+Uint64 luaAllocations = 0;
+
+bool LuaProfiler::enabled = false;
+const char* LuaProfiler::current = "other";
+std::vector<LuaProfiler::Frame> LuaProfiler::m_stack;
+std::map<std::string, LuaProfiler::Stat> LuaProfiler::m_functions;
+std::map<std::string, LuaProfiler::Stat> LuaProfiler::m_categories;
+
+LuaGCPacer luaIngameGC;
+LuaFrameBench luaFrameBench;
+
+static std::string functionName(lua_State* L, int funcIndex)
+{
+	lua_Debug ar;
+	lua_pushvalue(L, funcIndex);
+	if(!lua_getinfo(L, ">S", &ar))
+		return "?";
+	if(ar.what && std::string(ar.what) == "C")
+		return "[C]";
+	return std::string(ar.short_src) + ":" + to_string(ar.linedefined);
+}
+
+static void addSample(LuaProfiler::Stat& s, Uint64 ticks, Uint64 selfTicks, Uint64 bytes, Uint64 allocations)
+{
+	s.calls++;
+	s.ticks += ticks;
+	s.selfTicks += selfTicks;
+	s.maxTicks = std::max(s.maxTicks, ticks);
+	s.bytes += bytes;
+	s.allocations += allocations;
+}
+
+void LuaProfiler::begin(lua_State* L, int funcIndex)
+{
+	if(funcIndex < 0)
+		funcIndex = lua_gettop(L) + funcIndex + 1;
+
+	Frame f;
+	f.function = functionName(L, funcIndex);
+	f.category = current;
+	f.childTicks = 0;
+	f.startBytes = luaAllocatedBytes;
+	f.startAllocations = luaAllocations;
+	f.childBytes = 0;
+	f.childAllocations = 0;
+	// Take the time last so that the name lookup isn't counted
+	f.start = SDL_GetPerformanceCounter();
+	m_stack.push_back(f);
+}
+
+void LuaProfiler::end()
+{
+	if(m_stack.empty()) // Profiling was started within a call
+		return;
+
+	Uint64 now = SDL_GetPerformanceCounter();
+	Frame f = m_stack.back();
+	m_stack.pop_back();
+
+	Uint64 ticks = now - f.start;
+	Uint64 bytes = luaAllocatedBytes - f.startBytes;
+	Uint64 allocations = luaAllocations - f.startAllocations;
+	Uint64 selfTicks = ticks > f.childTicks ? ticks - f.childTicks : 0;
+
+	addSample(m_functions[f.function], ticks, selfTicks, bytes - f.childBytes, allocations - f.childAllocations);
+
+	// A category counts the outermost call only, nested calls of the same category are part of it
+	bool outermost = true;
+	for(size_t i = 0; i < m_stack.size(); ++i)
+		if(m_stack[i].category == f.category)
+		{
+			outermost = false;
+			break;
+		}
+	if(outermost)
+		addSample(m_categories[f.category], ticks, selfTicks, bytes, allocations);
+
+	if(!m_stack.empty())
+	{
+		Frame& parent = m_stack.back();
+		parent.childTicks += ticks;
+		parent.childBytes += bytes;
+		parent.childAllocations += allocations;
+	}
+}
+
+void LuaProfiler::reset()
+{
+	m_stack.clear();
+	m_functions.clear();
+	m_categories.clear();
+}
+
+typedef std::pair<std::string, LuaProfiler::Stat> StatEntry;
+
+static bool bySelfTime(const StatEntry& a, const StatEntry& b)
+{
+	return a.second.selfTicks > b.second.selfTicks;
+}
+
+static bool byTime(const StatEntry& a, const StatEntry& b)
+{
+	return a.second.ticks > b.second.ticks;
+}
+
+static std::string formatStat(const LuaProfiler::Stat& s, double msPerTick)
+{
+	return "calls " + to_string(s.calls) +
+		", total " + ftoa(float(s.ticks * msPerTick), 2) + " ms" +
+		", self " + ftoa(float(s.selfTicks * msPerTick), 2) + " ms" +
+		", max " + ftoa(float(s.maxTicks * msPerTick), 3) + " ms" +
+		", " + to_string(s.bytes / 1024) + " KB in " + to_string(s.allocations) + " allocs";
+}
+
+void LuaProfiler::dump(CmdLineIntf& cli, size_t count)
+{
+	double msPerTick = 1000.0 / double(SDL_GetPerformanceFrequency());
+
+	std::vector<StatEntry> categories(m_categories.begin(), m_categories.end());
+	std::sort(categories.begin(), categories.end(), byTime);
+	cli.writeMsg("Lua callbacks:");
+	for(size_t i = 0; i < categories.size(); ++i)
+		cli.writeMsg("  " + categories[i].first + ": " + formatStat(categories[i].second, msPerTick));
+
+	std::vector<StatEntry> functions(m_functions.begin(), m_functions.end());
+	std::sort(functions.begin(), functions.end(), bySelfTime);
+	cli.writeMsg("Lua functions (by self time):");
+	for(size_t i = 0; i < functions.size() && i < count; ++i)
+		cli.writeMsg("  " + functions[i].first + ": " + formatStat(functions[i].second, msPerTick));
+	if(functions.size() > count)
+		cli.writeMsg("  (" + to_string(functions.size() - count) + " more)");
+
+	const LuaGCPacer& gc = luaIngameGC;
+	if(gc.frames > 0)
+		cli.writeMsg("Lua GC: " + to_string(gc.steps) + " steps, " + to_string(gc.cycles) + " cycles in " +
+			to_string(gc.frames) + " frames, " +
+			ftoa(float(gc.ticks * msPerTick), 2) + " ms total, " +
+			ftoa(float(gc.maxFrameTicks * msPerTick), 3) + " ms max/frame, " +
+			to_string(gc.overBudgetFrames) + " frames over budget");
+}
+
+
+// Work per step in KB. Small enough that we don't overshoot the budget by much.
+static const int GC_STEP_KB = 16;
+// When the debt gets over this, we collect regardless of the budget
+static const Uint64 GC_MAX_DEBT_KB = 4096;
+
+LuaGCPacer::LuaGCPacer()
+: steps(0), cycles(0), frames(0), ticks(0), maxFrameTicks(0), overBudgetFrames(0),
+  lastFrameTicks(0), m_state(NULL), m_stepped(false), m_lastCount(0), m_debt(0) {}
+
+void LuaGCPacer::resetStats()
+{
+	steps = cycles = frames = ticks = maxFrameTicks = overBudgetFrames = lastFrameTicks = 0;
+}
+
+void LuaGCPacer::frame(lua_State* L, int budget)
+{
+	if(L == NULL)
+		return;
+
+	if(budget <= 0)
+	{
+		// Automatic GC; if we have stopped it, restart it
+		if(m_stepped && m_state == L)
+			lua_gc(L, LUA_GCRESTART, 0);
+		m_stepped = false;
+		m_state = L;
+		lastFrameTicks = 0;
+		return;
+	}
+
+	// Every frame because a script calling collectgarbage() or a new state
+	// (luaIngame was reset) has the automatic collector running again
+	lua_gc(L, LUA_GCSTOP, 0);
+
+	if(L != m_state || !m_stepped)
+	{
+		// New state or we just took over
+		m_state = L;
+		m_stepped = true;
+		m_debt = 0;
+		m_lastCount = lua_gc(L, LUA_GCCOUNT, 0);
+	}
+
+	// While the collector is stopped, nothing is freed except by our steps,
+	// so the growth since the last frame is what was allocated
+	int count = lua_gc(L, LUA_GCCOUNT, 0);
+	if(count > m_lastCount)
+		m_debt += count - m_lastCount;
+	m_lastCount = count;
+
+	Uint64 freq = SDL_GetPerformanceFrequency();
+	Uint64 budgetTicks = Uint64(budget) * freq / 1000000;
+	Uint64 start = SDL_GetPerformanceCounter();
+	Uint64 elapsed = 0;
+	bool worked = false;
+
+	while(m_debt > 0 && (elapsed < budgetTicks || m_debt > GC_MAX_DEBT_KB))
+	{
+		worked = true;
+		++steps;
+		if(lua_gc(L, LUA_GCSTEP, GC_STEP_KB))
+			++cycles;
+		m_debt = (m_debt > GC_STEP_KB) ? m_debt - GC_STEP_KB : 0;
+		elapsed = SDL_GetPerformanceCounter() - start;
+	}
+
+	if(worked)
+	{
+		// LUA_GCSTEP re-enables the automatic threshold, keep it off
+		lua_gc(L, LUA_GCSTOP, 0);
+		m_lastCount = lua_gc(L, LUA_GCCOUNT, 0);
+	}
+
+	++frames;
+	lastFrameTicks = elapsed;
+	ticks += elapsed;
+	maxFrameTicks = std::max(maxFrameTicks, elapsed);
+	if(elapsed > budgetTicks)
+		++overBudgetFrames;
+}
+
+
+void LuaFrameBench::start(size_t frames)
+{
+	m_wanted = frames;
+	m_ticks.clear();
+	m_ticks.reserve(frames);
+	m_gcTicks = 0;
+}
+
+void LuaFrameBench::frame(Uint64 ticks, Uint64 gcTicks)
+{
+	if(!running())
+		return;
+	m_ticks.push_back(ticks);
+	m_gcTicks += gcTicks;
+}
+
+std::string LuaFrameBench::summary() const
+{
+	if(m_ticks.empty())
+		return std::string("no frames recorded (") + backend() + ")";
+
+	std::vector<Uint64> sorted(m_ticks);
+	std::sort(sorted.begin(), sorted.end());
+	Uint64 total = 0;
+	for(size_t i = 0; i < sorted.size(); ++i)
+		total += sorted[i];
+
+	double msPerTick = 1000.0 / double(SDL_GetPerformanceFrequency());
+	size_t n = sorted.size();
+	return std::string(backend()) + ": " + to_string(n) + " frames" +
+		", avg " + ftoa(float(total * msPerTick / n), 3) + " ms" +
+		", median " + ftoa(float(sorted[n / 2] * msPerTick), 3) + " ms" +
+		", 99% " + ftoa(float(sorted[std::min(n - 1, n * 99 / 100)] * msPerTick), 3) + " ms" +
+		", max " + ftoa(float(sorted[n - 1] * msPerTick), 3) + " ms" +
+		", GC avg " + ftoa(float(m_gcTicks * msPerTick / n), 3) + " ms";
+}
+
+const char* LuaFrameBench::backend()
+{
+#ifdef LUA_JIT
+	return LUAJIT_VERSION;
+#else
+	return LUA_RELEASE;
+#endif
+}
@@ -0,0 +1,132 @@
+#ifndef LUA_PROFILER_H
+#define LUA_PROFILER_H
+
+extern "C"
+{
+#include "lua.h"
+}
+
+#include <string>
+#include <vector>
+#include <map>
+#include <SDL_stdinc.h>
+
+struct CmdLineIntf;
+
+// Bytes and blocks allocated by all Lua states so far, see l_alloc in context.cpp
+extern Uint64 luaAllocatedBytes;
+extern Uint64 luaAllocations;
+
+/*
+ Attributes the time spent in Lua and the allocations done there to the callback type
+ (LuaCallbacks) and to the Lua function which was called. Every lua_pcall goes through
+ LuaContext::call(), that is where we measure. Disabled, it costs one check per call.
+ */
+class LuaProfiler
+{
+public:
+	struct Stat
+	{
+		Stat() : calls(0), ticks(0), selfTicks(0), maxTicks(0), bytes(0), allocations(0) {}
+		Uint64 calls;
+		Uint64 ticks; // Including the Lua functions called from there
+		Uint64 selfTicks;
+		Uint64 maxTicks;
+		Uint64 bytes; // Allocated by the function itself
+		Uint64 allocations;
+	};
+
+	// What the calls made while it exists are about, e.g. the callback type
+	struct Category
+	{
+		Category(const char* name) : m_old(current) { current = name; }
+		~Category() { current = m_old; }
+	private:
+		const char* m_old;
+	};
+
+	static bool enabled;
+	static const char* current;
+
+	// Function to be called is at funcIndex
+	static void begin(lua_State* L, int funcIndex);
+	static void end();
+
+	static void reset();
+	static void dump(CmdLineIntf& cli, size_t count);
+
+private:
+	struct Frame
+	{
+		std::string function;
+		const char* category;
+		Uint64 start;
+		Uint64 childTicks;
+		Uint64 startBytes;
+		Uint64 startAllocations;
+		Uint64 childBytes;
+		Uint64 childAllocations;
+	};
+
+	static std::vector<Frame> m_stack;
+	static std::map<std::string, Stat> m_functions;
+	static std::map<std::string, Stat> m_categories;
+};
+
+/*
+ Instead of letting Lua collect whenever an allocation crosses its threshold, which can
+ be in the middle of a frame, the automatic collector is stopped and we do incremental
+ steps once per frame within a time budget (Advanced.LuaGCBudget). The steps pay back
+ what was allocated since the last frame; if the debt gets too big, we don't care about
+ the budget anymore, so the memory can't grow without bounds.
+ */
+class LuaGCPacer
+{
+public:
+	LuaGCPacer();
+
+	// Once per logic frame. budget in microseconds, 0 gives the control back to Lua.
+	void frame(lua_State* L, int budget);
+	void resetStats();
+
+	Uint64 steps;
+	Uint64 cycles;
+	Uint64 frames;
+	Uint64 ticks;
+	Uint64 maxFrameTicks;
+	Uint64 overBudgetFrames;
+	Uint64 lastFrameTicks;
+
+private:
+	lua_State* m_state;
+	bool m_stepped;
+	int m_lastCount; // LUA_GCCOUNT after the last frame, in KB
+	Uint64 m_debt; // In KB
+};
+
+extern LuaGCPacer luaIngameGC;
+
+// Collects the logic frame times of the next simulated frames (benchLua), to compare
+// the interpreter with LuaJIT on the same mod and map
+class LuaFrameBench
+{
+public:
+	LuaFrameBench() : m_wanted(0), m_gcTicks(0) {}
+
+	void start(size_t frames);
+	void frame(Uint64 ticks, Uint64 gcTicks);
+	bool running() const { return m_wanted > 0 && m_ticks.size() < m_wanted; }
+	bool finished() const { return m_wanted > 0 && m_ticks.size() == m_wanted; }
+	std::string summary() const;
+
+	static const char* backend();
+
+private:
+	size_t m_wanted;
+	std::vector<Uint64> m_ticks;
+	Uint64 m_gcTicks;
+};
+
+extern LuaFrameBench luaFrameBench;
+
+#endif // LUA_PROFILER_H
@@ -737,6 +737,14 @@ public:
 		return iterator(*this, layer, RenderLayerCount, ColLayerCount);
 	}
 	
+	iterator beginRenderLayer(int layer)
+	{
+		if(layers.size() == 0)
+			return iterator();
+			
+		return iterator(*this, layer*ColLayerCount, 1, ColLayerCount);
+	}
+	
 	void clear()
 	{
 		for(std::vector<Layer>::iterator i = layers.begin(); i != layers.end(); ++i)
@@ -9,6 +9,7 @@
 #include "util/stringbuild.h"
 #include "util/text.h"
 #include "gusanos/allegro.h"
+#include "../base_action.h"
 #include <boost/crc.hpp>
 using std::auto_ptr;
 using std::cout;
@@ -516,6 +517,27 @@ ActionDef* ActionFactory::operator[](std::string const& name)
 	return i->second;
 }
 
+// Stands in for an action until Parser::createDeferredActions() creates it
+struct DeferredAction : public BaseAction
+{
+	DeferredAction(ActionDef* def_, Parameters* params_)
+	: def(def_), params(params_)
+	{
+	}
+	
+	~DeferredAction()
+	{
+		delete params;
+	}
+	
+	void run(ActionParams const&)
+	{
+	}
+	
+	ActionDef* def;
+	Parameters* params;
+};
+
 struct ParserImpl : public TGrammar<ParserImpl>
 {
 	struct GameEvent
@@ -555,7 +577,7 @@ struct ParserImpl : public TGrammar<ParserImpl>
 	};
 	
 	ParserImpl(std::istream& str_, ActionFactory& actionFactory_, std::string const& fileName_)
-	: str(str_), fileName(fileName_), actionFactory(actionFactory_)
+	: str(str_), fileName(fileName_), deferActions(false), hasDeferred(false), actionFactory(actionFactory_)
 	{
 		this->next();
 	}
@@ -676,9 +698,31 @@ struct ParserImpl : public TGrammar<ParserImpl>
 	BaseAction* createAction(ActionDef* action, std::auto_ptr<Parameters> params)
 	{
 		params->calcCRC(crc);
+		if(deferActions)
+		{
+			hasDeferred = true;
+			return new DeferredAction(action, params.release());
+		}
 		return action->create(params->params);
 	}
 	
+	void createDeferredActions()
+	{
+		if(!hasDeferred)
+			return;
+		hasDeferred = false;
+		
+		foreach(e, events)
+		{
+			foreach(a, (*e)->actions)
+			{
+				DeferredAction* d = dynamic_cast<DeferredAction*>(a->get());
+				if(d)
+					a->reset(d->def->create(d->params->params));
+			}
+		}
+	}
+	
 	void addEvent(GameEventDef* event, std::auto_ptr<Parameters> params, std::vector< boost::shared_ptr<BaseAction> >& actions)
 	{
 		params->calcCRC(crc);
@@ -690,6 +734,8 @@ struct ParserImpl : public TGrammar<ParserImpl>
 	std::map<std::string, Property*> properties;
 	std::list<GameEvent*> events;
 	boost::crc_32_type crc;
+	bool deferActions;
+	bool hasDeferred;
 	
 	//
 	std::map<std::string, GameEventDef*> eventDef;
@@ -743,9 +789,10 @@ std::vector< boost::shared_ptr<BaseAction> >& Parser::GameEventIter::actions()
 }
 
 Parser::GameEventIter::GameEventIter(Parser& parser)
-: data(new GameEventData(parser.pimpl->events.begin(), parser.pimpl->events.end()))
+: data(0)
 {
-	
+	parser.pimpl->createDeferredActions();
+	data = new GameEventData(parser.pimpl->events.begin(), parser.pimpl->events.end());
 }
 
 #undef self
@@ -760,6 +807,11 @@ Parser::~Parser()
 	delete pimpl;
 }
 
+void Parser::deferActions()
+{
+	pimpl->deferActions = true;
+}
+
 ParamProxy Parser::addEvent(std::string const& name, int type, int provideMask)
 {
 	ParamDef* paramDef = new ParamDef;
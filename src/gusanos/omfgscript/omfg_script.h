@@ -267,6 +267,11 @@ struct Parser : public Pimpl<ParserImpl>
 	
 	ParamProxy addEvent(std::string const& name, int type, int provideMask);
 	
+	// Don't create the actions during run(). Creating them loads other resources,
+	// without that run() can be called on any thread. They are created when the
+	// events are first iterated.
+	void deferActions();
+	
 	bool run();
 	
 	double getDouble(std::string const& name, double def = 0.0);
@@ -0,0 +1,40 @@
+#include "parsed_script.h"
+
+#include "game_actions.h"
+#include "FindFile.h"
+#include <stdexcept>
+
+ParsedScript::ParsedScript(std::string const& filename_)
+: filename(filename_), ok(false)
+{
+	OpenGameFileR(stream, filename, std::ios::binary | std::ios::in);
+	if(stream)
+	{
+		// The parser starts reading right away
+		parser.reset(new OmfgScript::Parser(stream, gameActions, filename));
+		parser->deferActions();
+	}
+}
+
+bool ParsedScript::run()
+{
+	if(!parser.get())
+		return false;
+
+	try
+	{
+		ok = parser->run();
+	}
+	catch(std::exception const& e)
+	{
+		parser->error(e.what());
+		ok = false;
+	}
+
+	if(!ok && parser->incomplete())
+		parser->error("Trailing garbage");
+
+	// Everything is read now, don't keep a handle per preparsed file open
+	stream.close();
+	return ok;
+}
@@ -0,0 +1,33 @@
+#ifndef VERMES_PARSED_SCRIPT_H
+#define VERMES_PARSED_SCRIPT_H
+
+#include <string>
+#include <fstream>
+#include <memory>
+#include "omfgscript/omfg_script.h"
+
+/*
+	The first half of loading a PartType, ExpType or WeaponType: reading the
+	file and running the OmfgScript parser on it. Actions are not created yet
+	(that loads other resources), so this doesn't touch any global state and
+	can run on any thread. The second half, linking, reads the properties and
+	events from parser as before and has to run on the main thread.
+
+	The types' parse() does the first half with this, their load() then only
+	has to link. parse() can run on any thread.
+*/
+struct ParsedScript
+{
+	ParsedScript(std::string const& filename_);
+
+	// Add the events to parser before. Prints the parse errors and closes
+	// the file.
+	bool run();
+
+	std::string filename;
+	std::ifstream stream;
+	std::auto_ptr<OmfgScript::Parser> parser; // NULL if the file cannot be opened
+	bool ok;
+};
+
+#endif // VERMES_PARSED_SCRIPT_H
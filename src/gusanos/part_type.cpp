@@ -23,8 +23,10 @@
 
 #include "particle.h"
 #include "simple_particle.h"
+#include "simple_particle_system.h"
 #include "game_actions.h"
 #include "omfgscript/omfg_script.h"
+#include "parsed_script.h"
 #include "script.h"
 #include "FindFile.h"
 #include "game/Game.h"
@@ -95,6 +97,17 @@ CGameObject* newParticle_SimpleParticle(PartType* type, Vec pos_ = Vec(0.f, 0.f)
 	return particle;
 }
 
+#ifndef DEDICATED_ONLY
+// Nobody can see the particle, so it doesn't need to be an object. See SimpleParticleSystem.
+CGameObject* newParticle_SimpleParticleBatched(PartType* type, Vec pos_ = Vec(0.f, 0.f), Vec spd_ = Vec(0.f, 0.f), int dir = 1, CWormInputHandler* owner = NULL, Angle angle = Angle(0))
+{
+	int timeout = type->simpleParticle_timeout + rndInt(type->simpleParticle_timeoutVariation);
+	
+	simpleParticles.add(pos_, spd_, timeout, type->gravity, type->colour, type->wupixels, type->renderLayer);
+	return 0;
+}
+#endif
+
 #ifdef DEDICATED_ONLY
 CGameObject* newParticle_Dummy(PartType* type, Vec pos_ = Vec(0.f, 0.f), Vec spd_ = Vec(0.f, 0.f), int dir = 1, CWormInputHandler* owner = NULL, Angle angle = Angle(0))
 {
@@ -108,8 +121,8 @@ CGameObject* newParticle_Dummy(PartType* type, Vec pos_ = Vec(0.f, 0.f), Vec spd
 #endif
 
 PartType::PartType()
-: ResourceBase(), newParticle(0), wupixels(0)
-, invisible(false)
+: ResourceBase(), newParticle(0), newParticleObject(0), wupixels(0)
+, invisible(false), m_parsed(NULL)
 {
 	gravity			= 0;
 	bounceFactor	= 1;
@@ -159,6 +172,7 @@ PartType::PartType()
 
 PartType::~PartType()
 {
+	delete m_parsed;
 	delete groundCollision;
 	delete creation;
 #ifndef DEDICATED_ONLY
@@ -369,17 +383,14 @@ bool PartType::load(std::string const& filename)
 	return true;
 }
 
-bool PartType::_load(std::string const& filename)
+bool PartType::parse(std::string const& filename)
 {
-	std::ifstream fileStream;
-	OpenGameFileR(fileStream, filename, std::ios::binary | std::ios::in);
-
-	if(!fileStream) {
-		notes << "PartType: cannot open " << filename << endl;
+	delete m_parsed;
+	m_parsed = new ParsedScript(filename);
+	if(!m_parsed->parser.get())
 		return false;
-	}
 	
-	OmfgScript::Parser parser(fileStream, gameActions, filename);
+	OmfgScript::Parser& parser = *m_parsed->parser;
 	
 	namespace af = OmfgScript::ActionParamFlags;
 		
@@ -404,11 +415,27 @@ bool PartType::_load(std::string const& filename)
 		("detect_owner")
 		("layers")
 	;
-		
-	if(!parser.run())
+	
+	return m_parsed->run();
+}
+
+bool PartType::_load(std::string const& filename)
+{
+	// Already parsed if ResourceList::preparse() found the file
+	if(!m_parsed)
+		parse(filename);
+	std::auto_ptr<ParsedScript> parsed(m_parsed);
+	m_parsed = NULL;
+
+	if(!parsed->parser.get()) {
+		notes << "PartType: cannot open " << filename << endl;
+		return false;
+	}
+	
+	OmfgScript::Parser& parser = *parsed->parser;
+	
+	if(!parsed->ok)
 	{
-		if(parser.incomplete())
-			parser.error("Trailing garbage");
 		notes << "PartType: cannot parse " << filename << endl;
 		return false;
 	}
@@ -586,12 +613,17 @@ bool PartType::_load(std::string const& filename)
 	{
 #ifndef DEDICATED_ONLY
 		newParticle = newParticle_SimpleParticle<SimpleParticle>;
+		// Undetectable and without creation event: nothing can ever refer to it
+		if( colLayer < 0 && !creation )
+			newParticle = newParticle_SimpleParticleBatched;
+		newParticleObject = newParticle_SimpleParticle<SimpleParticle>;
 #else
 		newParticle = newParticle_Dummy;
+		newParticleObject = newParticle_Dummy;
 #endif
 	}
 	else
-		newParticle = newParticle_Particle;
+		newParticle = newParticleObject = newParticle_Particle;
 		
 	if( colLayer >= 0 )
 		colLayer = Grid::CustomColLayerStart + colLayer;
@@ -28,6 +28,7 @@ struct DetectEvent;
 class CWormInputHandler;
 class PartType;
 struct TimerEvent;
+struct ParsedScript;
 
 typedef CGameObject* (*NewParticleFunc)(PartType* type, Vec pos_, Vec spd_, int dir, CWormInputHandler* owner, Angle angle);
 
@@ -48,6 +49,8 @@ public:
 	void touch();
 	bool isSimpleParticleType();
 	bool load(std::string const& filename);
+	// The thread-safe first half of load(), see ParsedScript
+	bool parse(std::string const& filename);
 	
 	virtual void finalize();
 
@@ -55,6 +58,8 @@ public:
 	BaseAnimator* allocateAnimator();
 #endif
 	NewParticleFunc newParticle;
+	// Like newParticle, but always creates an object, for callers which need it
+	NewParticleFunc newParticleObject;
 
 	float gravity;
 	float bounceFactor;
@@ -124,6 +129,8 @@ public:
 		ANIM_RIGHTONCE
 	};
 	
+private:
+	ParsedScript* m_parsed; // Between parse() and _load()
 };
 
 extern ResourceList<PartType> partTypeList;
@@ -8,7 +8,11 @@
 #include <iostream>
 #include "util/macros.h"
 #include "Debug.h"
+#include "StringUtils.h"
+#include "TaskScheduler.h"
+#include "gusanos/allegro.h"
 #include <boost/cstdint.hpp>
+#include <boost/bind.hpp>
 
 /*
 namespace fs {
@@ -24,6 +28,23 @@ namespace fs {
 using std::cerr;
 using std::endl;
 
+// Calls items[i]->parse(files[i]) for all i, in parallel if there is a task scheduler
+template<typename T>
+void parseInParallel(std::vector<T*> const& items, std::vector<std::string> const& files)
+{
+	if(!taskScheduler)
+	{
+		for(size_t i = 0; i < items.size(); ++i)
+			items[i]->parse(files[i]);
+		return;
+	}
+	
+	TaskGroup group;
+	for(size_t i = 0; i < items.size(); ++i)
+		taskScheduler->spawn(group, boost::bind(&T::parse, items[i], files[i]));
+	taskScheduler->wait(group);
+}
+
 template<typename T1>
 class ResourceList
 {
@@ -39,6 +60,7 @@ public:
 	
 	void clear()
 	{
+		dropPreparsed();
 		m_paths.clear();
 		typename MapT::iterator item = m_resItems.begin();
 		for (; item != m_resItems.end(); ++item)
@@ -83,10 +105,37 @@ public:
 		}
 		else
 		{
-			T1 *i = new T1;
-			m_resItems[filename] = i;
+			std::string key = filename;
+			stringlwr(key);
+			typename PreparsedMap::iterator pre = m_preparsed.find(key);
+			
+			T1 *i;
+			bool ok;
+			if(pre != m_preparsed.end())
+			{
+				// We know where it is and it is parsed already, only link it
+				i = pre->second.second;
+				std::string const path = pre->second.first;
+				m_preparsed.erase(pre);
+				m_resItems[filename] = i;
+				ok = i->load(path + "/" + filename);
+				if(!ok)
+				{
+					// Broken file, fall back to the other paths like load(name, resource)
+					i->deleteThis();
+					i = new T1;
+					m_resItems[filename] = i;
+					ok = load(filename, *i);
+				}
+			}
+			else
+			{
+				i = new T1;
+				m_resItems[filename] = i;
+				ok = load(filename, *i);
+			}
 
-			if(load(filename, *i))
+			if(ok)
 			{
 				return i;
 			}
@@ -102,6 +151,37 @@ public:
 		}
 	}
 	
+	// Parses all files with the extension ext in the paths at once, in parallel.
+	// load() then takes them from here and only has to link them (T1::parse()
+	// and T1::load()). Like load(), the first path which has a file wins.
+	void preparse(std::string const& ext)
+	{
+		std::vector<T1*> items;
+		std::vector<std::string> files;
+		
+		for(std::list<std::string>::iterator p = m_paths.begin(); p != m_paths.end(); ++p)
+		{
+			if(!gusIsDirectory(*p)) continue;
+			for(Iterator<std::string>::Ref f = gusFileListIter(*p); f->isValid(); f->next())
+			{
+				std::string const name = f->get();
+				if(!stringcaseequal(GetFileExtensionWithDot(name), ext)) continue;
+				
+				std::string key = name;
+				stringlwr(key);
+				if(m_preparsed.count(key)) continue;
+				if(m_resItems.find(name) != m_resItems.end()) continue;
+				
+				T1* i = new T1;
+				m_preparsed[key] = std::make_pair(*p, i);
+				items.push_back(i);
+				files.push_back(*p + "/" + name);
+			}
+		}
+		
+		parseInParallel(items, files);
+	}
+	
 	void think()
 	{
 		typename MapT::iterator i = m_resItems.begin();
@@ -113,6 +193,7 @@ public:
 	
 	void indexate()
 	{
+		dropPreparsed();
 		m_locked = true;
 		typename MapT::iterator item = m_resItems.begin();
 		for( size_t i = 0; item != m_resItems.end() ; ++item, ++i )
@@ -163,6 +244,18 @@ public:
 	
 private:
 	
+	// Parsed by preparse() but never loaded
+	void dropPreparsed()
+	{
+		for(typename PreparsedMap::iterator i = m_preparsed.begin(); i != m_preparsed.end(); ++i)
+			i->second.second->deleteThis();
+		m_preparsed.clear();
+	}
+	
+	// Lower case file name -> path and parsed resource
+	typedef std::map<std::string, std::pair<std::string, T1*> > PreparsedMap;
+	
+	PreparsedMap m_preparsed;
 	bool m_locked;
 	std::vector<T1*> m_resItemsIndex;
 	MapT m_resItems;
@@ -0,0 +1,123 @@
+#include "simple_particle_system.h"
+
+#include "gusgame.h"
+#ifndef DEDICATED_ONLY
+#include "gfx.h"
+#include "blitters/blitters.h"
+#include "CViewport.h"
+#endif
+#include "game/CMap.h"
+#include "game/Game.h"
+
+SimpleParticleSystem simpleParticles;
+
+void SimpleParticleSystem::Batch::resize(size_t n)
+{
+	posX.resize(n); posY.resize(n);
+	spdX.resize(n); spdY.resize(n);
+	gravity.resize(n);
+	timeout.resize(n);
+	colour.resize(n);
+	wupixel.resize(n);
+}
+
+void SimpleParticleSystem::add(Vec const& pos, Vec const& spd, int timeout, float gravity, uint32_t colour, bool wupixel, int renderLayer)
+{
+	if(renderLayer < 0 || renderLayer >= Grid::RenderLayerCount)
+		return;
+
+	Batch& b = batches[renderLayer];
+	b.posX.push_back(pos.x); b.posY.push_back(pos.y);
+	b.spdX.push_back(spd.x); b.spdY.push_back(spd.y);
+	b.gravity.push_back(gravity);
+	b.timeout.push_back(timeout);
+	b.colour.push_back(colour);
+	b.wupixel.push_back(wupixel ? 1 : 0);
+}
+
+void SimpleParticleSystem::think()
+{
+	CMap* map = game.gameMap();
+	if(!map) return;
+
+	// particle_pass of all materials, looked up once instead of per particle
+	bool pass[256];
+	for(int i = 0; i < 256; ++i)
+		pass[i] = map->materialArray()[i].particle_pass;
+
+	for(int l = 0; l < Grid::RenderLayerCount; ++l)
+	{
+		Batch& b = batches[l];
+		const size_t n = b.size();
+		if(n == 0) continue;
+
+		float* posX = &b.posX[0];
+		float* posY = &b.posY[0];
+		float* spdX = &b.spdX[0];
+		float* spdY = &b.spdY[0];
+		float* gravity = &b.gravity[0];
+		int* timeout = &b.timeout[0];
+		uint32_t* colour = &b.colour[0];
+		unsigned char* wupixel = &b.wupixel[0];
+
+		for(size_t i = 0; i < n; ++i)
+			spdY[i] += gravity[i];
+
+		// Move the survivors down over the dead ones
+		size_t alive = 0;
+		for(size_t i = 0; i < n; ++i)
+		{
+			const float nextX = posX[i] + spdX[i];
+			const float nextY = posY[i] + spdY[i];
+			if(!pass[map->getMaterialIndex(int(nextX), int(nextY))] || --timeout[i] == 0)
+				continue;
+
+			posX[alive] = nextX;
+			posY[alive] = nextY;
+			spdX[alive] = spdX[i];
+			spdY[alive] = spdY[i];
+			gravity[alive] = gravity[i];
+			timeout[alive] = timeout[i];
+			colour[alive] = colour[i];
+			wupixel[alive] = wupixel[i];
+			++alive;
+		}
+
+		if(alive != n)
+			b.resize(alive);
+	}
+}
+
+#ifndef DEDICATED_ONLY
+void SimpleParticleSystem::draw(CViewport* viewport, int renderLayer)
+{
+	Batch& b = batches[renderLayer];
+	const size_t n = b.size();
+
+	for(size_t i = 0; i < n; ++i)
+	{
+		IVec rPos = viewport->convertCoords(IVec(Vec(b.posX[i], b.posY[i])));
+		if(!b.wupixel[i])
+			putpixel2x2(viewport->dest, rPos.x, rPos.y, b.colour[i]);
+		else {
+			for(short dy = 0; dy < 2; ++dy)
+			for(short dx = 0; dx < 2; ++dx)
+			Blitters::putpixelwu_blend_32(viewport->dest, rPos.x+dx, rPos.y+dy, b.colour[i], 256);
+		}
+	}
+}
+#endif
+
+void SimpleParticleSystem::clear()
+{
+	for(int l = 0; l < Grid::RenderLayerCount; ++l)
+		batches[l].resize(0);
+}
+
+size_t SimpleParticleSystem::size() const
+{
+	size_t s = 0;
+	for(int l = 0; l < Grid::RenderLayerCount; ++l)
+		s += batches[l].size();
+	return s;
+}
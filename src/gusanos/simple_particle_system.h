@@ -0,0 +1,51 @@
+#ifndef VERMES_SIMPLE_PARTICLE_SYSTEM_H
+#define VERMES_SIMPLE_PARTICLE_SYSTEM_H
+
+#include <vector>
+#include <cstddef>
+#include "CVec.h"
+#include "object_grid.h"
+
+class CViewport;
+
+/*
+	Simple particles which nobody can detect and which have no creation event
+	don't need to be game objects. They are kept here instead, one batch per
+	render layer, with each field in its own array. think() runs over those
+	arrays in tight loops without virtual calls or pointer chasing, and drops
+	dead particles by compacting the arrays.
+
+	Behaviour is the same as SimpleParticle::think()/draw().
+*/
+class SimpleParticleSystem
+{
+public:
+	void add(Vec const& pos, Vec const& spd, int timeout, float gravity, uint32_t colour, bool wupixel, int renderLayer);
+
+	void think();
+#ifndef DEDICATED_ONLY
+	void draw(CViewport* viewport, int renderLayer);
+#endif
+	void clear();
+	size_t size() const;
+
+private:
+	struct Batch
+	{
+		std::vector<float> posX, posY;
+		std::vector<float> spdX, spdY;
+		std::vector<float> gravity;
+		std::vector<int> timeout;
+		std::vector<uint32_t> colour;
+		std::vector<unsigned char> wupixel;
+
+		size_t size() const { return posX.size(); }
+		void resize(size_t n);
+	};
+
+	Batch batches[Grid::RenderLayerCount];
+};
+
+extern SimpleParticleSystem simpleParticles;
+
+#endif // VERMES_SIMPLE_PARTICLE_SYSTEM_H
@@ -13,6 +13,7 @@
 #include "lua/bindings-gfx.h"
 #include "blitters/blitters.h"
 #include "culling.h"
+#include "simple_particle_system.h"
 #include "game/CMap.h"
 #include "game/Game.h"
 #include "FlagInfo.h"
@@ -171,8 +172,12 @@ void CViewport::gusRender(const SmartPointer<SDL_Surface>& bmpDest)
 			w->get()->Draw(bmpDest.get(), this);
 	}
 
-	for ( Grid::iterator iter = game.objects.beginAll(); iter; ++iter)
-		iter->draw(this);
+	for ( int layer = 0; layer < Grid::RenderLayerCount; ++layer)
+	{
+		for ( Grid::iterator iter = game.objects.beginRenderLayer(layer); iter; ++iter)
+			iter->draw(this);
+		simpleParticles.draw(this, layer);
+	}
 
 	if(game.isLevelDarkMode() && pcTargetWorm) {
 		if(pcTargetWorm->isActive())
@@ -7,6 +7,7 @@
 #include "resource_base.h"
 #include "game_actions.h"
 #include "omfgscript/omfg_script.h"
+#include "parsed_script.h"
 #include "util/macros.h"
 #include "timer_event.h"
 #include "luaapi/context.h"
@@ -46,10 +47,13 @@ WeaponType::WeaponType() : ResourceBase()
 	primaryReleased = NULL;
 	outOfAmmo = NULL;
 	reloadEnd = NULL;
+
+	m_parsed = NULL;
 }
 
 WeaponType::~WeaponType()
 {
+	delete m_parsed;
 	delete primaryShoot;
 	delete primaryPressed;
 	delete primaryReleased;
@@ -84,19 +88,14 @@ namespace GameEventID
 	};
 }
 
-bool WeaponType::load(std::string const& filename)
+bool WeaponType::parse(std::string const& filename)
 {
-	std::ifstream fileStream;
-	OpenGameFileR(fileStream, filename, std::ios::binary | std::ios::in);
-
-	if (!fileStream ) {
-		//notes << "WeaponType: cannot load " << filename << endl;
+	delete m_parsed;
+	m_parsed = new ParsedScript(filename);
+	if(!m_parsed->parser.get())
 		return false;
-	}
-	
-	fileName = filename;
 
-	OmfgScript::Parser parser(fileStream, gameActions, filename);
+	OmfgScript::Parser& parser = *m_parsed->parser;
 
 	namespace af = OmfgScript::ActionParamFlags;
 
@@ -120,9 +119,27 @@ bool WeaponType::load(std::string const& filename)
 	("start_delay")
 	;
 
-	if(!parser.run()) {
-		if(parser.incomplete())
-			parser.error("Trailing garbage");
+	return m_parsed->run();
+}
+
+bool WeaponType::load(std::string const& filename)
+{
+	// Already parsed if GusGame::loadWeapons() did that in parallel
+	if(!m_parsed)
+		parse(filename);
+	std::auto_ptr<ParsedScript> parsed(m_parsed);
+	m_parsed = NULL;
+
+	if (!parsed->parser.get()) {
+		//notes << "WeaponType: cannot load " << filename << endl;
+		return false;
+	}
+	
+	fileName = filename;
+
+	OmfgScript::Parser& parser = *parsed->parser;
+
+	if(!parsed->ok) {
 		notes << "WeaponType: error at parsing" << endl;
 		return false;
 	}
@@ -17,6 +17,7 @@ class SpriteSet;
 #endif
 struct GameEvent;
 struct TimerEvent;
+struct ParsedScript;
 
 class WeaponType : public ResourceBase
 {
@@ -28,6 +29,8 @@ public:
 	~WeaponType();
 	
 	bool load(const std::string &filename);
+	// The thread-safe first half of load(), see ParsedScript
+	bool parse(std::string const& filename);
 	
 	virtual void finalize();
 
@@ -60,6 +63,9 @@ public:
 	GameEvent *primaryReleased;
 	GameEvent *outOfAmmo;
 	GameEvent *reloadEnd;
+
+private:
+	ParsedScript* m_parsed; // Between parse() and load()
 };
 
 struct WeaponOrder
@@ -29,6 +29,8 @@
 #include "Entity.h"
 #include "Error.h"
 #include "DedicatedControl.h"
+#include "MatchBenchmark.h"
+#include "FrameCapture.h"
 #include "Physics.h"
 #include "Version.h"
 #include "OLXG15.h"
@@ -86,6 +88,15 @@ static void ParseArguments_AfterInit(int argc, char *argv[]);
 
 static std::list<std::string> startupCommands;
 
+// -benchmark and its parameters
+static std::string benchmarkScenario;
+static int benchmarkTicks = 0; // 0: take it from the scenario
+static int benchmarkSeed = -1; // -1: take it from the scenario
+static std::string benchmarkOutput;
+
+// -playdemo
+static std::string playDemoFile;
+
 
 //
 // Loading screen info and functions
@@ -499,6 +510,41 @@ static void ParseArguments_AfterInit(int argc, char *argv[])
 				warnings << "-connect needs an additinal parameter" << endl;
 		} else
 
+		// -benchmark
+		// runs a headless benchmark match (next param is the scenario) and quits
+		if( stricmp(a, "-benchmark") == 0 ) {
+			if(argv[i + 1] != NULL) {
+				bDedicated = true;
+				bDisableSound = true;
+				tLXOptions->sDedicatedScript = "/dev/null";
+				benchmarkScenario = argv[++i];
+			}
+			else
+				warnings << "-benchmark needs an additinal parameter" << endl;
+		} else
+
+		// -ticks, -seed, -benchout
+		// benchmark parameters (next param)
+		if( stricmp(a, "-ticks") == 0 || stricmp(a, "-seed") == 0 || stricmp(a, "-benchout") == 0 ) {
+			if(argv[i + 1] != NULL) {
+				std::string value = argv[++i];
+				if( stricmp(a, "-ticks") == 0 ) benchmarkTicks = from_string<int>(value);
+				else if( stricmp(a, "-seed") == 0 ) benchmarkSeed = from_string<int>(value);
+				else benchmarkOutput = value;
+			}
+			else
+				warnings << a << " needs an additinal parameter" << endl;
+		} else
+
+		// -playdemo
+		// plays a demo (next param); together with -dedicated headless and as fast as possible
+		if( stricmp(a, "-playdemo") == 0 ) {
+			if(argv[i + 1] != NULL)
+				playDemoFile = argv[++i];
+			else
+				warnings << "-playdemo needs an additinal parameter" << endl;
+		} else
+
 		// -exec
 		// pushes a startup command
 		if( stricmp(a, "-exec") == 0 ) {
@@ -560,6 +606,11 @@ static void ParseArguments_AfterInit(int argc, char *argv[])
      		printf("   -opengl       OpenLieroX will use OpenGL for drawing\n");
      		printf("   -noopengl     Explicitly disable using OpenGL\n");
      		printf("   -dedicated    Dedicated mode\n");
+			printf("   -benchmark s  Runs the benchmark scenario s headless and quits\n");
+			printf("   -playdemo f   Plays the demo f (with -dedicated: headless, as fast as possible)\n");
+			printf("   -ticks n      Benchmark: number of simulated ticks\n");
+			printf("   -seed n       Benchmark: random seed\n");
+			printf("   -benchout f   Benchmark: write the JSON report to file f\n");
      		printf("   -nojoystick   Disable Joystick support\n");
      		printf("   -nosound      Disable sound\n");
      		printf("   -window       Run in window mode\n");
@@ -569,6 +620,7 @@ static void ParseArguments_AfterInit(int argc, char *argv[])
 			#endif
 			#ifdef DEBUG
      		printf("   -nettest      Test CChannel reliability\n");
+     		printf("   -nettestrate  Test CChannel send rate controller\n");
 			#endif
      		printf("   -skin         Turns on new skinned GUI - it's unfinished yet\n");
      		printf("   -noskin       Turns off new skinned GUI\n");
@@ -588,8 +640,25 @@ static void ParseArguments_AfterInit(int argc, char *argv[])
 			ShutdownLieroX();
      		exit(0);
 		}
+		if( !stricmp(a, "-nettestrate") )
+		{
+			InitializeLieroX();
+			TestCChannelSendRate();
+			ShutdownLieroX();
+     		exit(0);
+		}
 		#endif
     }
+
+	if(playDemoFile != "") {
+		if(bDedicated) {
+			// no dedicated script which would start a server
+			tLXOptions->sDedicatedScript = "/dev/null";
+			startupCommands.push_back("playDemo \"" + playDemoFile + "\" 0");
+		}
+		else
+			startupCommands.push_back("playDemo \"" + playDemoFile + "\"");
+	}
 }
 
 
@@ -697,6 +766,12 @@ bool InitializeLieroX()
 			return false;
 		}
 
+	if(benchmarkScenario != "")
+		if(!MatchBenchmark::Init(benchmarkScenario, benchmarkTicks, benchmarkSeed, benchmarkOutput)) {
+			errors << "couldn't init benchmark" << endl;
+			return false;
+		}
+
 	updateFileListCaches();
 	
 	notes << "Initializing ready" << endl;
@@ -834,6 +909,9 @@ void ShutdownLieroX()
 	if(bDedicated)
 		DedicatedControl::Uninit();
 
+	MatchBenchmark::Uninit();
+	FrameCapture::Uninit(); // writes the queued screenshots
+
 	if( ! bDedicated )
 		ShutdownBackgroundMusic();
 
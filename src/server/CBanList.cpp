@@ -22,91 +22,239 @@
 // BanList Constructor
 CBanList::CBanList()
 {
-    m_psBanList = NULL;
-    m_psSortedList = NULL;
-    m_nCount = 0;
+	m_ranges.push_back(TrieNode());
 	m_szPath = "cfg/ban.lst";
 	m_bLoading = false;
 }
 
 ///////////////////
-// Find a banned worm in the list
-banlist_t *CBanList::findBanned(const std::string& szAddress)
+// Parse an IPv4 address at pos, without allocating anything. pos is behind the address afterwards.
+bool CBanList::parseIP(const std::string& s, size_t& pos, Uint32& ip)
 {
-	if (m_nCount <= 0)
-		return NULL;
+	ip = 0;
+	for(int octet = 0; octet < 4; octet++) {
+		if(octet > 0) {
+			if(pos >= s.size() || s[pos] != '.')
+				return false;
+			pos++;
+		}
 
-	// Remove the port from the address
-	std::string addr = szAddress;
-	size_t pos = addr.find(':');
-	if(pos != std::string::npos) {
-		addr.erase(pos);
+		int value = 0, digits = 0;
+		for(; pos < s.size() && s[pos] >= '0' && s[pos] <= '9' && digits < 4; pos++, digits++)
+			value = value * 10 + (s[pos] - '0');
+		if(digits == 0 || value > 255)
+			return false;
+		ip = (ip << 8) | (Uint32)value;
 	}
-	TrimSpaces( addr );
+	return true;
+}
 
-    banlist_t *psWorm = m_psBanList;
+///////////////////
+// Parse a ban entry: "1.2.3.4", "1.2.3.0/24" or "1.2.*"
+bool CBanList::parseRange(const std::string& s, Uint32& ip, int& prefixLen)
+{
+	size_t pos = 0;
+	if(parseIP(s, pos, ip)) {
+		prefixLen = 32;
+		if(pos == s.size())
+			return true;
+		if(s[pos] != '/')
+			return false;
+
+		// CIDR
+		pos++;
+		if(pos == s.size() || pos + 2 < s.size())
+			return false;
+		prefixLen = 0;
+		for(; pos < s.size(); pos++) {
+			if(s[pos] < '0' || s[pos] > '9')
+				return false;
+			prefixLen = prefixLen * 10 + (s[pos] - '0');
+		}
+		if(prefixLen > 32)
+			return false;
+		ip = prefixLen ? (ip & (0xffffffffu << (32 - prefixLen))) : 0;
+		return true;
+	}
 
-    for(; psWorm; psWorm=psWorm->psNext) {
-        if( stringcasecmp(psWorm->szAddress, addr) == 0 )
-            return psWorm;
-    }
+	// Wildcards, all numbers must come before the first *
+	ip = 0;
+	prefixLen = 0;
+	pos = 0;
+	bool wildcard = false;
+	for(int octet = 0; octet < 4; octet++) {
+		if(octet > 0) {
+			if(pos == s.size())
+				break; // "1.2.*" is the same as "1.2.*.*"
+			if(s[pos] != '.')
+				return false;
+			pos++;
+		}
 
-    // No match
-    return NULL;
+		if(pos < s.size() && s[pos] == '*') {
+			pos++;
+			wildcard = true;
+			continue;
+		}
+		if(prefixLen != octet * 8)
+			return false; // Number behind a *
+
+		int value = 0, digits = 0;
+		for(; pos < s.size() && s[pos] >= '0' && s[pos] <= '9' && digits < 4; pos++, digits++)
+			value = value * 10 + (s[pos] - '0');
+		if(digits == 0 || value > 255)
+			return false;
+		ip |= (Uint32)value << (24 - octet * 8);
+		prefixLen += 8;
+	}
+	return wildcard && pos == s.size();
 }
 
 ///////////////////
-// Get the item ID from an address
-int CBanList::getIdByAddr(const std::string& szAddress)
+// Remove the port and spaces
+std::string CBanList::normalizeAddress(const std::string& szAddress)
 {
-	if (m_nCount <= 0)
-		return -1;
-
-	// Remove the port from the address
 	std::string addr = szAddress;
 	size_t pos = addr.find(':');
 	if(pos != std::string::npos) {
 		addr.erase(pos);
 	}
 	TrimSpaces( addr );
-    
-    banlist_t *psWorm = m_psBanList;
+	return addr;
+}
 
-    for(int i=0; psWorm; psWorm=psWorm->psNext,i++) {
-        if( stringcasecmp(psWorm->szAddress, addr) == 0 )
-            return i;
-    }
+void CBanList::indexEntry(banlist_t *entry)
+{
+	Uint32 ip;
+	int prefixLen;
+	if(!parseRange(entry->szAddress, ip, prefixLen)) {
+		m_other[stringtolower(entry->szAddress)] = entry;
+		return;
+	}
+
+	if(prefixLen == 32) {
+		m_exact[ip] = entry;
+		return;
+	}
+
+	int node = 0;
+	for(int bit = 0; bit < prefixLen; bit++) {
+		const int b = (ip >> (31 - bit)) & 1;
+		if(m_ranges[node].child[b] < 0) {
+			m_ranges[node].child[b] = (int)m_ranges.size();
+			m_ranges.push_back(TrieNode());
+		}
+		node = m_ranges[node].child[b];
+	}
+	m_ranges[node].entry = entry;
+}
+
+void CBanList::unindexEntry(banlist_t *entry)
+{
+	Uint32 ip;
+	int prefixLen;
+	if(!parseRange(entry->szAddress, ip, prefixLen)) {
+		m_other.erase(stringtolower(entry->szAddress));
+		return;
+	}
 
-    // No match
-    return -1;
+	if(prefixLen == 32) {
+		m_exact.erase(ip);
+		return;
+	}
+
+	// The nodes stay, they are rebuilt on the next load
+	int node = 0;
+	for(int bit = 0; bit < prefixLen && node >= 0; bit++)
+		node = m_ranges[node].child[(ip >> (31 - bit)) & 1];
+	if(node >= 0 && m_ranges[node].entry == entry)
+		m_ranges[node].entry = NULL;
 }
 
+///////////////////
+// Find the entry with exactly this address (not the entry which matches it)
+banlist_t *CBanList::findEntry(const std::string& addr)
+{
+	Uint32 ip;
+	int prefixLen;
+	if(!parseRange(addr, ip, prefixLen)) {
+		std::map<std::string, banlist_t *>::const_iterator it = m_other.find(stringtolower(addr));
+		return (it != m_other.end()) ? it->second : NULL;
+	}
+
+	if(prefixLen == 32) {
+		boost::unordered_map<Uint32, banlist_t *, IPHash>::const_iterator it = m_exact.find(ip);
+		return (it != m_exact.end()) ? it->second : NULL;
+	}
+
+	int node = 0;
+	for(int bit = 0; bit < prefixLen && node >= 0; bit++)
+		node = m_ranges[node].child[(ip >> (31 - bit)) & 1];
+	return (node >= 0) ? m_ranges[node].entry : NULL;
+}
 
 ///////////////////
-// Ban a worm
-void CBanList::addBanned(const std::string& szAddress, const std::string& szNick)
+// Find a banned worm in the list
+banlist_t *CBanList::findBanned(const std::string& szAddress)
 {
-	// Remove the port from the address
-	std::string addr = szAddress;
-	size_t p = addr.find(':');
-	if(p != std::string::npos) {
-		addr.erase(p);
+	if (m_entries.empty())
+		return NULL;
+
+	// The address as we get it from NetAddrToString, maybe with the port
+	size_t pos = 0;
+	while(pos < szAddress.size() && isspace((uchar)szAddress[pos]))
+		pos++;
+	Uint32 ip;
+	if(parseIP(szAddress, pos, ip) && (pos == szAddress.size() || szAddress[pos] == ':' || isspace((uchar)szAddress[pos]))) {
+		boost::unordered_map<Uint32, banlist_t *, IPHash>::const_iterator it = m_exact.find(ip);
+		if(it != m_exact.end())
+			return it->second;
+
+		// Walk down the ranges, the widest one which contains the IP wins
+		int node = 0;
+		for(int bit = 0; bit <= 32 && node >= 0; bit++) {
+			if(m_ranges[node].entry)
+				return m_ranges[node].entry;
+			if(bit == 32)
+				break;
+			node = m_ranges[node].child[(ip >> (31 - bit)) & 1];
+		}
+		return NULL;
 	}
 
-    banlist_t *psWorm = new banlist_t;
+	if(m_other.empty())
+		return NULL;
+	std::map<std::string, banlist_t *>::const_iterator it = m_other.find(stringtolower(normalizeAddress(szAddress)));
+	return (it != m_other.end()) ? it->second : NULL;
+}
 
-    if( !psWorm )
-        return;
+///////////////////
+// Add an entry, returns false if we already had it
+bool CBanList::addEntry(const std::string& szAddress, const std::string& szNick)
+{
+	const std::string addr = normalizeAddress(szAddress);
+	if(addr.empty())
+		return false;
 
-    psWorm->szNick = szNick;
-    psWorm->szAddress = addr;
-    
-    // Link it in
-    psWorm->psNext = m_psBanList;
-    m_psBanList = psWorm;
+	banlist_t *psWorm = findEntry(addr);
+	if(psWorm) {
+		psWorm->szNick = szNick;
+		return false;
+	}
+
+	psWorm = new banlist_t;
+	psWorm->szNick = szNick;
+	psWorm->szAddress = addr;
+	m_entries.push_back(psWorm);
+	indexEntry(psWorm);
+	return true;
+}
 
-    // Sort the list
-    sortList();
+///////////////////
+// Ban a worm
+void CBanList::addBanned(const std::string& szAddress, const std::string& szNick)
+{
+	addEntry(szAddress, szNick);
 
 	if (!m_bLoading)
 		saveList(m_szPath);
@@ -116,47 +264,20 @@ void CBanList::addBanned(const std::string& szAddress, const std::string& szNick
 // Unban a worm
 void CBanList::removeBanned(const std::string& szAddress)
 {
-	// Remove the port from the address
-	std::string addr = szAddress;
-	size_t pos = addr.find(':');
-	if(pos != std::string::npos) {
-		addr.erase(pos);
-	}
-
-    banlist_t *psWorm = findBanned(szAddress);
+	// Either the text of the entry (from the ban list dialog) or an address which is banned
+	banlist_t *psWorm = findEntry(normalizeAddress(szAddress));
+	if (!psWorm)
+		psWorm = findBanned(szAddress);
 	if (!psWorm)
 		return;
-	int ID = getIdByAddr(szAddress);
-	if (ID == -1)
-		return;
-
-	// Previous worm in ban list
-	banlist_t *psPrevWorm = getItemById(ID-1);
-	if (!psPrevWorm)  { // our worm is the first in the list
-		if (psWorm->psNext) 
-		  m_psBanList = psWorm->psNext;  // update the pointer to the first item
-		else
-		  m_psBanList = NULL;  // the worm is (was) the only one in the list
-		
-		// Unban the worm
-		delete psWorm;
-		psWorm = NULL;
-	}
-	else  {  // our worm isn't the first in the list
-		if (psWorm->psNext)
-			psPrevWorm->psNext = psWorm->psNext;  // our worm is somewhere in the middle of the list
-		else
-			psPrevWorm->psNext = NULL;  // our worm is the last in the list
-		
-		// Unban the worm
-		delete psWorm;
-		psWorm = NULL;
-	}
-
-	m_nCount--;  // update the number of items
 
-    // Sort the list
-    sortList();
+	unindexEntry(psWorm);
+	for(size_t i = 0; i < m_entries.size(); i++)
+		if(m_entries[i] == psWorm) {
+			m_entries.erase(m_entries.begin() + i);
+			break;
+		}
+	delete psWorm;
 
 	// Save the list
 	saveList(m_szPath);
@@ -172,47 +293,67 @@ void CBanList::saveList(const std::string& szFilename)
     if( !fp )
         return;
 
-    banlist_t *psWorm = m_psBanList;
-	if (!psWorm)
-		fputs("",fp);
-	else {
-		for(; psWorm; psWorm=psWorm->psNext) {
-
-			fprintf(fp, "%s,%s\n", psWorm->szAddress.c_str(), psWorm->szNick.c_str());
-		}
-	}  // else
+	for(size_t i = 0; i < m_entries.size(); i++)
+		fprintf(fp, "%s,%s\n", m_entries[i]->szAddress.c_str(), m_entries[i]->szNick.c_str());
 
     fclose(fp);
 }
 
 
 ///////////////////
-// Load the ban list
-void CBanList::loadList(const std::string& szFilename)
+// Read the entries of a ban list file into our list, returns how many were new
+int CBanList::readList(const std::string& szFilename)
 {
-	m_bLoading = true;
-    // Shutdown the list first
-    Shutdown();
-
     FILE *fp = OpenGameFile(szFilename, "rt");
     if( !fp )
-        return;
+        return 0;
 
+	int added = 0;
 	std::string line;
 	
     while( !feof(fp) ) {
         line = ReadUntil(fp, '\n');
-		std::vector<std::string> exploded = explode(line,",");
-		if (exploded.size() >= 2)
-			addBanned(exploded[0],exploded[1]);
+		TrimSpaces(line);
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		// address,nick - lists from elsewhere often have only the addresses
+		size_t comma = line.find(',');
+		if (comma == std::string::npos) {
+			if (addEntry(line, ""))
+				added++;
+		} else if (addEntry(line.substr(0, comma), line.substr(comma + 1)))
+			added++;
     }
 
     fclose(fp);
+	return added;
+}
+
+///////////////////
+// Load the ban list
+void CBanList::loadList(const std::string& szFilename)
+{
+	m_bLoading = true;
+    // Shutdown the list first
+    Shutdown();
+
+	readList(szFilename);
 
-    // Sort the list
-    sortList();
+	m_bLoading = false;
+}
 
+///////////////////
+// Import a (big) list, saved once at the end
+int CBanList::importList(const std::string& szFilename)
+{
+	m_bLoading = true;
+	const int added = readList(szFilename);
 	m_bLoading = false;
+
+	if (added > 0)
+		saveList(m_szPath);
+	return added;
 }
 
 ///////////////////
@@ -239,69 +380,14 @@ bool CBanList::isBanned(const std::string& szAddress)
 }
 
 
-
-///////////////////
-// Return the sorted ban list
-banlist_t *CBanList::getList()
-{
-	sortList();
-    return m_psSortedList;
-}
-
-
 ///////////////////
 // Return the number of banned IPs
 int CBanList::getNumItems()
 {
-    return m_nCount;
+    return (int)m_entries.size();
 }
 
 
-///////////////////
-// Create a sorted list
-void CBanList::sortList() {
-    int i, j;
-
-    // Free any previous list
-    if( m_psSortedList )
-        delete[] m_psSortedList;
-
-    // Count the number of banned worms
-    m_nCount = 0;
-    banlist_t *psWorm = m_psBanList;
-    for(; psWorm; psWorm=psWorm->psNext)  {
-        m_nCount++;
-	}
-
-    // Allocate the sorted list
-    m_psSortedList = new banlist_t[m_nCount];
-    if( !m_psSortedList )
-        return;
-
-    // Fill in the links
-    psWorm = m_psBanList;
-    for( i=0; i<m_nCount; i++, psWorm=psWorm->psNext)
-        m_psSortedList[i].psLink = psWorm;
-    
-    if( m_nCount < 2 )
-        return;
-
-    // Sort the list using a simple bubble sort
-    banlist_t temp;
-   	for(i=0; i<m_nCount; i++) {
-		for(j=0; j<m_nCount-1-i; j++) {
-
-            if( m_psSortedList[j].psLink->szNick.compare( m_psSortedList[j+1].psLink->szNick) > 0 ) {
-
-                // Swap the 2 items
-                temp = m_psSortedList[j];
-                m_psSortedList[j] = m_psSortedList[j+1];
-                m_psSortedList[j+1] = temp;
-            }
-        }
-    }
-}
-
 ///////////////////
 // Path to the ban list file
 std::string CBanList::getPath() {
@@ -311,38 +397,21 @@ std::string CBanList::getPath() {
 ///////////////////
 // Get the specified item
 banlist_t *CBanList::getItemById(int ID) {
-    if (ID > m_nCount || ID < 0)
+    if (ID >= (int)m_entries.size() || ID < 0)
 		return NULL;
-	banlist_t *psWorm = m_psBanList;
-
-	if(!psWorm)
-		return NULL;
-
-    for(int i=0; psWorm; psWorm=psWorm->psNext,i++)  {
-		if (ID == i) 
-		  return psWorm;
-	}
-
-	return NULL;
+	return m_entries[ID];
 }
 
 ///////////////////
 // Shutdown the ban list
 void CBanList::Shutdown()
 {
-     banlist_t *psWorm = m_psBanList;
-     banlist_t *psNext = NULL;
-
-     for(; psWorm; psWorm=psNext) {
-         psNext = psWorm->psNext;
-
-         delete psWorm;
-     }
-
-     m_psBanList = NULL;
-
-    // Free any sorted list
-    if( m_psSortedList )
-        delete[] m_psSortedList;
-    m_psSortedList = NULL;
+	for(size_t i = 0; i < m_entries.size(); i++)
+		delete m_entries[i];
+	m_entries.clear();
+
+	m_exact.clear();
+	m_other.clear();
+	m_ranges.clear();
+	m_ranges.push_back(TrieNode());
 }
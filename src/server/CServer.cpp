@@ -60,7 +60,7 @@ GameServer	*cServer = NULL;
 // declare them only locally here as nobody really should use them explicitly
 std::string OldLxCompatibleString(const std::string &Utf8String);
 
-GameServer::GameServer() {
+GameServer::GameServer() : tChallenges(MAX_CHALLENGES) {
 	m_flagInfo = NULL;
 	cClients = NULL;
 	Clear();
@@ -95,15 +95,13 @@ void GameServer::Clear()
 	fLastUpdateSent = AbsTime();
 
 	cBanList.loadList("cfg/ban.lst");
-	cShootList.Clear();
+	cShotJournal.Clear();
 
 	iSuicidesInPacket = 0;
 
-	for(int i=0; i<MAX_CHALLENGES; i++) {
-		SetNetAddrValid(tChallenges[i].Address, false);
-		tChallenges[i].fTime = 0;
-		tChallenges[i].iNum = 0;
-	}
+	tChallenges.clear();
+	m_queryLimiter.clear();
+	invalidateConnectionlessReplies();
 
 	tMasterServers.clear();
 	tCurrentMasterServer = tMasterServers.begin();
@@ -198,12 +196,6 @@ int GameServer::StartServer()
 	for(int i=0;i<MAX_BONUSES;i++)
 		cBonuses[i].setUsed(false);
 
-	// Shooting list
-	if( !cShootList.Initialize() ) {
-		SetError("Error: Out of memory!\nsv::Startserver() " + itoa(__LINE__));
-		return false;
-	}
-
 	// In the lobby
 	game.state = Game::S_Lobby;
 	
@@ -367,7 +359,7 @@ int GameServer::PrepareGame(std::string* errMsg)
 		cBonuses[i].setUsed(false);
 
 	// Clear the shooting list
-	cShootList.Clear();
+	cShotJournal.Clear();
 
 	m_flagInfo->reset();
 	
@@ -377,7 +369,7 @@ int GameServer::PrepareGame(std::string* errMsg)
 
 	// Set all the clients to 'not ready'
 	for(int i=0;i<MAX_CLIENTS;i++) {
-		cClients[i].getShootList()->Clear();
+		cClients[i].getShotCursor() = cShotJournal.end();
 		cClients[i].setGameReady(false);
 		cClients[i].getUdpFileDownloader()->allowFileRequest(false);
 	}
@@ -441,7 +433,7 @@ void GameServer::BeginMatch(CServerConnection* receiver)
 		// Initialize some server settings
 		game.serverFrame = 0;
 		game.gameOver = false;
-		cShootList.Clear();
+		cShotJournal.Clear();
 	}
 	
 	// Send the connected clients a startgame message
@@ -2160,7 +2152,7 @@ void GameServer::Shutdown()
 		m_flagInfo = NULL;
 	}
 	
-	cShootList.Shutdown();
+	cShotJournal.Clear();
 
 	cBanList.Shutdown();
 	
@@ -51,7 +51,7 @@ CServerConnection::CServerConnection( GameServer * _server ) {
 	bGameReady = false;
 	m_gusLoggedIn = false;
 	
-	cShootList.Initialize();
+	iShotCursor = 0;
 	gameState = NULL;
 
 	fLastFileRequest = fConnectTime = tLX->currentTime;
@@ -79,8 +79,7 @@ void CServerConnection::Clear()
 	fLastReceived = AbsTime::Max();
 	fLastUpdateSent = AbsTime();
 
-	cShootList.Shutdown();
-	cShootList.Initialize();
+	iShotCursor = server ? server->getShotJournal()->end() : 0;
 
 	if(gameState)
 		delete gameState;
@@ -154,9 +153,6 @@ void CServerConnection::setGameReady(bool _g) {
 // Shutdown the client
 void CServerConnection::Shutdown()
 {	
-	// Shooting list
-	cShootList.Shutdown();
-
 	if(gameState)
 		delete gameState;
 	gameState = NULL;
@@ -354,14 +354,8 @@ void GameServer::WormShootEnd(CWorm* w, const weapon_t* wpn) {
 	if( w->hasOwnServerTime() )
 		time = w->serverTime();
 	
-	// Add the shot to ALL the connected clients shootlist
-	CServerConnection *cl = getClients();
-	for(short i=0; i<MAX_CLIENTS; i++,cl++) {
-		if(cl->getStatus() == NET_DISCONNECTED)
-			continue;
-		
-		cl->getShootList()->addShoot(wpn->ID, time, speed, (int)Angle, w, true);
-	}
+	// Add the shot once, all connected clients get it from there
+	cShotJournal.addShoot(wpn->ID, time, speed, (int)Angle, w, true);
 }
 
 ///////////////////
@@ -439,14 +433,8 @@ void GameServer::WormShoot(CWorm *w)
 	if( game.isClient() && w->hasOwnServerTime() )
 		time = w->serverTime();
 	
-	// Add the shot to ALL the connected clients shootlist
-	CServerConnection *cl = getClients();
-	for(short i=0; i<MAX_CLIENTS; i++,cl++) {
-		if(cl->getStatus() == NET_DISCONNECTED)
-			continue;
-
-		cl->getShootList()->addShoot(Slot->weapon()->ID, time, speed, (int)Angle, w, false);
-	}
+	// Add the shot once, all connected clients get it from there
+	cShotJournal.addShoot(Slot->weapon()->ID, time, speed, (int)Angle, w, false);
 
 	
 
@@ -1048,6 +1048,15 @@ void CServerNetEngineBeta9::ParseNewNetChecksum(CBytestream *bs)
 void GameServer::ParseConnectionlessPacket(const SmartPointer<NetworkSocket>& tSocket, CBytestream *bs, const std::string& ip) {
 	std::string cmd = bs->readString(128);
 
+	// Everybody can send these, drop them as early as possible when somebody floods us
+	if (cmd == "lx::getchallenge" || cmd == "lx::ping" || cmd == "lx::time" || cmd == "lx::query" ||
+		cmd == "lx::getinfo" || cmd == "lx::wantsjoin") {
+		if (!allowConnectionlessQuery(ip)) {
+			bs->SkipAll();
+			return;
+		}
+	}
+
 	if (cmd == "lx::getchallenge")
 		ParseGetChallenge(tSocket, bs);
 	else if (cmd == "lx::connect")
@@ -1073,13 +1082,45 @@ void GameServer::ParseConnectionlessPacket(const SmartPointer<NetworkSocket>& tS
 }
 
 
+///////////////////
+// Rate limit for the connectionless queries, per IP
+bool GameServer::allowConnectionlessQuery(const std::string& ip) {
+	if (tLXOptions->iQueryRateLimit <= 0)
+		return true;
+
+	// All ports of an IP share the bucket
+	const size_t pos = ip.rfind(':');
+	const std::string source = (pos != std::string::npos) ? ip.substr(0, pos) : ip;
+	return m_queryLimiter.allow(source, tLX->currentTime, (float)tLXOptions->iQueryRateLimit, (float)MAX(tLXOptions->iQueryBurst, 1));
+}
+
+bool GameServer::isReplyCached(const ConnectionlessReply& r) {
+	if (!r.valid || tLXOptions->iQueryReplyCacheTime <= 0)
+		return false;
+	if (r.state != (int)game.state || r.worms != (int)game.worms()->size())
+		return false;
+	const Uint64 now = tLX->currentTime.milliseconds();
+	return now >= r.built.milliseconds() && now < r.built.milliseconds() + (Uint64)tLXOptions->iQueryReplyCacheTime;
+}
+
+void GameServer::cacheReply(ConnectionlessReply& r, const std::string& data) {
+	r.data = data;
+	r.built = tLX->currentTime;
+	r.state = (int)game.state;
+	r.worms = (int)game.worms()->size();
+	r.valid = true;
+}
+
+void GameServer::invalidateConnectionlessReplies() {
+	m_queryReply.valid = false;
+	m_infoReply.valid = false;
+}
+
+
 ///////////////////
 // Handle a "getchallenge" msg
 void GameServer::ParseGetChallenge(const SmartPointer<NetworkSocket>& tSocket, CBytestream *bs_in) {
-	int			i;
 	NetworkAddr	adrFrom;
-	AbsTime		OldestTime = AbsTime::Max();
-	int			ChallengeToSet = -1;
 	CBytestream	bs;
 
 	//hints << "Got GetChallenge packet" << endl;
@@ -1133,32 +1174,7 @@ void GameServer::ParseGetChallenge(const SmartPointer<NetworkSocket>& tSocket, C
 		return;
 	}
 	
-	// see if we already have a challenge for this ip
-	for (i = 0;i < MAX_CHALLENGES;i++) {
-
-		if (IsNetAddrValid(tChallenges[i].Address)) {
-			if (AreNetAddrEqual(adrFrom, tChallenges[i].Address))
-				continue;
-			if (ChallengeToSet < 0 || tChallenges[i].fTime < OldestTime) {
-				OldestTime = tChallenges[i].fTime;
-				ChallengeToSet = i;
-			}
-		} else {
-			ChallengeToSet = i;
-			break;
-		}
-	}
-
-	if (ChallengeToSet >= 0) {
-
-		// overwrite the oldest
-		tChallenges[ChallengeToSet].iNum = (rand() << 16) ^ rand();
-		tChallenges[ChallengeToSet].Address = adrFrom;
-		tChallenges[ChallengeToSet].fTime = tLX->currentTime;
-		tChallenges[ChallengeToSet].sClientVersion = client_version;
-
-		i = ChallengeToSet;
-	}
+	const challenge_t& challenge = tChallenges.add(adrFrom, client_version, tLX->currentTime);
 
 	// Send the challenge details back to the client
 	tSocket->setRemoteAddress(adrFrom);
@@ -1167,7 +1183,7 @@ void GameServer::ParseGetChallenge(const SmartPointer<NetworkSocket>& tSocket, C
 	// TODO: move this out here
 	bs.writeInt(-1, 4);
 	bs.writeString("lx::challenge");
-	bs.writeInt(tChallenges[i].iNum, 4);
+	bs.writeInt(challenge.iNum, 4);
 	if( client_version != "" )
 		bs.writeString(GetFullGameName());
 	bs.Send(tSocket.get());
@@ -1280,35 +1296,12 @@ void GameServer::ParseConnect(const SmartPointer<NetworkSocket>& net_socket, CBy
 
 	// See if the challenge is valid
 	{
-		bool valid_challenge = false;
-		int i;
-		for (i = 0; i < MAX_CHALLENGES; i++) {
-			if (IsNetAddrValid(tChallenges[i].Address) && AreNetAddrEqual(adrFrom, tChallenges[i].Address)) {
-
-				if (ChallId == tChallenges[i].iNum)  { // good
-					SetNetAddrValid(tChallenges[i].Address, false); // Invalidate it here to avoid duplicate connections
-					tChallenges[i].iNum = 0;
-					valid_challenge = true;
-					break;
-				} else { // bad
-					valid_challenge = false;
-
-					// HINT: we could receive another connect packet which will contain this challenge
-					// and therefore get the worm connected twice. To avoid it, we clear the challenge here
-					SetNetAddrValid(tChallenges[i].Address, false);
-					tChallenges[i].iNum = 0;
-					if(!reconnectFrom) {
-						hints << "HINT: deleting a doubled challenge" << endl;
-					}
-					
-					// There can be more challanges from one client, if this one doesn't match,
-					// perhaps some other does
-				}
-			}
-		}
-
-		// Ran out of challenges
-		if (!reconnectFrom && i == MAX_CHALLENGES ) {
+		// HINT: we could receive another connect packet which will contain this challenge
+		// and therefore get the worm connected twice. To avoid it, the challenges of this
+		// address are removed here, also if they don't match.
+		std::string challengeVersion;
+		const ChallengeTable::TakeResult challenge = tChallenges.take(adrFrom, ChallId, &challengeVersion);
+		if (challenge == ChallengeTable::TR_NotFound && !reconnectFrom) {
 			notes << "No connection verification for client found" << endl;
 			CBytestream bytestr;
 			bytestr.writeInt(-1, 4);
@@ -1318,7 +1311,7 @@ void GameServer::ParseConnect(const SmartPointer<NetworkSocket>& net_socket, CBy
 			return;
 		}
 
-		if (!reconnectFrom && !valid_challenge)  {
+		if (challenge == ChallengeTable::TR_WrongNum && !reconnectFrom) {
 			notes << "Bad connection verification of client" << endl;
 			CBytestream bytestr;
 			bytestr.writeInt(-1, 4);
@@ -1331,7 +1324,7 @@ void GameServer::ParseConnect(const SmartPointer<NetworkSocket>& net_socket, CBy
 		if(reconnectFrom)
 			clientVersion = reconnectFrom->getClientVersion();
 		else
-			clientVersion = tChallenges[i].sClientVersion;
+			clientVersion = challengeVersion;
 	}
 
 
@@ -1705,7 +1698,7 @@ void GameServer::ParseConnect(const SmartPointer<NetworkSocket>& net_socket, CBy
 		// we already check for compatibility earlier
 		
 		if(!reconnectFrom) {
-			newcl->getShootList()->Clear();
+			newcl->getShotCursor() = cShotJournal.end();
 			newcl->getUdpFileDownloader()->allowFileRequest(false);
 		}
 		newcl->setGameReady(false);
@@ -1858,8 +1851,6 @@ void GameServer::ParseWantsJoin(const SmartPointer<NetworkSocket>& tSocket, CByt
 // Parse a query packet
 void GameServer::ParseQuery(const SmartPointer<NetworkSocket>& tSocket, CBytestream *bs, const std::string& ip) 
 {
-	CBytestream bytestr;
-
 	int num = bs->readByte();
 
 	// Ignore queries in local
@@ -1868,26 +1859,30 @@ void GameServer::ParseQuery(const SmartPointer<NetworkSocket>& tSocket, CBytestr
 	if (game.isLocalGame())
 		return;
 
-	bytestr.writeInt(-1, 4);
-	bytestr.writeString("lx::queryreturn");
-
-	// Get Port
-	size_t pos = ip.rfind(':');
-	if (pos != std::string::npos)
-		ip.substr(pos);
-	
-	//if(ip == "23401")
-	//	bytestr.writeString(OldLxCompatibleString(sName+" (private)")); // Not used anyway
-	//else
-	bytestr.writeString(OldLxCompatibleString(tLXOptions->sServerName));
-	bytestr.writeByte(game.worms()->size());
-	bytestr.writeByte(tLXOptions->iMaxPlayers);
-	bytestr.writeByte(oldLXStateInt());
-	bytestr.writeByte(num);
-	// Beta8+ info - old clients will just skip it
-	bytestr.writeString( GetGameVersion().asString() );
-	bytestr.writeByte( serverAllowsConnectDuringGame() );
-
+	if (!isReplyCached(m_queryReply)) {
+		CBytestream bytestr;
+		bytestr.writeInt(-1, 4);
+		bytestr.writeString("lx::queryreturn");
+
+		//if(ip == "23401")
+		//	bytestr.writeString(OldLxCompatibleString(sName+" (private)")); // Not used anyway
+		//else
+		bytestr.writeString(OldLxCompatibleString(tLXOptions->sServerName));
+		bytestr.writeByte(game.worms()->size());
+		bytestr.writeByte(tLXOptions->iMaxPlayers);
+		bytestr.writeByte(oldLXStateInt());
+		m_queryReply.patchPos = bytestr.GetLength();
+		bytestr.writeByte(0); // Query number, patched below
+		// Beta8+ info - old clients will just skip it
+		bytestr.writeString( GetGameVersion().asString() );
+		bytestr.writeByte( serverAllowsConnectDuringGame() );
+
+		cacheReply(m_queryReply, bytestr.data());
+	}
+
+	std::string data = m_queryReply.data;
+	data[m_queryReply.patchPos] = (char)num;
+	CBytestream bytestr(data);
 	bytestr.Send(tSocket);
 }
 
@@ -1902,68 +1897,82 @@ void GameServer::ParseGetInfo(const SmartPointer<NetworkSocket>& tSocket, CBytes
 	if (game.isLocalGame())
 		return;
 
-	CBytestream     bs;
-
-	if(bsHeader)
-		bs.Append(bsHeader);
-	else
-		bs.writeInt(-1, 4);
-	bs.writeString("lx::serverinfo");
+	if (!isReplyCached(m_infoReply)) {
+		// Everything behind the header
+		CBytestream     bs;
+		bs.writeString("lx::serverinfo");
+
+		bs.writeString(OldLxCompatibleString(tLXOptions->sServerName));
+		bs.writeByte(tLXOptions->iMaxPlayers);
+		bs.writeByte(oldLXStateInt());
+
+		// TODO: check if we should append "levels/" string here, it was like this in old code
+		bs.writeString( game.state == Game::S_Playing ? "levels/" + gameSettings[FT_Map].as<LevelInfo>()->path.get() : gameSettings[FT_Map].as<LevelInfo>()->path.get() );
+		bs.writeString(gameSettings[FT_Mod].as<ModInfo>()->name);
+		bs.writeByte(game.gameMode()->GeneralGameType());
+		bs.writeInt16(((int)gameSettings[FT_Lives] < 0) ? WRM_UNLIM : (int)gameSettings[FT_Lives]);
+		bs.writeInt16((int)gameSettings[FT_KillLimit]);
+		bs.writeInt16((int)gameSettings[FT_LoadingTime]);
+		bs.writeBool(gameSettings[FT_Bonuses]);
+
+
+		// Players, best first
+		std::vector<CWorm*> worms;
+		worms.reserve(game.worms()->size());
+		const std::vector<int>& ranked = game.roster.ranked();
+		for(size_t i = 0; i < ranked.size(); ++i)
+			if(CWorm* w = game.wormById(ranked[i], false))
+				worms.push_back(w);
+		bs.writeByte(worms.size());
+		
+		foreach(w, worms) {
+			bs.writeString(RemoveSpecialChars((*w)->getName()));
+			bs.writeInt((*w)->getScore(), 2);
+		}
 
-	bs.writeString(OldLxCompatibleString(tLXOptions->sServerName));
-	bs.writeByte(tLXOptions->iMaxPlayers);
-	bs.writeByte(oldLXStateInt());
+		// Write out lives
+		foreach(w, worms) {
+			bs.writeInt((*w)->getLives(), 2);
+		}
 
-	// TODO: check if we should append "levels/" string here, it was like this in old code
-	bs.writeString( game.state == Game::S_Playing ? "levels/" + gameSettings[FT_Map].as<LevelInfo>()->path.get() : gameSettings[FT_Map].as<LevelInfo>()->path.get() );
-	bs.writeString(gameSettings[FT_Mod].as<ModInfo>()->name);
-	bs.writeByte(game.gameMode()->GeneralGameType());
-	bs.writeInt16(((int)gameSettings[FT_Lives] < 0) ? WRM_UNLIM : (int)gameSettings[FT_Lives]);
-	bs.writeInt16((int)gameSettings[FT_KillLimit]);
-	bs.writeInt16((int)gameSettings[FT_LoadingTime]);
-	bs.writeBool(gameSettings[FT_Bonuses]);
+		// Write out IPs
+		foreach(w, worms) {
+			std::string addr;
+			if (NetAddrToString((*w)->getClient()->getChannel()->getAddress(), addr))  {
+				size_t pos = addr.find(':');
+				if (pos != std::string::npos)
+					addr.erase(pos, std::string::npos);
+			} else {
+				errors << "Cannot convert address for worm " << (*w)->getName() << endl;
+			}
 
+			if (addr.size() == 0)
+				addr = "0.0.0.0";
+			bs.writeString(addr);
+		}
 
-	// Players
-	bs.writeByte(game.worms()->size());
-	
-	for_each_iterator(CWorm*, w, game.worms()) {
-		bs.writeString(RemoveSpecialChars(w->get()->getName()));
-		bs.writeInt(w->get()->getScore(), 2);
-	}
+		// Write out my version (we do this since Beta5)
+		bs.writeString(GetFullGameName());
 
-	// Write out lives
-	for_each_iterator(CWorm*, w, game.worms()) {
-		bs.writeInt(w->get()->getLives(), 2);
-	}
+		// since Beta7
+		bs.writeFloat(gameSettings[FT_GameSpeed]);
+		
+		// since Beta9
+		CServerNetEngineBeta9::WriteFeatureSettings(&bs, Version());
 
-	// Write out IPs
-	for_each_iterator(CWorm*, w, game.worms()) {
-		std::string addr;
-		if (NetAddrToString(w->get()->getClient()->getChannel()->getAddress(), addr))  {
-			size_t pos = addr.find(':');
-			if (pos != std::string::npos)
-				addr.erase(pos, std::string::npos);
-		} else {
-			errors << "Cannot convert address for worm " << w->get()->getName() << endl;
-		}
+		// Game mode name
+		bs.writeString(game.gameMode()->Name());
 
-		if (addr.size() == 0)
-			addr = "0.0.0.0";
-		bs.writeString(addr);
+		cacheReply(m_infoReply, bs.data());
 	}
 
-	// Write out my version (we do this since Beta5)
-	bs.writeString(GetFullGameName());
-
-	// since Beta7
-	bs.writeFloat(gameSettings[FT_GameSpeed]);
-	
-	// since Beta9
-	CServerNetEngineBeta9::WriteFeatureSettings(&bs, Version());
+	CBytestream     bs;
 
-	// Game mode name
-	bs.writeString(game.gameMode()->Name());
+	if(bsHeader)
+		bs.Append(bsHeader);
+	else
+		bs.writeInt(-1, 4);
+	bs.writeData(m_infoReply.data);
 
 	bs.Send(tSocket);
 }
@@ -445,6 +445,9 @@ bool GameServer::SendUpdate()
 		}
 	}
 
+	// Everything shot since the last update goes into one segment
+	cShotJournal.seal();
+
 	size_t uploadAmount = 0;
 
 	{
@@ -557,15 +560,14 @@ bool GameServer::SendUpdate()
 			}
 						
 			// Send the shootlist (reliable)
-			CShootList *sh = cl->getShootList();
+			CShotJournal::Cursor& shots = cl->getShotCursor();
 			float delay = shootDelay[cl->getNetSpeed()];
 
-			if(tLX->currentTime - sh->getStartTime() > delay && sh->getNumShots() > 0) {
+			if(cShotJournal.hasPending(shots) && tLX->currentTime - cShotJournal.getPendingStartTime(shots) > delay) {
 				CBytestream shootBs;
 
-				// Send the shootlist
-				if( sh->writePacket(&shootBs, cl->getClientVersion()) )
-					sh->Clear();
+				// Send the shots, they are only encoded once for all clients
+				cShotJournal.writePacket(&shootBs, cl->getClientVersion(), shots);
 
 				if(!cl->isLocalClient())
 					uploadAmount += shootBs.GetLength();
@@ -586,6 +588,15 @@ bool GameServer::SendUpdate()
 		}		
 	}
 
+	// Forget the shots every client has got
+	{
+		CShotJournal::Cursor oldest = cShotJournal.end();
+		for (int i = 0; i < MAX_CLIENTS; i++)
+			if (cClients[i].getStatus() != NET_DISCONNECTED && cClients[i].getStatus() != NET_ZOMBIE)
+				oldest = MIN(oldest, cClients[i].getShotCursor());
+		cShotJournal.trim(oldest);
+	}
+
 	// All good
 	return true;
 }
@@ -634,6 +645,7 @@ void GameServer::SendGameStateUpdates() {
 					"Client cur/max rate: "
 					+ ftoa(firstNonlocalClientConnection()->getChannel()->getOutgoingRate()/1024.f, 1) + " / "
 					+ ftoa(maxRateForClient(firstNonlocalClientConnection())/1024.f, 1));
+		CClient::addHudDebugInfo("Client send rate: " + firstNonlocalClientConnection()->getChannel()->getSendRate().stats());
 		CClient::addHudDebugInfo("Update FPS: " + ftoa(counter.getRate()));
 		CClient::addHudDebugInfo("BandwdthHit FPS: " + ftoa(bandwidthHitCounter.getRate()));
 	}
@@ -716,8 +728,13 @@ bool GameServer::checkBandwidth(CServerConnection *cl)
 	if(cl->getNetSpeed() == 3) // local
 		return true;
 
+	// Stay below what the link of the client can take, even if it claims more
+	float maxRate = maxRateForClient(cl);
+	if(tLXOptions->bAdaptiveSendRate)
+		maxRate = MIN(maxRate, cl->getChannel()->getSendBudget());
+
 	// Are we over the clients bandwidth rate?
-	if(cl->getChannel()->getOutgoingRate() > maxRateForClient(cl))
+	if(cl->getChannel()->getOutgoingRate() > maxRate)
 		// Don't send the packet
 		return false;
 
@@ -833,6 +850,7 @@ void GameServer::UpdateGameLobby()
 	gameSettings.overwrite[FT_Mod].as<ModInfo>()->name = modName(gameSettings[FT_Mod].as<ModInfo>()->path);
 	
 	m_clientsNeedLobbyUpdate = true;
+	invalidateConnectionlessReplies();
 	m_clientsNeedLobbyUpdateTime = tLX->currentTime;
 }
 
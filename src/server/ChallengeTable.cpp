@@ -0,0 +1,89 @@
+/*
+ *  ChallengeTable.cpp
+ *  OpenLieroX
+ *
+ *  code under LGPL
+ *
+ */
+
+#include <stdlib.h>
+#include "ChallengeTable.h"
+
+
+static std::string addrKey(const NetworkAddr& addr) {
+	std::string s;
+	NetAddrToString(addr, s);
+	return s;
+}
+
+
+ChallengeTable::ChallengeTable(size_t maxSize) : m_slots(maxSize), m_pos(maxSize) {
+	clear();
+}
+
+void ChallengeTable::clear() {
+	m_byAddr.clear();
+	m_order.clear();
+	m_free.clear();
+	// Hand out the low slots first
+	for(size_t i = m_slots.size(); i > 0; --i) {
+		challenge_t& c = m_slots[i - 1];
+		SetNetAddrValid(c.Address, false);
+		c.fTime = AbsTime();
+		c.iNum = 0;
+		c.sClientVersion = "";
+		m_free.push_back(i - 1);
+	}
+}
+
+void ChallengeTable::remove(size_t slot) {
+	challenge_t& c = m_slots[slot];
+	m_byAddr.erase(m_pos[slot].byAddr);
+	m_order.erase(m_pos[slot].order);
+
+	SetNetAddrValid(c.Address, false);
+	c.iNum = 0;
+	m_free.push_back(slot);
+}
+
+const challenge_t& ChallengeTable::add(const NetworkAddr& addr, const std::string& clientVersion, const AbsTime& now) {
+	// Full, overwrite the oldest
+	if(m_free.empty())
+		remove(m_order.front());
+
+	const size_t slot = m_free.back();
+	m_free.pop_back();
+
+	challenge_t& c = m_slots[slot];
+	c.iNum = (rand() << 16) ^ rand();
+	c.Address = addr;
+	c.fTime = now;
+	c.sClientVersion = clientVersion;
+
+	m_pos[slot].byAddr = m_byAddr.insert(std::make_pair(addrKey(addr), slot));
+	m_pos[slot].order = m_order.insert(m_order.end(), slot);
+	return c;
+}
+
+ChallengeTable::TakeResult ChallengeTable::take(const NetworkAddr& addr, int num, std::string* clientVersion) {
+	const std::string key = addrKey(addr);
+
+	std::vector<size_t> slots;
+	std::pair<AddrIndex::iterator, AddrIndex::iterator> r = m_byAddr.equal_range(key);
+	for(AddrIndex::iterator it = r.first; it != r.second; ++it)
+		slots.push_back(it->second);
+	if(slots.empty())
+		return TR_NotFound;
+
+	bool found = false;
+	for(size_t i = 0; i < slots.size(); ++i) {
+		const challenge_t& c = m_slots[slots[i]];
+		if(!found && c.iNum == num) {
+			found = true;
+			if(clientVersion) *clientVersion = c.sClientVersion;
+		}
+		remove(slots[i]);
+	}
+
+	return found ? TR_Ok : TR_WrongNum;
+}
@@ -47,6 +47,10 @@
 #include "Cache.h"
 #include "AuxLib.h"
 #include "DeprecatedGUI/Menu.h"
+#include "Mutex.h"
+#include "Condition.h"
+#include "Options.h"
+#include "MathLib.h"
 
 #ifdef _MSC_VER
 #pragma warning(disable: 4996)
@@ -76,12 +80,92 @@ void DedicatedControl::Uninit() {
 
 
 
+/*
+ Binary protocol (Misc.DedicatedBinaryProtocol = true)
+ 
+ Every frame is: uint32 length (of type + payload), uint8 type, payload.
+ Integers are little endian, a string is uint32 length + bytes and a
+ string list is uint16 count + strings.
+ 
+ OLX -> script:
+   'H' hello: uint16 protocol version, uint32 signal queue size. Always the first frame.
+   'S' signals: uint16 count, then count string lists (signal name + args).
+       All signals raised in one frame are sent together, nextsignal is not needed.
+       If the queue gets full within a frame, it is sent right away, no signal is dropped.
+       A script which stops reading is stopped once Misc.DedicatedSignalQueueSize frames wait for it.
+   'R' command return: uint32 command id, string list of the return values.
+ script -> OLX:
+   'C' command: uint32 command id, string list (command name + params).
+       The params are taken as they are, no quoting needed.
+ */
+
+enum { DedBinaryProtocolVersion = 1, DedMaxFrameSize = 16 * 1024 * 1024 };
+
+static void writeUint16(std::string& s, Uint16 v) {
+	s += (char)(v & 0xff); s += (char)(v >> 8);
+}
+
+static void writeUint32(std::string& s, Uint32 v) {
+	for(int i = 0; i < 4; ++i) s += (char)((v >> (i * 8)) & 0xff);
+}
+
+static void writeBinString(std::string& s, const std::string& str) {
+	writeUint32(s, (Uint32)str.size());
+	s += str;
+}
+
+template<typename _List>
+static void writeStringList(std::string& s, const _List& l) {
+	writeUint16(s, (Uint16)l.size());
+	for(typename _List::const_iterator i = l.begin(); i != l.end(); ++i)
+		writeBinString(s, *i);
+}
+
+static bool readUint32(const std::string& s, size_t& pos, Uint32& v) {
+	if(pos + 4 > s.size()) return false;
+	v = 0;
+	for(int i = 0; i < 4; ++i) v |= (Uint32)(unsigned char)s[pos + i] << (i * 8);
+	pos += 4;
+	return true;
+}
+
+static bool readStringList(const std::string& s, size_t& pos, std::vector<std::string>& l) {
+	if(pos + 2 > s.size()) return false;
+	size_t count = (unsigned char)s[pos] | ((unsigned char)s[pos + 1] << 8);
+	pos += 2;
+	for(size_t i = 0; i < count; ++i) {
+		Uint32 len = 0;
+		if(!readUint32(s, pos, len) || pos + len > s.size()) return false;
+		l.push_back(s.substr(pos, len));
+		pos += len;
+	}
+	return true;
+}
+
+static int signalQueueSize() {
+	return MAX(16, tLXOptions->iDedicatedSignalQueueSize);
+}
+
+
 struct ScriptCmdLineIntf : CmdLineIntf {
 	Process pipe;
 	ThreadPoolItem* thread;
+	bool binary;
+	
+	// Binary mode: everything we send goes through the writer thread, so the game loop never waits for the pipe.
+	// If the script doesn't read anymore and more than signalQueueSize() frames are waiting, we stop the script.
+	ThreadPoolItem* writerThread;
+	Mutex outputMutex;
+	Condition outputCond;
+	std::string output;
+	size_t outputFrames; // in output
+	bool writing; // the writer thread is writing what it took from output
+	bool writerQuit;
+	bool outputBroken;
 	
 
-	ScriptCmdLineIntf() : thread(NULL) {
+	ScriptCmdLineIntf() : thread(NULL), binary(false), writerThread(NULL),
+		outputFrames(0), writing(false), writerQuit(false), outputBroken(false) {
 	}
 	
 	~ScriptCmdLineIntf() {
@@ -89,11 +173,14 @@ struct ScriptCmdLineIntf : CmdLineIntf {
 	}
 
 	
+	// Binary mode: the returns go to the BinaryCommandCLI of each command
 	void pushReturnArg(const std::string& str) {
+		if(binary) return;
 		pipeOut() << ":" << str << endl;
 	}
 	
 	void finalizeReturn() {
+		if(binary) return;
 		pipeOut() << "." << endl;
 	}
 
@@ -108,7 +195,10 @@ struct ScriptCmdLineIntf : CmdLineIntf {
 	}
 	
 	void closePipe() {
+		drainWriter();
+		// A write to a script which doesn't read fails now, so the writer can quit
 		pipe.close();
+		joinWriter();
 	}
 	
 	bool havePipe() {
@@ -118,11 +208,14 @@ struct ScriptCmdLineIntf : CmdLineIntf {
 	
 	
 	bool breakCurrentScript() {
+		drainWriter();
 		if(thread) {
 			notes << "waiting for pipeThread ..." << endl;
 			pipe.close();
+			joinWriter();
 			threadPool->wait(thread, NULL);
 		}
+		joinWriter();
 		thread = NULL;
 		
 		return true;
@@ -154,6 +247,20 @@ struct ScriptCmdLineIntf : CmdLineIntf {
 				return false;
 			}
 
+			binary = tLXOptions->bDedicatedBinaryProtocol;
+			if(binary) {
+				notes << "Dedicated server: using the binary protocol" << endl;
+				writerQuit = false;
+				outputBroken = false;
+				outputFrames = 0;
+				output = "";
+				writerThread = threadPool->start(&ScriptCmdLineIntf::writerThreadFunc, this, "Ded pipe writer");
+				std::string hello;
+				writeUint16(hello, DedBinaryProtocolVersion);
+				writeUint32(hello, signalQueueSize());
+				sendFrame('H', hello);
+			}
+			
 			thread = threadPool->start(&ScriptCmdLineIntf::pipeThreadFunc, this, "Ded pipe watcher");
 		}
 		else
@@ -171,6 +278,8 @@ struct ScriptCmdLineIntf : CmdLineIntf {
 	// reading lines from pipe-out and put them to pipeOutput
 	static Result pipeThreadFunc(void* o) {
 		ScriptCmdLineIntf* owner = (ScriptCmdLineIntf*)o;
+		if(owner->binary)
+			return owner->readFrames();
 
 		while(!owner->pipe.out().eof()) {
 			std::string buf;
@@ -181,6 +290,151 @@ struct ScriptCmdLineIntf : CmdLineIntf {
 		return true;
 	}
 	
+	// Binary mode: every command gets its own caller, which knows the command id.
+	// Like StartupCLI, it is also the ExecScope, so the command keeps it alive.
+	struct BinaryCommandCLI : CmdLineIntf, ExecScope {
+		ScriptCmdLineIntf* owner;
+		Uint32 id;
+		std::vector<std::string> returnArgs;
+		BinaryCommandCLI(ScriptCmdLineIntf* o, Uint32 i) : owner(o), id(i) {}
+		
+		void pushReturnArg(const std::string& str) {
+			returnArgs.push_back(str);
+		}
+		
+		void finalizeReturn() {
+			std::string payload;
+			writeUint32(payload, id);
+			writeStringList(payload, returnArgs);
+			returnArgs.clear();
+			owner->sendFrame('R', payload);
+		}
+		
+		void writeMsg(const std::string& str, CmdLineMsgType type) {
+			owner->writeMsg(str, type);
+		}
+	};
+	
+	// Binary mode: reads the command frames and splits them up already here,
+	// so the game loop only has to execute them
+	Result readFrames() {
+		std::istream& in = pipe.out();
+		while(true) {
+			char lenBuf[4];
+			if(!in.read(lenBuf, 4)) break;
+			Uint32 len = 0;
+			size_t pos = 0;
+			readUint32(std::string(lenBuf, 4), pos, len);
+			if(len == 0 || len > DedMaxFrameSize) {
+				errors << "Dedicated: invalid frame size " << len << " from script, stopping to read" << endl;
+				break;
+			}
+			
+			std::string frame(len, '\0');
+			if(!in.read(&frame[0], len)) break;
+			
+			if(frame[0] != 'C') {
+				warnings << "Dedicated: unknown frame type " << (int)(unsigned char)frame[0] << " from script" << endl;
+				continue;
+			}
+			
+			pos = 1;
+			Uint32 id = 0;
+			std::vector<std::string> args;
+			if(!readUint32(frame, pos, id) || !readStringList(frame, pos, args) || args.empty() || args[0] == "") {
+				warnings << "Dedicated: bad command frame from script" << endl;
+				// Answer anyway, the script might wait for it
+				std::string payload;
+				writeUint32(payload, id);
+				writeStringList(payload, std::vector<std::string>());
+				sendFrame('R', payload);
+				continue;
+			}
+			
+			BinaryCommandCLI* cli = new BinaryCommandCLI(this, id);
+			CmdLineIntf::Command cmd(cli, SmartPointer<ExecScope>(cli), args[0]);
+			cmd.preparsed = true;
+			cmd.params.assign(args.begin() + 1, args.end());
+			Execute(cmd);
+		}
+		return true;
+	}
+	
+	// Binary mode: queues a frame for the writer thread
+	void sendFrame(char type, const std::string& payload) {
+		std::string frame;
+		writeUint32(frame, (Uint32)payload.size() + 1);
+		frame += type;
+		frame += payload;
+		
+		{
+			Mutex::ScopedLock lock(outputMutex);
+			if(outputBroken) return;
+			if(outputFrames < (size_t)signalQueueSize()) {
+				output += frame;
+				outputFrames++;
+				outputCond.broadcast();
+				return;
+			}
+			outputBroken = true;
+			output = "";
+			outputFrames = 0;
+		}
+		errors << "Dedicated: the script doesn't read anymore, " << signalQueueSize() << " frames are waiting, stopping it" << endl;
+		pipe.close();
+	}
+	
+	// Lets the writer send what is left (e.g. the quit signal), but doesn't wait long for a script which doesn't read
+	void drainWriter() {
+		if(!writerThread) return;
+		Mutex::ScopedLock lock(outputMutex);
+		writerQuit = true;
+		outputCond.broadcast();
+		const AbsTime until = GetTime() + TimeDiff(1000);
+		while(!output.empty() || writing) {
+			const AbsTime now = GetTime();
+			if(now >= until) break;
+			outputCond.wait(outputMutex, (Uint32)(until - now).milliseconds());
+		}
+	}
+	
+	// The pipe must be closed before, otherwise we could wait forever for a blocked write
+	void joinWriter() {
+		if(!writerThread) return;
+		{
+			Mutex::ScopedLock lock(outputMutex);
+			writerQuit = true;
+			outputCond.broadcast();
+		}
+		threadPool->wait(writerThread, NULL);
+		writerThread = NULL;
+	}
+	
+	static Result writerThreadFunc(void* o) {
+		ScriptCmdLineIntf* owner = (ScriptCmdLineIntf*)o;
+		std::string buf;
+		while(true) {
+			{
+				Mutex::ScopedLock lock(owner->outputMutex);
+				while(owner->output.empty() && !owner->writerQuit)
+					owner->outputCond.wait(owner->outputMutex);
+				if(owner->output.empty()) break; // quit and everything is written
+				buf.swap(owner->output);
+				owner->outputFrames = 0;
+				owner->writing = true;
+			}
+			
+			owner->pipeOut().write(buf.data(), buf.size());
+			owner->pipeOut().flush();
+			buf.clear();
+			
+			Mutex::ScopedLock lock(owner->outputMutex);
+			owner->writing = false;
+			owner->outputCond.broadcast(); // for drainWriter()
+		}
+		return true;
+	}
+	
 };
 
 
@@ -197,19 +451,32 @@ struct DedIntern {
 	struct Signal {
 		std::string name;
 		std::list<std::string> args;
+		Signal() {}
 		Signal(const std::string& n, const std::list<std::string>& a) : name(n), args(a) {}
 	};
-	std::list<Signal> pendingSignals;
 	
+	// Signals the script didn't get yet. This is a bounded ring (Misc.DedicatedSignalQueueSize).
+	// In binary mode, a full queue is sent to the script right away. In text mode, the script
+	// has to ask for every signal with nextsignal, so if it is full, the oldest signal is dropped.
+	std::vector<Signal> pendingSignals;
+	size_t pendingSignalsStart, pendingSignalsCount;
+	
+	struct SignalStats {
+		Uint64 pushed, delivered, dropped, batches;
+		size_t highWater;
+		SignalStats() : pushed(0), delivered(0), dropped(0), batches(0), highWater(0) {}
+	} signalStats;
 	
 
 	DedIntern() :
 		scriptInterface(NULL),
 		quitSignal(false),
-		pendingSignalsMutex(NULL), waitingForNextSignal(false)
+		pendingSignalsMutex(NULL), waitingForNextSignal(false),
+		pendingSignalsStart(0), pendingSignalsCount(0)
 	{
 		dedicatedControlInstance->internData = this;
 		pendingSignalsMutex = SDL_CreateMutex();
+		pendingSignals.resize(signalQueueSize());
 
 		scriptInterface = new ScriptCmdLineIntf();
 	}
@@ -227,25 +494,89 @@ struct DedIntern {
 	}
 
 	
+	// The pending signal functions expect that pendingSignalsMutex is locked
+	
+	void queueSignal(const Signal& sig) {
+		if(pendingSignalsCount == pendingSignals.size()) {
+			if(scriptInterface->binary)
+				sendSignalBatch();
+			else {
+				warnings << "Dedicated pending signals queue got too full!" << endl;
+				popSignal();
+				signalStats.dropped++;
+			}
+		}
+		pendingSignals[(pendingSignalsStart + pendingSignalsCount) % pendingSignals.size()] = sig;
+		pendingSignalsCount++;
+		signalStats.highWater = MAX(signalStats.highWater, pendingSignalsCount);
+	}
+	
+	Signal popSignal() {
+		Signal sig;
+		std::swap(sig, pendingSignals[pendingSignalsStart]);
+		pendingSignalsStart = (pendingSignalsStart + 1) % pendingSignals.size();
+		pendingSignalsCount--;
+		return sig;
+	}
+	
+	bool nextSignal(Signal& sig) {
+		if(pendingSignalsCount == 0) return false;
+		sig = popSignal();
+		signalStats.delivered++;
+		return true;
+	}
+	
+	void clearSignals() {
+		for(; pendingSignalsCount > 0; pendingSignalsCount--) {
+			pendingSignals[pendingSignalsStart] = Signal();
+			pendingSignalsStart = (pendingSignalsStart + 1) % pendingSignals.size();
+		}
+		pendingSignalsStart = 0;
+	}
+	
+	// Binary mode: sends all pending signals in one frame
+	void sendSignalBatch() {
+		while(pendingSignalsCount > 0) {
+			std::string payload;
+			Uint16 count = 0;
+			writeUint16(payload, 0); // count, filled in below
+			Signal sig;
+			while(count < 0xffff && nextSignal(sig)) {
+				std::list<std::string> l(sig.args);
+				l.push_front(sig.name);
+				writeStringList(payload, l);
+				count++;
+			}
+			payload[0] = (char)(count & 0xff);
+			payload[1] = (char)(count >> 8);
+			scriptInterface->sendFrame('S', payload);
+			signalStats.batches++;
+		}
+	}
+	
 	void pushSignal(const std::string& name, const std::list<std::string>& args = std::list<std::string>()) {
 		if(!scriptInterface->havePipe()) return;
 		ScopedLock lock(pendingSignalsMutex);
-		if(waitingForNextSignal) {
-			if(pendingSignals.size() > 0)
+		signalStats.pushed++;
+		if(waitingForNextSignal && !scriptInterface->binary) {
+			if(pendingSignalsCount > 0)
 				errors << "Dedicated pending signals queue should be empty when the script is waiting for next signal" << endl;
 			scriptInterface->pushReturnArg(name);
 			for(std::list<std::string>::const_iterator i = args.begin(); i != args.end(); ++i)
 				scriptInterface->pushReturnArg(*i);
 			scriptInterface->finalizeReturn();
 			waitingForNextSignal = false;
+			signalStats.delivered++;
 		}
-		else {
-			pendingSignals.push_back(Signal(name, args));
-			if(pendingSignals.size() > 1000) {
-				warnings << "Dedicated pending signals queue got too full!" << endl;
-				pendingSignals.pop_front();
-			}
-		}
+		else
+			queueSignal(Signal(name, args));
+	}
+	
+	// Binary mode: called once per frame
+	void flushSignals() {
+		if(!scriptInterface->havePipe() || !scriptInterface->binary) return;
+		ScopedLock lock(pendingSignalsMutex);
+		sendSignalBatch();
 	}
 	
 	void pushSignal(const std::string& name, const std::string& arg1) {
@@ -282,7 +613,7 @@ struct DedIntern {
 	void Sig_WeaponSelections() { pushSignal("weaponselections"); }
 	void Sig_GameStarted() { pushSignal("gamestarted"); }
 	void Sig_BackToLobby() { pushSignal("backtolobby"); }
-	void Sig_Quit() { pushSignal("quit"); scriptInterface->closePipe(); }
+	void Sig_Quit() { pushSignal("quit"); flushSignals(); scriptInterface->closePipe(); }
 
 	void Sig_Connecting(const std::string& addr) { pushSignal("connecting", addr); }
 	void Sig_ConnectError(const std::string& err) { pushSignal("connecterror", err); }
@@ -387,6 +718,12 @@ struct DedIntern {
 		}
 #endif
 
+		struct FlushSignals {
+			DedIntern* ded;
+			FlushSignals(DedIntern* d) : ded(d) {}
+			~FlushSignals() { ded->flushSignals(); }
+		} flushSignalsAtEnd(this);
+		
 		switch(game.state) {
 		case Game::S_Inactive: break;
 		case Game::S_Connecting:
@@ -461,7 +798,7 @@ void DedicatedControl::ChangeScript(const std::string& filename, const std::stri
 	{
 		ScopedLock lock(internData->pendingSignalsMutex);
 		internData->waitingForNextSignal = false;
-		internData->pendingSignals.clear();
+		internData->clearSignals();
 	}
 
 	if(filename == "" || filename == "/dev/null")
@@ -477,17 +814,33 @@ bool DedicatedControl::GetNextSignal(CmdLineIntf* sender) {
 	}
 	
 	ScopedLock lock(internData->pendingSignalsMutex);
-	if(internData->pendingSignals.size() > 0) {
-		DedIntern::Signal sig = internData->pendingSignals.front();
-		internData->pendingSignals.pop_front();
+	DedIntern::Signal sig;
+	if(internData->nextSignal(sig)) {
 		sender->pushReturnArg(sig.name);
 		for(std::list<std::string>::iterator i = sig.args.begin(); i != sig.args.end(); ++i)
 			sender->pushReturnArg(*i);
 		return true;
 	}
+	else if(internData->scriptInterface->binary) {
+		// the signals are sent in batches anyway, there is nothing to wait for
+		return true;
+	}
 	else {
 		// do nothing, we will send the next signal when it arrives
 		internData->waitingForNextSignal = true;
 		return false;
 	}
 }
+
+void DedicatedControl::GetSignalQueueStats(CmdLineIntf* caller) {
+	ScopedLock lock(internData->pendingSignalsMutex);
+	const DedIntern::SignalStats& st = internData->signalStats;
+	caller->pushReturnArg("protocol " + std::string(internData->scriptInterface->binary ? "binary" : "text"));
+	caller->pushReturnArg("queued " + itoa((int)internData->pendingSignalsCount));
+	caller->pushReturnArg("capacity " + itoa((int)internData->pendingSignals.size()));
+	caller->pushReturnArg("highwater " + itoa((int)st.highWater));
+	caller->pushReturnArg("pushed " + to_string(st.pushed));
+	caller->pushReturnArg("delivered " + to_string(st.delivered));
+	caller->pushReturnArg("dropped " + to_string(st.dropped));
+	caller->pushReturnArg("batches " + to_string(st.batches));
+}
@@ -17,6 +17,7 @@
 #include "util/macros.h"
 #include "sfxdriver_openal.h"
 #include "sound_sample_openal.h"
+#include "voicepool_openal.h"
 #include "sound_sample.h"
 
 #include <boost/assign/list_inserter.hpp>
@@ -43,12 +44,15 @@ bool SfxDriverOpenAL::init()
 	ALfloat listenerOri[]={0.0,0.0,-1.0, 0.0,1.0,0.0};
 	alListenerfv(AL_ORIENTATION,listenerOri);
 
+	VoicePoolOpenAL::get().init();
+
 	hints << "OpenAL lib initialized" << endl;
 	return true;
 }
 
 void SfxDriverOpenAL::shutDown()
 {
+	VoicePoolOpenAL::get().shutDown();
 	alutExit();
 }
 
@@ -60,6 +64,7 @@ void SfxDriverOpenAL::think()
 		ALfloat listenerPos[]={listeners[i]->pos.x,listeners[i]->pos.y,(ALfloat)-SFX_LISTENER_DISTANCE };
 		//cout<<"listener x,y,z "<<listenerPos[0]<<" "<<listenerPos[1]<<" "<<listenerPos[2]<<endl;
 		alListenerfv(AL_POSITION,listenerPos);
+		VoicePoolOpenAL::get().setListener(listeners[i]->pos);
 		//multi listeners are not supported in OpenAL
 		break;
 	}
@@ -77,6 +82,8 @@ void SfxDriverOpenAL::think()
 		}
 	}
 
+	// Sends the position updates from above
+	VoicePoolOpenAL::get().think();
 }
 	
 void SfxDriverOpenAL::clear()
@@ -85,6 +92,19 @@ void SfxDriverOpenAL::clear()
 }
 
 
+static string guscon_sfx_voices(const list<string> &args)
+{
+	return VoicePoolOpenAL::get().stats();
+}
+
+void SfxDriverOpenAL::registerInConsole()
+{
+	SfxDriver::registerInConsole();
+	console.registerCommands()
+			("SFX_VOICES", guscon_sfx_voices)
+			;
+}
+
 void SfxDriverOpenAL::volumeChange()
 {
 	float v = volume();
@@ -16,6 +16,7 @@ public:
 		
 	bool init();
 	void shutDown();
+	void registerInConsole();
 	void think();
 	void volumeChange();
 	void clear();
@@ -1,6 +1,7 @@
 #ifndef DEDICATED_ONLY
 
 #include "sound_sample_openal.h"
+#include "voicepool_openal.h"
 #include "gusanos/resource_list.h"
 #include "game/CGameObject.h"
 #include "gusanos/allegro.h"
@@ -136,11 +137,17 @@ struct OpenALBuffer {
 	std::string name;
 	ALuint bufferID;
 	size_t size;
+	float playTime; // seconds
 
-	OpenALBuffer(ALuint bufid, const std::string& n) : name(n), bufferID(bufid), size(0) {
-		ALint s = 0;
+	OpenALBuffer(ALuint bufid, const std::string& n) : name(n), bufferID(bufid), size(0), playTime(0) {
+		ALint s = 0, freq = 0, channels = 0, bits = 0;
 		alGetBufferi(bufferID, AL_SIZE, &s);
 		if(s >= 0) size = s;
+		alGetBufferi(bufferID, AL_FREQUENCY, &freq);
+		alGetBufferi(bufferID, AL_CHANNELS, &channels);
+		alGetBufferi(bufferID, AL_BITS, &bits);
+		if(freq > 0 && channels > 0 && bits > 0)
+			playTime = float(size) / (freq * channels * (bits / 8));
 	}
 
 	~OpenALBuffer() {
@@ -159,10 +166,10 @@ template <> void SmartPointer_ObjectDeinit<OpenALBuffer> ( OpenALBuffer * obj )
 
 
 
-SoundSampleOpenAL::SoundSampleOpenAL(std::string const& filename)
-{	
-	m_sound = 0;
-
+SoundSampleOpenAL::SoundSampleOpenAL(std::string const& filename) :
+	m_voice(-1), m_active(false), m_startTicks(0),
+	m_pitch(1.0f), m_gain(0.7f), m_refDistance(50.0f), m_priority(PRIO_World), m_posDirty(false)
+{
 	if(!IsFileAvailable(filename))
 		// we silently ignore this
 		return;
@@ -186,38 +193,31 @@ SoundSampleOpenAL::SoundSampleOpenAL(std::string const& filename)
 	}
 	
 	buffer = new OpenALBuffer(bufferID, filename);
-	initSound();
 }
 
 SoundSampleOpenAL::~SoundSampleOpenAL()
 {
-	if ( m_sound)  
-		alDeleteSources(1,&m_sound);
+	// Must be done before the buffer can be deleted
+	VoicePoolOpenAL::get().release(this);
 }
 
-SoundSampleOpenAL::SoundSampleOpenAL(const SoundSampleOpenAL& s) {
-	m_sound = 0;
+// Copies don't get a source before they are played, see VoicePoolOpenAL
+SoundSampleOpenAL::SoundSampleOpenAL(const SoundSampleOpenAL& s) :
+	SoundSample(s), buffer(s.buffer),
+	m_voice(-1), m_active(false), m_startTicks(0),
+	m_pitch(1.0f), m_gain(0.7f), m_refDistance(50.0f), m_priority(PRIO_World), m_posDirty(false)
+{}
 
-	buffer = s.buffer;
-	if(buffer.get())
-		initSound();
+ALuint SoundSampleOpenAL::bufferID() const {
+	return buffer.get() ? buffer->bufferID : AL_NONE;
 }
 
-void SoundSampleOpenAL::initSound() {
-    ALuint sourceID = 0;                        // The OpenAL sound source
-    alGenSources(1, &sourceID);
-	
-    // Attach sound buffer to source
-    alSourcei(sourceID, AL_BUFFER, buffer->bufferID);
-	alSourcef(sourceID,AL_ROLLOFF_FACTOR,2);
-	alSourcef(sourceID,AL_GAIN,0.7f);
-	//alSourcef(	 mALSource,AL_REFERENCE_DISTANCE,20);
-    /*alSource3f(mALSource, AL_POSITION,        0.0, 0.0, 0.0);
-	 alSource3f(mALSource, AL_VELOCITY,        0.0, 0.0, 0.0);
-	 alSource3f(mALSource, AL_DIRECTION,       0.0, 0.0, 0.0);
-	 alSourcef (mALSource, AL_ROLLOFF_FACTOR,  0.0          );
-	 alSourcei (mALSource, AL_SOURCE_RELATIVE, AL_TRUE      );*/
-	m_sound=sourceID;	
+float SoundSampleOpenAL::playTime() const {
+	return buffer.get() ? buffer->playTime : 0.0f;
+}
+
+float SoundSampleOpenAL::playOffset() const {
+	return (SDL_GetTicks() - m_startTicks) * 0.001f * m_pitch;
 }
 
 size_t SoundSampleOpenAL::currentSimulatiousPlays() {
@@ -230,42 +230,34 @@ size_t SoundSampleOpenAL::currentSimulatiousPlays() {
 
 bool SoundSampleOpenAL::avail()
 {
-	return (m_sound!=0);
+	return buffer.get() && VoicePoolOpenAL::get().initialized();
 }
 
 
 void SoundSampleOpenAL::play( float pitch,float volume)
 {
-	if( m_sound ) 
+	if( avail() ) 
 	{
-		//cout<<"Play "<<endl;
-
-		float _pos[3];
-		alGetListenerfv(AL_POSITION, _pos);
-		_pos[2] = 0;
-		
-		alSourcefv( m_sound , AL_POSITION, _pos);		
-		alSourcef(	 m_sound ,AL_REFERENCE_DISTANCE,100.0/100*50); //ok?
-
-		
-		alSourcef(	 m_sound ,AL_PITCH,pitch);
-		alSourcef(	 m_sound ,AL_GAIN,volume );
-		alSourcePlay( m_sound) ;			
+		// At the listener, so it is always fully audible
+		m_pos = VoicePoolOpenAL::get().listener();
+		m_refDistance = 100.0f/100*50; //ok?
+		m_pitch = pitch;
+		m_gain = volume;
+		m_priority = PRIO_Global;
+		VoicePoolOpenAL::get().play(this);
 	}
 }
 
 
 void SoundSampleOpenAL::play2D(const Vec& pos, float loudness, float pitch)
 {
-	if( m_sound ) 
+	if( avail() ) 
 	{
-		//cout<<"Play 2D"<<endl;
-			float _pos[3] = { pos.x, pos.y, 0 };
-			//cout<<"sound: x,y: "<<pos.x<<" "<<pos.y<<endl;
-			alSourcefv( m_sound , AL_POSITION, _pos);
-			alSourcef(	 m_sound ,AL_PITCH,pitch);
-			alSourcef(	 m_sound ,AL_REFERENCE_DISTANCE,loudness/100*50); //ok?
-			alSourcePlay( m_sound) ;			
+		m_pos = pos;
+		m_pitch = pitch;
+		m_refDistance = loudness/100*50; //ok?
+		m_priority = PRIO_World;
+		VoicePoolOpenAL::get().play(this);
 	}
 }
 
@@ -277,21 +269,14 @@ void SoundSampleOpenAL::play2D(CGameObject* obj, float loudness, float pitch)
 
 bool SoundSampleOpenAL::isPlaying()
 {
-	if(!m_sound) return false;
-	
-	ALint state;
-	alGetSourcei(m_sound,AL_SOURCE_STATE,&state);
-	if (state==AL_PLAYING) 
-	{
-		return true;
-	}
-	return false; //I think
+	return VoicePoolOpenAL::get().isPlaying(this);
 }
 
 void SoundSampleOpenAL::updateObjSound(Vec& vec)
 {
-	ALfloat pos[3] = { vec.x, vec.y, 0 };
-	alSourcefv( m_sound , AL_POSITION, pos);	
+	// Sent with the next VoicePoolOpenAL::think()
+	m_pos = vec;
+	m_posDirty = true;
 }
 
 
@@ -4,6 +4,7 @@
 #include "gusanos/resource_list.h"
 #include "CVec.h"
 #include "sound_sample.h"
+#include <SDL.h>
 #ifdef __APPLE__
 #include <OpenAL/al.h>
 #else
@@ -35,11 +36,28 @@ public:
 	size_t GetMemorySize();
 	
 private:
-	
-	void initSound();
+	friend class VoicePoolOpenAL;
+
+	enum Priority { PRIO_World = 1, PRIO_Global = 2 };
+
+	ALuint bufferID() const;
+	// Length of the buffer in seconds
+	float playTime() const;
+	// Seconds of the buffer which were played since start
+	float playOffset() const;
+
 	SmartPointer<OpenALBuffer> buffer;
-	ALuint m_sound;
-	
+
+	// Playback state; the source itself is owned by VoicePoolOpenAL
+	int m_voice; // index in the voice pool, -1 if we have no source
+	bool m_active; // started and not finished, with or without a source
+	Uint32 m_startTicks;
+	Vec m_pos;
+	float m_pitch;
+	float m_gain;
+	float m_refDistance;
+	int m_priority;
+	bool m_posDirty; // m_pos was not yet sent to the source
 };
 
 #endif // SOUND_SAMPLE_OPENAL_H
@@ -0,0 +1,253 @@
+#ifndef DEDICATED_ONLY
+
+#include <cmath>
+#ifdef __APPLE__
+#include <OpenAL/al.h>
+#include <OpenAL/alc.h>
+#else
+#include <AL/al.h>
+#include <AL/alc.h>
+#endif
+
+#include "voicepool_openal.h"
+#include "sound_sample_openal.h"
+#include "sfxdriver.h"
+#include "StringUtils.h"
+#include "Debug.h"
+
+// Below this gain at the listener, a sample is not worth a source
+static const float INAUDIBLE_GAIN = 0.005f;
+// Must match what we set on every source
+static const float ROLLOFF_FACTOR = 2.0f;
+
+VoicePoolOpenAL& VoicePoolOpenAL::get()
+{
+	static VoicePoolOpenAL pool;
+	return pool;
+}
+
+void VoicePoolOpenAL::init()
+{
+	shutDown();
+
+	// Create as many as we can get, up to MaxVoices. Hardware devices can have less.
+	while(m_voices.size() < MaxVoices) {
+		alGetError();
+		Voice v;
+		v.source = 0;
+		v.owner = NULL;
+		alGenSources(1, &v.source);
+		if(alGetError() != AL_NO_ERROR || v.source == 0)
+			break;
+		alSourcef(v.source, AL_ROLLOFF_FACTOR, ROLLOFF_FACTOR);
+		m_voices.push_back(v);
+	}
+
+	m_steals = m_virtualized = m_realized = 0;
+	notes << "OpenAL voice pool: " << m_voices.size() << " sources" << endl;
+}
+
+void VoicePoolOpenAL::shutDown()
+{
+	for(size_t i = 0; i < m_voices.size(); ++i) {
+		detach(m_voices[i]);
+		alDeleteSources(1, &m_voices[i].source);
+	}
+	m_voices.clear();
+
+	for(std::set<SoundSampleOpenAL*>::iterator i = m_virtual.begin(); i != m_virtual.end(); ++i)
+		(*i)->m_active = false;
+	m_virtual.clear();
+}
+
+float VoicePoolOpenAL::audibility(const SoundSampleOpenAL* s) const
+{
+	// Like AL_INVERSE_DISTANCE_CLAMPED, the OpenAL default model
+	const Vec d = s->m_pos - m_listener;
+	const float dist = sqrtf(d.GetLength2() + SFX_LISTENER_DISTANCE * SFX_LISTENER_DISTANCE);
+	const float ref = s->m_refDistance;
+	float att = 1.0f;
+	if(dist > ref && ref > 0.0f)
+		att = ref / (ref + ROLLOFF_FACTOR * (dist - ref));
+	return s->m_gain * att;
+}
+
+bool VoicePoolOpenAL::finished(const SoundSampleOpenAL* s) const
+{
+	return s->playOffset() >= s->playTime();
+}
+
+void VoicePoolOpenAL::detach(Voice& v)
+{
+	if(v.owner) {
+		v.owner->m_voice = -1;
+		v.owner = NULL;
+	}
+	alSourceStop(v.source);
+	// The buffer may be deleted when the sample goes away
+	alSourcei(v.source, AL_BUFFER, AL_NONE);
+}
+
+int VoicePoolOpenAL::findVoice(float score, bool allowSteal)
+{
+	int lowest = -1;
+	float lowestScore = 0.0f;
+
+	for(size_t i = 0; i < m_voices.size(); ++i) {
+		Voice& v = m_voices[i];
+		if(v.owner == NULL)
+			return (int)i;
+
+		ALint state = AL_STOPPED;
+		alGetSourcei(v.source, AL_SOURCE_STATE, &state);
+		if(state != AL_PLAYING) {
+			// Finished, but nobody asked isPlaying() yet
+			v.owner->m_active = false;
+			detach(v);
+			return (int)i;
+		}
+
+		const float vScore = v.owner->m_priority * audibility(v.owner);
+		if(lowest < 0 || vScore < lowestScore) {
+			lowest = (int)i;
+			lowestScore = vScore;
+		}
+	}
+
+	if(!allowSteal || lowest < 0 || lowestScore >= score)
+		return -1;
+
+	// The stolen sample continues virtually, it can get a source back later
+	SoundSampleOpenAL* victim = m_voices[lowest].owner;
+	detach(m_voices[lowest]);
+	m_virtual.insert(victim);
+	m_steals++;
+	return lowest;
+}
+
+void VoicePoolOpenAL::bind(int idx, SoundSampleOpenAL* s, float offset)
+{
+	Voice& v = m_voices[idx];
+	v.owner = s;
+	s->m_voice = idx;
+
+	const ALfloat pos[3] = { s->m_pos.x, s->m_pos.y, 0 };
+	alSourcei(v.source, AL_BUFFER, s->bufferID());
+	alSourcefv(v.source, AL_POSITION, pos);
+	alSourcef(v.source, AL_REFERENCE_DISTANCE, s->m_refDistance);
+	alSourcef(v.source, AL_PITCH, s->m_pitch);
+	alSourcef(v.source, AL_GAIN, s->m_gain);
+	if(offset > 0.0f)
+		alSourcef(v.source, AL_SEC_OFFSET, offset);
+	s->m_posDirty = false;
+	alSourcePlay(v.source);
+}
+
+void VoicePoolOpenAL::play(SoundSampleOpenAL* s)
+{
+	if(!initialized()) return;
+
+	s->m_active = true;
+	s->m_startTicks = SDL_GetTicks();
+
+	// Restart on the source we already have
+	if(s->m_voice >= 0) {
+		alSourceStop(m_voices[s->m_voice].source);
+		bind(s->m_voice, s, 0.0f);
+		return;
+	}
+
+	m_virtual.erase(s);
+	const float aud = audibility(s);
+	int idx = -1;
+	if(aud >= INAUDIBLE_GAIN)
+		idx = findVoice(s->m_priority * aud, true);
+
+	if(idx < 0) {
+		m_virtual.insert(s);
+		m_virtualized++;
+		return;
+	}
+	bind(idx, s, 0.0f);
+}
+
+void VoicePoolOpenAL::release(SoundSampleOpenAL* s)
+{
+	if(s->m_voice >= 0 && s->m_voice < (int)m_voices.size())
+		detach(m_voices[s->m_voice]);
+	s->m_voice = -1;
+	s->m_active = false;
+	m_virtual.erase(s);
+}
+
+bool VoicePoolOpenAL::isPlaying(SoundSampleOpenAL* s)
+{
+	if(!s->m_active) return false;
+
+	if(s->m_voice >= 0) {
+		ALint state = AL_STOPPED;
+		alGetSourcei(m_voices[s->m_voice].source, AL_SOURCE_STATE, &state);
+		if(state == AL_PLAYING) return true;
+	}
+	else if(!finished(s))
+		return true;
+
+	release(s);
+	return false;
+}
+
+void VoicePoolOpenAL::think()
+{
+	if(!initialized()) return;
+
+	// Let OpenAL apply all changes of this frame at once
+	ALCcontext* context = alcGetCurrentContext();
+	if(context) alcSuspendContext(context);
+
+	for(size_t i = 0; i < m_voices.size(); ++i) {
+		SoundSampleOpenAL* s = m_voices[i].owner;
+		if(s && s->m_posDirty) {
+			const ALfloat pos[3] = { s->m_pos.x, s->m_pos.y, 0 };
+			alSourcefv(m_voices[i].source, AL_POSITION, pos);
+			s->m_posDirty = false;
+		}
+	}
+
+	for(std::set<SoundSampleOpenAL*>::iterator i = m_virtual.begin(); i != m_virtual.end(); ) {
+		SoundSampleOpenAL* s = *i;
+		if(finished(s)) {
+			s->m_active = false;
+			m_virtual.erase(i++);
+			continue;
+		}
+
+		// Don't steal here, that would make voices jump back and forth
+		const float aud = audibility(s);
+		const int idx = (aud >= INAUDIBLE_GAIN) ? findVoice(s->m_priority * aud, false) : -1;
+		if(idx < 0) {
+			++i;
+			continue;
+		}
+
+		m_virtual.erase(i++);
+		bind(idx, s, s->playOffset());
+		m_realized++;
+	}
+
+	if(context) alcProcessContext(context);
+}
+
+std::string VoicePoolOpenAL::stats() const
+{
+	size_t used = 0;
+	for(size_t i = 0; i < m_voices.size(); ++i)
+		if(m_voices[i].owner) used++;
+
+	return "sources: " + itoa(used) + "/" + itoa(m_voices.size()) +
+		", virtual: " + itoa(m_virtual.size()) +
+		", stolen: " + itoa(m_steals) +
+		", virtualized: " + itoa(m_virtualized) +
+		", got source back: " + itoa(m_realized);
+}
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef VOICEPOOL_OPENAL_H
+#define VOICEPOOL_OPENAL_H
+
+#ifdef DEDICATED_ONLY
+#error "Can't use this in dedicated server"
+#endif //DEDICATED_ONLY
+
+#include <vector>
+#include <set>
+#include <string>
+#include "CVec.h"
+#ifdef __APPLE__
+#include <OpenAL/al.h>
+#else
+#include <AL/al.h>
+#endif
+
+class SoundSampleOpenAL;
+
+/*
+	A fixed set of OpenAL sources, created once at init, shared by all playing samples.
+
+	A sample gets a source when it starts to play. If all sources are busy, the
+	voice with the lowest priority * audibility is stolen, if that is less than
+	what the new sample has. Samples which don't get a source, or which are too
+	far away to be heard at all, become virtual: their time keeps running, and
+	they get a source in think() once they are audible and a source is free.
+
+	Position updates are only stored in the sample and sent to OpenAL in one
+	batch in think().
+*/
+class VoicePoolOpenAL
+{
+public:
+	enum { MaxVoices = 32 };
+
+	static VoicePoolOpenAL& get();
+
+	void init();
+	void shutDown();
+	bool initialized() const { return !m_voices.empty(); }
+
+	void setListener(const Vec& pos) { m_listener = pos; }
+	const Vec& listener() const { return m_listener; }
+
+	// (Re)starts the sample, on a source or virtually
+	void play(SoundSampleOpenAL* s);
+	// Stops the sample and gives its source back
+	void release(SoundSampleOpenAL* s);
+	// True if the sample is still playing; releases the source if not
+	bool isPlaying(SoundSampleOpenAL* s);
+	// Once per frame: send batched updates, give sources to audible virtual voices
+	void think();
+
+	std::string stats() const;
+
+private:
+	VoicePoolOpenAL() : m_steals(0), m_virtualized(0), m_realized(0) {}
+
+	struct Voice {
+		ALuint source;
+		SoundSampleOpenAL* owner;
+	};
+
+	float audibility(const SoundSampleOpenAL* s) const;
+	int findVoice(float score, bool allowSteal);
+	void detach(Voice& v);
+	void bind(int idx, SoundSampleOpenAL* s, float offset);
+	bool finished(const SoundSampleOpenAL* s) const;
+
+	std::vector<Voice> m_voices;
+	std::set<SoundSampleOpenAL*> m_virtual;
+	Vec m_listener;
+
+	size_t m_steals;
+	size_t m_virtualized;
+	size_t m_realized;
+};
+
+#endif // VOICEPOOL_OPENAL_H
@@ -0,0 +1,7 @@
+#!/bin/bash
+
+cd "$(dirname "$0")"
+mkdir -p bin
+g++ -O2 src/*.cpp -I../../include \
+-o bin/queue_bench \
+`sdl2-config --cflags --libs` -lpthread
@@ -0,0 +1,198 @@
+/*
+	OpenLieroX
+
+	microbenchmark for the MpscQueue in include/LockFreeQueue.h
+
+	Several producer threads push timestamped items, one consumer thread pops them.
+	It is compared against a std::list guarded by a mutex, which is what the
+	command queue and the event queue used before.
+
+	code under LGPL
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <list>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <SDL.h>
+#include "LockFreeQueue.h"
+
+
+struct Item {
+	Uint64 stamp;
+	int producer;
+	int seq;
+	Item() : stamp(0), producer(-1), seq(0) {}
+};
+
+// The old way
+struct LockedListQueue {
+	Mutex mutex;
+	std::list<Item> items;
+	void push(const Item& i) { Mutex::ScopedLock lock(mutex); items.push_back(i); }
+	bool pop(Item& i) {
+		Mutex::ScopedLock lock(mutex);
+		if(items.empty()) return false;
+		i = items.front();
+		items.pop_front();
+		return true;
+	}
+};
+
+struct LockFreeQueue {
+	MpscQueue<Item> queue;
+	LockFreeQueue(unsigned int capacity) : queue(capacity) {}
+	void push(const Item& i) { queue.push(i); }
+	bool pop(Item& i) { return queue.pop(i); }
+};
+
+enum { SampleEvery = 16 };
+
+template<typename _Q>
+struct Run {
+	_Q* queue;
+	int producers;
+	int itemsPerProducer;
+	Uint64 interval; // performance counter ticks between two pushes of one producer, 0 = as fast as possible
+	SDL_atomic_t started;
+	std::vector< std::vector<Uint64> > pushLatency; // per producer
+	std::vector<Uint64> e2eLatency;
+	bool orderOk;
+};
+
+template<typename _Q>
+struct ProducerArg {
+	Run<_Q>* run;
+	int index;
+};
+
+template<typename _Q>
+static int producerFunc(void* p) {
+	ProducerArg<_Q>* arg = (ProducerArg<_Q>*)p;
+	Run<_Q>& run = *arg->run;
+	std::vector<Uint64>& lat = run.pushLatency[arg->index];
+	lat.reserve(run.itemsPerProducer / SampleEvery + 1);
+
+	// Start all at the same time, so they actually contend
+	SDL_AtomicIncRef(&run.started);
+	while(SDL_AtomicGet(&run.started) < run.producers) {}
+
+	Item item;
+	item.producer = arg->index;
+	Uint64 next = SDL_GetPerformanceCounter();
+	for(int i = 0; i < run.itemsPerProducer; ++i) {
+		if(run.interval) {
+			while(SDL_GetPerformanceCounter() < next) {}
+			next += run.interval;
+		}
+		item.seq = i;
+		item.stamp = SDL_GetPerformanceCounter();
+		run.queue->push(item);
+		if(i % SampleEvery == 0)
+			lat.push_back(SDL_GetPerformanceCounter() - item.stamp);
+	}
+	return 0;
+}
+
+static Uint64 percentile(std::vector<Uint64>& v, double p) {
+	if(v.empty()) return 0;
+	size_t i = std::min(v.size() - 1, (size_t)(p * (v.size() - 1) + 0.5));
+	std::nth_element(v.begin(), v.begin() + i, v.end());
+	return v[i];
+}
+
+template<typename _Q>
+static void runBench(const char* name, _Q& queue, int producers, int items, int rate) {
+	Run<_Q> run;
+	run.queue = &queue;
+	run.producers = producers;
+	run.itemsPerProducer = items;
+	run.interval = rate > 0 ? SDL_GetPerformanceFrequency() / rate : 0;
+	SDL_AtomicSet(&run.started, 0);
+	run.pushLatency.resize(producers);
+	run.orderOk = true;
+	run.e2eLatency.reserve((size_t)producers * items / SampleEvery + 1);
+
+	std::vector< ProducerArg<_Q> > args(producers);
+	std::vector<SDL_Thread*> threads(producers);
+	const Uint64 start = SDL_GetPerformanceCounter();
+	for(int p = 0; p < producers; ++p) {
+		args[p].run = &run;
+		args[p].index = p;
+		threads[p] = SDL_CreateThread(&producerFunc<_Q>, "producer", &args[p]);
+	}
+
+	// We are the consumer
+	std::vector<int> nextSeq(producers, 0);
+	const long long total = (long long)producers * items;
+	long long received = 0;
+	Item item;
+	while(received < total) {
+		if(!queue.pop(item)) continue;
+		if(received % SampleEvery == 0)
+			run.e2eLatency.push_back(SDL_GetPerformanceCounter() - item.stamp);
+		if(item.seq != nextSeq[item.producer]) run.orderOk = false;
+		nextSeq[item.producer] = item.seq + 1;
+		received++;
+	}
+	const Uint64 end = SDL_GetPerformanceCounter();
+
+	for(int p = 0; p < producers; ++p)
+		SDL_WaitThread(threads[p], NULL);
+
+	std::vector<Uint64> pushLat;
+	for(int p = 0; p < producers; ++p)
+		pushLat.insert(pushLat.end(), run.pushLatency[p].begin(), run.pushLatency[p].end());
+
+	const double freq = (double)SDL_GetPerformanceFrequency();
+	const double secs = (end - start) / freq;
+	const double ns = 1e9 / freq;
+	printf("%-12s %2i producers: %7.2f Mops/s, push p50 %6.0f ns p99 %8.0f ns, end-to-end p50 %9.0f ns p99 %10.0f ns%s\n",
+		name, producers, total / secs / 1e6,
+		percentile(pushLat, 0.5) * ns, percentile(pushLat, 0.99) * ns,
+		percentile(run.e2eLatency, 0.5) * ns, percentile(run.e2eLatency, 0.99) * ns,
+		run.orderOk ? "" : "  ORDER VIOLATED");
+}
+
+static void usage() {
+	printf("Usage: queue_bench [-p max_producers] [-n items_per_producer] [-c ring_capacity] [-r pushes_per_second]\n");
+	printf("Defaults: up to 8 producers (1, 2, 4, 8), 1000000 items, capacity 4096, no rate limit\n");
+	printf("Without a rate limit the producers are usually faster than the consumer, so the\n");
+	printf("end-to-end latency mostly shows the backlog. Use -r to see it for a steady load.\n");
+}
+
+int main(int argc, char** argv) {
+	int maxProducers = 8;
+	int items = 1000000;
+	int capacity = 4096;
+	int rate = 0;
+	for(int i = 1; i < argc; ++i) {
+		std::string a = argv[i];
+		if(a == "-p" && i + 1 < argc) maxProducers = atoi(argv[++i]);
+		else if(a == "-n" && i + 1 < argc) items = atoi(argv[++i]);
+		else if(a == "-c" && i + 1 < argc) capacity = atoi(argv[++i]);
+		else if(a == "-r" && i + 1 < argc) rate = atoi(argv[++i]);
+		else { usage(); return (a == "-h" || a == "--help") ? 0 : 1; }
+	}
+	if(maxProducers <= 0 || items <= 0 || capacity <= 0 || rate < 0) { usage(); return 1; }
+
+	printf("%i items per producer, ring capacity %i", items, capacity);
+	if(rate > 0) printf(", %i pushes/s per producer", rate);
+	printf("\n");
+	for(int producers = 1; producers <= maxProducers; producers *= 2) {
+		{
+			LockedListQueue q;
+			runBench("mutex+list", q, producers, items, rate);
+		}
+		{
+			LockFreeQueue q(capacity);
+			runBench("MpscQueue", q, producers, items, rate);
+			printf("%-12s %2i producers: %i of %lli pushes went to the overflow list\n",
+				"", producers, q.queue.overflowPushes(), (long long)producers * items);
+		}
+	}
+	return 0;
+}
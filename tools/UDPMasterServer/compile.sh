@@ -1,4 +1,6 @@
 #!/bin/bash
 
 mkdir -p bin
-g++ src/*.cpp -o bin/udpmasterserver
+g++ -O2 src/*.cpp -o bin/udpmasterserver
+# Loopback load generator, Linux only
+g++ -O2 loadgen/*.cpp -o bin/udp_loadgen
@@ -0,0 +1,308 @@
+
+// Load generator for the UDP masterserver
+// Simulates lots of game servers sending lx::register heartbeats and lots of
+// clients querying lx::getserverlist2, and measures the throughput on loopback.
+// Linux only (uses epoll).
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+unsigned long long GetMicroseconds()
+{
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return (unsigned long long)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+struct SimServer
+{
+	int sock;
+	unsigned long long nextHeartbeat;
+	unsigned long long lastSent;
+};
+
+struct SimClient
+{
+	int sock;
+	bool waiting;
+	unsigned long long queryStart;
+	unsigned entries;	// Server entries received for the current query
+};
+
+struct Stats
+{
+	Stats(): registersSent(0), registersAcked(0), queriesSent(0), queriesDone(0), queriesTimedOut(0),
+				listPackets(0), listEntries(0) {};
+	unsigned long long registersSent;
+	unsigned long long registersAcked;
+	unsigned long long queriesSent;
+	unsigned long long queriesDone;
+	unsigned long long queriesTimedOut;
+	unsigned long long listPackets;
+	unsigned long long listEntries;
+	std::vector< unsigned > registerLatency;	// In microseconds
+	std::vector< unsigned > queryLatency;
+};
+
+int OpenSocket()
+{
+	int s = socket( PF_INET, SOCK_DGRAM, IPPROTO_UDP );
+	if( s == -1 )
+		return -1;
+	struct sockaddr_in addr;
+	memset( &addr, 0, sizeof(addr) );
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+	addr.sin_port = 0;
+	if( bind( s, (struct sockaddr *)&addr, sizeof(addr) ) != 0 )
+	{
+		close( s );
+		return -1;
+	};
+	fcntl( s, F_SETFL, fcntl( s, F_GETFL, 0 ) | O_NONBLOCK );
+	// A full list reply is many packets, don't let the kernel drop them while we are busy sending
+	int rcvbuf = 1024 * 1024;
+	setsockopt( s, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf) );
+	return s;
+}
+
+// Counts the entries in one lx::serverlist2 packet
+unsigned CountListEntries( const char * buf, int size )
+{
+	static const std::string header = std::string("\xff\xff\xff\xfflx::serverlist2") + '\0';
+	if( size <= (int)header.size() )
+		return 0;
+	return (unsigned char)buf[ header.size() ];
+}
+
+unsigned Percentile( std::vector< unsigned > & v, double p )
+{
+	if( v.empty() )
+		return 0;
+	size_t i = std::min( v.size() - 1, (size_t)( p * ( v.size() - 1 ) + 0.5 ) );
+	std::nth_element( v.begin(), v.begin() + i, v.end() );
+	return v[i];
+}
+
+void usage()
+{
+	printf("Usage: udp_loadgen [-s servers] [-c clients] [-t seconds] [-i heartbeat_ms] [-q query_timeout_ms] [host] [port]\n");
+	printf("Defaults: 2000 servers, 200 clients, 10 seconds, heartbeat every 1000 ms, 1000 ms query timeout, 127.0.0.1 23450\n");
+}
+
+int main(int argc, char ** argv)
+{
+	int numServers = 2000;
+	int numClients = 200;
+	int seconds = 10;
+	int heartbeatMs = 1000;
+	int queryTimeoutMs = 1000;
+	std::string host = "127.0.0.1";
+	int port = 23450;
+
+	int positional = 0;
+	for( int i = 1; i < argc; i++ )
+	{
+		std::string a = argv[i];
+		if( a == "-h" || a == "--help" ) { usage(); return 0; }
+		else if( a == "-s" && i + 1 < argc ) numServers = atoi( argv[++i] );
+		else if( a == "-c" && i + 1 < argc ) numClients = atoi( argv[++i] );
+		else if( a == "-t" && i + 1 < argc ) seconds = atoi( argv[++i] );
+		else if( a == "-i" && i + 1 < argc ) heartbeatMs = atoi( argv[++i] );
+		else if( a == "-q" && i + 1 < argc ) queryTimeoutMs = atoi( argv[++i] );
+		else if( positional == 0 ) { host = a; positional++; }
+		else if( positional == 1 ) { port = atoi( a.c_str() ); positional++; }
+		else { usage(); return 1; }
+	};
+
+	if( numServers < 0 || numClients < 0 || seconds <= 0 || heartbeatMs <= 0 || queryTimeoutMs <= 0 )
+	{
+		usage();
+		return 1;
+	};
+
+	// We need one socket per simulated server and client
+	struct rlimit lim;
+	if( getrlimit( RLIMIT_NOFILE, &lim ) == 0 && lim.rlim_cur < (rlim_t)( numServers + numClients + 16 ) )
+	{
+		lim.rlim_cur = std::min( lim.rlim_max, (rlim_t)( numServers + numClients + 16 ) );
+		setrlimit( RLIMIT_NOFILE, &lim );
+	};
+
+	struct sockaddr_in master;
+	memset( &master, 0, sizeof(master) );
+	master.sin_family = AF_INET;
+	master.sin_port = htons(port);
+	master.sin_addr.s_addr = inet_addr( host.c_str() );
+
+	int epollfd = epoll_create( 1 );
+	if( epollfd == -1 )
+	{
+		printf("Error creating epoll instance\n");
+		return 1;
+	};
+
+	unsigned long long start = GetMicroseconds();
+	std::vector< SimServer > servers( numServers );
+	std::vector< SimClient > clients( numClients );
+	std::vector< int > sockOwner;	// fd -> index; servers are 0..numServers-1, clients follow
+
+	for( int i = 0; i < numServers + numClients; i++ )
+	{
+		int s = OpenSocket();
+		if( s == -1 )
+		{
+			printf("Error opening socket %i: %s\n", i, strerror(errno));
+			return 1;
+		};
+		if( s >= (int)sockOwner.size() )
+			sockOwner.resize( s + 1, -1 );
+		sockOwner[s] = i;
+		struct epoll_event ev;
+		ev.events = EPOLLIN;
+		ev.data.fd = s;
+		epoll_ctl( epollfd, EPOLL_CTL_ADD, s, &ev );
+
+		if( i < numServers )
+		{
+			servers[i].sock = s;
+			// Spread the heartbeats over the whole interval
+			servers[i].nextHeartbeat = start + (unsigned long long)heartbeatMs * 1000 * i / std::max( numServers, 1 );
+			servers[i].lastSent = 0;
+		}
+		else
+		{
+			SimClient & c = clients[ i - numServers ];
+			c.sock = s;
+			c.waiting = false;
+			c.queryStart = 0;
+			c.entries = 0;
+		};
+	};
+
+	printf("Simulating %i servers and %i clients against %s:%i for %i seconds\n", numServers, numClients, host.c_str(), port, seconds);
+
+	Stats stats;
+	const std::string getList = "\xff\xff\xff\xfflx::getserverlist2";
+	const std::string registered = "\xff\xff\xff\xfflx::registered";
+	const std::string serverList = "\xff\xff\xff\xfflx::serverlist2";
+	const unsigned long long end = start + (unsigned long long)seconds * 1000000;
+	std::vector< struct epoll_event > events( 256 );
+	char buf[1500];
+
+	while( true )
+	{
+		unsigned long long now = GetMicroseconds();
+		if( now >= end )
+			break;
+
+		// Heartbeats
+		for( int i = 0; i < numServers; i++ )
+		{
+			SimServer & s = servers[i];
+			if( now < s.nextHeartbeat )
+				continue;
+			char name[64];
+			sprintf( name, "Load test server %i", i );
+			std::string send = std::string("\xff\xff\xff\xfflx::register") + '\0' + name + '\0';
+			send += char( i % 8 );	// numplayers
+			send += char( 8 );		// maxworms
+			send += char( i % 3 );	// state
+			send += std::string("OpenLieroX/0.59_beta10") + '\0' + char(1);
+			sendto( s.sock, send.c_str(), send.size(), 0, (struct sockaddr *)&master, sizeof(master) );
+			s.lastSent = now;
+			s.nextHeartbeat = now + (unsigned long long)heartbeatMs * 1000;
+			stats.registersSent++;
+		};
+
+		// List queries, every client keeps one in flight
+		for( int i = 0; i < numClients; i++ )
+		{
+			SimClient & c = clients[i];
+			if( c.waiting )
+			{
+				// A query is done when we got all the servers or nothing more arrives
+				if( now - c.queryStart < (unsigned long long)queryTimeoutMs * 1000 )
+					continue;
+				stats.queriesTimedOut++;
+			};
+			sendto( c.sock, getList.c_str(), getList.size(), 0, (struct sockaddr *)&master, sizeof(master) );
+			c.waiting = true;
+			c.queryStart = now;
+			c.entries = 0;
+			stats.queriesSent++;
+		};
+
+		int ready = epoll_wait( epollfd, &events[0], events.size(), 1 );
+		for( int e = 0; e < ready; e++ )
+		{
+			int fd = events[e].data.fd;
+			int idx = sockOwner[fd];
+			while( true )
+			{
+				int size = recv( fd, buf, sizeof(buf), 0 );
+				if( size < 0 )
+					break;
+				now = GetMicroseconds();
+				std::string data( buf, size );
+				if( idx < numServers && data.find( registered ) == 0 )
+				{
+					stats.registersAcked++;
+					stats.registerLatency.push_back( unsigned( now - servers[idx].lastSent ) );
+				}
+				else if( idx >= numServers && data.find( serverList ) == 0 )
+				{
+					SimClient & c = clients[ idx - numServers ];
+					unsigned count = CountListEntries( buf, size );
+					stats.listPackets++;
+					stats.listEntries += count;
+					if( ! c.waiting )
+						continue;
+					c.entries += count;
+					if( c.entries >= (unsigned)numServers )
+					{
+						stats.queriesDone++;
+						stats.queryLatency.push_back( unsigned( now - c.queryStart ) );
+						c.waiting = false;
+					};
+				};
+			};
+		};
+	};
+
+	double elapsed = ( GetMicroseconds() - start ) / 1000000.0;
+	printf("\nResults after %.2f seconds:\n", elapsed);
+	printf("register:      %llu sent, %llu acked (%.0f/s), latency p50 %u us, p99 %u us\n",
+			stats.registersSent, stats.registersAcked, stats.registersAcked / elapsed,
+			Percentile( stats.registerLatency, 0.5 ), Percentile( stats.registerLatency, 0.99 ));
+	printf("getserverlist: %llu sent, %llu complete (%.0f/s), %llu timed out, latency p50 %u us, p99 %u us\n",
+			stats.queriesSent, stats.queriesDone, stats.queriesDone / elapsed, stats.queriesTimedOut,
+			Percentile( stats.queryLatency, 0.5 ), Percentile( stats.queryLatency, 0.99 ));
+	printf("serverlist:    %llu packets (%.0f/s), %llu entries (%.0f/s)\n",
+			stats.listPackets, stats.listPackets / elapsed, stats.listEntries, stats.listEntries / elapsed);
+
+	for( int i = 0; i < numServers; i++ )
+	{
+		std::string send = std::string("\xff\xff\xff\xfflx::deregister") + '\0';
+		sendto( servers[i].sock, send.c_str(), send.size(), 0, (struct sockaddr *)&master, sizeof(master) );
+		close( servers[i].sock );
+	};
+	for( int i = 0; i < numClients; i++ )
+		close( clients[i].sock );
+	close( epollfd );
+	return 0;
+};
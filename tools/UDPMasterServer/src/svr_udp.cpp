@@ -3,9 +3,10 @@
 
 #include <string>
 #include <vector>
-#include <list>
+#include <unordered_map>
 #include <stdlib.h>
 #include <stdio.h>
+#include <time.h>
 
 void signal_handler_impl(int signum);
 
@@ -19,7 +20,7 @@ void signal_handler_impl(int signum);
 typedef int socklen_t;
 
 BOOL signal_handler( DWORD signum )
-{ 
+{
 	signal_handler_impl(signum);
 	return TRUE;
 };
@@ -27,18 +28,24 @@ BOOL signal_handler( DWORD signum )
 #else
 
 #include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
 #include <sys/types.h>
 #include <sys/time.h>
 #include <sys/socket.h>
+#include <sys/select.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <signal.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
 
 void signal_handler(int signum)
 {
 	signal_handler_impl(signum);
 };
-		 
+
 #endif
 
 bool quit = false;	// Signal here on Ctrl-C
@@ -47,6 +54,14 @@ bool quit = false;	// Signal here on Ctrl-C
 int port = DEFAULT_PORT;
 int sock = -1;
 
+enum
+{
+	HOST_TIMEOUT = 2*60,		// Seconds without lx::register before the host is deleted
+	ASK_TIMEOUT = 10,			// Seconds we wait for the answer to lx::ask
+	SWEEP_INTERVAL_MS = 1000,	// How often the outdated entries are cleaned up
+	MAX_DRAIN = 256				// Max datagrams handled per wakeup, so the expiry sweep is not starved
+};
+
 void signal_handler_impl(int signum)
 {
 	printf("Caught signal %i, quitting\n", signum);
@@ -64,12 +79,19 @@ struct HostInfo
 
 	HostInfo( std::string _addr, time_t _lastping, std::string _name, int _maxworms, int _numplayers, int _state,
 				std::string _version = "OpenLieroX/0.57_beta5", bool _allowsJoinDuringGame = false ):
-		addr(_addr), lastping(_lastping), name(_name), maxworms(_maxworms), numplayers(_numplayers), state(_state), 
+		addr(_addr), lastping(_lastping), name(_name), maxworms(_maxworms), numplayers(_numplayers), state(_state),
 		version(_version), allowsJoinDuringGame(_allowsJoinDuringGame) {};
 
-	HostInfo(): lastping(0), maxworms(0), numplayers(0), state(0), 
+	HostInfo(): lastping(0), maxworms(0), numplayers(0), state(0),
 				version("OpenLieroX/0.57_beta5"), allowsJoinDuringGame(false) {};
 
+	// True if the entry would look the same in lx::serverlist
+	bool sameListing( const HostInfo & h ) const
+	{
+		return name == h.name && maxworms == h.maxworms && numplayers == h.numplayers && state == h.state &&
+				version == h.version && allowsJoinDuringGame == h.allowsJoinDuringGame;
+	};
+
 	std::string addr;
 	time_t lastping;
 	std::string name;
@@ -90,11 +112,24 @@ struct RawPacketRequest
 	time_t lastping;
 };
 
-bool AreNetAddrEqual( sockaddr_in a1, sockaddr_in a2 )
+// IP and port packed into one number, used as the key of the host and lx::ask tables
+typedef unsigned long long NetAddrKey;
+
+NetAddrKey GetNetAddrKey( sockaddr_in a )
 {
-	return a1.sin_addr.s_addr == a2.sin_addr.s_addr && a1.sin_port == a2.sin_port;
+	return ( (NetAddrKey)ntohl(a.sin_addr.s_addr) << 16 ) | ntohs(a.sin_port);
 }
 
+typedef std::unordered_map< NetAddrKey, HostInfo > HostTable;
+typedef std::unordered_multimap< NetAddrKey, RawPacketRequest > RawPacketTable;
+
+HostTable hosts;
+RawPacketTable askedRawPackets;
+
+// Pre-serialized lx::serverlist / lx::serverlist2 replies, rebuilt only after the host table changed
+std::vector< std::string > cachedServerList[2];
+bool cachedServerListValid = false;
+
 void printStr(const std::string & s)
 {
 	for(size_t f=0; f<s.size(); f++)
@@ -102,6 +137,283 @@ void printStr(const std::string & s)
 	printf("\n");
 };
 
+unsigned long long GetMilliseconds()
+{
+	#ifdef WIN32
+	return GetTickCount();
+	#else
+	struct timeval tv;
+	gettimeofday( &tv, NULL );
+	return (unsigned long long)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+	#endif
+}
+
+void BuildServerList( bool beta8, std::vector< std::string > & packets )
+{
+	packets.clear();
+	std::string response = std::string("\xff\xff\xff\xfflx::serverlist") + '\0';
+	if( beta8 )
+		response = std::string("\xff\xff\xff\xfflx::serverlist2") + '\0';
+	std::string send;
+	unsigned amount = 0;
+	for( HostTable :: const_iterator it = hosts.begin(); it != hosts.end(); it++, amount++ )
+	{
+		if( send.size() >= 255 || amount >= 255 )
+		{
+			packets.push_back( response + char((unsigned char)amount) + send );
+			amount = 0;
+			send = "";
+		};
+		const HostInfo & h = it->second;
+		send += h.addr + '\0' + h.name + '\0' +
+				char((unsigned char)h.numplayers) +
+				char((unsigned char)h.maxworms) +
+				char((unsigned char)h.state);
+		if( beta8 )
+			send += h.version + '\0' + char((unsigned char)h.allowsJoinDuringGame);
+	};
+	// Send serverlist even with 0 entries so client will know we're alive
+	packets.push_back( response + char((unsigned char)amount) + send );
+}
+
+const std::vector< std::string > & GetServerList( bool beta8 )
+{
+	if( ! cachedServerListValid )
+	{
+		BuildServerList( false, cachedServerList[0] );
+		BuildServerList( true, cachedServerList[1] );
+		cachedServerListValid = true;
+	};
+	return cachedServerList[ beta8 ? 1 : 0 ];
+}
+
+void UpdateHost( NetAddrKey key, const HostInfo & info )
+{
+	HostTable :: iterator it = hosts.find( key );
+	if( it == hosts.end() )
+	{
+		hosts.insert( HostTable :: value_type( key, info ) );
+		cachedServerListValid = false;
+		//printf("Host db updated: added: %s %s %u/%u %u\n", info.addr.c_str(), info.name.c_str(), info.numplayers, info.maxworms, info.state );
+		return;
+	};
+	// Heartbeats mostly only refresh the timestamp, keep the cached list then
+	if( ! it->second.sameListing( info ) )
+		cachedServerListValid = false;
+	it->second = info;
+}
+
+void CleanupOutdated( time_t now )
+{
+	for( HostTable :: iterator it = hosts.begin(); it != hosts.end(); )
+	{
+		if( now - it->second.lastping > HOST_TIMEOUT )
+		{
+			//printf("Host db updated: deleted: %s %s\n", it->second.addr.c_str(), it->second.name.c_str() );
+			it = hosts.erase(it);
+			cachedServerListValid = false;
+		}
+		else
+			it++;
+	};
+
+	for( RawPacketTable :: iterator it = askedRawPackets.begin(); it != askedRawPackets.end(); )
+	{
+		if( now - it->second.lastping > ASK_TIMEOUT )
+			it = askedRawPackets.erase(it);
+		else
+			it++;
+	}
+}
+
+void ProcessPacket( const std::string & data, const sockaddr_in & source, time_t lastping )
+{
+	unsigned sourcePort = ntohs(source.sin_port);
+	NetAddrKey sourceKey = GetNetAddrKey( source );
+
+	std::string srcAddr = inet_ntoa( source.sin_addr );
+	char sourceAddrBuf[128];
+	sprintf(sourceAddrBuf, "%i", sourcePort );
+	srcAddr += ":";
+	srcAddr += sourceAddrBuf;
+
+	//printf("Got msg from %s: %s\n", srcAddr.c_str(), data.c_str() );
+
+	if( data.find( "\xff\xff\xff\xfflx::getserverlist" ) == 0 )
+	{
+		bool beta8 = data.find( "\xff\xff\xff\xfflx::getserverlist2" ) == 0;
+		const std::vector< std::string > & packets = GetServerList( beta8 );
+		for( size_t i = 0; i < packets.size(); i++ )
+			sendto( sock, packets[i].c_str(), packets[i].size(), 0, (struct sockaddr *)&source, sizeof(source) );
+	}
+
+	else if( data.find( "\xff\xff\xff\xfflx::traverse" ) == 0 )
+	{
+		struct sockaddr_in dest;
+		dest.sin_family = AF_INET;
+		unsigned destPort;
+		size_t f = data.find( '\0' );
+		if( f == std::string::npos )
+			return;
+		f++;
+		if( f >= data.size() || data.find(":", f) == std::string::npos )
+			return;
+		dest.sin_addr.s_addr = inet_addr( data.substr( f, data.find(":", f) - f ).c_str() );
+		f = data.find(":", f);
+		f++;
+		destPort = atoi( data.c_str()+f );
+		dest.sin_port = htons(destPort);
+		std::string send = "\xff\xff\xff\xfflx::traverse";
+		send += '\0';
+		send += srcAddr;
+		send += '\0';
+
+		f = data.find( '\0', f );
+		if( f != std::string::npos )	// Additional data, for future OLX versions - just copy it into dest packet
+		{
+			f++;
+			send += data.substr( f );
+		};
+
+		//printf("Sending lx::traverse %s to %s:%i\n", send.c_str() + send.find('\0')+1, inet_ntoa( dest.sin_addr ), destPort );
+		sendto( sock, send.c_str(), send.size(), 0, (struct sockaddr *)&dest, sizeof(dest) );
+	}
+
+	else if( data.find( "\xff\xff\xff\xfflx::register" ) == 0 )
+	{
+		size_t f = data.find( '\0' );
+		if( f == std::string::npos )
+			return;
+		f++;
+		if( data.find( '\0', f ) == std::string::npos )
+			return;
+		std::string name = data.substr( f, data.find( '\0', f ) - f );
+		f = data.find( '\0', f );
+		if( f == std::string::npos )
+			return;
+		f++;
+		if( f + 3 > data.size() )
+			return;
+		unsigned numplayers = (unsigned char)(data[f]);
+		unsigned maxworms = (unsigned char)(data[f+1]);
+		unsigned state = (unsigned char)(data[f+2]);
+
+		HostInfo info( srcAddr, lastping, name, maxworms, numplayers, state );
+
+		// Beta8+
+		f += 3;
+		if( f < data.size() && data.find( '\0', f ) != std::string::npos )
+		{
+			std::string version = data.substr( f, data.find( '\0', f ) - f );
+			f = data.find( '\0', f );
+			f++;
+			if( f < data.size() )
+				info = HostInfo( srcAddr, lastping, name, maxworms, numplayers, state, version, (unsigned char)(data[f]) != 0 );
+		};
+
+		UpdateHost( sourceKey, info );
+
+		// Send back confirmation so host will know we're alive
+		std::string send = std::string("\xff\xff\xff\xfflx::registered") + '\0';
+		sendto( sock, send.c_str(), send.size(), 0, (struct sockaddr *)&source, sizeof(source) );
+	}
+
+	else if( data.find( "\xff\xff\xff\xfflx::deregister" ) == 0 )
+	{
+		//printf("Host db updated: deleted: %s\n", srcAddr.c_str() );
+		if( hosts.erase( sourceKey ) )
+			cachedServerListValid = false;
+		// No need in confirmation here
+	}
+
+	else if( data.find( "\xff\xff\xff\xfflx::ask" ) == 0 )
+	{
+		// Directly send given packet to server, and return back an answer
+		struct sockaddr_in dest;
+		dest.sin_family = AF_INET;
+		unsigned destPort;
+		size_t f = data.find( '\0' );
+		if( f == std::string::npos )
+			return;
+		f++;
+		if( f >= data.size() || data.find(":", f) == std::string::npos )
+			return;
+		dest.sin_addr.s_addr = inet_addr( data.substr( f, data.find(":", f) - f ).c_str() );
+		f = data.find(":", f);
+		f++;
+		destPort = atoi( data.c_str()+f );
+		dest.sin_port = htons(destPort);
+
+		f = data.find( '\0', f );
+		if( f != std::string::npos )	// Raw packet data to send to remote host
+		{
+			f++;
+			std::string send = data.substr( f );
+			//printf("Sending raw packet to %s:%i\n", inet_ntoa( dest.sin_addr ), destPort );
+			sendto( sock, send.c_str(), send.size(), 0, (struct sockaddr *)&dest, sizeof(dest) );
+			askedRawPackets.insert( RawPacketTable :: value_type( GetNetAddrKey( dest ), RawPacketRequest( source, dest, lastping ) ) );
+		};
+	}
+
+	else if( data.find( "\xff\xff\xff\xfflx::" ) == 0 )
+	{
+		// We got response for lx::ask packet, the oldest request to that host gets it
+		std::pair< RawPacketTable :: iterator, RawPacketTable :: iterator > range = askedRawPackets.equal_range( sourceKey );
+		RawPacketTable :: iterator oldest = range.second;
+		for( RawPacketTable :: iterator it = range.first; it != range.second; it++ )
+		{
+			if( oldest == range.second || it->second.lastping < oldest->second.lastping )
+				oldest = it;
+		}
+		if( oldest != range.second )
+		{
+			std::string send = "\xff\xff\xff\xfflx::answer";
+			send += '\0';
+			send += srcAddr;
+			send += '\0';
+			send += data;
+
+			const RawPacketRequest & req = oldest->second;
+			//printf("Sending raw packet answer %s:%i\n", inet_ntoa( req.src.sin_addr ), ntohs(req.src.sin_port) );
+			sendto( sock, send.c_str(), send.size(), 0, (struct sockaddr *)&req.src, sizeof(req.src) );
+		}
+	}
+}
+
+// Reads all the datagrams which are queued on the socket, returns false if there was nothing
+bool DrainSocket()
+{
+	struct sockaddr_in source;
+	socklen_t sourceLen;
+	char buf[1500];
+	std::string data;
+	bool gotAny = false;
+
+	for( int count = 0; count < MAX_DRAIN && ! quit; count++ )
+	{
+		sourceLen = sizeof(source);
+		int size = recvfrom( sock, buf, sizeof(buf)-1, 0, (struct sockaddr *)&source, &sourceLen );
+		if( size < 0 )
+			break;	// EWOULDBLOCK - queue is empty
+
+		gotAny = true;
+		data.assign( buf, size );
+		ProcessPacket( data, source, time(NULL) );
+	};
+	return gotAny;
+}
+
+bool SetNonBlocking( int s )
+{
+	#ifdef WIN32
+	u_long nonBlocking = 1;
+	return ioctlsocket( s, FIONBIO, &nonBlocking ) == 0;
+	#else
+	int flags = fcntl( s, F_GETFL, 0 );
+	return flags != -1 && fcntl( s, F_SETFL, flags | O_NONBLOCK ) == 0;
+	#endif
+}
+
 int main(int argc, char ** argv)
 {
 	#ifdef WIN32
@@ -121,257 +433,86 @@ int main(int argc, char ** argv)
 		printf("Error opening UDP socket\n");
 		return 1;
 	};
-	
+
 	struct sockaddr_in addr;
 	addr.sin_family = AF_INET;
 	addr.sin_port = htons(port);
 	addr.sin_addr.s_addr = 0;
-	
+
 	if( bind( sock, (struct sockaddr *)&addr, sizeof(addr) ) != 0 )
 	{
 		printf("Error binding UDP socket at port %i\n", port);
 		return 1;
 	};
-	
-	printf("UDP masterserver started at port %i\n", port);
-	
-	std::list< HostInfo > hosts;
-	std::list< RawPacketRequest > askedRawPackets;
-	
-	struct sockaddr_in source;
-	unsigned sourcePort;
-	socklen_t sourceLen;
-	char buf[1500];
-	std::string data;
-	
-	while( ! quit )
-	{
-		sourceLen = sizeof(source);
-		int size = recvfrom( sock, buf, sizeof(buf)-1, 0, (struct sockaddr *)&source, &sourceLen );
-		if( size == -1 )
-			continue;
 
-		time_t lastping = time(NULL);
-		
-		data.assign( buf, size );
-		
-		sourcePort = ntohs(source.sin_port);
-		
-		std::string srcAddr = inet_ntoa( source.sin_addr );
-		char sourceAddrBuf[128];
-		sprintf(sourceAddrBuf, "%i", sourcePort );
-		srcAddr += ":";
-		srcAddr += sourceAddrBuf;
-		
-		//printf("Got msg from %s: %s\n", srcAddr.c_str(), data.c_str() );
-
-		if( data.find( "\xff\xff\xff\xfflx::getserverlist" ) == 0 )
-		{
-			bool beta8 = data.find( "\xff\xff\xff\xfflx::getserverlist2" ) == 0;
-			std::string response = std::string("\xff\xff\xff\xfflx::serverlist") + '\0';
-			if( beta8 )
-				response = std::string("\xff\xff\xff\xfflx::serverlist2") + '\0';
-			std::string send;
-			unsigned amount = 0;
-			for( std::list<HostInfo> :: iterator it = hosts.begin(); it != hosts.end(); it++, amount++ )
-			{
-				if( send.size() >= 255 || amount >= 255 )
-				{
-					send = response + char((unsigned char)amount) + send;
-					sendto( sock, send.c_str(), send.size(), 0, (struct sockaddr *)&source, sizeof(source) );
-					amount = 0;
-					send = "";
-				};
-				send += it->addr + '\0' + it->name + '\0' + 
-						char((unsigned char)it->numplayers) +
-						char((unsigned char)it->maxworms) +
-						char((unsigned char)it->state);
-				if( beta8 )
-					send += it->version + '\0' + char((unsigned char)it->allowsJoinDuringGame);
-			};
-			// Send serverlist even with 0 entries so client will know we're alive
-			send = response + char((unsigned char)amount) + send;
-			//printf( "Sending lx::serverlist\n" );
-			//printStr( send );
-			sendto( sock, send.c_str(), send.size(), 0, (struct sockaddr *)&source, sizeof(source) );
-		}
-		
-		else if( data.find( "\xff\xff\xff\xfflx::traverse" ) == 0 )
-		{
-			struct sockaddr_in dest;
-			dest.sin_family = AF_INET;
-			unsigned destPort;
-			int f = data.find( '\0' );
-			if( f == std::string::npos )
-				continue;
-			f++;
-			if( f >= data.size() || data.find(":", f) == std::string::npos )
-				continue;
-			dest.sin_addr.s_addr = inet_addr( data.substr( f, data.find(":", f) - f ).c_str() );
-			f = data.find(":", f);
-			f++;
-			destPort = atoi( data.c_str()+f );
-			dest.sin_port = htons(destPort);
-			std::string send = "\xff\xff\xff\xfflx::traverse";
-			send += '\0';
-			send += srcAddr;
-			send += '\0';
+	if( ! SetNonBlocking( sock ) )
+	{
+		printf("Error setting UDP socket non-blocking\n");
+		return 1;
+	};
 
-			f = data.find( '\0', f );
-			if( f != std::string::npos )	// Additional data, for future OLX versions - just copy it into dest packet
-			{
-				f++;
-				send += data.substr( f );
-			};
+	// Bigger receive buffer, so bursts of heartbeats and list queries are not dropped by the kernel
+	int rcvbuf = 4 * 1024 * 1024;
+	setsockopt( sock, SOL_SOCKET, SO_RCVBUF, (const char *)&rcvbuf, sizeof(rcvbuf) );
 
-			//printf("Sending lx::traverse %s to %s:%i\n", send.c_str() + send.find('\0')+1, inet_ntoa( dest.sin_addr ), destPort );
-			sendto( sock, send.c_str(), send.size(), 0, (struct sockaddr *)&dest, sizeof(dest) );
-		}
-
-		else if( data.find( "\xff\xff\xff\xfflx::register" ) == 0 )
-		{
-			int f = data.find( '\0' );
-			if( f == std::string::npos )
-				continue;
-			f++;
-			if( data.find( '\0', f ) == std::string::npos )
-				continue;
-			std::string name = data.substr( f, data.find( '\0', f ) - f );
-			f = data.find( '\0', f );
-			if( f == std::string::npos )
-				continue;
-			f++;
-			if( f + 3 > data.size() )
-				continue;
-			unsigned numplayers = (unsigned char)(data[f]);
-			unsigned maxworms = (unsigned char)(data[f+1]);
-			unsigned state = (unsigned char)(data[f+2]);
-	
-			std::list<HostInfo> :: iterator it;
-			for( it = hosts.begin(); it != hosts.end(); it++ )
-			{
-				if( it->addr == srcAddr )
-				{
-					*it = HostInfo( srcAddr, lastping, name, maxworms, numplayers, state );
-					//printf("Host db updated: updated: %s %s %u/%u %u\n", srcAddr.c_str(), name.c_str(), numplayers, maxworms, state );
-					break;
-				};
-			};
-			if( it == hosts.end() )
-			{
-				hosts.push_back( HostInfo( srcAddr, lastping, name, maxworms, numplayers, state ) );
-				it == hosts.end();
-				it --; // End of list
-				//printf("Host db updated: added: %s %s %u/%u %u\n", srcAddr.c_str(), name.c_str(), numplayers, maxworms, state );
-			};
-			// Send back confirmation so host will know we're alive
-			std::string send = std::string("\xff\xff\xff\xfflx::registered") + '\0';
-			sendto( sock, send.c_str(), send.size(), 0, (struct sockaddr *)&source, sizeof(source) );
-			
-			// Beta8+
-			f += 3;
-			if( f >= data.size() || data.find( '\0', f ) == std::string::npos )
-				continue;
-			std::string version = data.substr( f, data.find( '\0', f ) - f );
-			f = data.find( '\0', f );
-			f++;
-			if( f >= data.size() )
-				continue;
-			bool allowsJoinDuringGame = (unsigned char)(data[f]);
-			*it = HostInfo( srcAddr, lastping, name, maxworms, numplayers, state, version, allowsJoinDuringGame );
-		}
-
-		else if( data.find( "\xff\xff\xff\xfflx::deregister" ) == 0 )
-		{
-			std::list<HostInfo> :: iterator it;
-			for( it = hosts.begin(); it != hosts.end(); it++ )
-			{
-				if( it->addr == srcAddr )
-				{
-					//printf("Host db updated: deleted: %s %s\n", it->addr.c_str(), it->name.c_str() );
-					hosts.erase(it);
-					break;
-				};
-			};
-			// No need in confirmation here
-		}
+	#ifdef __linux__
+	int epollfd = epoll_create( 1 );
+	if( epollfd == -1 )
+	{
+		printf("Error creating epoll instance\n");
+		return 1;
+	};
+	struct epoll_event ev;
+	ev.events = EPOLLIN;
+	ev.data.fd = sock;
+	if( epoll_ctl( epollfd, EPOLL_CTL_ADD, sock, &ev ) != 0 )
+	{
+		printf("Error adding UDP socket to epoll\n");
+		return 1;
+	};
+	#endif
 
-		else if( data.find( "\xff\xff\xff\xfflx::ask" ) == 0 )
-		{
-			// Directly send given packet to server, and return back an answer
-			struct sockaddr_in dest;
-			dest.sin_family = AF_INET;
-			unsigned destPort;
-			int f = data.find( '\0' );
-			if( f == std::string::npos )
-				continue;
-			f++;
-			if( f >= data.size() || data.find(":", f) == std::string::npos )
-				continue;
-			dest.sin_addr.s_addr = inet_addr( data.substr( f, data.find(":", f) - f ).c_str() );
-			f = data.find(":", f);
-			f++;
-			destPort = atoi( data.c_str()+f );
-			dest.sin_port = htons(destPort);
+	printf("UDP masterserver started at port %i\n", port);
 
-			f = data.find( '\0', f );
-			if( f != std::string::npos )	// Raw packet data to send to remote host
-			{
-				f++;
-				std::string send = data.substr( f );
-				//printf("Sending raw packet to %s:%i\n", inet_ntoa( dest.sin_addr ), destPort );
-				sendto( sock, send.c_str(), send.size(), 0, (struct sockaddr *)&dest, sizeof(dest) );
-				askedRawPackets.push_back( RawPacketRequest( source, dest, lastping ) );
-			};
-		}
-		
-		else if( data.find( "\xff\xff\xff\xfflx::" ) == 0 )
-		{
-			// We got response for lx::ask packet
-			for( std::list< RawPacketRequest > :: iterator it = askedRawPackets.begin(); it != askedRawPackets.end(); it++ )
-			{
-				if( AreNetAddrEqual( it->dst, source ) )
-				{
-					std::string send = "\xff\xff\xff\xfflx::answer";
-					send += '\0';
-					send += srcAddr;
-					send += '\0';
-					send += data;
-				
-					//printf("Sending raw packet answer %s:%i\n", inet_ntoa( it->src.sin_addr ), ntohs(it->src.sin_port) );
-					sendto( sock, send.c_str(), send.size(), 0, (struct sockaddr *)&it->src, sizeof(it->src) );
-
-					break;
-				}
-			}
-		}
+	unsigned long long nextSweep = GetMilliseconds() + SWEEP_INTERVAL_MS;
 
-		// Clean up outdated entries
-		for( std::list<HostInfo> :: iterator it = hosts.begin(); it != hosts.end(); it++ )
+	while( ! quit )
+	{
+		unsigned long long now = GetMilliseconds();
+		int timeout = now >= nextSweep ? 0 : int( nextSweep - now );
+
+		#ifdef __linux__
+		struct epoll_event events[1];
+		int ready = epoll_wait( epollfd, events, 1, timeout );
+		#else
+		fd_set readfds;
+		FD_ZERO( &readfds );
+		FD_SET( sock, &readfds );
+		struct timeval tv;
+		tv.tv_sec = timeout / 1000;
+		tv.tv_usec = ( timeout % 1000 ) * 1000;
+		int ready = select( sock + 1, &readfds, NULL, NULL, &tv );
+		#endif
+
+		if( ready > 0 )
+			DrainSocket();
+
+		// Timer-driven cleanup of outdated entries, independent of the packet rate
+		now = GetMilliseconds();
+		if( now >= nextSweep )
 		{
-			if( lastping - it->lastping > 2*60 )
-			{
-				//printf("Host db updated: deleted: %s %s\n", it->addr.c_str(), it->name.c_str() );
-				hosts.erase(it);
-				it = hosts.begin();
-			};
+			CleanupOutdated( time(NULL) );
+			nextSweep = now + SWEEP_INTERVAL_MS;
 		};
-
-		for( std::list< RawPacketRequest > :: iterator it = askedRawPackets.begin(); it != askedRawPackets.end(); it++ )
-		{
-			if( lastping - it->lastping > 10 )
-			{
-				askedRawPackets.erase(it);
-				it = askedRawPackets.begin();
-			}
-		}
-
 	};
 
 	#ifdef WIN32
 	closesocket(sock);
 	WSACleanup();
 	#else
+	#ifdef __linux__
+	close(epollfd);
+	#endif
 	close(sock);
 	#endif
 	return 0;